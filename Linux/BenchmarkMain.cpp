@@ -0,0 +1,227 @@
+/**
+ * BenchmarkMain.cpp
+ * Runs the benchmark headlessly on Linux, the same way the application runs it
+ * on the devices, except for what needs a window.
+ *
+ * Usage: partcat-benchmark [-profile] [workspace] [results]
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Benchmark.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
+
+using namespace std;
+
+// Where the benchmark workspace and its results are written to by default.
+#define BENCHMARK_WORKSPACE "/tmp/PartCat Benchmark"
+#define BENCHMARK_RESULTS   "/tmp/PartCat Benchmark.json"
+
+// Parts in the in-memory workspaces that the indexes are timed against and in
+// the one that is scanned for duplicates. A desktop has room for the sizes the
+// handhelds can't cope with.
+#define BENCHMARK_INDEX_PARTS     50000
+#define BENCHMARK_DUPLICATE_PARTS 100000
+
+// Same similarity the application looks for duplicates with.
+#define BENCHMARK_SIMILARITY 0.8
+
+// Switch that also profiles the memory allocations.
+#define BENCHMARK_PROFILE_SWITCH "-profile"
+
+// Helpers.
+static wstring BuildCommandLine(int argc, char *argv[]);
+static wstring Widen(const char *szString);
+static wstring WidenPath(const char *szPath);
+
+/**
+ * Benchmark's main entry point.
+ *
+ * @param  argc Number of arguments.
+ * @param  argv Arguments.
+ * @return      0 if every check passed and every budget was met.
+ */
+int main(int argc, char *argv[]) {
+	const char *szWorkspace = BENCHMARK_WORKSPACE;
+	const char *szResults = BENCHMARK_RESULTS;
+	bool bProfile = false;
+	size_t nPath = 0;
+	int i;
+
+	// Copies of ourselves started by the benchmark do their own thing.
+	wstring swCommandLine = BuildCommandLine(argc, argv);
+	if (Benchmark::IsChild(swCommandLine.c_str()))
+		return Benchmark::RunChild(swCommandLine.c_str());
+
+	// Parse the arguments.
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], BENCHMARK_PROFILE_SWITCH) == 0) {
+			bProfile = true;
+		} else if (nPath == 0) {
+			szWorkspace = argv[i];
+			nPath++;
+		} else if (nPath == 1) {
+			szResults = argv[i];
+			nPath++;
+		} else {
+			fprintf(stderr, "Usage: %s [%s] [workspace] [results]\n", argv[0],
+				BENCHMARK_PROFILE_SWITCH);
+			return 2;
+		}
+	}
+
+	// Start from a fresh workspace.
+	wstring swWorkspace = WidenPath(szWorkspace);
+	wstring swResults = WidenPath(szResults);
+	IoAccounting::Initialize();
+	Benchmark benchmark(WorkspaceGenerator::GetDefaultSettings(),
+		BENCHMARK_RUNS);
+	Directory dirBenchmark(swWorkspace.c_str());
+	Workspace wsBenchmark;
+	if (dirBenchmark.Exists())
+		dirBenchmark.DeleteRecursively();
+	if (!benchmark.Generate(swWorkspace.c_str())) {
+		fprintf(stderr, "An error occured while generating the benchmark "
+			"workspace in %s.\n", szWorkspace);
+		return 1;
+	}
+
+	// Time everything, counting only what the benchmark does.
+	IoAccounting::Reset();
+	if (bProfile)
+		AllocProfiler::Enable();
+	if (!benchmark.RunWorkspace(swWorkspace.c_str(), &wsBenchmark)) {
+		AllocProfiler::Disable();
+		fprintf(stderr, "An error occured while opening the benchmark "
+			"workspace.\n");
+		return 1;
+	}
+
+	// Check where the memory went while everything is loaded.
+	MemoryReport memory;
+	wsBenchmark.AccountMemory(&memory);
+	bool bWithinMemory = benchmark.AddMemoryReport(&memory);
+
+	benchmark.RunSearch(&wsBenchmark, BENCHMARK_QUERY);
+	benchmark.RunComponents(&wsBenchmark, BENCHMARK_SAVES);
+	benchmark.RunSaveChecks(&wsBenchmark);
+	benchmark.RunSaveAsChecks(&wsBenchmark);
+	bool bConsistent = benchmark.RunConcurrentWriters(swWorkspace.c_str(),
+		&wsBenchmark);
+	bConsistent = benchmark.RunConcurrentProcesses(swWorkspace.c_str(),
+		&wsBenchmark) && bConsistent;
+	benchmark.RunBomImport(&wsBenchmark, BENCHMARK_BOM_IMPORT_LINES);
+	benchmark.RunBomApply(&wsBenchmark, BENCHMARK_BOM_APPLY_LINES);
+	benchmark.RunHistory(swWorkspace.c_str(), BENCHMARK_HISTORY_EVENTS);
+	wsBenchmark.Close();
+	bool bWithinBudget = benchmark.AddIoReport();
+
+	// Time the indexes against a workspace that only lives in memory.
+	benchmark.RunFacets(BENCHMARK_INDEX_PARTS, BENCHMARK_INDEX_EDITS);
+	benchmark.RunSmartFolders(BENCHMARK_INDEX_PARTS, BENCHMARK_SMART_FOLDERS,
+		BENCHMARK_INDEX_EDITS);
+	benchmark.RunDuplicates(BENCHMARK_DUPLICATE_PARTS, BENCHMARK_SIMILARITY);
+
+	// Check the policies of the subsystems that don't need a workspace.
+	benchmark.RunCacheChecks();
+	benchmark.RunImageChecks();
+	benchmark.RunPrefetchChecks();
+	benchmark.RunTreeChecks();
+	benchmark.RunReclaimChecks();
+	benchmark.RunTraceChecks();
+	bool bChecksPassed = benchmark.AddChecks();
+
+	// Anything the profiler still knows about after closing was leaked.
+	size_t nLeaks = 0;
+	if (bProfile) {
+		nLeaks = AllocProfiler::GetLeakCount();
+		benchmark.AddSection(L"allocations", AllocProfiler::ToJSON());
+		AllocProfiler::Disable();
+		AllocProfiler::Reset();
+	}
+
+	// Save the results.
+	if (!benchmark.Save(swResults.c_str())) {
+		fprintf(stderr, "An error occured while saving the results to %s.\n",
+			szResults);
+		return 1;
+	}
+
+	printf("The benchmark results were saved to %s\n", szResults);
+	if (!bWithinBudget)
+		printf("Some operations went over their I/O budget.\n");
+	if (!bWithinMemory)
+		printf("Components went over their memory budget.\n");
+	if (nLeaks != 0)
+		printf("Some allocations were leaked.\n");
+	if (!bConsistent)
+		printf("Concurrent writers lost some changes.\n");
+	if (!bChecksPassed)
+		printf("Some checks failed.\n");
+
+	return (bWithinBudget && bWithinMemory && (nLeaks == 0) && bConsistent &&
+		bChecksPassed) ? 0 : 1;
+}
+
+/**
+ * Puts the arguments back together into a command line like the one Windows
+ * hands to WinMain, without the name of the program.
+ *
+ * @param  argc Number of arguments.
+ * @param  argv Arguments.
+ * @return      Every argument quoted and separated by spaces.
+ */
+static wstring BuildCommandLine(int argc, char *argv[]) {
+	wstring swCommandLine;
+
+	for (int i = 1; i < argc; i++) {
+		if (i > 1)
+			swCommandLine += L" ";
+
+		swCommandLine += L"\"";
+		swCommandLine += Widen(argv[i]);
+		swCommandLine += L"\"";
+	}
+
+	return swCommandLine;
+}
+
+/**
+ * Converts a UTF-8 string into a wide one.
+ *
+ * @param  szString UTF-8 string.
+ * @return          Wide string.
+ */
+static wstring Widen(const char *szString) {
+	int nLength = MultiByteToWideChar(CP_UTF8, 0, szString, -1, NULL, 0);
+	if (nLength <= 1)
+		return wstring();
+
+	vector<wchar_t> arrString(nLength);
+	MultiByteToWideChar(CP_UTF8, 0, szString, -1, &arrString[0], nLength);
+
+	return wstring(&arrString[0]);
+}
+
+/**
+ * Converts a native path into the kind of path the application works with.
+ *
+ * @param  szPath Path with forward slashes.
+ * @return        Wide path with backslashes.
+ */
+static wstring WidenPath(const char *szPath) {
+	wstring swPath = Widen(szPath);
+
+	for (size_t i = 0; i < swPath.length(); i++) {
+		if (swPath[i] == L'/')
+			swPath[i] = L'\\';
+	}
+
+	return swPath;
+}
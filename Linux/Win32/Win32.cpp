@@ -0,0 +1,1734 @@
+/**
+ * Win32.cpp
+ * POSIX implementation of the Win32 calls the core of the application uses.
+ *
+ * Handles point to small objects tagged with what they are. Sharing modes are
+ * emulated with advisory locks: opening a file only to read it while allowing
+ * others to read it takes a shared lock, anything else takes an exclusive one.
+ * Just like on Windows, a file that is open can't be deleted, and every lock
+ * is released when the process that holds it goes away.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "windows.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// Kinds of objects a handle can point to.
+#define OBJECT_FILE    1
+#define OBJECT_FIND    2
+#define OBJECT_THREAD  3
+#define OBJECT_PROCESS 4
+
+// Seconds between 1601 and 1970, where the file times and the epoch start.
+#define FILETIME_EPOCH_SECONDS 11644473600ULL
+#define FILETIME_TICKS_PER_SECOND 10000000ULL
+
+// Largest formatted string swprintf is trusted with.
+#define SWPRINTF_MAX_LENGTH 0x7FFFFFFF
+
+// Object behind a handle.
+typedef struct {
+	int iType;
+	int fd;
+	vector<WIN32_FIND_DATA> arrFound;
+	size_t nNextFound;
+	pthread_t thread;
+	LPTHREAD_START_ROUTINE lpStartAddress;
+	LPVOID lpParameter;
+	DWORD dwExitCode;
+	bool bJoined;
+	LONG volatile lReferences;
+	pid_t pid;
+	bool bReaped;
+} Win32Object;
+
+// Last error of each thread.
+static __thread DWORD dwLastError = ERROR_SUCCESS;
+
+// Helpers.
+static string NativePath(LPCTSTR szPath);
+static wstring WidePath(const char *szPath);
+static DWORD ErrorFromErrno(int iErrno);
+static bool FailWithErrno();
+static void FillFindData(const string &strPath, const char *szName,
+						 WIN32_FIND_DATA *data);
+static void ToFileTime(time_t tTime, FILETIME *ft);
+static void* ThreadProc(void *lpParam);
+static void ReleaseObject(Win32Object *object);
+static void ReapProcess(Win32Object *object, bool bWait);
+static vector<string> SplitCommandLine(LPCTSTR szCommandLine);
+static size_t EncodeUtf8(wchar_t wc, char *szOut);
+
+/*
+ * Files.
+ */
+
+/**
+ * Opens or creates a file.
+ *
+ * @param  lpFileName            Path of the file.
+ * @param  dwDesiredAccess       GENERIC_READ and/or GENERIC_WRITE.
+ * @param  dwShareMode           What others may do with the file meanwhile.
+ * @param  lpSecurityAttributes  Ignored.
+ * @param  dwCreationDisposition What to do if the file exists or not.
+ * @param  dwFlagsAndAttributes  Ignored.
+ * @param  hTemplateFile         Ignored.
+ * @return                       File handle or INVALID_HANDLE_VALUE.
+ */
+HANDLE CreateFile(LPCTSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+				  LPVOID lpSecurityAttributes, DWORD dwCreationDisposition,
+				  DWORD dwFlagsAndAttributes, HANDLE hTemplateFile) {
+	string strPath = NativePath(lpFileName);
+	bool bShared = (dwShareMode & FILE_SHARE_READ) &&
+		!(dwDesiredAccess & GENERIC_WRITE);
+	int iFlags;
+
+	// Access.
+	if ((dwDesiredAccess & GENERIC_READ) && (dwDesiredAccess & GENERIC_WRITE)) {
+		iFlags = O_RDWR;
+	} else if (dwDesiredAccess & GENERIC_WRITE) {
+		iFlags = O_WRONLY;
+	} else {
+		iFlags = O_RDONLY;
+	}
+
+	// Disposition.
+	switch (dwCreationDisposition) {
+	case CREATE_NEW:
+		iFlags |= O_CREAT | O_EXCL;
+		break;
+	case CREATE_ALWAYS:
+	case OPEN_ALWAYS:
+		iFlags |= O_CREAT;
+		break;
+	case OPEN_EXISTING:
+	case TRUNCATE_EXISTING:
+		break;
+	default:
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	for (;;) {
+		struct stat stOpened;
+		struct stat stPath;
+		bool bExisted = access(strPath.c_str(), F_OK) == 0;
+
+		int fd = open(strPath.c_str(), iFlags | O_CLOEXEC, 0666);
+		if (fd < 0) {
+			FailWithErrno();
+			return INVALID_HANDLE_VALUE;
+		}
+
+		// Someone else has it open in a way that doesn't let us in.
+		if (flock(fd, ((bShared) ? LOCK_SH : LOCK_EX) | LOCK_NB) != 0) {
+			close(fd);
+			SetLastError(ERROR_SHARING_VIOLATION);
+			return INVALID_HANDLE_VALUE;
+		}
+
+		// The file was deleted while we were locking it, so try again.
+		if ((fstat(fd, &stOpened) != 0) ||
+				(stat(strPath.c_str(), &stPath) != 0) ||
+				(stOpened.st_ino != stPath.st_ino) ||
+				(stOpened.st_dev != stPath.st_dev)) {
+			close(fd);
+			continue;
+		}
+
+		// Only truncate once nobody else can be reading it.
+		if ((dwCreationDisposition == CREATE_ALWAYS) ||
+				(dwCreationDisposition == TRUNCATE_EXISTING)) {
+			if (ftruncate(fd, 0) != 0) {
+				FailWithErrno();
+				close(fd);
+				return INVALID_HANDLE_VALUE;
+			}
+		}
+
+		Win32Object *object = new Win32Object;
+		object->iType = OBJECT_FILE;
+		object->fd = fd;
+		object->lReferences = 1;
+
+		SetLastError((bExisted && ((dwCreationDisposition == CREATE_ALWAYS) ||
+			(dwCreationDisposition == OPEN_ALWAYS))) ? ERROR_ALREADY_EXISTS :
+			ERROR_SUCCESS);
+		return (HANDLE)object;
+	}
+}
+
+/**
+ * Reads from a file.
+ *
+ * @param  hFile                File handle.
+ * @param  lpBuffer             Where the data will be read into.
+ * @param  nNumberOfBytesToRead Number of bytes to be read.
+ * @param  lpNumberOfBytesRead  Number of bytes that were actually read.
+ * @param  lpOverlapped         Ignored.
+ * @return                      TRUE if the operation was successful.
+ */
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+			  LPDWORD lpNumberOfBytesRead, LPVOID lpOverlapped) {
+	Win32Object *object = (Win32Object*)hFile;
+	DWORD dwRead = 0;
+
+	while (dwRead < nNumberOfBytesToRead) {
+		ssize_t lRead = read(object->fd, (char*)lpBuffer + dwRead,
+			nNumberOfBytesToRead - dwRead);
+
+		if (lRead < 0) {
+			if (errno == EINTR)
+				continue;
+
+			*lpNumberOfBytesRead = dwRead;
+			return FailWithErrno();
+		}
+		if (lRead == 0)
+			break;
+
+		dwRead += (DWORD)lRead;
+	}
+
+	*lpNumberOfBytesRead = dwRead;
+	return TRUE;
+}
+
+/**
+ * Writes to a file.
+ *
+ * @param  hFile                  File handle.
+ * @param  lpBuffer               Data to be written.
+ * @param  nNumberOfBytesToWrite  Number of bytes to be written.
+ * @param  lpNumberOfBytesWritten Number of bytes that were actually written.
+ * @param  lpOverlapped           Ignored.
+ * @return                        TRUE if the operation was successful.
+ */
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
+			   LPDWORD lpNumberOfBytesWritten, LPVOID lpOverlapped) {
+	Win32Object *object = (Win32Object*)hFile;
+	DWORD dwWritten = 0;
+
+	while (dwWritten < nNumberOfBytesToWrite) {
+		ssize_t lWritten = write(object->fd, (const char*)lpBuffer + dwWritten,
+			nNumberOfBytesToWrite - dwWritten);
+
+		if (lWritten < 0) {
+			if (errno == EINTR)
+				continue;
+
+			*lpNumberOfBytesWritten = dwWritten;
+			return FailWithErrno();
+		}
+
+		dwWritten += (DWORD)lWritten;
+	}
+
+	*lpNumberOfBytesWritten = dwWritten;
+	return TRUE;
+}
+
+/**
+ * Gets the size of a file.
+ *
+ * @param  hFile          File handle.
+ * @param  lpFileSizeHigh Upper 32 bits of the size. Can be NULL.
+ * @return                Lower 32 bits of the size or INVALID_FILE_SIZE.
+ */
+DWORD GetFileSize(HANDLE hFile, LPDWORD lpFileSizeHigh) {
+	Win32Object *object = (Win32Object*)hFile;
+	struct stat st;
+
+	if (fstat(object->fd, &st) != 0) {
+		FailWithErrno();
+		return INVALID_FILE_SIZE;
+	}
+
+	if (lpFileSizeHigh != NULL)
+		*lpFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+	return (DWORD)st.st_size;
+}
+
+/**
+ * Moves the file pointer.
+ *
+ * @param  hFile                File handle.
+ * @param  lDistanceToMove      Lower 32 bits of the distance.
+ * @param  lpDistanceToMoveHigh Upper 32 bits of the distance. Can be NULL.
+ * @param  dwMoveMethod         FILE_BEGIN, FILE_CURRENT or FILE_END.
+ * @return                      Lower 32 bits of the new position or
+ *                              INVALID_SET_FILE_POINTER.
+ */
+DWORD SetFilePointer(HANDLE hFile, LONG lDistanceToMove,
+					 PLONG lpDistanceToMoveHigh, DWORD dwMoveMethod) {
+	Win32Object *object = (Win32Object*)hFile;
+	off_t lDistance = lDistanceToMove;
+	int iWhence = SEEK_SET;
+
+	if (lpDistanceToMoveHigh != NULL) {
+		lDistance = (off_t)(((ULONGLONG)(DWORD)*lpDistanceToMoveHigh << 32) |
+			(DWORD)lDistanceToMove);
+	}
+	if (dwMoveMethod == FILE_CURRENT) {
+		iWhence = SEEK_CUR;
+	} else if (dwMoveMethod == FILE_END) {
+		iWhence = SEEK_END;
+	}
+
+	off_t lPosition = lseek(object->fd, lDistance, iWhence);
+	if (lPosition < 0) {
+		FailWithErrno();
+		return INVALID_SET_FILE_POINTER;
+	}
+
+	if (lpDistanceToMoveHigh != NULL)
+		*lpDistanceToMoveHigh = (LONG)((ULONGLONG)lPosition >> 32);
+	SetLastError(ERROR_SUCCESS);
+	return (DWORD)lPosition;
+}
+
+/**
+ * Truncates a file at the current position of the file pointer.
+ *
+ * @param  hFile File handle.
+ * @return       TRUE if the operation was successful.
+ */
+BOOL SetEndOfFile(HANDLE hFile) {
+	Win32Object *object = (Win32Object*)hFile;
+	off_t lPosition = lseek(object->fd, 0, SEEK_CUR);
+
+	if ((lPosition < 0) || (ftruncate(object->fd, lPosition) != 0))
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Flushes what was written to a file to the disk.
+ *
+ * @param  hFile File handle.
+ * @return       TRUE if the operation was successful.
+ */
+BOOL FlushFileBuffers(HANDLE hFile) {
+	Win32Object *object = (Win32Object*)hFile;
+
+	if (fsync(object->fd) != 0)
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Closes a handle.
+ *
+ * @param  hObject Handle of any kind.
+ * @return         TRUE if the operation was successful.
+ */
+BOOL CloseHandle(HANDLE hObject) {
+	Win32Object *object = (Win32Object*)hObject;
+
+	if ((object == NULL) || (hObject == INVALID_HANDLE_VALUE)) {
+		SetLastError(ERROR_INVALID_HANDLE);
+		return FALSE;
+	}
+
+	switch (object->iType) {
+	case OBJECT_FILE:
+		close(object->fd);
+		break;
+	case OBJECT_THREAD:
+		// Let the thread clean up after itself if it's still running.
+		if (!object->bJoined)
+			pthread_detach(object->thread);
+		break;
+	case OBJECT_PROCESS:
+		ReapProcess(object, false);
+		break;
+	}
+
+	ReleaseObject(object);
+	return TRUE;
+}
+
+/**
+ * Gets the attributes of a file or directory.
+ *
+ * @param  lpFileName Path of the file.
+ * @return            Attributes or INVALID_FILE_ATTRIBUTES if it doesn't exist.
+ */
+DWORD GetFileAttributes(LPCTSTR lpFileName) {
+	string strPath = NativePath(lpFileName);
+	struct stat st;
+
+	if (stat(strPath.c_str(), &st) != 0) {
+		FailWithErrno();
+		return INVALID_FILE_ATTRIBUTES;
+	}
+
+	return (S_ISDIR(st.st_mode)) ? FILE_ATTRIBUTE_DIRECTORY :
+		FILE_ATTRIBUTE_NORMAL;
+}
+
+/**
+ * Deletes a file, unless someone has it open.
+ *
+ * @param  lpFileName Path of the file.
+ * @return            TRUE if the file was deleted.
+ */
+BOOL DeleteFile(LPCTSTR lpFileName) {
+	string strPath = NativePath(lpFileName);
+	int fd = open(strPath.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0)
+		return FailWithErrno();
+
+	// Files that are open can't be deleted.
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		close(fd);
+		SetLastError(ERROR_SHARING_VIOLATION);
+		return FALSE;
+	}
+
+	int iResult = unlink(strPath.c_str());
+	close(fd);
+	if (iResult != 0)
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Moves a file or directory, failing if the destination already exists.
+ *
+ * @param  lpExistingFileName Current path.
+ * @param  lpNewFileName      New path.
+ * @return                    TRUE if the operation was successful.
+ */
+BOOL MoveFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName) {
+	string strExisting = NativePath(lpExistingFileName);
+	string strNew = NativePath(lpNewFileName);
+
+	if (access(strNew.c_str(), F_OK) == 0) {
+		SetLastError(ERROR_ALREADY_EXISTS);
+		return FALSE;
+	}
+	if (rename(strExisting.c_str(), strNew.c_str()) != 0)
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Copies a file.
+ *
+ * @param  lpExistingFileName Path of the file to be copied.
+ * @param  lpNewFileName      Path of the copy.
+ * @param  bFailIfExists      Fail if the copy already exists?
+ * @return                    TRUE if the operation was successful.
+ */
+BOOL CopyFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName,
+			  BOOL bFailIfExists) {
+	HANDLE hSource = CreateFile(lpExistingFileName, GENERIC_READ,
+		FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hSource == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	HANDLE hCopy = CreateFile(lpNewFileName, GENERIC_WRITE, 0, NULL,
+		(bFailIfExists) ? CREATE_NEW : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+		NULL);
+	if (hCopy == INVALID_HANDLE_VALUE) {
+		CloseHandle(hSource);
+		return FALSE;
+	}
+
+	char szBuffer[8192];
+	DWORD dwRead;
+	DWORD dwWritten;
+	BOOL bSuccess = TRUE;
+	while (bSuccess && ReadFile(hSource, szBuffer, sizeof(szBuffer), &dwRead,
+			NULL) && (dwRead > 0))
+		bSuccess = WriteFile(hCopy, szBuffer, dwRead, &dwWritten, NULL);
+
+	CloseHandle(hCopy);
+	CloseHandle(hSource);
+	return bSuccess;
+}
+
+/**
+ * Creates a directory.
+ *
+ * @param  lpPathName           Path of the directory.
+ * @param  lpSecurityAttributes Ignored.
+ * @return                      TRUE if the directory was created.
+ */
+BOOL CreateDirectory(LPCTSTR lpPathName, LPVOID lpSecurityAttributes) {
+	string strPath = NativePath(lpPathName);
+
+	if (mkdir(strPath.c_str(), 0777) != 0)
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Removes an empty directory.
+ *
+ * @param  lpPathName Path of the directory.
+ * @return            TRUE if the directory was removed.
+ */
+BOOL RemoveDirectory(LPCTSTR lpPathName) {
+	string strPath = NativePath(lpPathName);
+
+	if (rmdir(strPath.c_str()) != 0)
+		return FailWithErrno();
+
+	return TRUE;
+}
+
+/**
+ * Starts listing the files that match a pattern. Like on Windows CE, the "."
+ * and ".." entries are never listed.
+ *
+ * @param  lpFileName     Directory followed by a name that may have wildcards.
+ * @param  lpFindFileData First file found.
+ * @return                Search handle or INVALID_HANDLE_VALUE if nothing was
+ *                        found.
+ */
+HANDLE FindFirstFile(LPCTSTR lpFileName, LPWIN32_FIND_DATA lpFindFileData) {
+	string strPattern = NativePath(lpFileName);
+	size_t nSlash = strPattern.find_last_of('/');
+	string strDirectory = (nSlash == string::npos) ? string(".") :
+		strPattern.substr(0, nSlash);
+	string strMask = (nSlash == string::npos) ? strPattern :
+		strPattern.substr(nSlash + 1);
+	Win32Object *object = new Win32Object;
+
+	object->iType = OBJECT_FIND;
+	object->nNextFound = 0;
+	object->lReferences = 1;
+	if (strDirectory.empty())
+		strDirectory = "/";
+	if (strMask == "*.*")
+		strMask = "*";
+
+	if (strMask.find_first_of("*?") == string::npos) {
+		// Looking for a single file.
+		struct stat st;
+		if (stat(strPattern.c_str(), &st) == 0) {
+			WIN32_FIND_DATA data;
+			FillFindData(strDirectory, strMask.c_str(), &data);
+			object->arrFound.push_back(data);
+		}
+	} else {
+		DIR *dir = opendir(strDirectory.c_str());
+		if (dir == NULL) {
+			FailWithErrno();
+			delete object;
+			return INVALID_HANDLE_VALUE;
+		}
+
+		// Sort the names so that every run lists them in the same order.
+		vector<string> arrNames;
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if ((strcmp(entry->d_name, ".") == 0) ||
+					(strcmp(entry->d_name, "..") == 0))
+				continue;
+			if (fnmatch(strMask.c_str(), entry->d_name, FNM_CASEFOLD) == 0)
+				arrNames.push_back(entry->d_name);
+		}
+		closedir(dir);
+		sort(arrNames.begin(), arrNames.end());
+
+		for (size_t i = 0; i < arrNames.size(); i++) {
+			WIN32_FIND_DATA data;
+			FillFindData(strDirectory, arrNames[i].c_str(), &data);
+			object->arrFound.push_back(data);
+		}
+	}
+
+	if (object->arrFound.empty()) {
+		delete object;
+		SetLastError(ERROR_FILE_NOT_FOUND);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	*lpFindFileData = object->arrFound[object->nNextFound++];
+	return (HANDLE)object;
+}
+
+/**
+ * Gets the next file of a search.
+ *
+ * @param  hFindFile      Search handle.
+ * @param  lpFindFileData Next file found.
+ * @return                TRUE if a file was found.
+ */
+BOOL FindNextFile(HANDLE hFindFile, LPWIN32_FIND_DATA lpFindFileData) {
+	Win32Object *object = (Win32Object*)hFindFile;
+
+	if (object->nNextFound >= object->arrFound.size()) {
+		SetLastError(ERROR_NO_MORE_FILES);
+		return FALSE;
+	}
+
+	*lpFindFileData = object->arrFound[object->nNextFound++];
+	return TRUE;
+}
+
+/**
+ * Ends a search.
+ *
+ * @param  hFindFile Search handle.
+ * @return           TRUE if the operation was successful.
+ */
+BOOL FindClose(HANDLE hFindFile) {
+	return CloseHandle(hFindFile);
+}
+
+/*
+ * Errors.
+ */
+
+/**
+ * Gets the error of the last call that failed in this thread.
+ *
+ * @return Win32 error code.
+ */
+DWORD GetLastError() {
+	return dwLastError;
+}
+
+/**
+ * Sets the error of this thread.
+ *
+ * @param dwErrCode Win32 error code.
+ */
+void SetLastError(DWORD dwErrCode) {
+	dwLastError = dwErrCode;
+}
+
+/*
+ * Memory.
+ */
+
+/**
+ * Allocates memory.
+ *
+ * @param  uFlags LMEM_ZEROINIT to clear the memory.
+ * @param  uBytes Number of bytes to be allocated.
+ * @return        Allocated memory or NULL.
+ */
+HLOCAL LocalAlloc(UINT uFlags, size_t uBytes) {
+	HLOCAL hMem = (uFlags & LMEM_ZEROINIT) ? calloc(1, uBytes) : malloc(uBytes);
+
+	if (hMem == NULL)
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+	return hMem;
+}
+
+/**
+ * Frees memory allocated with LocalAlloc.
+ *
+ * @param  hMem Memory to be freed.
+ * @return      Always NULL.
+ */
+HLOCAL LocalFree(HLOCAL hMem) {
+	free(hMem);
+	return NULL;
+}
+
+/**
+ * Gets how much of the physical memory is in use.
+ *
+ * @param lpBuffer Only the memory load and the physical memory are filled in.
+ */
+void GlobalMemoryStatus(LPMEMORYSTATUS lpBuffer) {
+	struct sysinfo info;
+
+	memset(lpBuffer, 0, sizeof(MEMORYSTATUS));
+	lpBuffer->dwLength = sizeof(MEMORYSTATUS);
+	if ((sysinfo(&info) != 0) || (info.totalram == 0))
+		return;
+
+	lpBuffer->dwTotalPhys = (size_t)info.totalram * info.mem_unit;
+	lpBuffer->dwAvailPhys = (size_t)info.freeram * info.mem_unit;
+	lpBuffer->dwMemoryLoad = (DWORD)(100 - ((info.freeram * 100) /
+		info.totalram));
+}
+
+/*
+ * Graphics.
+ */
+
+/**
+ * Gets information about a graphics object. There are no graphics objects
+ * without a display, so this always fails.
+ *
+ * @param  hgdiobj   Graphics object.
+ * @param  cbBuffer  Size of the buffer.
+ * @param  lpvObject Buffer where the information would be stored.
+ * @return           Always 0.
+ */
+int GetObject(HGDIOBJ hgdiobj, int cbBuffer, LPVOID lpvObject) {
+	SetLastError(ERROR_INVALID_HANDLE);
+	return 0;
+}
+
+/**
+ * Deletes a graphics object. There are no graphics objects without a display,
+ * so there's never anything to delete.
+ *
+ * @param  hObject Graphics object.
+ * @return         TRUE if there was no object.
+ */
+BOOL DeleteObject(HGDIOBJ hObject) {
+	return hObject == NULL;
+}
+
+/*
+ * Threads.
+ */
+
+/**
+ * Starts a thread.
+ *
+ * @param  lpThreadAttributes Ignored.
+ * @param  dwStackSize        Ignored.
+ * @param  lpStartAddress     Function that will be run by the thread.
+ * @param  lpParameter        Parameter passed to the function.
+ * @param  dwCreationFlags    Ignored.
+ * @param  lpThreadId         Identifier of the thread. Can be NULL.
+ * @return                    Thread handle or NULL.
+ */
+HANDLE CreateThread(LPVOID lpThreadAttributes, size_t dwStackSize,
+					LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter,
+					DWORD dwCreationFlags, LPDWORD lpThreadId) {
+	Win32Object *object = new Win32Object;
+
+	object->iType = OBJECT_THREAD;
+	object->lpStartAddress = lpStartAddress;
+	object->lpParameter = lpParameter;
+	object->dwExitCode = STILL_ACTIVE;
+	object->bJoined = false;
+	object->lReferences = 2;
+
+	if (pthread_create(&object->thread, NULL, ThreadProc, object) != 0) {
+		delete object;
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
+	if (lpThreadId != NULL)
+		*lpThreadId = (DWORD)(ULONG_PTR)object;
+	return (HANDLE)object;
+}
+
+/**
+ * Waits for a thread or process to finish.
+ *
+ * @param  hHandle        Thread or process handle.
+ * @param  dwMilliseconds Maximum time to wait or INFINITE.
+ * @return                WAIT_OBJECT_0 if it finished or WAIT_TIMEOUT.
+ */
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds) {
+	Win32Object *object = (Win32Object*)hHandle;
+	DWORD dwStart = GetTickCount();
+
+	if (object->iType == OBJECT_THREAD) {
+		if (!object->bJoined) {
+			if (dwMilliseconds != INFINITE) {
+				while (__sync_fetch_and_add(&object->dwExitCode, 0) ==
+						STILL_ACTIVE) {
+					if ((GetTickCount() - dwStart) >= dwMilliseconds)
+						return WAIT_TIMEOUT;
+					Sleep(1);
+				}
+			}
+
+			pthread_join(object->thread, NULL);
+			object->bJoined = true;
+		}
+
+		return WAIT_OBJECT_0;
+	}
+
+	if (object->iType == OBJECT_PROCESS) {
+		while (!object->bReaped) {
+			ReapProcess(object, dwMilliseconds == INFINITE);
+			if (object->bReaped)
+				break;
+			if ((GetTickCount() - dwStart) >= dwMilliseconds)
+				return WAIT_TIMEOUT;
+			Sleep(1);
+		}
+
+		return WAIT_OBJECT_0;
+	}
+
+	SetLastError(ERROR_INVALID_HANDLE);
+	return WAIT_FAILED;
+}
+
+/**
+ * Gets an identifier of the calling thread.
+ *
+ * @return Thread identifier.
+ */
+DWORD GetCurrentThreadId() {
+	return (DWORD)(ULONG_PTR)pthread_self();
+}
+
+/**
+ * Suspends the calling thread.
+ *
+ * @param dwMilliseconds Time to sleep for.
+ */
+void Sleep(DWORD dwMilliseconds) {
+	struct timespec ts;
+
+	ts.tv_sec = dwMilliseconds / 1000;
+	ts.tv_nsec = (long)(dwMilliseconds % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0) {
+		if (errno != EINTR)
+			break;
+	}
+}
+
+/**
+ * Gets information about the system.
+ *
+ * @param lpSystemInfo Only the page size and the number of processors are
+ *                     filled in.
+ */
+void GetSystemInfo(LPSYSTEM_INFO lpSystemInfo) {
+	long lProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+
+	memset(lpSystemInfo, 0, sizeof(SYSTEM_INFO));
+	lpSystemInfo->dwPageSize = (DWORD)sysconf(_SC_PAGESIZE);
+	lpSystemInfo->dwNumberOfProcessors = (lProcessors > 0) ?
+		(DWORD)lProcessors : 1;
+}
+
+/*
+ * Processes.
+ */
+
+/**
+ * Gets the path of the running executable.
+ *
+ * @param  hModule    Must be NULL.
+ * @param  lpFilename Buffer where the path will be stored.
+ * @param  nSize      Size of the buffer in characters.
+ * @return            Length of the path or 0 if it failed.
+ */
+DWORD GetModuleFileName(HMODULE hModule, LPTSTR lpFilename, DWORD nSize) {
+	char szPath[4096];
+	ssize_t lLength = readlink("/proc/self/exe", szPath, sizeof(szPath) - 1);
+
+	if ((lLength <= 0) || (nSize == 0))
+		return FailWithErrno();
+	szPath[lLength] = '\0';
+
+	wstring swPath = WidePath(szPath);
+	if (swPath.length() >= nSize) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+
+	wcscpy(lpFilename, swPath.c_str());
+	return (DWORD)swPath.length();
+}
+
+/**
+ * Starts a process.
+ *
+ * @param  lpApplicationName    Path of the executable.
+ * @param  lpCommandLine        Arguments separated by spaces. Quotes group
+ *                              arguments with spaces in them.
+ * @param  lpProcessAttributes  Ignored.
+ * @param  lpThreadAttributes   Ignored.
+ * @param  bInheritHandles      Ignored.
+ * @param  dwCreationFlags      Ignored.
+ * @param  lpEnvironment        Ignored.
+ * @param  lpCurrentDirectory   Ignored.
+ * @param  lpStartupInfo        Ignored.
+ * @param  lpProcessInformation Handle and identifier of the process. The
+ *                              thread handle is always NULL.
+ * @return                      TRUE if the process was started.
+ */
+BOOL CreateProcess(LPCTSTR lpApplicationName, LPCTSTR lpCommandLine,
+				   LPVOID lpProcessAttributes, LPVOID lpThreadAttributes,
+				   BOOL bInheritHandles, DWORD dwCreationFlags,
+				   LPVOID lpEnvironment, LPCTSTR lpCurrentDirectory,
+				   LPVOID lpStartupInfo,
+				   LPPROCESS_INFORMATION lpProcessInformation) {
+	string strApplication = NativePath(lpApplicationName);
+	vector<string> arrArguments = SplitCommandLine(lpCommandLine);
+	vector<char*> arrArgv;
+
+	// Build the argument vector before forking.
+	arrArgv.push_back((char*)strApplication.c_str());
+	for (size_t i = 0; i < arrArguments.size(); i++)
+		arrArgv.push_back((char*)arrArguments[i].c_str());
+	arrArgv.push_back(NULL);
+
+	pid_t pid = fork();
+	if (pid < 0)
+		return FailWithErrno();
+	if (pid == 0) {
+		execv(strApplication.c_str(), &arrArgv[0]);
+		_exit(127);
+	}
+
+	Win32Object *object = new Win32Object;
+	object->iType = OBJECT_PROCESS;
+	object->pid = pid;
+	object->bReaped = false;
+	object->dwExitCode = STILL_ACTIVE;
+	object->lReferences = 1;
+
+	lpProcessInformation->hProcess = (HANDLE)object;
+	lpProcessInformation->hThread = NULL;
+	lpProcessInformation->dwProcessId = (DWORD)pid;
+	lpProcessInformation->dwThreadId = 0;
+
+	return TRUE;
+}
+
+/**
+ * Kills a process.
+ *
+ * @param  hProcess  Process handle.
+ * @param  uExitCode Exit code the process will be reported to have.
+ * @return           TRUE if the process was killed.
+ */
+BOOL TerminateProcess(HANDLE hProcess, UINT uExitCode) {
+	Win32Object *object = (Win32Object*)hProcess;
+
+	if (object->bReaped || (kill(object->pid, SIGKILL) != 0))
+		return FailWithErrno();
+
+	ReapProcess(object, true);
+	object->dwExitCode = uExitCode;
+
+	return TRUE;
+}
+
+/**
+ * Gets the exit code of a process.
+ *
+ * @param  hProcess   Process handle.
+ * @param  lpExitCode Exit code or STILL_ACTIVE if it's still running.
+ * @return            TRUE if the operation was successful.
+ */
+BOOL GetExitCodeProcess(HANDLE hProcess, LPDWORD lpExitCode) {
+	Win32Object *object = (Win32Object*)hProcess;
+
+	ReapProcess(object, false);
+	*lpExitCode = object->dwExitCode;
+
+	return TRUE;
+}
+
+/*
+ * Synchronization.
+ */
+
+/**
+ * Initializes a critical section that can be entered recursively.
+ *
+ * @param lpCriticalSection Critical section to be initialized.
+ */
+void InitializeCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+	pthread_mutexattr_t attr;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&lpCriticalSection->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+/**
+ * Destroys a critical section.
+ *
+ * @param lpCriticalSection Critical section to be destroyed.
+ */
+void DeleteCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+	pthread_mutex_destroy(&lpCriticalSection->mutex);
+}
+
+/**
+ * Enters a critical section.
+ *
+ * @param lpCriticalSection Critical section to be entered.
+ */
+void EnterCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+	pthread_mutex_lock(&lpCriticalSection->mutex);
+}
+
+/**
+ * Leaves a critical section.
+ *
+ * @param lpCriticalSection Critical section to be left.
+ */
+void LeaveCriticalSection(LPCRITICAL_SECTION lpCriticalSection) {
+	pthread_mutex_unlock(&lpCriticalSection->mutex);
+}
+
+/**
+ * Atomically increments a number.
+ *
+ * @param  lpAddend Number to be incremented.
+ * @return          Incremented value.
+ */
+LONG InterlockedIncrement(LONG volatile *lpAddend) {
+	return __sync_add_and_fetch(lpAddend, 1);
+}
+
+/**
+ * Atomically decrements a number.
+ *
+ * @param  lpAddend Number to be decremented.
+ * @return          Decremented value.
+ */
+LONG InterlockedDecrement(LONG volatile *lpAddend) {
+	return __sync_sub_and_fetch(lpAddend, 1);
+}
+
+/**
+ * Atomically replaces a number.
+ *
+ * @param  lpTarget Number to be replaced.
+ * @param  lValue   New value.
+ * @return          Previous value.
+ */
+LONG InterlockedExchange(LONG volatile *lpTarget, LONG lValue) {
+	return __sync_lock_test_and_set(lpTarget, lValue);
+}
+
+/**
+ * Atomically adds to a number.
+ *
+ * @param  lpAddend Number to be added to.
+ * @param  lValue   Value to be added.
+ * @return          Previous value.
+ */
+LONG InterlockedExchangeAdd(LONG volatile *lpAddend, LONG lValue) {
+	return __sync_fetch_and_add(lpAddend, lValue);
+}
+
+/**
+ * Allocates a thread local storage slot.
+ *
+ * @return Slot index or TLS_OUT_OF_INDEXES.
+ */
+DWORD TlsAlloc() {
+	pthread_key_t key;
+
+	if (pthread_key_create(&key, NULL) != 0)
+		return TLS_OUT_OF_INDEXES;
+
+	return (DWORD)key;
+}
+
+/**
+ * Frees a thread local storage slot.
+ *
+ * @param  dwTlsIndex Slot index.
+ * @return            TRUE if the operation was successful.
+ */
+BOOL TlsFree(DWORD dwTlsIndex) {
+	return pthread_key_delete((pthread_key_t)dwTlsIndex) == 0;
+}
+
+/**
+ * Gets the value of a thread local storage slot for this thread.
+ *
+ * @param  dwTlsIndex Slot index.
+ * @return            Value of the slot.
+ */
+LPVOID TlsGetValue(DWORD dwTlsIndex) {
+	return pthread_getspecific((pthread_key_t)dwTlsIndex);
+}
+
+/**
+ * Sets the value of a thread local storage slot for this thread.
+ *
+ * @param  dwTlsIndex Slot index.
+ * @param  lpTlsValue Value of the slot.
+ * @return            TRUE if the operation was successful.
+ */
+BOOL TlsSetValue(DWORD dwTlsIndex, LPVOID lpTlsValue) {
+	return pthread_setspecific((pthread_key_t)dwTlsIndex, lpTlsValue) == 0;
+}
+
+/*
+ * Time.
+ */
+
+/**
+ * Gets the number of milliseconds since some point in the past.
+ *
+ * @return Monotonic time in milliseconds. Wraps around just like on Windows.
+ */
+DWORD GetTickCount() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (DWORD)(((ULONGLONG)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+/**
+ * Gets the current value of the high resolution counter.
+ *
+ * @param  lpPerformanceCount Monotonic time in nanoseconds.
+ * @return                    Always TRUE.
+ */
+BOOL QueryPerformanceCounter(LARGE_INTEGER *lpPerformanceCount) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	lpPerformanceCount->QuadPart = ((LONGLONG)ts.tv_sec * 1000000000LL) +
+		ts.tv_nsec;
+
+	return TRUE;
+}
+
+/**
+ * Gets the frequency of the high resolution counter.
+ *
+ * @param  lpFrequency Ticks per second.
+ * @return             Always TRUE.
+ */
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *lpFrequency) {
+	lpFrequency->QuadPart = 1000000000LL;
+	return TRUE;
+}
+
+/**
+ * Gets the current time in UTC.
+ *
+ * @param lpSystemTime Current time.
+ */
+void GetSystemTime(LPSYSTEMTIME lpSystemTime) {
+	struct timespec ts;
+	FILETIME ft;
+	ULARGE_INTEGER uli;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uli.QuadPart = (((ULONGLONG)ts.tv_sec + FILETIME_EPOCH_SECONDS) *
+		FILETIME_TICKS_PER_SECOND) + (ts.tv_nsec / 100);
+	ft.dwLowDateTime = uli.LowPart;
+	ft.dwHighDateTime = uli.HighPart;
+
+	FileTimeToSystemTime(&ft, lpSystemTime);
+}
+
+/**
+ * Converts a calendar time to a file time.
+ *
+ * @param  lpSystemTime Calendar time in UTC.
+ * @param  lpFileTime   100-nanosecond intervals since 1601.
+ * @return              TRUE if the operation was successful.
+ */
+BOOL SystemTimeToFileTime(const SYSTEMTIME *lpSystemTime,
+						  LPFILETIME lpFileTime) {
+	struct tm tmTime;
+	ULARGE_INTEGER uli;
+
+	memset(&tmTime, 0, sizeof(tmTime));
+	tmTime.tm_year = lpSystemTime->wYear - 1900;
+	tmTime.tm_mon = lpSystemTime->wMonth - 1;
+	tmTime.tm_mday = lpSystemTime->wDay;
+	tmTime.tm_hour = lpSystemTime->wHour;
+	tmTime.tm_min = lpSystemTime->wMinute;
+	tmTime.tm_sec = lpSystemTime->wSecond;
+
+	time_t tTime = timegm(&tmTime);
+	if ((lpSystemTime->wMonth < 1) || (lpSystemTime->wMonth > 12) ||
+			(tTime < -(time_t)FILETIME_EPOCH_SECONDS)) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	uli.QuadPart = ((ULONGLONG)(tTime + (time_t)FILETIME_EPOCH_SECONDS) *
+		FILETIME_TICKS_PER_SECOND) + (lpSystemTime->wMilliseconds * 10000ULL);
+	lpFileTime->dwLowDateTime = uli.LowPart;
+	lpFileTime->dwHighDateTime = uli.HighPart;
+
+	return TRUE;
+}
+
+/**
+ * Converts a file time to a calendar time.
+ *
+ * @param  lpFileTime   100-nanosecond intervals since 1601.
+ * @param  lpSystemTime Calendar time in UTC.
+ * @return              TRUE if the operation was successful.
+ */
+BOOL FileTimeToSystemTime(const FILETIME *lpFileTime,
+						  LPSYSTEMTIME lpSystemTime) {
+	ULARGE_INTEGER uli;
+	struct tm tmTime;
+
+	uli.LowPart = lpFileTime->dwLowDateTime;
+	uli.HighPart = lpFileTime->dwHighDateTime;
+	time_t tTime = (time_t)(uli.QuadPart / FILETIME_TICKS_PER_SECOND) -
+		(time_t)FILETIME_EPOCH_SECONDS;
+	if (gmtime_r(&tTime, &tmTime) == NULL) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return FALSE;
+	}
+
+	lpSystemTime->wYear = (WORD)(tmTime.tm_year + 1900);
+	lpSystemTime->wMonth = (WORD)(tmTime.tm_mon + 1);
+	lpSystemTime->wDayOfWeek = (WORD)tmTime.tm_wday;
+	lpSystemTime->wDay = (WORD)tmTime.tm_mday;
+	lpSystemTime->wHour = (WORD)tmTime.tm_hour;
+	lpSystemTime->wMinute = (WORD)tmTime.tm_min;
+	lpSystemTime->wSecond = (WORD)tmTime.tm_sec;
+	lpSystemTime->wMilliseconds = (WORD)((uli.QuadPart %
+		FILETIME_TICKS_PER_SECOND) / 10000);
+
+	return TRUE;
+}
+
+/**
+ * Compares two file times.
+ *
+ * @param  lpFileTime1 First file time.
+ * @param  lpFileTime2 Second file time.
+ * @return             -1, 0 or 1 if the first is earlier, equal or later.
+ */
+LONG CompareFileTime(const FILETIME *lpFileTime1, const FILETIME *lpFileTime2) {
+	if (lpFileTime1->dwHighDateTime != lpFileTime2->dwHighDateTime)
+		return (lpFileTime1->dwHighDateTime < lpFileTime2->dwHighDateTime) ? -1 : 1;
+	if (lpFileTime1->dwLowDateTime != lpFileTime2->dwLowDateTime)
+		return (lpFileTime1->dwLowDateTime < lpFileTime2->dwLowDateTime) ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Strings.
+ */
+
+/**
+ * Converts a narrow string to a wide one. CP_ACP is treated as Latin-1, which
+ * is what the devices use in the west.
+ *
+ * @param  CodePage       CP_ACP or CP_UTF8.
+ * @param  dwFlags        Ignored.
+ * @param  lpMultiByteStr String to be converted.
+ * @param  cbMultiByte    Length in bytes or -1 if it's NULL-terminated.
+ * @param  lpWideCharStr  Converted string. Can be NULL to get the length.
+ * @param  cchWideChar    Size of the converted string buffer.
+ * @return                Number of characters written, including the NULL
+ *                        terminator if it was part of the input.
+ */
+int MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+						int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar) {
+	const unsigned char *p = (const unsigned char*)lpMultiByteStr;
+	size_t nLength = (cbMultiByte < 0) ? strlen(lpMultiByteStr) + 1 :
+		(size_t)cbMultiByte;
+	size_t i = 0;
+	int nWritten = 0;
+
+	while (i < nLength) {
+		wchar_t wc = p[i++];
+
+		// Decode UTF-8 sequences, replacing the invalid ones.
+		if ((CodePage == CP_UTF8) && (wc >= 0x80)) {
+			int nContinuation = (wc >= 0xF0) ? 3 : (wc >= 0xE0) ? 2 :
+				(wc >= 0xC0) ? 1 : -1;
+
+			if (nContinuation < 0) {
+				wc = 0xFFFD;
+			} else {
+				wc &= 0x3F >> nContinuation;
+				while ((nContinuation-- > 0) && (i < nLength) &&
+						((p[i] & 0xC0) == 0x80))
+					wc = (wc << 6) | (p[i++] & 0x3F);
+				if (nContinuation >= 0)
+					wc = 0xFFFD;
+			}
+		}
+
+		if (lpWideCharStr != NULL) {
+			if (nWritten >= cchWideChar) {
+				SetLastError(ERROR_INVALID_PARAMETER);
+				return 0;
+			}
+			lpWideCharStr[nWritten] = wc;
+		}
+		nWritten++;
+	}
+
+	return nWritten;
+}
+
+/**
+ * Converts a wide string to a narrow one. CP_ACP is treated as Latin-1, with
+ * the characters that don't fit replaced by question marks.
+ *
+ * @param  CodePage          CP_ACP or CP_UTF8.
+ * @param  dwFlags           Ignored.
+ * @param  lpWideCharStr     String to be converted.
+ * @param  cchWideChar       Length in characters or -1 if it's
+ *                           NULL-terminated.
+ * @param  lpMultiByteStr    Converted string. Can be NULL to get the length.
+ * @param  cbMultiByte       Size of the converted string buffer.
+ * @param  lpDefaultChar     Ignored.
+ * @param  lpUsedDefaultChar Set if a character didn't fit. Can be NULL.
+ * @return                   Number of bytes written, including the NULL
+ *                           terminator if it was part of the input.
+ */
+int WideCharToMultiByte(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr,
+						int cchWideChar, LPSTR lpMultiByteStr, int cbMultiByte,
+						LPCSTR lpDefaultChar, LPBOOL lpUsedDefaultChar) {
+	size_t nLength = (cchWideChar < 0) ? wcslen(lpWideCharStr) + 1 :
+		(size_t)cchWideChar;
+	int nWritten = 0;
+
+	if (lpUsedDefaultChar != NULL)
+		*lpUsedDefaultChar = FALSE;
+
+	for (size_t i = 0; i < nLength; i++) {
+		char szEncoded[4];
+		size_t nEncoded = 1;
+
+		if (CodePage == CP_UTF8) {
+			nEncoded = EncodeUtf8(lpWideCharStr[i], szEncoded);
+		} else if ((DWORD)lpWideCharStr[i] > 0xFF) {
+			szEncoded[0] = '?';
+			if (lpUsedDefaultChar != NULL)
+				*lpUsedDefaultChar = TRUE;
+		} else {
+			szEncoded[0] = (char)lpWideCharStr[i];
+		}
+
+		if (lpMultiByteStr != NULL) {
+			if (nWritten + (int)nEncoded > cbMultiByte) {
+				SetLastError(ERROR_INVALID_PARAMETER);
+				return 0;
+			}
+			memcpy(lpMultiByteStr + nWritten, szEncoded, nEncoded);
+		}
+		nWritten += (int)nEncoded;
+	}
+
+	return nWritten;
+}
+
+/**
+ * Compares two strings ignoring their case.
+ *
+ * @param  string1 First string.
+ * @param  string2 Second string.
+ * @return         Negative, zero or positive like wcscmp.
+ */
+int _wcsicmp(const wchar_t *string1, const wchar_t *string2) {
+	return wcscasecmp(string1, string2);
+}
+
+/**
+ * Compares the start of two strings ignoring their case.
+ *
+ * @param  string1 First string.
+ * @param  string2 Second string.
+ * @param  count   Maximum number of characters to be compared.
+ * @return         Negative, zero or positive like wcsncmp.
+ */
+int _wcsnicmp(const wchar_t *string1, const wchar_t *string2, size_t count) {
+	return wcsncasecmp(string1, string2, count);
+}
+
+/**
+ * Parses a decimal number.
+ *
+ * @param  str String with the number.
+ * @return     Parsed number or 0 if there isn't one.
+ */
+long _wtol(const wchar_t *str) {
+	return wcstol(str, NULL, 10);
+}
+
+/**
+ * Formats a signed number.
+ *
+ * @param  value Number to be formatted.
+ * @param  str   Buffer where the number will be stored.
+ * @param  radix Base between 2 and 36.
+ * @return       The buffer.
+ */
+wchar_t* _ltow(long value, wchar_t *str, int radix) {
+	// Windows longs are 32 bits wide.
+	int iValue = (int)value;
+
+	if ((radix == 10) && (iValue < 0)) {
+		str[0] = L'-';
+		_ultow((unsigned long)(-(long)iValue), str + 1, radix);
+		return str;
+	}
+
+	return _ultow((unsigned int)iValue, str, radix);
+}
+
+/**
+ * Formats an unsigned number.
+ *
+ * @param  value Number to be formatted.
+ * @param  str   Buffer where the number will be stored.
+ * @param  radix Base between 2 and 36.
+ * @return       The buffer.
+ */
+wchar_t* _ultow(unsigned long value, wchar_t *str, int radix) {
+	wchar_t szReversed[65];
+	size_t nLength = 0;
+
+	do {
+		int iDigit = (int)(value % radix);
+		szReversed[nLength++] = (wchar_t)((iDigit < 10) ? L'0' + iDigit :
+			L'a' + iDigit - 10);
+		value /= radix;
+	} while (value > 0);
+
+	for (size_t i = 0; i < nLength; i++)
+		str[i] = szReversed[nLength - i - 1];
+	str[nLength] = L'\0';
+
+	return str;
+}
+
+/**
+ * Formats a wide string the Windows way, where %s and %c take wide arguments
+ * and longs are 32 bits wide.
+ *
+ * @param  buffer Buffer where the string will be stored. Must be big enough.
+ * @param  format Format string.
+ * @return        Number of characters written.
+ */
+int Win32_swprintf(wchar_t *buffer, const wchar_t *format, ...) {
+	wstring swFormat;
+	va_list args;
+
+	// Translate the conversions to what glibc expects.
+	for (const wchar_t *p = format; *p != L'\0'; p++) {
+		swFormat += *p;
+		if (*p != L'%')
+			continue;
+
+		// Flags, width and precision.
+		p++;
+		while ((*p != L'\0') && (wcschr(L"-+ #0123456789.*", *p) != NULL))
+			swFormat += *p++;
+
+		// Windows longs are ints here.
+		if ((*p == L'l') && (wcschr(L"diuxX", *(p + 1)) != NULL))
+			p++;
+		if ((*p == L's') || (*p == L'c'))
+			swFormat += L'l';
+		if (*p == L'\0')
+			break;
+		swFormat += *p;
+	}
+
+	va_start(args, format);
+	int iWritten = vswprintf(buffer, SWPRINTF_MAX_LENGTH, swFormat.c_str(),
+		args);
+	va_end(args);
+
+	return iWritten;
+}
+
+/*
+ * User interface.
+ */
+
+/**
+ * Shows a message on the standard error, since there's nobody to click on it.
+ *
+ * @param  hWnd      Ignored.
+ * @param  lpText    Message.
+ * @param  lpCaption Title of the message.
+ * @param  uType     Ignored.
+ * @return           Always IDOK.
+ */
+int MessageBox(HWND hWnd, LPCTSTR lpText, LPCTSTR lpCaption, UINT uType) {
+	fprintf(stderr, "%ls: %ls\n", lpCaption, lpText);
+	return IDOK;
+}
+
+/**
+ * Debug output is only useful on the devices.
+ *
+ * @param lpOutputString Ignored.
+ */
+void OutputDebugString(LPCTSTR lpOutputString) {
+}
+
+/*
+ * Helpers.
+ */
+
+/**
+ * Converts a Windows path to a native one.
+ *
+ * @param  szPath Path with backslashes.
+ * @return        UTF-8 path with forward slashes.
+ */
+static string NativePath(LPCTSTR szPath) {
+	string strPath;
+
+	for (const wchar_t *p = szPath; *p != L'\0'; p++) {
+		char szEncoded[4];
+		size_t nEncoded = EncodeUtf8((*p == L'\\') ? L'/' : *p, szEncoded);
+
+		strPath.append(szEncoded, nEncoded);
+	}
+
+	return strPath;
+}
+
+/**
+ * Converts a native path to a Windows one.
+ *
+ * @param  szPath UTF-8 path with forward slashes.
+ * @return        Path with backslashes.
+ */
+static wstring WidePath(const char *szPath) {
+	int nLength = MultiByteToWideChar(CP_UTF8, 0, szPath, -1, NULL, 0);
+	vector<wchar_t> arrPath(nLength);
+
+	MultiByteToWideChar(CP_UTF8, 0, szPath, -1, &arrPath[0], nLength);
+	for (int i = 0; i < nLength; i++) {
+		if (arrPath[i] == L'/')
+			arrPath[i] = L'\\';
+	}
+
+	return wstring(&arrPath[0]);
+}
+
+/**
+ * Translates an errno value to a Win32 error.
+ *
+ * @param  iErrno Value of errno.
+ * @return        Win32 error code.
+ */
+static DWORD ErrorFromErrno(int iErrno) {
+	switch (iErrno) {
+	case ENOENT:
+		return ERROR_FILE_NOT_FOUND;
+	case ENOTDIR:
+		return ERROR_PATH_NOT_FOUND;
+	case EACCES:
+	case EPERM:
+	case EISDIR:
+		return ERROR_ACCESS_DENIED;
+	case EROFS:
+		return ERROR_WRITE_PROTECT;
+	case EEXIST:
+		return ERROR_ALREADY_EXISTS;
+	case ENOTEMPTY:
+		return ERROR_DIR_NOT_EMPTY;
+	case ENOSPC:
+		return ERROR_DISK_FULL;
+	case ENOMEM:
+		return ERROR_NOT_ENOUGH_MEMORY;
+	case EBADF:
+		return ERROR_INVALID_HANDLE;
+	}
+
+	return ERROR_INVALID_PARAMETER;
+}
+
+/**
+ * Sets the last error from errno.
+ *
+ * @return Always FALSE, so that failures can be returned straight away.
+ */
+static bool FailWithErrno() {
+	SetLastError(ErrorFromErrno(errno));
+	return false;
+}
+
+/**
+ * Fills in what we know about a file that was found.
+ *
+ * @param strDirectory Directory where the file is.
+ * @param szName       Name of the file.
+ * @param data         Information about the file.
+ */
+static void FillFindData(const string &strDirectory, const char *szName,
+						 WIN32_FIND_DATA *data) {
+	string strPath = strDirectory + "/" + szName;
+	wstring swName = WidePath(szName);
+	struct stat st;
+
+	memset(data, 0, sizeof(WIN32_FIND_DATA));
+	if (stat(strPath.c_str(), &st) == 0) {
+		data->dwFileAttributes = (S_ISDIR(st.st_mode)) ?
+			FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+		data->nFileSizeHigh = (DWORD)((ULONGLONG)st.st_size >> 32);
+		data->nFileSizeLow = (DWORD)st.st_size;
+		ToFileTime(st.st_ctime, &data->ftCreationTime);
+		ToFileTime(st.st_atime, &data->ftLastAccessTime);
+		ToFileTime(st.st_mtime, &data->ftLastWriteTime);
+	}
+
+	wcsncpy(data->cFileName, swName.c_str(), MAX_PATH - 1);
+}
+
+/**
+ * Converts a POSIX time to a file time.
+ *
+ * @param tTime Seconds since 1970.
+ * @param ft    100-nanosecond intervals since 1601.
+ */
+static void ToFileTime(time_t tTime, FILETIME *ft) {
+	ULARGE_INTEGER uli;
+
+	uli.QuadPart = ((ULONGLONG)tTime + FILETIME_EPOCH_SECONDS) *
+		FILETIME_TICKS_PER_SECOND;
+	ft->dwLowDateTime = uli.LowPart;
+	ft->dwHighDateTime = uli.HighPart;
+}
+
+/**
+ * Runs the function of a thread and keeps its exit code.
+ *
+ * @param  lpParam Thread object.
+ * @return         Always NULL.
+ */
+static void* ThreadProc(void *lpParam) {
+	Win32Object *object = (Win32Object*)lpParam;
+	DWORD dwExitCode = object->lpStartAddress(object->lpParameter);
+
+	__sync_lock_test_and_set(&object->dwExitCode, dwExitCode);
+	ReleaseObject(object);
+
+	return NULL;
+}
+
+/**
+ * Drops a reference to an object, deleting it once nobody uses it.
+ *
+ * @param object Object behind a handle.
+ */
+static void ReleaseObject(Win32Object *object) {
+	if (__sync_sub_and_fetch(&object->lReferences, 1) == 0)
+		delete object;
+}
+
+/**
+ * Collects the exit code of a process that has finished.
+ *
+ * @param object Process object.
+ * @param bWait  Wait for the process to finish?
+ */
+static void ReapProcess(Win32Object *object, bool bWait) {
+	int iStatus;
+
+	if (object->bReaped)
+		return;
+	if (waitpid(object->pid, &iStatus, (bWait) ? 0 : WNOHANG) != object->pid)
+		return;
+
+	object->bReaped = true;
+	if (WIFEXITED(iStatus)) {
+		object->dwExitCode = (DWORD)WEXITSTATUS(iStatus);
+	} else {
+		object->dwExitCode = (DWORD)(128 + WTERMSIG(iStatus));
+	}
+}
+
+/**
+ * Splits a command line into arguments.
+ *
+ * @param  szCommandLine Arguments separated by spaces. Quotes group arguments
+ *                       with spaces in them. Can be NULL.
+ * @return               Arguments as native strings.
+ */
+static vector<string> SplitCommandLine(LPCTSTR szCommandLine) {
+	vector<string> arrArguments;
+	string strArgument;
+	bool bQuoted = false;
+	bool bHasArgument = false;
+
+	if (szCommandLine == NULL)
+		return arrArguments;
+
+	for (const wchar_t *p = szCommandLine; *p != L'\0'; p++) {
+		if (*p == L'"') {
+			bQuoted = !bQuoted;
+			bHasArgument = true;
+			continue;
+		}
+
+		if ((*p == L' ') && !bQuoted) {
+			if (bHasArgument)
+				arrArguments.push_back(strArgument);
+			strArgument.clear();
+			bHasArgument = false;
+			continue;
+		}
+
+		char szEncoded[4];
+		strArgument.append(szEncoded, EncodeUtf8(*p, szEncoded));
+		bHasArgument = true;
+	}
+	if (bHasArgument)
+		arrArguments.push_back(strArgument);
+
+	return arrArguments;
+}
+
+/**
+ * Encodes a single character as UTF-8.
+ *
+ * @param  wc    Character to be encoded.
+ * @param  szOut Buffer of at least 4 bytes.
+ * @return       Number of bytes written.
+ */
+static size_t EncodeUtf8(wchar_t wc, char *szOut) {
+	DWORD dwChar = (DWORD)wc;
+
+	if (dwChar < 0x80) {
+		szOut[0] = (char)dwChar;
+		return 1;
+	} else if (dwChar < 0x800) {
+		szOut[0] = (char)(0xC0 | (dwChar >> 6));
+		szOut[1] = (char)(0x80 | (dwChar & 0x3F));
+		return 2;
+	} else if (dwChar < 0x10000) {
+		szOut[0] = (char)(0xE0 | (dwChar >> 12));
+		szOut[1] = (char)(0x80 | ((dwChar >> 6) & 0x3F));
+		szOut[2] = (char)(0x80 | (dwChar & 0x3F));
+		return 3;
+	}
+
+	szOut[0] = (char)(0xF0 | ((dwChar >> 18) & 0x07));
+	szOut[1] = (char)(0x80 | ((dwChar >> 12) & 0x3F));
+	szOut[2] = (char)(0x80 | ((dwChar >> 6) & 0x3F));
+	szOut[3] = (char)(0x80 | (dwChar & 0x3F));
+	return 4;
+}
@@ -0,0 +1,355 @@
+/**
+ * windows.h
+ * Thin portability layer that maps the few Win32 calls the core of the
+ * application relies on to POSIX, so that the benchmark can be built and run
+ * headlessly on Linux.
+ *
+ * Only what the portable modules actually use is provided. Types keep their
+ * Win32 sizes (DWORD and LONG are 32 bits wide) so that hashes and file
+ * formats come out the same as on the devices. Paths are converted from
+ * UTF-16-style wide strings with backslashes to UTF-8 with forward slashes,
+ * so "\tmp\Workspace" ends up as "/tmp/Workspace".
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _WIN32_SHIM_WINDOWS_H
+#define _WIN32_SHIM_WINDOWS_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+#include <pthread.h>
+#include <cwchar>
+#include <string>
+
+// Basic types.
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef int LONG;
+typedef unsigned int ULONG;
+typedef unsigned int UINT;
+typedef int INT;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long ULONG_PTR;
+typedef unsigned long DWORD_PTR;
+typedef long LONG_PTR;
+typedef unsigned long WPARAM;
+typedef long LPARAM;
+typedef long LRESULT;
+typedef char CHAR;
+typedef wchar_t WCHAR;
+typedef wchar_t TCHAR;
+
+// Pointers.
+typedef void *LPVOID;
+typedef const void *LPCVOID;
+typedef BYTE *LPBYTE;
+typedef DWORD *LPDWORD;
+typedef LONG *PLONG;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+typedef WCHAR *LPWSTR;
+typedef const WCHAR *LPCWSTR;
+typedef TCHAR *LPTSTR;
+typedef const TCHAR *LPCTSTR;
+typedef BOOL *LPBOOL;
+
+// Handles.
+typedef void *HANDLE;
+typedef void *HLOCAL;
+typedef void *HWND;
+typedef void *HINSTANCE;
+typedef void *HMODULE;
+typedef void *HGDIOBJ;
+typedef void *HBITMAP;
+
+// Calling conventions.
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+
+// Constants.
+#define TRUE  1
+#define FALSE 0
+#ifndef NULL
+	#define NULL 0
+#endif
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define INVALID_FILE_ATTRIBUTES 0xFFFFFFFF
+#define INVALID_FILE_SIZE 0xFFFFFFFF
+#define INVALID_SET_FILE_POINTER 0xFFFFFFFF
+#define TLS_OUT_OF_INDEXES 0xFFFFFFFF
+
+// Errors.
+#define ERROR_SUCCESS           0
+#define ERROR_FILE_NOT_FOUND    2
+#define ERROR_PATH_NOT_FOUND    3
+#define ERROR_ACCESS_DENIED     5
+#define ERROR_INVALID_HANDLE    6
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_NO_MORE_FILES     18
+#define ERROR_WRITE_PROTECT     19
+#define ERROR_SHARING_VIOLATION 32
+#define ERROR_LOCK_VIOLATION    33
+#define ERROR_HANDLE_DISK_FULL  39
+#define ERROR_FILE_EXISTS       80
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_DISK_FULL         112
+#define ERROR_DIR_NOT_EMPTY     145
+#define ERROR_ALREADY_EXISTS    183
+#define WAIT_OBJECT_0           0
+#define WAIT_TIMEOUT            258
+#define WAIT_FAILED             0xFFFFFFFF
+#define STILL_ACTIVE            259
+
+// Files.
+#define GENERIC_READ             0x80000000
+#define GENERIC_WRITE            0x40000000
+#define FILE_SHARE_READ          0x00000001
+#define FILE_SHARE_WRITE         0x00000002
+#define CREATE_NEW               1
+#define CREATE_ALWAYS            2
+#define OPEN_EXISTING            3
+#define OPEN_ALWAYS              4
+#define TRUNCATE_EXISTING        5
+#define FILE_ATTRIBUTE_READONLY  0x00000001
+#define FILE_ATTRIBUTE_HIDDEN    0x00000002
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_NORMAL    0x00000080
+#define FILE_FLAG_WRITE_THROUGH  0x80000000
+#define FILE_BEGIN               0
+#define FILE_CURRENT             1
+#define FILE_END                 2
+
+// Memory.
+#define LMEM_FIXED    0x0000
+#define LMEM_ZEROINIT 0x0040
+#define LPTR          (LMEM_FIXED | LMEM_ZEROINIT)
+
+// Code pages.
+#define CP_ACP  0
+#define CP_UTF8 65001
+
+// Message boxes.
+#define MB_OK              0x00000000
+#define MB_YESNO           0x00000004
+#define MB_ICONERROR       0x00000010
+#define MB_ICONQUESTION    0x00000020
+#define MB_ICONWARNING     0x00000030
+#define MB_ICONINFORMATION 0x00000040
+#define IDOK  1
+#define IDYES 6
+
+// Bitmaps.
+#define BI_RGB       0
+#define BI_RLE8      1
+#define BI_RLE4      2
+#define BI_BITFIELDS 3
+
+// Times.
+typedef struct {
+	DWORD dwLowDateTime;
+	DWORD dwHighDateTime;
+} FILETIME, *LPFILETIME;
+
+typedef struct {
+	WORD wYear;
+	WORD wMonth;
+	WORD wDayOfWeek;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	WORD wMilliseconds;
+} SYSTEMTIME, *LPSYSTEMTIME;
+
+typedef union {
+	struct {
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef union {
+	struct {
+		DWORD LowPart;
+		DWORD HighPart;
+	};
+	ULONGLONG QuadPart;
+} ULARGE_INTEGER;
+
+// File searches.
+typedef struct {
+	DWORD dwFileAttributes;
+	FILETIME ftCreationTime;
+	FILETIME ftLastAccessTime;
+	FILETIME ftLastWriteTime;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+	DWORD dwOID;
+	WCHAR cFileName[MAX_PATH];
+} WIN32_FIND_DATA, *LPWIN32_FIND_DATA;
+
+// Threads and processes.
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID lpParameter);
+
+typedef struct {
+	pthread_mutex_t mutex;
+} CRITICAL_SECTION, *LPCRITICAL_SECTION;
+
+typedef struct {
+	DWORD dwOemId;
+	DWORD dwPageSize;
+	LPVOID lpMinimumApplicationAddress;
+	LPVOID lpMaximumApplicationAddress;
+	DWORD dwActiveProcessorMask;
+	DWORD dwNumberOfProcessors;
+	DWORD dwProcessorType;
+	DWORD dwAllocationGranularity;
+	WORD wProcessorLevel;
+	WORD wProcessorRevision;
+} SYSTEM_INFO, *LPSYSTEM_INFO;
+
+typedef struct {
+	HANDLE hProcess;
+	HANDLE hThread;
+	DWORD dwProcessId;
+	DWORD dwThreadId;
+} PROCESS_INFORMATION, *LPPROCESS_INFORMATION;
+
+// Memory and graphics.
+typedef struct {
+	DWORD dwLength;
+	DWORD dwMemoryLoad;
+	size_t dwTotalPhys;
+	size_t dwAvailPhys;
+	size_t dwTotalPageFile;
+	size_t dwAvailPageFile;
+	size_t dwTotalVirtual;
+	size_t dwAvailVirtual;
+} MEMORYSTATUS, *LPMEMORYSTATUS;
+
+typedef struct {
+	LONG bmType;
+	LONG bmWidth;
+	LONG bmHeight;
+	LONG bmWidthBytes;
+	WORD bmPlanes;
+	WORD bmBitsPixel;
+	LPVOID bmBits;
+} BITMAP;
+
+// Files.
+HANDLE CreateFile(LPCTSTR lpFileName, DWORD dwDesiredAccess, DWORD dwShareMode,
+				  LPVOID lpSecurityAttributes, DWORD dwCreationDisposition,
+				  DWORD dwFlagsAndAttributes, HANDLE hTemplateFile);
+BOOL ReadFile(HANDLE hFile, LPVOID lpBuffer, DWORD nNumberOfBytesToRead,
+			  LPDWORD lpNumberOfBytesRead, LPVOID lpOverlapped);
+BOOL WriteFile(HANDLE hFile, LPCVOID lpBuffer, DWORD nNumberOfBytesToWrite,
+			   LPDWORD lpNumberOfBytesWritten, LPVOID lpOverlapped);
+DWORD GetFileSize(HANDLE hFile, LPDWORD lpFileSizeHigh);
+DWORD SetFilePointer(HANDLE hFile, LONG lDistanceToMove,
+					 PLONG lpDistanceToMoveHigh, DWORD dwMoveMethod);
+BOOL SetEndOfFile(HANDLE hFile);
+BOOL FlushFileBuffers(HANDLE hFile);
+BOOL CloseHandle(HANDLE hObject);
+DWORD GetFileAttributes(LPCTSTR lpFileName);
+BOOL DeleteFile(LPCTSTR lpFileName);
+BOOL MoveFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName);
+BOOL CopyFile(LPCTSTR lpExistingFileName, LPCTSTR lpNewFileName,
+			  BOOL bFailIfExists);
+BOOL CreateDirectory(LPCTSTR lpPathName, LPVOID lpSecurityAttributes);
+BOOL RemoveDirectory(LPCTSTR lpPathName);
+HANDLE FindFirstFile(LPCTSTR lpFileName, LPWIN32_FIND_DATA lpFindFileData);
+BOOL FindNextFile(HANDLE hFindFile, LPWIN32_FIND_DATA lpFindFileData);
+BOOL FindClose(HANDLE hFindFile);
+
+// Errors.
+DWORD GetLastError();
+void SetLastError(DWORD dwErrCode);
+
+// Memory.
+HLOCAL LocalAlloc(UINT uFlags, size_t uBytes);
+HLOCAL LocalFree(HLOCAL hMem);
+void GlobalMemoryStatus(LPMEMORYSTATUS lpBuffer);
+
+// Graphics.
+int GetObject(HGDIOBJ hgdiobj, int cbBuffer, LPVOID lpvObject);
+BOOL DeleteObject(HGDIOBJ hObject);
+
+// Threads.
+HANDLE CreateThread(LPVOID lpThreadAttributes, size_t dwStackSize,
+					LPTHREAD_START_ROUTINE lpStartAddress, LPVOID lpParameter,
+					DWORD dwCreationFlags, LPDWORD lpThreadId);
+DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds);
+DWORD GetCurrentThreadId();
+void Sleep(DWORD dwMilliseconds);
+void GetSystemInfo(LPSYSTEM_INFO lpSystemInfo);
+
+// Processes.
+DWORD GetModuleFileName(HMODULE hModule, LPTSTR lpFilename, DWORD nSize);
+BOOL CreateProcess(LPCTSTR lpApplicationName, LPCTSTR lpCommandLine,
+				   LPVOID lpProcessAttributes, LPVOID lpThreadAttributes,
+				   BOOL bInheritHandles, DWORD dwCreationFlags,
+				   LPVOID lpEnvironment, LPCTSTR lpCurrentDirectory,
+				   LPVOID lpStartupInfo,
+				   LPPROCESS_INFORMATION lpProcessInformation);
+BOOL TerminateProcess(HANDLE hProcess, UINT uExitCode);
+BOOL GetExitCodeProcess(HANDLE hProcess, LPDWORD lpExitCode);
+
+// Synchronization.
+void InitializeCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void DeleteCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void EnterCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+void LeaveCriticalSection(LPCRITICAL_SECTION lpCriticalSection);
+LONG InterlockedIncrement(LONG volatile *lpAddend);
+LONG InterlockedDecrement(LONG volatile *lpAddend);
+LONG InterlockedExchange(LONG volatile *lpTarget, LONG lValue);
+LONG InterlockedExchangeAdd(LONG volatile *lpAddend, LONG lValue);
+DWORD TlsAlloc();
+BOOL TlsFree(DWORD dwTlsIndex);
+LPVOID TlsGetValue(DWORD dwTlsIndex);
+BOOL TlsSetValue(DWORD dwTlsIndex, LPVOID lpTlsValue);
+
+// Time.
+DWORD GetTickCount();
+BOOL QueryPerformanceCounter(LARGE_INTEGER *lpPerformanceCount);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *lpFrequency);
+void GetSystemTime(LPSYSTEMTIME lpSystemTime);
+BOOL SystemTimeToFileTime(const SYSTEMTIME *lpSystemTime,
+						  LPFILETIME lpFileTime);
+BOOL FileTimeToSystemTime(const FILETIME *lpFileTime,
+						  LPSYSTEMTIME lpSystemTime);
+LONG CompareFileTime(const FILETIME *lpFileTime1, const FILETIME *lpFileTime2);
+
+// Strings.
+int MultiByteToWideChar(UINT CodePage, DWORD dwFlags, LPCSTR lpMultiByteStr,
+						int cbMultiByte, LPWSTR lpWideCharStr, int cchWideChar);
+int WideCharToMultiByte(UINT CodePage, DWORD dwFlags, LPCWSTR lpWideCharStr,
+						int cchWideChar, LPSTR lpMultiByteStr, int cbMultiByte,
+						LPCSTR lpDefaultChar, LPBOOL lpUsedDefaultChar);
+int _wcsicmp(const wchar_t *string1, const wchar_t *string2);
+int _wcsnicmp(const wchar_t *string1, const wchar_t *string2, size_t count);
+long _wtol(const wchar_t *str);
+wchar_t* _ltow(long value, wchar_t *str, int radix);
+wchar_t* _ultow(unsigned long value, wchar_t *str, int radix);
+int Win32_swprintf(wchar_t *buffer, const wchar_t *format, ...);
+
+// Wide formatting works like on Windows: %s takes a wide string and there's no
+// buffer size.
+#define swprintf Win32_swprintf
+
+// User interface.
+int MessageBox(HWND hWnd, LPCTSTR lpText, LPCTSTR lpCaption, UINT uType);
+void OutputDebugString(LPCTSTR lpOutputString);
+
+#endif  // _WIN32_SHIM_WINDOWS_H
@@ -96,6 +96,11 @@
 #   define __NODE_ALLOCATOR_THREADS false
 #endif
 
+// PartCat: Optional hook that is told about every block handed out or taken
+// back by the node allocator. Defined by the application's allocation
+// profiler and NULL unless profiling is enabled.
+extern void (* __stl_alloc_hook)(void* __p, size_t __n, bool __allocated);
+
 __STL_BEGIN_NAMESPACE
 
 #if defined(__sgi) && !defined(__GNUC__) && (_MIPS_SIM != _MIPS_SIM_ABI32)
@@ -379,12 +384,16 @@ public:
       }
     }
 
+    if (__stl_alloc_hook)
+      __stl_alloc_hook(__ret, __n, true);
     return __ret;
   };
 
   /* __p may not be 0 */
   static void deallocate(void* __p, size_t __n)
   {
+    if (__stl_alloc_hook)
+      __stl_alloc_hook(__p, __n, false);
     if (__n > (size_t) _MAX_BYTES)
       malloc_alloc::deallocate(__p, __n);
     else {
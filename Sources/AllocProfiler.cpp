@@ -0,0 +1,393 @@
+/**
+ * AllocProfiler.cpp
+ * Opt-in profiler of the heap allocations done on behalf of each user action.
+ *
+ * The strings that are handed around with LocalAlloc go through Alloc and
+ * Free, which keep a table of the blocks that are still alive along with the
+ * place in the code that allocated them, so anything left in it is a leak.
+ * The STL containers are seen through a hook in the node allocator, which
+ * only gives us sizes, so for them we just keep the totals. Allocations are
+ * attributed to the same user actions as the file system operations, and the
+ * profiler's own bookkeeping is kept out of the figures. When profiling is
+ * disabled all of this costs a flag check per allocation.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "AllocProfiler.h"
+
+// Hook called by the STL node allocator.
+void (* __stl_alloc_hook)(void* __p, size_t __n, bool __allocated) = NULL;
+
+// Static members.
+AllocCounters AllocProfiler::aLocal[IO_OP_COUNT];
+AllocCounters AllocProfiler::aStl[IO_OP_COUNT];
+map<LPCTSTR, AllocSite> AllocProfiler::mapSites;
+map<LPVOID, AllocRecord> AllocProfiler::mapLive;
+LONG AllocProfiler::lUntrackedFrees = 0;
+bool AllocProfiler::bEnabled = false;
+bool AllocProfiler::bInitialized = false;
+bool AllocProfiler::bInside = false;
+CRITICAL_SECTION AllocProfiler::csProfiler;
+
+/**
+ * Starts profiling from scratch, discarding what was recorded before.
+ * @remark Must be called from the main thread.
+ */
+void AllocProfiler::Enable() {
+	if (!bInitialized) {
+		InitializeCriticalSection(&csProfiler);
+		bInitialized = true;
+	}
+
+	Reset();
+	bEnabled = true;
+	__stl_alloc_hook = CountStl;
+}
+
+/**
+ * Stops profiling. What was recorded is kept until it's enabled again.
+ */
+void AllocProfiler::Disable() {
+	__stl_alloc_hook = NULL;
+	bEnabled = false;
+}
+
+/**
+ * Checks if allocations are being profiled.
+ *
+ * @return TRUE if profiling is enabled.
+ */
+bool AllocProfiler::IsEnabled() {
+	return bEnabled;
+}
+
+/**
+ * Forgets everything that was recorded.
+ * @remark Blocks that are alive are forgotten as well, so freeing them later
+ *         counts as an untracked free.
+ */
+void AllocProfiler::Reset() {
+	if (!bInitialized)
+		return;
+
+	EnterCriticalSection(&csProfiler);
+	bInside = true;
+	memset(aLocal, 0, sizeof(aLocal));
+	memset(aStl, 0, sizeof(aStl));
+	mapSites.clear();
+	mapLive.clear();
+	lUntrackedFrees = 0;
+	bInside = false;
+	LeaveCriticalSection(&csProfiler);
+}
+
+/**
+ * Stops profiling and frees the bookkeeping.
+ * @remark Must only be called when no other threads are running.
+ */
+void AllocProfiler::Release() {
+	Disable();
+	if (!bInitialized)
+		return;
+
+	Reset();
+	DeleteCriticalSection(&csProfiler);
+	bInitialized = false;
+}
+
+/**
+ * Allocates a block of memory, exactly like LocalAlloc, and records where it
+ * was allocated from.
+ *
+ * @param  uFlags Allocation flags. Only LMEM_FIXED blocks can be tracked.
+ * @param  uBytes Size of the block in bytes.
+ * @param  szSite Place in the code that allocated it. Must be a string literal.
+ * @return        Allocated block or NULL if the allocation failed.
+ */
+LPVOID AllocProfiler::Alloc(UINT uFlags, UINT uBytes, LPCTSTR szSite) {
+	LPVOID lpBlock = (LPVOID)LocalAlloc(uFlags, uBytes);
+	if (!bEnabled || (lpBlock == NULL))
+		return lpBlock;
+
+	EnterCriticalSection(&csProfiler);
+	bInside = true;
+
+	// Keep track of the block until it's freed.
+	AllocRecord record;
+	record.szSite = szSite;
+	record.nOperation = IoAccounting::GetOperation();
+	record.dwBytes = uBytes;
+	mapLive[lpBlock] = record;
+
+	// Count it for its call site and action.
+	map<LPCTSTR, AllocSite>::iterator iter = mapSites.find(szSite);
+	if (iter == mapSites.end()) {
+		AllocSite site;
+		memset(&site, 0, sizeof(AllocSite));
+		iter = mapSites.insert(pair<const LPCTSTR, AllocSite>(szSite,
+			site)).first;
+	}
+	iter->second.alAllocs[record.nOperation]++;
+	iter->second.alBytes[record.nOperation] += uBytes;
+	CountAlloc(&aLocal[record.nOperation], uBytes);
+
+	bInside = false;
+	LeaveCriticalSection(&csProfiler);
+
+	return lpBlock;
+}
+
+/**
+ * Frees a block of memory, exactly like LocalFree.
+ *
+ * @param  hMem Block to be freed.
+ * @return      NULL if the operation was successful, otherwise the block.
+ */
+HLOCAL AllocProfiler::Free(HLOCAL hMem) {
+	if (bEnabled && (hMem != NULL)) {
+		EnterCriticalSection(&csProfiler);
+		bInside = true;
+
+		// Blocks we don't know were allocated before we started or not by us.
+		map<LPVOID, AllocRecord>::iterator iter = mapLive.find((LPVOID)hMem);
+		if (iter != mapLive.end()) {
+			CountFree(&aLocal[iter->second.nOperation], iter->second.dwBytes);
+			mapLive.erase(iter);
+		} else {
+			lUntrackedFrees++;
+		}
+
+		bInside = false;
+		LeaveCriticalSection(&csProfiler);
+	}
+
+	return LocalFree(hMem);
+}
+
+/**
+ * Counts a block being allocated.
+ *
+ * @param counters Counters of the action that allocated it.
+ * @param dwBytes  Size of the block.
+ */
+void AllocProfiler::CountAlloc(AllocCounters *counters, DWORD dwBytes) {
+	counters->lAllocs++;
+	counters->lBytes += (LONG)dwBytes;
+	counters->lLive += (LONG)dwBytes;
+	if (counters->lLive > counters->lPeak)
+		counters->lPeak = counters->lLive;
+}
+
+/**
+ * Counts a block being freed.
+ *
+ * @param counters Counters of the action that allocated it.
+ * @param dwBytes  Size of the block.
+ */
+void AllocProfiler::CountFree(AllocCounters *counters, DWORD dwBytes) {
+	counters->lFrees++;
+	counters->lLive -= (LONG)dwBytes;
+}
+
+/**
+ * Counts a block handed out or taken back by the STL node allocator. Since
+ * we can't tell which action allocated a block, frees are counted for the
+ * action that is being done when they happen.
+ *
+ * @param lpBlock    Block of memory.
+ * @param nBytes     Size of the block.
+ * @param bAllocated Was it allocated or freed?
+ */
+void AllocProfiler::CountStl(void *lpBlock, size_t nBytes, bool bAllocated) {
+	if (!bEnabled)
+		return;
+
+	EnterCriticalSection(&csProfiler);
+	if (!bInside) {
+		AllocCounters *counters = &aStl[IoAccounting::GetOperation()];
+
+		if (bAllocated) {
+			CountAlloc(counters, nBytes);
+		} else {
+			CountFree(counters, nBytes);
+		}
+	}
+	LeaveCriticalSection(&csProfiler);
+}
+
+/**
+ * Gets the LocalAlloc counters of a user action.
+ *
+ * @param  nOperation User action.
+ * @return            Allocations done by the action.
+ */
+AllocCounters AllocProfiler::GetCounters(int nOperation) {
+	return aLocal[nOperation];
+}
+
+/**
+ * Gets the STL allocator counters of a user action.
+ *
+ * @param  nOperation User action.
+ * @return            Allocations done by the action.
+ */
+AllocCounters AllocProfiler::GetStlCounters(int nOperation) {
+	return aStl[nOperation];
+}
+
+/**
+ * Gets the number of blocks that were allocated and not freed yet.
+ *
+ * @return Number of blocks alive.
+ */
+size_t AllocProfiler::GetLeakCount() {
+	size_t nCount;
+
+	if (!bInitialized)
+		return 0;
+
+	EnterCriticalSection(&csProfiler);
+	nCount = mapLive.size();
+	LeaveCriticalSection(&csProfiler);
+
+	return nCount;
+}
+
+/**
+ * Builds a JSON object with the counters of every user action, the call
+ * sites, and the blocks that weren't freed.
+ *
+ * @return Report as a JSON object.
+ */
+wstring AllocProfiler::ToJSON() {
+	map<wstring, AllocSite> mapNamedSites;
+	map<wstring, AllocSite> mapLeaks;
+	map<wstring, AllocSite>::iterator iter;
+	WCHAR szLine[MAX_PATH];
+	wstring swJSON;
+	bool bFirst;
+
+	if (!bInitialized)
+		return L"{}";
+
+	EnterCriticalSection(&csProfiler);
+	bInside = true;
+
+	// Totals.
+	swJSON = L"{\r\n\t\t\"local\": ";
+	AppendCounters(&swJSON, aLocal);
+	swJSON += L",\r\n\t\t\"stl\": ";
+	AppendCounters(&swJSON, aStl);
+
+	// The same literal may live at different addresses in each module.
+	for (map<LPCTSTR, AllocSite>::iterator iterSite = mapSites.begin();
+			iterSite != mapSites.end(); iterSite++) {
+		AllocSite *site = FindSite(&mapNamedSites, iterSite->first);
+
+		for (int i = 0; i < IO_OP_COUNT; i++) {
+			site->alAllocs[i] += iterSite->second.alAllocs[i];
+			site->alBytes[i] += iterSite->second.alBytes[i];
+		}
+	}
+
+	// Group the blocks that are still alive by where they came from.
+	for (map<LPVOID, AllocRecord>::iterator iterLive = mapLive.begin();
+			iterLive != mapLive.end(); iterLive++) {
+		AllocRecord *record = &iterLive->second;
+		AllocSite *site = FindSite(&mapLeaks, record->szSite);
+
+		site->alAllocs[record->nOperation]++;
+		site->alBytes[record->nOperation] += record->dwBytes;
+	}
+
+	// Call sites.
+	swJSON += L",\r\n\t\t\"sites\": [";
+	bFirst = true;
+	for (iter = mapNamedSites.begin(); iter != mapNamedSites.end(); iter++) {
+		for (int i = 0; i < IO_OP_COUNT; i++) {
+			if (iter->second.alAllocs[i] == 0)
+				continue;
+
+			swprintf(szLine, L"%s\r\n\t\t\t{\"site\": \"%s\", \"operation\": "
+				L"\"%s\", \"allocs\": %ld, \"bytes\": %ld}",
+				(bFirst) ? L"" : L",", iter->first.c_str(),
+				IoAccounting::GetOperationName(i), iter->second.alAllocs[i],
+				iter->second.alBytes[i]);
+			swJSON += szLine;
+			bFirst = false;
+		}
+	}
+
+	// Leaks.
+	swJSON += L"\r\n\t\t],\r\n\t\t\"leaks\": [";
+	bFirst = true;
+	for (iter = mapLeaks.begin(); iter != mapLeaks.end(); iter++) {
+		for (int i = 0; i < IO_OP_COUNT; i++) {
+			if (iter->second.alAllocs[i] == 0)
+				continue;
+
+			swprintf(szLine, L"%s\r\n\t\t\t{\"site\": \"%s\", \"operation\": "
+				L"\"%s\", \"blocks\": %ld, \"bytes\": %ld}",
+				(bFirst) ? L"" : L",", iter->first.c_str(),
+				IoAccounting::GetOperationName(i), iter->second.alAllocs[i],
+				iter->second.alBytes[i]);
+			swJSON += szLine;
+			bFirst = false;
+		}
+	}
+
+	swprintf(szLine, L"\r\n\t\t],\r\n\t\t\"untracked_frees\": %ld\r\n\t}",
+		lUntrackedFrees);
+	swJSON += szLine;
+
+	// Keep our own bookkeeping out of the figures.
+	mapNamedSites.clear();
+	mapLeaks.clear();
+	bInside = false;
+	LeaveCriticalSection(&csProfiler);
+
+	return swJSON;
+}
+
+/**
+ * Gets the counters of a call site by its name, creating them if needed.
+ *
+ * @param  mapNames Call sites by name.
+ * @param  szSite   Name of the call site.
+ * @return          Counters of the call site.
+ */
+AllocSite* AllocProfiler::FindSite(map<wstring, AllocSite> *mapNames,
+								   LPCTSTR szSite) {
+	map<wstring, AllocSite>::iterator iter = mapNames->find(szSite);
+
+	if (iter == mapNames->end()) {
+		AllocSite site;
+		memset(&site, 0, sizeof(AllocSite));
+		iter = mapNames->insert(pair<const wstring, AllocSite>(szSite,
+			site)).first;
+	}
+
+	return &iter->second;
+}
+
+/**
+ * Appends the counters of every user action to a JSON document.
+ *
+ * @param swJSON    JSON being built.
+ * @param aCounters Counters of every action.
+ */
+void AllocProfiler::AppendCounters(wstring *swJSON, AllocCounters *aCounters) {
+	WCHAR szLine[MAX_PATH];
+
+	*swJSON += L"{";
+	for (int i = 0; i < IO_OP_COUNT; i++) {
+		swprintf(szLine, L"%s\r\n\t\t\t\"%s\": {\"allocs\": %ld, \"frees\": %ld, "
+			L"\"bytes\": %ld, \"live\": %ld, \"peak\": %ld}",
+			(i == 0) ? L"" : L",", IoAccounting::GetOperationName(i),
+			aCounters[i].lAllocs, aCounters[i].lFrees, aCounters[i].lBytes,
+			aCounters[i].lLive, aCounters[i].lPeak);
+		*swJSON += szLine;
+	}
+	*swJSON += L"\r\n\t\t}";
+}
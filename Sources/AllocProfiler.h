@@ -0,0 +1,81 @@
+/**
+ * AllocProfiler.h
+ * Opt-in profiler of the heap allocations done on behalf of each user action.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _ALLOC_PROFILER_H
+#define _ALLOC_PROFILER_H
+
+#include <windows.h>
+#include <string>
+#include <map>
+#include "IoAccounting.h"
+
+using namespace std;
+
+// Allocations done by a user action.
+typedef struct {
+	LONG lAllocs;
+	LONG lFrees;
+	LONG lBytes;
+	LONG lLive;
+	LONG lPeak;
+} AllocCounters;
+
+// Allocations done from a single place in the code.
+typedef struct {
+	LONG alAllocs[IO_OP_COUNT];
+	LONG alBytes[IO_OP_COUNT];
+} AllocSite;
+
+// An allocation that wasn't freed yet.
+typedef struct {
+	LPCTSTR szSite;
+	int nOperation;
+	DWORD dwBytes;
+} AllocRecord;
+
+class AllocProfiler {
+private:
+	static AllocCounters aLocal[IO_OP_COUNT];
+	static AllocCounters aStl[IO_OP_COUNT];
+	static map<LPCTSTR, AllocSite> mapSites;
+	static map<LPVOID, AllocRecord> mapLive;
+	static LONG lUntrackedFrees;
+	static bool bEnabled;
+	static bool bInitialized;
+	static bool bInside;
+	static CRITICAL_SECTION csProfiler;
+
+	AllocProfiler() {}
+
+	// Bookkeeping.
+	static void CountAlloc(AllocCounters *counters, DWORD dwBytes);
+	static void CountFree(AllocCounters *counters, DWORD dwBytes);
+	static void CountStl(void *lpBlock, size_t nBytes, bool bAllocated);
+	static AllocSite* FindSite(map<wstring, AllocSite> *mapNames,
+							   LPCTSTR szSite);
+	static void AppendCounters(wstring *swJSON, AllocCounters *aCounters);
+
+public:
+	// Profiling.
+	static void Enable();
+	static void Disable();
+	static bool IsEnabled();
+	static void Reset();
+	static void Release();
+
+	// Allocation.
+	static LPVOID Alloc(UINT uFlags, UINT uBytes, LPCTSTR szSite);
+	static HLOCAL Free(HLOCAL hMem);
+
+	// Reporting.
+	static AllocCounters GetCounters(int nOperation);
+	static AllocCounters GetStlCounters(int nOperation);
+	static size_t GetLeakCount();
+	static wstring ToJSON();
+};
+
+#endif  // _ALLOC_PROFILER_H
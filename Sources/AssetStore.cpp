@@ -0,0 +1,369 @@
+/**
+ * AssetStore.cpp
+ * Content-addressed store that lets identical datasheets and images share a
+ * single copy on disk.
+ *
+ * Blobs live in assets\blobs and are named after the hash and size of their
+ * contents. A file that was moved into the store is replaced by a reference
+ * file with the same name plus BLOB_REF_EXTENSION, which holds the name of the
+ * blob. Resolving a file always prefers the real file, so workspaces that were
+ * never deduplicated keep working exactly as before.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <stdio.h>
+#include "AssetStore.h"
+#include "Constants.h"
+#include "FileUtils.h"
+#include "ParallelUtils.h"
+#include "AllocProfiler.h"
+
+/**
+ * Initializes a store that isn't associated with any workspace.
+ */
+AssetStore::AssetStore() {
+}
+
+/**
+ * Associates the store with a workspace.
+ *
+ * @param dirWorkspace Workspace root directory.
+ */
+void AssetStore::Open(Directory dirWorkspace) {
+	this->dirWorkspace = dirWorkspace;
+	dirBlobs = Directory(dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(ASSETS_BLOBS_DIR));
+}
+
+/**
+ * Gets the path to the actual contents of a workspace file.
+ *
+ * @param  pathFile     Path to the file as if it was never deduplicated.
+ * @param  pathResolved Path to the file or to the blob it references.
+ * @return              TRUE if the file exists in one of the two forms.
+ */
+bool AssetStore::Resolve(Path pathFile, Path *pathResolved) {
+	return ResolveFile(dirWorkspace, pathFile, pathResolved);
+}
+
+/**
+ * Gets the path to the actual contents of a workspace file without needing an
+ * opened store.
+ *
+ * @param  dirWorkspace Workspace root directory.
+ * @param  pathFile     Path to the file as if it was never deduplicated.
+ * @param  pathResolved Path to the file or to the blob it references.
+ * @return              TRUE if the file exists in one of the two forms.
+ */
+bool AssetStore::ResolveFile(Directory dirWorkspace, Path pathFile,
+							 Path *pathResolved) {
+	wstring swBlobName;
+
+	// The file itself always wins.
+	if (pathFile.Exists()) {
+		*pathResolved = pathFile;
+		return true;
+	}
+
+	// Check if it was moved into the store.
+	if (!ReadReference(GetReferencePath(pathFile).ToString(), &swBlobName))
+		return false;
+	Path pathBlob = dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(
+		ASSETS_BLOBS_DIR).Concatenate(swBlobName.c_str());
+	if (!pathBlob.Exists())
+		return false;
+
+	*pathResolved = pathBlob;
+	return true;
+}
+
+/**
+ * Moves every datasheet and image that has an identical copy somewhere else
+ * in the workspace into the store, and removes blobs that nothing references
+ * anymore. Files are hashed in parallel and compared byte by byte before
+ * being replaced.
+ *
+ * @param  report Summary of what was done and how much space is saved.
+ * @return        TRUE if the store could be used.
+ */
+bool AssetStore::Deduplicate(AssetReport *report) {
+	map<wstring, vector<size_t> > mapGroups;
+	map<wstring, vector<size_t> >::iterator it;
+	map<wstring, size_t> mapRefs;
+	size_t i;
+
+	memset(report, 0, sizeof(AssetReport));
+
+	// Make sure the store exists.
+	if (!dirBlobs.Exists() && !CreateDirectory(dirBlobs.ToString(), NULL))
+		return false;
+
+	// Hash everything that could be deduplicated.
+	ListCandidates(&mapRefs);
+	report->nScanned = arrBatchPaths.size();
+	arrBatchHashes.resize(arrBatchPaths.size());
+	ParallelUtils::ForEach(arrBatchPaths.size(), HashProc, this);
+
+	// Group the files by their contents.
+	for (i = 0; i < arrBatchPaths.size(); i++) {
+		if (!arrBatchHashes[i].bHashed)
+			continue;
+
+		mapGroups[BuildBlobName(arrBatchHashes[i].dwHash,
+			arrBatchHashes[i].dwSize, arrBatchPaths[i].c_str())].push_back(i);
+	}
+
+	// Replace the copies with references.
+	for (it = mapGroups.begin(); it != mapGroups.end(); it++) {
+		vector<size_t> *arrMembers = &it->second;
+		Path pathBlob = dirBlobs.Concatenate(it->first.c_str());
+		bool bNewBlob = !pathBlob.Exists();
+		DWORD dwSize = arrBatchHashes[(*arrMembers)[0]].dwSize;
+		size_t nReplaced = 0;
+
+		// Files that are unique and aren't in the store yet stay where they are.
+		if (bNewBlob && (arrMembers->size() < 2))
+			continue;
+		if (bNewBlob && !CopyFile(arrBatchPaths[(*arrMembers)[0]].c_str(),
+				pathBlob.ToString(), TRUE))
+			continue;
+
+		for (i = 0; i < arrMembers->size(); i++) {
+			LPCTSTR szPath = arrBatchPaths[(*arrMembers)[i]].c_str();
+
+			// Guard against hash collisions.
+			if (!FileUtils::CompareContents(szPath, pathBlob.ToString()))
+				continue;
+
+			if (ReplaceWithReference(szPath, it->first.c_str())) {
+				mapRefs[it->first]++;
+				nReplaced++;
+			}
+		}
+
+		// Account for the copy we've put in the store.
+		if (bNewBlob && (nReplaced == 0)) {
+			FileUtils::Delete(pathBlob.ToString());
+			continue;
+		}
+		report->nDeduplicated += nReplaced;
+		report->dwBytesReclaimed += (nReplaced - (bNewBlob ? 1 : 0)) * dwSize;
+	}
+
+	// Get rid of unused blobs and see how much we are saving.
+	CollectBlobs(&mapRefs, report);
+
+	// Clean up.
+	arrBatchPaths.clear();
+	arrBatchHashes.clear();
+
+	return true;
+}
+
+/**
+ * Lists the datasheets and images that could be deduplicated and counts the
+ * references that already exist.
+ *
+ * @param mapRefs Number of references to each blob.
+ */
+void AssetStore::ListCandidates(map<wstring, size_t> *mapRefs) {
+	Directory dirComponents(dirWorkspace.Concatenate(COMPONENTS_ROOT));
+	Directory dirImages(dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(IMAGES_DIR));
+	vector<Directory> arrDirs = dirComponents.GetSubDirectories();
+	WIN32_FIND_DATA wfd;
+	HANDLE hFind;
+	size_t i;
+
+	arrBatchPaths.clear();
+
+	// Component datasheets.
+	for (i = 0; i < arrDirs.size(); i++)
+		AddCandidate(arrDirs[i].Concatenate(DATASHEET_FILE), mapRefs);
+
+	// Workspace images.
+	Path pathQuery = dirImages.Concatenate(L"*");
+	pathQuery.AppendString(IMAGE_EXTENSION);
+	hFind = FileUtils::FindFirst(pathQuery.ToString(), &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		if (!(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			AddCandidate(dirImages.Concatenate(wfd.cFileName), mapRefs);
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+
+	// Images that were already moved into the store.
+	pathQuery.AppendString(BLOB_REF_EXTENSION);
+	hFind = FileUtils::FindFirst(pathQuery.ToString(), &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		wstring swName(wfd.cFileName);
+
+		// Strip the reference extension to get the original image name.
+		swName.erase(swName.length() - wcslen(BLOB_REF_EXTENSION));
+		if (!dirImages.Concatenate(swName.c_str()).Exists())
+			AddCandidate(dirImages.Concatenate(swName.c_str()), mapRefs);
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+}
+
+/**
+ * Adds a file to the deduplication batch, or counts its reference if it was
+ * already moved into the store.
+ *
+ * @param pathFile Path to the file as if it was never deduplicated.
+ * @param mapRefs  Number of references to each blob.
+ */
+void AssetStore::AddCandidate(Path pathFile, map<wstring, size_t> *mapRefs) {
+	wstring swBlobName;
+
+	if (pathFile.Exists()) {
+		arrBatchPaths.push_back(wstring(pathFile.ToString()));
+	} else if (ReadReference(GetReferencePath(pathFile).ToString(), &swBlobName)) {
+		(*mapRefs)[swBlobName]++;
+	}
+}
+
+/**
+ * Parallel worker that hashes a single file.
+ *
+ * @param nIndex  Index of the file in the batch.
+ * @param lpParam Pointer to the AssetStore object.
+ */
+void AssetStore::HashProc(size_t nIndex, LPVOID lpParam) {
+	AssetStore *store = (AssetStore*)lpParam;
+	AssetHash *hash = &store->arrBatchHashes[nIndex];
+	LPCTSTR szPath = store->arrBatchPaths[nIndex].c_str();
+	WIN32_FIND_DATA wfd;
+
+	hash->bHashed = false;
+
+	// Get the size of the file.
+	if (!FileUtils::GetInfo(szPath, &wfd))
+		return;
+	hash->dwSize = wfd.nFileSizeLow;
+
+	// Hash its contents.
+	hash->bHashed = FileUtils::HashContents(szPath, &hash->dwHash);
+}
+
+/**
+ * Replaces a file with a reference to a blob.
+ *
+ * @param  szPath     Path to the file to be replaced.
+ * @param  szBlobName Name of the blob with the same contents.
+ * @return            TRUE if the file was replaced.
+ */
+bool AssetStore::ReplaceWithReference(LPCTSTR szPath, LPCTSTR szBlobName) {
+	Path pathRef = GetReferencePath(Path(szPath));
+
+	// Write the reference before getting rid of the file, so that there's
+	// always a way to get to the contents.
+	if (!FileUtils::SaveContents(pathRef.ToString(), szBlobName))
+		return false;
+
+	if (!FileUtils::Delete(szPath)) {
+		FileUtils::Delete(pathRef.ToString());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Removes blobs that aren't referenced by anything and adds up how much space
+ * the remaining ones are saving.
+ *
+ * @param mapRefs Number of references to each blob.
+ * @param report  Report to be updated.
+ */
+void AssetStore::CollectBlobs(map<wstring, size_t> *mapRefs,
+							  AssetReport *report) {
+	map<wstring, size_t>::iterator it;
+	WIN32_FIND_DATA wfd;
+	HANDLE hFind;
+
+	hFind = FileUtils::FindFirst(dirBlobs.Concatenate(L"*").ToString(), &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	do {
+		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		// Delete the blobs that nothing points to.
+		it = mapRefs->find(wstring(wfd.cFileName));
+		if (it == mapRefs->end()) {
+			if (FileUtils::Delete(dirBlobs.Concatenate(wfd.cFileName).ToString()))
+				report->nOrphans++;
+
+			continue;
+		}
+
+		// Every reference after the first one is a copy we didn't have to keep.
+		report->nBlobs++;
+		report->nReferences += it->second;
+		report->dwBytesSaved += (it->second - 1) * wfd.nFileSizeLow;
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+}
+
+/**
+ * Builds the name of the blob that holds some contents.
+ *
+ * @param  dwHash Hash of the contents.
+ * @param  dwSize Size of the contents.
+ * @param  szPath Path of a file with these contents, used for its extension.
+ * @return        Blob name.
+ */
+wstring AssetStore::BuildBlobName(DWORD dwHash, DWORD dwSize, LPCTSTR szPath) {
+	WCHAR szName[32];
+	LPCTSTR szExtension = wcsrchr(Path(szPath).FileName(), L'.');
+
+	// Keep the extension so that the shell knows how to open the blob.
+	swprintf(szName, L"%08lX%08lX", dwHash, dwSize);
+	wstring swName(szName);
+	if (szExtension != NULL)
+		swName += szExtension;
+
+	return swName;
+}
+
+/**
+ * Reads the name of the blob a reference file points to.
+ *
+ * @param  szPath     Path to the reference file.
+ * @param  swBlobName Name of the blob.
+ * @return            TRUE if the reference exists and is valid.
+ */
+bool AssetStore::ReadReference(LPCTSTR szPath, wstring *swBlobName) {
+	LPTSTR szContents;
+
+	if (!FileUtils::Exists(szPath) ||
+			!FileUtils::ReadContents(szPath, &szContents))
+		return false;
+
+	// Ignore any trailing whitespace.
+	*swBlobName = szContents;
+	AllocProfiler::Free(szContents);
+	while (!swBlobName->empty() && iswspace((*swBlobName)[swBlobName->length() - 1]))
+		swBlobName->erase(swBlobName->length() - 1);
+
+	// Blobs are always directly inside the store.
+	return !swBlobName->empty() && ((*swBlobName)[0] != L'.') &&
+		(swBlobName->find_first_of(L"\\/:") == wstring::npos);
+}
+
+/**
+ * Gets the path of the reference file that replaces a file.
+ *
+ * @param  pathFile Path to the original file.
+ * @return          Path to the reference file.
+ */
+Path AssetStore::GetReferencePath(Path pathFile) {
+	pathFile.AppendString(BLOB_REF_EXTENSION);
+	return pathFile;
+}
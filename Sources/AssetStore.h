@@ -0,0 +1,73 @@
+/**
+ * AssetStore.h
+ * Content-addressed store that lets identical datasheets and images share a
+ * single copy on disk.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _ASSET_STORE_H
+#define _ASSET_STORE_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Directory.h"
+
+using namespace std;
+
+// Summary of a deduplication run.
+typedef struct {
+	size_t nScanned;
+	size_t nDeduplicated;
+	size_t nBlobs;
+	size_t nReferences;
+	size_t nOrphans;
+	DWORD dwBytesReclaimed;
+	DWORD dwBytesSaved;
+} AssetReport;
+
+class AssetStore {
+protected:
+	// Contents of a single file in a deduplication run.
+	typedef struct {
+		DWORD dwHash;
+		DWORD dwSize;
+		bool bHashed;
+	} AssetHash;
+
+	Directory dirWorkspace;
+	Directory dirBlobs;
+
+	// Deduplication batch.
+	vector<wstring> arrBatchPaths;
+	vector<AssetHash> arrBatchHashes;
+
+	// Deduplication.
+	void ListCandidates(map<wstring, size_t> *mapRefs);
+	void AddCandidate(Path pathFile, map<wstring, size_t> *mapRefs);
+	static void HashProc(size_t nIndex, LPVOID lpParam);
+	bool ReplaceWithReference(LPCTSTR szPath, LPCTSTR szBlobName);
+	void CollectBlobs(map<wstring, size_t> *mapRefs, AssetReport *report);
+
+	// Helpers.
+	static wstring BuildBlobName(DWORD dwHash, DWORD dwSize, LPCTSTR szPath);
+	static bool ReadReference(LPCTSTR szPath, wstring *swBlobName);
+	static Path GetReferencePath(Path pathFile);
+
+public:
+	// Constructors and destructors.
+	AssetStore();
+
+	// Store.
+	void Open(Directory dirWorkspace);
+	bool Resolve(Path pathFile, Path *pathResolved);
+	static bool ResolveFile(Directory dirWorkspace, Path pathFile,
+							Path *pathResolved);
+
+	// Maintenance.
+	bool Deduplicate(AssetReport *report);
+};
+
+#endif  // _ASSET_STORE_H
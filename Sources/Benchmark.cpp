@@ -0,0 +1,378 @@
+/**
+ * Benchmark.cpp
+ * Times the core operations of the application against a synthetic workspace.
+ *
+ * Each operation is run a number of times and timed with the system tick
+ * count, so only the aggregated figures of the operations that take a few
+ * milliseconds or more are meaningful. The results are written as a JSON
+ * document so they can be compared between builds and devices.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "FileUtils.h"
+#include "IoAccounting.h"
+
+/**
+ * Initializes a benchmark with the default workspace and a single run.
+ */
+Benchmark::Benchmark() {
+	nRuns = 1;
+	dwStarted = 0;
+}
+
+/**
+ * Initializes a benchmark.
+ *
+ * @param settings Shape of the synthetic workspace.
+ * @param nRuns    Number of times each workspace-wide operation is run.
+ */
+Benchmark::Benchmark(GeneratorSettings settings, size_t nRuns) :
+	generator(settings) {
+	this->nRuns = (nRuns > 0) ? nRuns : 1;
+	dwStarted = 0;
+}
+
+/**
+ * Starts timing an operation.
+ *
+ * @param szName Name of the operation in the results.
+ */
+void Benchmark::Start(LPCTSTR szName) {
+	swCurrent = szName;
+	dwStarted = GetTickCount();
+}
+
+/**
+ * Stops timing the current operation and adds it to the results.
+ */
+void Benchmark::Stop() {
+	DWORD dwElapsed = GetTickCount() - dwStarted;
+	BenchmarkResult *result = GetResult(swCurrent.c_str());
+
+	result->dwRuns++;
+	result->dwTotal += dwElapsed;
+	if (dwElapsed < result->dwMin)
+		result->dwMin = dwElapsed;
+	if (dwElapsed > result->dwMax)
+		result->dwMax = dwElapsed;
+}
+
+/**
+ * Gets the number of times each workspace-wide operation should be run.
+ *
+ * @return Number of runs.
+ */
+size_t Benchmark::GetRuns() {
+	return nRuns;
+}
+
+/**
+ * Generates the synthetic workspace.
+ *
+ * @param  szPath Path of the workspace directory. Must not exist yet.
+ * @return        TRUE if the operation was successful.
+ */
+bool Benchmark::Generate(LPCTSTR szPath) {
+	bool bSuccess;
+
+	Start(L"generate");
+	bSuccess = generator.Generate(szPath);
+	Stop();
+
+	return bSuccess;
+}
+
+/**
+ * Records the outcome of a check.
+ *
+ * @param szName  Name of the check.
+ * @param bPassed Did the subsystem behave as expected?
+ */
+void Benchmark::Check(LPCTSTR szName, bool bPassed) {
+	BenchmarkCheck check;
+
+	check.swName = szName;
+	check.bPassed = bPassed;
+	arrChecks.push_back(check);
+}
+
+/**
+ * Attaches an extra report to the results.
+ *
+ * @param szName Name of the report.
+ * @param swJSON Report as a JSON value.
+ */
+void Benchmark::AddSection(LPCTSTR szName, const wstring &swJSON) {
+	BenchmarkSection section;
+
+	section.swName = szName;
+	section.swJSON = swJSON;
+	arrSections.push_back(section);
+}
+
+/**
+ * Attaches the file system operations done during the benchmark and checks
+ * the average of each user action against its budget.
+ * @remark The counters should be reset before the benchmark is run and this
+ *         must be called before AddChecks.
+ *
+ * @return TRUE if every action is within its budget.
+ */
+bool Benchmark::AddIoReport() {
+	IoCounters open = IoAccounting::GetCounters(IO_OP_OPEN);
+	IoCounters refresh = IoAccounting::GetCounters(IO_OP_REFRESH);
+	IoCounters select = IoAccounting::GetCounters(IO_OP_SELECT);
+	IoCounters save = IoAccounting::GetCounters(IO_OP_SAVE);
+	LONG lComponents = (LONG)generator.GetSettings().nComponents;
+	wstring swJSON(L"[");
+	bool bPassed = true;
+
+	AddSection(L"io", IoAccounting::ToJSON());
+
+	// Check the averages of each action.
+	bPassed &= AppendBudget(&swJSON, IO_OP_OPEN, L"opens", open.lOpens,
+		open.lCalls, IO_BUDGET_OPEN_WORKSPACE +
+		(lComponents * IO_BUDGET_OPEN_PER_COMPONENT));
+	swJSON += L",";
+	bPassed &= AppendBudget(&swJSON, IO_OP_REFRESH, L"opens", refresh.lOpens,
+		refresh.lCalls, IO_BUDGET_OPEN_WORKSPACE +
+		(lComponents * IO_BUDGET_OPEN_PER_COMPONENT));
+	swJSON += L",";
+	bPassed &= AppendBudget(&swJSON, IO_OP_SELECT, L"opens", select.lOpens,
+		select.lCalls, IO_BUDGET_SELECT_OPENS);
+	swJSON += L",";
+	bPassed &= AppendBudget(&swJSON, IO_OP_SELECT, L"probes", select.lProbes,
+		select.lCalls, IO_BUDGET_SELECT_PROBES);
+	swJSON += L",";
+	bPassed &= AppendBudget(&swJSON, IO_OP_SAVE, L"opens", save.lOpens,
+		save.lCalls, IO_BUDGET_SAVE_OPENS);
+	swJSON += L"\r\n\t]";
+
+	AddSection(L"io_budgets", swJSON);
+	return bPassed;
+}
+
+/**
+ * Attaches where the memory went and checks the average cost of each
+ * component against its budget.
+ *
+ * @param  report Memory used by the synthetic workspace.
+ * @return        TRUE if the components are within their budget.
+ */
+bool Benchmark::AddMemoryReport(MemoryReport *report) {
+	bool bPassed = report->GetPerComponent() <= MEMORY_BUDGET_PER_COMPONENT;
+	wstring swJSON(L"{");
+
+	// Subsystems.
+	swJSON += L"\r\n\t\t\"subsystems\": {";
+	for (int i = 0; i < MEMORY_SUBSYSTEMS; i++) {
+		AppendNumber(&swJSON, MemoryReport::GetSubsystemName(i),
+			report->GetBytes(i), i == (MEMORY_SUBSYSTEMS - 1));
+	}
+	swJSON += L"},\r\n\t\t";
+
+	// Budget.
+	AppendNumber(&swJSON, L"total_bytes", report->GetTotal(), false);
+	AppendNumber(&swJSON, L"components", report->GetComponents(), false);
+	AppendNumber(&swJSON, L"per_component", report->GetPerComponent(), false);
+	AppendNumber(&swJSON, L"budget_per_component", MEMORY_BUDGET_PER_COMPONENT,
+		false);
+	swJSON += bPassed ? L" \"passed\": true\r\n\t}" :
+		L" \"passed\": false\r\n\t}";
+
+	AddSection(L"memory", swJSON);
+	return bPassed;
+}
+
+/**
+ * Attaches the outcome of every check that was run.
+ *
+ * @return TRUE if every check passed.
+ */
+bool Benchmark::AddChecks() {
+	wstring swJSON(L"[");
+	bool bPassed = true;
+
+	for (size_t i = 0; i < arrChecks.size(); i++) {
+		swJSON += (i == 0) ? L"\r\n\t\t{\"name\": " : L",\r\n\t\t{\"name\": ";
+		AppendString(&swJSON, arrChecks[i].swName.c_str());
+		swJSON += arrChecks[i].bPassed ? L", \"passed\": true}" :
+			L", \"passed\": false}";
+
+		bPassed &= arrChecks[i].bPassed;
+	}
+	swJSON += L"\r\n\t]";
+
+	AddSection(L"checks", swJSON);
+	return bPassed;
+}
+
+/**
+ * Gets the timings of every operation.
+ *
+ * @return Timings in the order the operations were first run.
+ */
+vector<BenchmarkResult> Benchmark::GetResults() {
+	return arrResults;
+}
+
+/**
+ * Gets the timings of an operation, creating them if needed.
+ *
+ * @param  szName Name of the operation.
+ * @return        Timings of the operation.
+ */
+BenchmarkResult* Benchmark::GetResult(LPCTSTR szName) {
+	BenchmarkResult result;
+
+	for (size_t i = 0; i < arrResults.size(); i++) {
+		if (arrResults[i].swName.compare(szName) == 0)
+			return &arrResults[i];
+	}
+
+	result.swName = szName;
+	result.dwRuns = 0;
+	result.dwTotal = 0;
+	result.dwMin = (DWORD)-1;
+	result.dwMax = 0;
+	arrResults.push_back(result);
+
+	return &arrResults.back();
+}
+
+/**
+ * Builds the JSON document with the settings and the results.
+ *
+ * @return Results as a JSON document.
+ */
+wstring Benchmark::ToJSON() {
+	GeneratorSettings settings = generator.GetSettings();
+	wstring swJSON;
+	size_t i;
+
+	// Workspace settings.
+	swJSON = L"{\r\n\t\"workspace\": {";
+	AppendNumber(&swJSON, L"components", settings.nComponents, false);
+	AppendNumber(&swJSON, L"categories", settings.nCategories, false);
+	AppendNumber(&swJSON, L"sub_categories", settings.nSubCategories, false);
+	AppendNumber(&swJSON, L"min_properties", settings.nMinProperties, false);
+	AppendNumber(&swJSON, L"max_properties", settings.nMaxProperties, false);
+	AppendNumber(&swJSON, L"max_notes_length", settings.nMaxNotesLength, false);
+	AppendNumber(&swJSON, L"images", settings.nImages, false);
+	AppendNumber(&swJSON, L"seed", settings.dwSeed, true);
+	swJSON += L"},\r\n\t";
+	AppendNumber(&swJSON, L"runs", nRuns, false);
+
+	// Timings.
+	swJSON += L"\r\n\t\"results\": [";
+	for (i = 0; i < arrResults.size(); i++) {
+		BenchmarkResult *result = &arrResults[i];
+
+		swJSON += (i == 0) ? L"\r\n\t\t{\"name\": " : L",\r\n\t\t{\"name\": ";
+		AppendString(&swJSON, result->swName.c_str());
+		swJSON += L",";
+		AppendNumber(&swJSON, L"runs", result->dwRuns, false);
+		AppendNumber(&swJSON, L"total_ms", result->dwTotal, false);
+		AppendNumber(&swJSON, L"min_ms", result->dwMin, false);
+		AppendNumber(&swJSON, L"max_ms", result->dwMax, false);
+		AppendNumber(&swJSON, L"mean_ms", result->dwTotal / result->dwRuns, true);
+		swJSON += L"}";
+	}
+	swJSON += L"\r\n\t]";
+
+	// Extra reports.
+	for (i = 0; i < arrSections.size(); i++) {
+		swJSON += L",\r\n\t";
+		AppendString(&swJSON, arrSections[i].swName.c_str());
+		swJSON += L": ";
+		swJSON += arrSections[i].swJSON;
+	}
+	swJSON += L"\r\n}\r\n";
+
+	return swJSON;
+}
+
+/**
+ * Saves the results to a JSON file.
+ *
+ * @param  szPath Path of the file.
+ * @return        TRUE if the operation was successful.
+ */
+bool Benchmark::Save(LPCTSTR szPath) {
+	return FileUtils::SaveContents(szPath, ToJSON().c_str());
+}
+
+/**
+ * Appends a number field to a JSON object.
+ *
+ * @param swJSON  JSON being built.
+ * @param szName  Field name.
+ * @param dwValue Field value.
+ * @param bLast   Is this the last field of the object?
+ */
+void Benchmark::AppendNumber(wstring *swJSON, LPCTSTR szName, DWORD dwValue,
+							 bool bLast) {
+	WCHAR szNumber[33];
+
+	*swJSON += L" ";
+	AppendString(swJSON, szName);
+	*swJSON += L": ";
+	*swJSON += _ultow(dwValue, szNumber, 10);
+	if (!bLast)
+		*swJSON += L",";
+}
+
+/**
+ * Appends the check of a file system operation budget to a JSON array and
+ * records it with the other checks, so that going over it fails the run.
+ *
+ * @param  swJSON     JSON being built.
+ * @param  nOperation User action that was checked.
+ * @param  szCounter  Name of the counter that was checked.
+ * @param  lCount     Total count of the counter.
+ * @param  lCalls     Number of times the action was done.
+ * @param  lBudget    Most the action may do per call.
+ * @return            TRUE if the action is within its budget.
+ */
+bool Benchmark::AppendBudget(wstring *swJSON, int nOperation,
+							 LPCTSTR szCounter, LONG lCount, LONG lCalls,
+							 LONG lBudget) {
+	LONG lPerCall = (lCalls > 0) ? (lCount / lCalls) : 0;
+	bool bPassed = lPerCall <= lBudget;
+
+	*swJSON += L"\r\n\t\t{\"operation\": ";
+	AppendString(swJSON, IoAccounting::GetOperationName(nOperation));
+	*swJSON += L", \"counter\": ";
+	AppendString(swJSON, szCounter);
+	*swJSON += L",";
+	AppendNumber(swJSON, L"per_call", (DWORD)lPerCall, false);
+	AppendNumber(swJSON, L"budget", (DWORD)lBudget, false);
+	*swJSON += bPassed ? L" \"passed\": true}" : L" \"passed\": false}";
+
+	// Record it as a check as well.
+	wstring swCheck(L"io_budget_");
+	swCheck += IoAccounting::GetOperationName(nOperation);
+	swCheck += L"_";
+	swCheck += szCounter;
+	Check(swCheck.c_str(), bPassed);
+
+	return bPassed;
+}
+
+/**
+ * Appends a string to a JSON document with the required escaping.
+ *
+ * @param swJSON   JSON being built.
+ * @param szString String to be appended.
+ */
+void Benchmark::AppendString(wstring *swJSON, LPCTSTR szString) {
+	*swJSON += L'"';
+	for (; *szString != L'\0'; szString++) {
+		if ((*szString == L'"') || (*szString == L'\\'))
+			*swJSON += L'\\';
+		*swJSON += *szString;
+	}
+	*swJSON += L'"';
+}
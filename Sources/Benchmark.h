@@ -0,0 +1,244 @@
+/**
+ * Benchmark.h
+ * Times the core operations of the application against a synthetic workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Workspace.h"
+#include "WorkspaceGenerator.h"
+#include "MemoryReport.h"
+#include "DetailLoader.h"
+#include "TreeDiff.h"
+#include "TreeMaterializer.h"
+#include "FacetIndex.h"
+#include "SmartQuery.h"
+
+using namespace std;
+
+// Number of runs, components saved and query used by the benchmark.
+#define BENCHMARK_RUNS  3
+#define BENCHMARK_SAVES 50
+#define BENCHMARK_QUERY L"Package = 0805 & Quantity > 100"
+
+// Lines of the bills of materials imported into and applied to the synthetic
+// workspace.
+#define BENCHMARK_BOM_IMPORT_LINES 100000
+#define BENCHMARK_BOM_APPLY_LINES  10000
+
+// Quantity changes recorded in the history that is queried.
+#define BENCHMARK_HISTORY_EVENTS 100000
+
+// Most file system operations each user action may do on average. Opening a
+// workspace reads its own file, plus the manifest, the quantity and the
+// version stamp of each component. Selecting one includes decoding its image.
+#define IO_BUDGET_OPEN_WORKSPACE     1
+#define IO_BUDGET_OPEN_PER_COMPONENT 3
+#define IO_BUDGET_SELECT_OPENS       4
+#define IO_BUDGET_SELECT_PROBES      8
+#define IO_BUDGET_SAVE_OPENS         6
+
+// Most memory each component may cost on average, in bytes. Platforms with
+// wider characters and pointers than the devices bring their own.
+#ifndef MEMORY_BUDGET_PER_COMPONENT
+	#define MEMORY_BUDGET_PER_COMPONENT (12 * 1024)
+#endif
+
+// Concurrent writers stress test.
+#define BENCHMARK_WRITERS       4
+#define BENCHMARK_WRITER_ROUNDS 50
+
+// Copies of the application started by the benchmark to stress the locks
+// across processes.
+#define BENCHMARK_CHILD_LOCK      L"-benchmark-lock"
+#define BENCHMARK_CHILD_WRITER    L"-benchmark-writer"
+#define BENCHMARK_CHILD_TIMEOUT   30000
+#define BENCHMARK_PROCESSES       4
+#define BENCHMARK_PROCESS_LOCK    L"Benchmark.lock"
+#define BENCHMARK_READY_EXTENSION L".ready"
+#define BENCHMARK_LOCK_WAIT       500
+
+// Selections done through the background detail loader.
+#define BENCHMARK_DETAIL_CLASS   L"PartCatBenchmark"
+#define BENCHMARK_DETAIL_TIMEOUT 5000
+
+// Synthetic workspace that the indexes are timed against in memory.
+#define BENCHMARK_INDEX_ROOT    L"\\Benchmark Index"
+#define BENCHMARK_INDEX_EDITS   1000
+#define BENCHMARK_SMART_FOLDERS 50
+
+// Components between each exact and near copy planted for the duplicates scan.
+#define BENCHMARK_DUPLICATE_SPACING 100
+
+// Bill of materials imported into the synthetic workspace, written to disk
+// this many lines at a time.
+#define BENCHMARK_BOM_FILE        L"Benchmark BOM.csv"
+#define BENCHMARK_BOM_REPORT_FILE L"Benchmark BOM Report.csv"
+#define BENCHMARK_BOM_CHUNK_LINES 512
+
+// How far ahead of the clock the batches left in the quantity journal by the
+// bill of materials checks are.
+#define BENCHMARK_JOURNAL_AHEAD 1000
+
+// History recorded from scratch and queried.
+#define BENCHMARK_HISTORY_FILE         L"Benchmark.history"
+#define BENCHMARK_HISTORY_COMPONENTS   500
+#define BENCHMARK_HISTORY_DAYS         730
+#define BENCHMARK_HISTORY_CHUNK        1000
+#define BENCHMARK_HISTORY_TOP          10
+#define BENCHMARK_HISTORY_UNICODE_NAME L"Resistor 10k\x03A9 \x00B1" L"1%"
+
+// Synthetic tree that is compared and patched without a TreeView.
+#define BENCHMARK_TREE_FOLDERS    100
+#define BENCHMARK_TREE_COMPONENTS 100000
+
+// Timings of a single operation in milliseconds.
+typedef struct {
+	wstring swName;
+	DWORD dwRuns;
+	DWORD dwTotal;
+	DWORD dwMin;
+	DWORD dwMax;
+} BenchmarkResult;
+
+// Writer of the concurrent writers stress test. Each one has its own copy of
+// the component and of the history, as if it was another instance of the
+// application sharing the workspace.
+typedef struct {
+	Directory dirComponent;
+	Path pathHistory;
+	size_t nRounds;
+	size_t nFailed;
+} BenchmarkWriter;
+
+// Outcome of a check of how a subsystem behaves.
+typedef struct {
+	wstring swName;
+	bool bPassed;
+} BenchmarkCheck;
+
+// Extra report that is attached to the results as a JSON value.
+typedef struct {
+	wstring swName;
+	wstring swJSON;
+} BenchmarkSection;
+
+class Benchmark {
+protected:
+	WorkspaceGenerator generator;
+	vector<BenchmarkResult> arrResults;
+	vector<BenchmarkSection> arrSections;
+	vector<BenchmarkCheck> arrChecks;
+	size_t nRuns;
+	wstring swCurrent;
+	DWORD dwStarted;
+
+	// Reporting.
+	BenchmarkResult* GetResult(LPCTSTR szName);
+	static void AppendNumber(wstring *swJSON, LPCTSTR szName, DWORD dwValue,
+							 bool bLast);
+	static void AppendString(wstring *swJSON, LPCTSTR szString);
+	bool AppendBudget(wstring *swJSON, int nOperation, LPCTSTR szCounter,
+					  LONG lCount, LONG lCalls, LONG lBudget);
+
+	// Checks.
+	static void CountFreeProc(void *lpData, void *lpParam);
+	static void AppendLittleEndian(vector<unsigned char> *arrData,
+								   unsigned long ulValue, size_t nBytes);
+	static vector<unsigned char> EncodeTestRows(int nBitCount,
+		const unsigned long *aulValues, bool bTopDown);
+	static vector<unsigned char> BuildTestBmp(bool bCore, int nBitCount,
+		unsigned long ulCompression, long lWidth, long lHeight, size_t nColors,
+		const unsigned long *aulMasks, const vector<unsigned char> &arrPixels);
+	static bool DecodesTo(const vector<unsigned char> &arrFile,
+						  const unsigned long *aulExpected);
+
+	// Concurrent writers.
+	static DWORD WINAPI WriterThreadProc(LPVOID lpParam);
+	static void SumDeltasProc(const HistoryEvent *event, LPVOID lpParam);
+	static long SumHistory(Path pathHistory);
+
+	// Concurrent processes.
+	static HANDLE StartChild(LPCTSTR szArguments);
+	static bool NextArgument(LPCTSTR *szCommandLine, wstring *swArgument);
+
+	// History.
+	static void CountEventsProc(const HistoryEvent *event, LPVOID lpParam);
+
+	// Selections.
+	static DetailModel* WaitForDetail(HWND hwndNotify);
+	static bool MatchesDetail(Component *component, DetailModel *model);
+
+	// Saves.
+	static LONG GetSaveWrites();
+
+	// Indexes.
+	static Component* EditTestComponent(vector<Component> *arrComponents,
+										size_t nEdit);
+	static SmartQuery BuildTestQuery(size_t nFolder);
+	static bool SameFacets(FacetIndex *first, FacetIndex *second);
+	static bool SameCount(FacetCount first, FacetCount second);
+
+	// Trees.
+	static void BuildTestTree(TreeModel *model, size_t nMoved,
+							  size_t nOnlyFolder);
+	static void AddTestChip(TreeModel *model, size_t nParent,
+							size_t nComponent, LPCTSTR szPrefix);
+
+public:
+	// Constructors and destructors.
+	Benchmark();
+	Benchmark(GeneratorSettings settings, size_t nRuns);
+
+	// Timing.
+	void Start(LPCTSTR szName);
+	void Stop();
+	size_t GetRuns();
+
+	// Suite.
+	bool Generate(LPCTSTR szPath);
+	bool RunWorkspace(LPCTSTR szPath, Workspace *workspace);
+	void RunComponents(Workspace *workspace, size_t nSaves);
+	void RunSearch(Workspace *workspace, LPCTSTR szExpression);
+	bool RunConcurrentWriters(LPCTSTR szPath, Workspace *workspace);
+	bool RunConcurrentProcesses(LPCTSTR szPath, Workspace *workspace);
+	void RunBomApply(Workspace *workspace, size_t nLines);
+	void RunBomImport(Workspace *workspace, size_t nLines);
+	void RunHistory(LPCTSTR szPath, size_t nEvents);
+	void RunSelection(Workspace *workspace, size_t nSelections);
+	void RunFacets(size_t nComponents, size_t nEdits);
+	void RunSmartFolders(size_t nComponents, size_t nFolders, size_t nEdits);
+	void RunDuplicates(size_t nComponents, double dSimilarity);
+
+	// Child processes.
+	static bool IsChild(LPCTSTR szCommandLine);
+	static int RunChild(LPCTSTR szCommandLine);
+
+	// Checks.
+	void Check(LPCTSTR szName, bool bPassed);
+	void RunCacheChecks();
+	void RunImageChecks();
+	void RunPrefetchChecks();
+	void RunSaveChecks(Workspace *workspace);
+	void RunSaveAsChecks(Workspace *workspace);
+	void RunTreeChecks();
+	void RunReclaimChecks();
+	void RunTraceChecks();
+
+	// Reporting.
+	void AddSection(LPCTSTR szName, const wstring &swJSON);
+	bool AddIoReport();
+	bool AddMemoryReport(MemoryReport *report);
+	bool AddChecks();
+	vector<BenchmarkResult> GetResults();
+	wstring ToJSON();
+	bool Save(LPCTSTR szPath);
+};
+
+#endif  // _BENCHMARK_H
@@ -0,0 +1,205 @@
+/**
+ * BenchmarkBom.cpp
+ * Times importing a bill of materials and applying it to the quantities of
+ * the synthetic workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "FileUtils.h"
+#include "BomImporter.h"
+
+/**
+ * Applies a large bill of materials to the synthetic workspace as a single
+ * batch of quantity changes and checks that the journal finishes what was
+ * left behind by an interrupted batch exactly once.
+ *
+ * @param workspace Opened synthetic workspace.
+ * @param nLines    Number of lines in the bill of materials.
+ */
+void Benchmark::RunBomApply(Workspace *workspace, size_t nLines) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	Path pathJournal = workspace->GetDirectory().Concatenate(
+		QUANTITY_JOURNAL_FILE);
+	vector<QuantityDelta> arrDeltas;
+	vector<size_t> arrExpected;
+	WCHAR szNumber[33];
+	wstring swJournal;
+	size_t i;
+
+	if (arrComponents->empty())
+		return;
+
+	// Build the bill, going around the workspace a few times. Others may have
+	// changed the quantities on disk, so that's where we start from.
+	for (i = 0; i < arrComponents->size(); i++) {
+		arrExpected.push_back(Component(
+			(*arrComponents)[i].GetDirectory()).GetQuantity());
+	}
+	for (i = 0; i < nLines; i++) {
+		QuantityDelta delta;
+
+		delta.hComponent = workspace->GetComponentHandle(
+			i % arrComponents->size());
+		delta.lDelta = (long)(i % 3) + 1;
+		arrDeltas.push_back(delta);
+
+		arrExpected[i % arrComponents->size()] += delta.lDelta;
+	}
+
+	// Apply it.
+	Start(L"bom_apply");
+	bool bApplied = workspace->ApplyQuantityDeltas(arrDeltas);
+	Stop();
+
+	// Check that every quantity made it to disk.
+	bool bSaved = bApplied && !pathJournal.Exists();
+	for (i = 0; bSaved && (i < arrComponents->size()); i++) {
+		bSaved = Component((*arrComponents)[i].GetDirectory()).GetQuantity() ==
+			arrExpected[i];
+	}
+	Check(L"bom_apply_saved", bSaved);
+
+	// Leave a finished batch and one that was torn while being written in the
+	// journal, as if we crashed right after writing them.
+	Directory dirFirst = arrComponents->front().GetDirectory();
+	Directory dirLast = arrComponents->back().GetDirectory();
+	size_t nFirst = Component(dirFirst).GetQuantity();
+	size_t nLast = Component(dirLast).GetQuantity();
+	DWORD dwBatch = QuantityHistory::Now() + BENCHMARK_JOURNAL_AHEAD;
+
+	_ultow(dwBatch, szNumber, 10);
+	swJournal = szNumber;
+	swJournal += L"\r\n";
+	swJournal += dirFirst.ToString();
+	swJournal += L"\t5\r\n.\r\n";
+	_ultow(dwBatch + 1, szNumber, 10);
+	swJournal += szNumber;
+	swJournal += L"\r\n";
+	swJournal += dirLast.ToString();
+	swJournal += L"\t7\r\n";
+	FileUtils::SaveContents(pathJournal.ToString(), swJournal.c_str());
+
+	// The next batch must finish the pending one first, not throw it away.
+	arrDeltas.resize(1);
+	arrDeltas[0].hComponent = workspace->GetComponentHandle(0);
+	arrDeltas[0].lDelta = 1;
+	bApplied = workspace->ApplyQuantityDeltas(arrDeltas);
+	Check(L"bom_apply_keeps_pending_batch", bApplied &&
+		(Component(dirFirst).GetQuantity() == (nFirst + 6)) &&
+		(arrComponents->front().GetQuantity() == (nFirst + 6)) &&
+		!pathJournal.Exists());
+	Check(L"bom_apply_skips_torn_batch",
+		Component(dirLast).GetQuantity() == nLast);
+
+	// A batch that already reached the component mustn't be applied again.
+	_ultow(dwBatch, szNumber, 10);
+	swJournal = szNumber;
+	swJournal += L"\r\n";
+	swJournal += dirFirst.ToString();
+	swJournal += L"\t5\r\n.\r\n";
+	FileUtils::SaveContents(pathJournal.ToString(), swJournal.c_str());
+	bApplied = workspace->ApplyQuantityDeltas(vector<QuantityDelta>());
+	Check(L"bom_apply_replays_once", bApplied &&
+		(Component(dirFirst).GetQuantity() == (nFirst + 6)) &&
+		!pathJournal.Exists());
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"lines", nLines, false);
+	AppendNumber(&swJSON, L"components", arrComponents->size(), false);
+	AppendNumber(&swJSON, L"total_ms", GetResult(L"bom_apply")->dwTotal, true);
+	swJSON += L"}";
+	AddSection(L"bom_apply", swJSON);
+}
+
+/**
+ * Times importing a large bill of materials into the synthetic workspace. A
+ * third of the lines have the part number of a component, a third only have
+ * something like its name and the rest aren't in the workspace at all.
+ *
+ * @param workspace Opened synthetic workspace.
+ * @param nLines    Number of lines in the bill of materials.
+ */
+void Benchmark::RunBomImport(Workspace *workspace, size_t nLines) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	Path pathBom = workspace->GetDirectory().Concatenate(BENCHMARK_BOM_FILE);
+	Path pathReport = workspace->GetDirectory().Concatenate(
+		BENCHMARK_BOM_REPORT_FILE);
+	BomImporter importer(arrComponents);
+	WCHAR szNumber[33];
+	wstring swChunk;
+	HANDLE hFile;
+	bool bWritten;
+	size_t i;
+
+	if (arrComponents->empty())
+		return;
+
+	// Write the bill of materials a chunk at a time.
+	hFile = CreateFile(pathBom.ToString(), GENERIC_WRITE, 0, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+	bWritten = FileUtils::WriteString(hFile,
+		L"Part Number,Name,Quantity\r\n");
+	for (i = 0; bWritten && (i < nLines); i++) {
+		_ltow((long)(i % arrComponents->size()), szNumber, 10);
+		switch (i % 3) {
+		case 0:
+			swChunk += L"PART-";
+			swChunk += szNumber;
+			swChunk += L",,";
+			break;
+		case 1:
+			swChunk += L",Part ";
+			swChunk += szNumber;
+			swChunk += L" Rev B,";
+			break;
+		default:
+			_ltow((long)i, szNumber, 10);
+			swChunk += L"ZZ-";
+			swChunk += szNumber;
+			swChunk += L",Missing Part,";
+			break;
+		}
+		_ltow((long)(i % 5) + 1, szNumber, 10);
+		swChunk += szNumber;
+		swChunk += L"\r\n";
+
+		if ((i % BENCHMARK_BOM_CHUNK_LINES) == (BENCHMARK_BOM_CHUNK_LINES - 1)) {
+			bWritten = FileUtils::WriteString(hFile, swChunk.c_str());
+			swChunk.erase();
+		}
+	}
+	bWritten = bWritten && FileUtils::WriteString(hFile, swChunk.c_str());
+	CloseHandle(hFile);
+
+	// Import it.
+	Start(L"bom_import");
+	bool bImported = bWritten && importer.Import(pathBom.ToString(),
+		pathReport.ToString());
+	Stop();
+	DeleteFile(pathBom.ToString());
+	DeleteFile(pathReport.ToString());
+
+	// Every line with a part number must have found its component.
+	BomSummary summary = importer.GetSummary();
+	Check(L"bom_import_matches_part_numbers", bImported &&
+		(summary.nLines == nLines) &&
+		(summary.nMatched >= ((nLines + 2) / 3)));
+
+	// Report.
+	DWORD dwElapsed = GetResult(L"bom_import")->dwTotal;
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"lines", nLines, false);
+	AppendNumber(&swJSON, L"components", arrComponents->size(), false);
+	AppendNumber(&swJSON, L"matched", summary.nMatched, false);
+	AppendNumber(&swJSON, L"unmatched", summary.nUnmatched, false);
+	AppendNumber(&swJSON, L"total_ms", dwElapsed, false);
+	AppendNumber(&swJSON, L"lines_per_second", (dwElapsed > 0) ?
+		(nLines * 1000) / dwElapsed : nLines * 1000, true);
+	swJSON += L"}";
+	AddSection(L"bom_import", swJSON);
+}
@@ -0,0 +1,132 @@
+/**
+ * BenchmarkCaches.cpp
+ * Checks the eviction policies of the caches and of the prefetch queue.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "LruCache.h"
+#include "BitmapCache.h"
+#include "PrefetchQueue.h"
+
+/**
+ * Checks the eviction policy of the least recently used cache that holds the
+ * decoded bitmaps, using plain numbers as objects.
+ */
+void Benchmark::RunCacheChecks() {
+	size_t nFreed = 0;
+	LruCache cache(3, CountFreeProc, &nFreed);
+	size_t i;
+
+	// Fill it up and touch the oldest one.
+	cache.Put(L"a", NULL, 1);
+	cache.Put(L"b", NULL, 1);
+	cache.Put(L"c", NULL, 1);
+	cache.Release(L"a");
+	cache.Release(L"b");
+	cache.Release(L"c");
+	cache.Get(L"a");
+	cache.Release(L"a");
+
+	// The least recently used one should make room for a new one.
+	cache.Put(L"d", NULL, 1);
+	cache.Release(L"d");
+	Check(L"lru_evicts_least_recent", !cache.Contains(L"b") &&
+		cache.Contains(L"a") && cache.Contains(L"c") && cache.Contains(L"d") &&
+		(cache.GetUsedBytes() == 3) && (cache.GetEvictions() == 1) &&
+		(nFreed == 1));
+
+	// Lookups are counted.
+	cache.ResetStatistics();
+	cache.Get(L"c");
+	cache.Release(L"c");
+	cache.Get(L"b");
+	Check(L"lru_counts_hits_and_misses", (cache.GetHits() == 1) &&
+		(cache.GetMisses() == 1));
+
+	// Pinned objects survive going over the budget and can't be replaced.
+	cache.Get(L"a");
+	bool bReplaced = cache.Put(L"a", NULL, 1);
+	for (i = 0; i < 3; i++) {
+		WCHAR szKey[2] = { (WCHAR)(L'e' + i), L'\0' };
+		cache.Put(szKey, NULL, 1);
+		cache.Release(szKey);
+	}
+	bool bPinned = cache.Contains(L"a");
+	cache.Release(L"a");
+	Check(L"lru_keeps_pinned_objects", bPinned && !bReplaced &&
+		(cache.GetUsedBytes() <= cache.GetBudget()));
+
+	// Memory pressure empties it.
+	cache.SetBudget(0);
+	Check(L"lru_trims_under_pressure", (cache.GetCount() == 0) &&
+		(cache.GetUsedBytes() == 0) && (nFreed == cache.GetEvictions() + 1));
+
+	// The bitmap budget follows the memory load of the device.
+	BitmapCache bitmaps;
+	LruCache *stats = bitmaps.GetStatistics();
+	bitmaps.AdjustBudget(BITMAP_CACHE_MEMORY_LOAD);
+	bool bHalved = (stats->GetBudget() == (BITMAP_CACHE_BUDGET / 2));
+	for (i = 0; i < 8; i++)
+		bitmaps.AdjustBudget(100);
+	bool bFloored = (stats->GetBudget() == BITMAP_CACHE_MIN_BUDGET);
+	bitmaps.AdjustBudget(BITMAP_CACHE_RESTORE_LOAD);
+	bool bHeld = (stats->GetBudget() == BITMAP_CACHE_MIN_BUDGET);
+	bitmaps.AdjustBudget(BITMAP_CACHE_RESTORE_LOAD - 1);
+	Check(L"bitmap_budget_follows_memory_load", bHalved && bFloored && bHeld &&
+		(stats->GetBudget() == BITMAP_CACHE_BUDGET));
+}
+
+/**
+ * Counts an object that was freed by a cache.
+ *
+ * @param lpData  Object that was freed.
+ * @param lpParam Pointer to the size_t counter.
+ */
+void Benchmark::CountFreeProc(void *lpData, void *lpParam) {
+	(*((size_t*)lpParam))++;
+}
+
+/**
+ * Checks that the images are prefetched in the order they are likely to be
+ * needed and that a new selection drops whatever was left of the previous one.
+ */
+void Benchmark::RunPrefetchChecks() {
+	PrefetchQueue queue(4);
+	vector<wstring> arrNeighbours;
+	PrefetchRequest request;
+	wstring swOrder;
+
+	// Selected image first, then the neighbours without duplicates or blanks.
+	arrNeighbours.push_back(L"b");
+	arrNeighbours.push_back(L"a");
+	arrNeighbours.push_back(wstring());
+	arrNeighbours.push_back(L"c");
+	arrNeighbours.push_back(L"b");
+	arrNeighbours.push_back(L"d");
+	arrNeighbours.push_back(L"e");
+	unsigned long ulFirst = queue.Select(L"a", arrNeighbours);
+	bool bSelectedFirst = queue.Pop(&request) && request.bSelected &&
+		(request.swKey == L"a") && (request.ulGeneration == ulFirst);
+	while (queue.Pop(&request)) {
+		if (request.bSelected)
+			bSelectedFirst = false;
+		swOrder += request.swKey;
+	}
+	Check(L"prefetch_selected_first", bSelectedFirst);
+	Check(L"prefetch_keeps_neighbour_order", swOrder == L"bcd");
+
+	// A new selection replaces the old one.
+	queue.Select(L"x", arrNeighbours);
+	unsigned long ulSecond = queue.Select(L"y", vector<wstring>());
+	Check(L"prefetch_drops_old_selection", !queue.IsCurrent(ulFirst) &&
+		queue.IsCurrent(ulSecond) && (queue.GetPending() == 1) &&
+		queue.Pop(&request) && (request.swKey == L"y") &&
+		!queue.Pop(&request));
+
+	// Cancelling makes the images in flight stale.
+	queue.Clear();
+	Check(L"prefetch_cancel_drops_all", !queue.IsCurrent(ulSecond) &&
+		(queue.GetPending() == 0));
+}
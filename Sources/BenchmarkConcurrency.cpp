@@ -0,0 +1,378 @@
+/**
+ * BenchmarkConcurrency.cpp
+ * Stresses the locks with writers in other threads and in other copies of
+ * the application sharing the synthetic workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "FileUtils.h"
+#include "FileLock.h"
+
+/**
+ * Hammers the quantity of a single component and the history from several
+ * writers at once, checking that none of their changes were lost along the
+ * way.
+ * @remark The writers are threads that don't share anything but the files,
+ *         so the locks are exercised just like they would by different
+ *         instances of the application.
+ *
+ * @param  szPath    Path of the workspace directory.
+ * @param  workspace Opened synthetic workspace.
+ * @return           TRUE if every change made it to disk.
+ */
+bool Benchmark::RunConcurrentWriters(LPCTSTR szPath, Workspace *workspace) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	BenchmarkWriter writers[BENCHMARK_WRITERS];
+	HANDLE hThreads[BENCHMARK_WRITERS];
+	Path pathHistory(Directory(szPath).Concatenate(QUANTITY_HISTORY_FILE));
+	size_t nWrites = 0;
+	size_t i;
+
+	if (arrComponents->empty())
+		return true;
+
+	// Take a snapshot of where everything stands.
+	Directory dirComponent = arrComponents->front().GetDirectory();
+	size_t nStart = Component(dirComponent).GetQuantity();
+	long lStartHistory = SumHistory(pathHistory);
+	FileLock::ResetContended();
+
+	// Let the writers loose.
+	Start(L"concurrent_writers");
+	DWORD dwStarted = GetTickCount();
+	for (i = 0; i < BENCHMARK_WRITERS; i++) {
+		writers[i].dirComponent = dirComponent;
+		writers[i].pathHistory = pathHistory;
+		writers[i].nRounds = BENCHMARK_WRITER_ROUNDS;
+		writers[i].nFailed = 0;
+
+		hThreads[i] = CreateThread(NULL, 0, WriterThreadProc, &writers[i], 0,
+			NULL);
+		if (hThreads[i] == NULL)
+			WriterThreadProc(&writers[i]);
+	}
+	for (i = 0; i < BENCHMARK_WRITERS; i++) {
+		if (hThreads[i] != NULL) {
+			WaitForSingleObject(hThreads[i], INFINITE);
+			CloseHandle(hThreads[i]);
+		}
+
+		nWrites += writers[i].nRounds - writers[i].nFailed;
+	}
+	DWORD dwElapsed = GetTickCount() - dwStarted;
+	Stop();
+
+	// Check that every write that succeeded is there.
+	size_t nQuantity = Component(dirComponent).GetQuantity();
+	long lHistory = SumHistory(pathHistory) - lStartHistory;
+	size_t nLostQuantity = (nQuantity < nStart + nWrites) ?
+		nStart + nWrites - nQuantity : 0;
+	size_t nLostEvents = ((long)nWrites > lHistory) ?
+		(size_t)((long)nWrites - lHistory) : 0;
+	bool bPassed = (nQuantity == (nStart + nWrites)) &&
+		(lHistory == (long)nWrites);
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"writers", BENCHMARK_WRITERS, false);
+	AppendNumber(&swJSON, L"rounds", BENCHMARK_WRITER_ROUNDS, false);
+	AppendNumber(&swJSON, L"writes", nWrites, false);
+	AppendNumber(&swJSON, L"failed", (BENCHMARK_WRITERS *
+		BENCHMARK_WRITER_ROUNDS) - nWrites, false);
+	AppendNumber(&swJSON, L"total_ms", dwElapsed, false);
+	AppendNumber(&swJSON, L"writes_per_second", (dwElapsed > 0) ?
+		(nWrites * 1000) / dwElapsed : nWrites * 1000, false);
+	AppendNumber(&swJSON, L"contended_locks", FileLock::GetContended(), false);
+	AppendNumber(&swJSON, L"lost_quantity", nLostQuantity, false);
+	AppendNumber(&swJSON, L"lost_events", nLostEvents, false);
+	swJSON += bPassed ? L" \"passed\": true}" : L" \"passed\": false}";
+	AddSection(L"concurrent_writers", swJSON);
+
+	return bPassed;
+}
+
+/**
+ * Checks the locks across processes, with copies of the application started
+ * just to hold a lock or to hammer the quantity of a component and the
+ * history like RunConcurrentWriters does with threads.
+ * @remark A lock held by a process that dies must be released by the system,
+ *         leaving just a stale lock file behind that mustn't get in the way.
+ *
+ * @param  szPath    Path of the workspace directory.
+ * @param  workspace Opened synthetic workspace.
+ * @return           TRUE if every change made it to disk.
+ */
+bool Benchmark::RunConcurrentProcesses(LPCTSTR szPath, Workspace *workspace) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	HANDLE hProcesses[BENCHMARK_PROCESSES];
+	Path pathHistory(Directory(szPath).Concatenate(QUANTITY_HISTORY_FILE));
+	Path pathLock(Directory(szPath).Concatenate(BENCHMARK_PROCESS_LOCK));
+	Path pathReady((wstring(pathLock.ToString()) +
+		BENCHMARK_READY_EXTENSION).c_str());
+	WCHAR szNumber[33];
+	wstring swArguments;
+	size_t nStarted = 0;
+	size_t nWrites = 0;
+	DWORD dwExitCode;
+	size_t i;
+
+	if (arrComponents->empty())
+		return true;
+
+	// A lock file that was left behind by someone who is gone is free.
+	FileUtils::SaveContents(pathLock.ToString(), L"");
+	FileLock lockStale(pathLock);
+	Check(L"lock_ignores_stale_file", lockStale.Acquire(0));
+	lockStale.Release();
+
+	// Have another process hold the lock.
+	DeleteFile(pathReady.ToString());
+	swArguments = BENCHMARK_CHILD_LOCK L" \"";
+	swArguments += pathLock.ToString();
+	swArguments += L"\"";
+	HANDLE hHolder = StartChild(swArguments.c_str());
+	DWORD dwStarted = GetTickCount();
+	while ((hHolder != NULL) && !pathReady.Exists() &&
+			((GetTickCount() - dwStarted) < BENCHMARK_CHILD_TIMEOUT))
+		Sleep(LOCK_RETRY_INTERVAL);
+
+	// We must be kept out until it dies, without ever deleting its lock file.
+	FileLock lock(pathLock);
+	Check(L"lock_excludes_other_process", (hHolder != NULL) &&
+		pathReady.Exists() && !lock.Acquire(BENCHMARK_LOCK_WAIT));
+	if (hHolder != NULL) {
+		TerminateProcess(hHolder, 1);
+		WaitForSingleObject(hHolder, INFINITE);
+		CloseHandle(hHolder);
+	}
+	Check(L"lock_released_on_process_death", (hHolder != NULL) &&
+		pathLock.Exists() && lock.Acquire(BENCHMARK_LOCK_WAIT));
+	lock.Release();
+	DeleteFile(pathReady.ToString());
+
+	// Take a snapshot of where everything stands.
+	Directory dirComponent = arrComponents->front().GetDirectory();
+	size_t nStart = Component(dirComponent).GetQuantity();
+	long lStartHistory = SumHistory(pathHistory);
+
+	// Let the writers loose.
+	_ultow(BENCHMARK_WRITER_ROUNDS, szNumber, 10);
+	swArguments = BENCHMARK_CHILD_WRITER L" ";
+	swArguments += szNumber;
+	swArguments += L" \"";
+	swArguments += dirComponent.ToString();
+	swArguments += L"\" \"";
+	swArguments += pathHistory.ToString();
+	swArguments += L"\"";
+	Start(L"concurrent_processes");
+	dwStarted = GetTickCount();
+	for (i = 0; i < BENCHMARK_PROCESSES; i++) {
+		hProcesses[i] = StartChild(swArguments.c_str());
+		if (hProcesses[i] != NULL)
+			nStarted++;
+	}
+	for (i = 0; i < BENCHMARK_PROCESSES; i++) {
+		if (hProcesses[i] == NULL)
+			continue;
+
+		// The exit code is the number of writes that failed.
+		WaitForSingleObject(hProcesses[i], INFINITE);
+		if (GetExitCodeProcess(hProcesses[i], &dwExitCode) &&
+				(dwExitCode <= BENCHMARK_WRITER_ROUNDS))
+			nWrites += BENCHMARK_WRITER_ROUNDS - dwExitCode;
+		CloseHandle(hProcesses[i]);
+	}
+	DWORD dwElapsed = GetTickCount() - dwStarted;
+	Stop();
+
+	// Check that every write that succeeded is there.
+	size_t nQuantity = Component(dirComponent).GetQuantity();
+	long lHistory = SumHistory(pathHistory) - lStartHistory;
+	bool bPassed = (nStarted == BENCHMARK_PROCESSES) &&
+		(nQuantity == (nStart + nWrites)) && (lHistory == (long)nWrites);
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"processes", nStarted, false);
+	AppendNumber(&swJSON, L"rounds", BENCHMARK_WRITER_ROUNDS, false);
+	AppendNumber(&swJSON, L"writes", nWrites, false);
+	AppendNumber(&swJSON, L"total_ms", dwElapsed, false);
+	AppendNumber(&swJSON, L"quantity_delta", nQuantity - nStart, false);
+	AppendNumber(&swJSON, L"history_delta", (DWORD)lHistory, false);
+	swJSON += bPassed ? L" \"passed\": true}" : L" \"passed\": false}";
+	AddSection(L"concurrent_processes", swJSON);
+
+	return bPassed;
+}
+
+/**
+ * Starts a copy of the application to do a part of the benchmark.
+ *
+ * @param  szArguments Command line of the copy.
+ * @return             Process handle or NULL if it couldn't be started.
+ */
+HANDLE Benchmark::StartChild(LPCTSTR szArguments) {
+	PROCESS_INFORMATION pi;
+	WCHAR szModule[MAX_PATH];
+
+	if (GetModuleFileName(NULL, szModule, MAX_PATH) == 0)
+		return NULL;
+	if (!CreateProcess(szModule, szArguments, NULL, NULL, FALSE, 0, NULL, NULL,
+			NULL, &pi))
+		return NULL;
+
+	if (pi.hThread != NULL)
+		CloseHandle(pi.hThread);
+	return pi.hProcess;
+}
+
+/**
+ * Checks if the application was started to do a part of the benchmark.
+ *
+ * @param  szCommandLine Command line of the application.
+ * @return               TRUE if RunChild should be called instead of
+ *                       starting the application.
+ */
+bool Benchmark::IsChild(LPCTSTR szCommandLine) {
+	wstring swCommand;
+
+	NextArgument(&szCommandLine, &swCommand);
+	return (swCommand.compare(BENCHMARK_CHILD_LOCK) == 0) ||
+		(swCommand.compare(BENCHMARK_CHILD_WRITER) == 0);
+}
+
+/**
+ * Does the part of the benchmark that the application was started for.
+ *
+ * @param  szCommandLine Command line of the application.
+ * @return               Exit code of the process.
+ */
+int Benchmark::RunChild(LPCTSTR szCommandLine) {
+	wstring swCommand;
+	wstring swArgument;
+
+	NextArgument(&szCommandLine, &swCommand);
+	if (swCommand.compare(BENCHMARK_CHILD_LOCK) == 0) {
+		// Hold the lock until we are killed.
+		NextArgument(&szCommandLine, &swArgument);
+		FileLock lock(Path(swArgument.c_str()));
+		if (!lock.Acquire(BENCHMARK_CHILD_TIMEOUT))
+			return 1;
+
+		FileUtils::SaveContents((swArgument + BENCHMARK_READY_EXTENSION).c_str(),
+			L"");
+		Sleep(BENCHMARK_CHILD_TIMEOUT);
+		return 0;
+	} else if (swCommand.compare(BENCHMARK_CHILD_WRITER) == 0) {
+		BenchmarkWriter writer;
+
+		// Hammer the component just like a writer thread would.
+		NextArgument(&szCommandLine, &swArgument);
+		writer.nRounds = (size_t)_wtol(swArgument.c_str());
+		writer.nFailed = 0;
+		NextArgument(&szCommandLine, &swArgument);
+		writer.dirComponent = Directory(swArgument.c_str());
+		NextArgument(&szCommandLine, &swArgument);
+		writer.pathHistory = Path(swArgument.c_str());
+
+		WriterThreadProc(&writer);
+		return (int)writer.nFailed;
+	}
+
+	return 1;
+}
+
+/**
+ * Gets the next argument from a command line. Quotes group arguments with
+ * spaces in them.
+ *
+ * @param  szCommandLine Pointer to the command line, which is moved past the
+ *                       argument.
+ * @param  swArgument    Pointer to the string that will receive the argument.
+ * @return               TRUE if there was an argument.
+ */
+bool Benchmark::NextArgument(LPCTSTR *szCommandLine, wstring *swArgument) {
+	LPCTSTR szCurrent = *szCommandLine;
+	bool bQuoted = false;
+
+	swArgument->erase();
+
+	// Skip the spaces before it.
+	while (*szCurrent == L' ')
+		szCurrent++;
+	if (*szCurrent == L'\0') {
+		*szCommandLine = szCurrent;
+		return false;
+	}
+
+	// Go until an unquoted space.
+	for (; (*szCurrent != L'\0') && (bQuoted || (*szCurrent != L' '));
+			szCurrent++) {
+		if (*szCurrent == L'"') {
+			bQuoted = !bQuoted;
+		} else {
+			*swArgument += *szCurrent;
+		}
+	}
+
+	*szCommandLine = szCurrent;
+	return true;
+}
+
+/**
+ * Adds one to the quantity of a component over and over, recording each
+ * change in the history.
+ *
+ * @param  lpParam Pointer to the BenchmarkWriter.
+ * @return         Always 0.
+ */
+DWORD WINAPI Benchmark::WriterThreadProc(LPVOID lpParam) {
+	BenchmarkWriter *writer = (BenchmarkWriter*)lpParam;
+	Component component(writer->dirComponent);
+	QuantityHistory history;
+
+	history.Open(writer->pathHistory);
+	for (size_t i = 0; i < writer->nRounds; i++) {
+		component.SetQuantity(component.GetQuantity() + 1);
+		if (!component.SaveQuantity()) {
+			// Forget about it so it isn't carried into the next round.
+			component.SetQuantity(component.GetQuantity() - 1);
+			writer->nFailed++;
+			continue;
+		}
+
+		history.RecordDelta(writer->dirComponent.FileName(), 1);
+	}
+	history.Close();
+
+	return 0;
+}
+
+/**
+ * Adds up the quantity change of an event.
+ *
+ * @param event   Event from the history.
+ * @param lpParam Pointer to the long that holds the sum.
+ */
+void Benchmark::SumDeltasProc(const HistoryEvent *event, LPVOID lpParam) {
+	*((long*)lpParam) += event->lDelta;
+}
+
+/**
+ * Adds up every quantity change in a history file.
+ *
+ * @param  pathHistory Path to the history file.
+ * @return             Sum of the changes.
+ */
+long Benchmark::SumHistory(Path pathHistory) {
+	QuantityHistory history;
+	long lSum = 0;
+
+	history.Open(pathHistory);
+	history.ForEachEvent(0, (DWORD)-1, SumDeltasProc, &lSum);
+	history.Close();
+
+	return lSum;
+}
@@ -0,0 +1,161 @@
+/**
+ * BenchmarkHistory.cpp
+ * Times recording and querying a large quantity history.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "FileUtils.h"
+
+/**
+ * Times the history queries against a history of a couple of years that is
+ * recorded from scratch, checking their answers against what was recorded.
+ * The queries are done by a reader that was opened before anything was
+ * recorded, like another instance of the application would.
+ *
+ * @param szPath  Path of the workspace directory.
+ * @param nEvents Number of quantity changes to be recorded.
+ */
+void Benchmark::RunHistory(LPCTSTR szPath, size_t nEvents) {
+	Path pathHistory(Directory(szPath).Concatenate(BENCHMARK_HISTORY_FILE));
+	vector<long> arrConsumed(BENCHMARK_HISTORY_COMPONENTS, 0);
+	vector<HistoryConsumer> arrConsumers;
+	vector<MonthlyConsumption> arrMonths;
+	vector<HistoryPending> arrDeltas;
+	QuantityHistory history;
+	QuantityHistory reader;
+	WCHAR szNumber[33];
+	size_t nConsumedFirst = 0;
+	size_t nAddedFirst = 0;
+	size_t nInRange = 0;
+	size_t nCounted;
+	bool bPassed;
+	size_t i;
+
+	history.Open(pathHistory);
+	reader.Open(pathHistory);
+
+	// Spread the changes evenly over the period, a chunk at a time.
+	DWORD dwEnd = QuantityHistory::Now();
+	DWORD dwStart = dwEnd - (BENCHMARK_HISTORY_DAYS * 86400);
+	DWORD dwStep = (nEvents > 0) ? (dwEnd - dwStart) / nEvents : 1;
+	DWORD dwRangeFrom = dwStart + ((dwEnd - dwStart) / 2);
+	DWORD dwRangeTo = dwRangeFrom + (30 * 86400) - 1;
+	DWORD dwTopFrom = dwEnd - (365 * 86400);
+	Start(L"history_record");
+	for (i = 0; i < nEvents; i++) {
+		size_t nComponent = i % BENCHMARK_HISTORY_COMPONENTS;
+		HistoryPending pending;
+
+		pending.swName = L"Part ";
+		pending.swName += _ltow((long)nComponent, szNumber, 10);
+		pending.dwTime = dwStart + (DWORD)(i * dwStep);
+		pending.lDelta = ((i % 4) == 3) ? 20 : -(long)((nComponent % 7) + 1);
+		arrDeltas.push_back(pending);
+
+		// Remember what each query should find.
+		if ((pending.dwTime >= dwRangeFrom) && (pending.dwTime <= dwRangeTo))
+			nInRange++;
+		if ((pending.dwTime >= dwTopFrom) && (pending.lDelta < 0))
+			arrConsumed[nComponent] -= pending.lDelta;
+		if (nComponent == 0) {
+			if (pending.lDelta < 0) {
+				nConsumedFirst += (size_t)(-pending.lDelta);
+			} else {
+				nAddedFirst += (size_t)pending.lDelta;
+			}
+		}
+
+		if (arrDeltas.size() == BENCHMARK_HISTORY_CHUNK) {
+			history.RecordDeltas(arrDeltas);
+			arrDeltas.clear();
+		}
+	}
+
+	// Finish with the biggest consumer of all, which has a name that isn't
+	// plain ASCII.
+	HistoryPending pending;
+	pending.swName = BENCHMARK_HISTORY_UNICODE_NAME;
+	pending.dwTime = dwEnd;
+	pending.lDelta = -(long)(nEvents + 1);
+	arrDeltas.push_back(pending);
+	history.RecordDeltas(arrDeltas);
+	history.Close();
+	Stop();
+
+	// Range query over a single month.
+	for (i = 0; i < nRuns; i++) {
+		nCounted = 0;
+		Start(L"history_range");
+		reader.ForEachEvent(dwRangeFrom, dwRangeTo, CountEventsProc, &nCounted);
+		Stop();
+	}
+	Check(L"history_range_matches", nCounted == nInRange);
+
+	// The whole history, for comparison.
+	for (i = 0; i < nRuns; i++) {
+		nCounted = 0;
+		Start(L"history_scan");
+		reader.ForEachEvent(0, (DWORD)-1, CountEventsProc, &nCounted);
+		Stop();
+	}
+	Check(L"history_scan_matches", nCounted == (nEvents + 1));
+
+	// Monthly consumption of a single component.
+	Component component(Directory(szPath), L"Part 0");
+	for (i = 0; i < nRuns; i++) {
+		Start(L"history_monthly");
+		arrMonths = reader.GetMonthlyConsumption(&component, 0, (DWORD)-1);
+		Stop();
+	}
+	size_t nConsumed = 0;
+	size_t nAdded = 0;
+	for (i = 0; i < arrMonths.size(); i++) {
+		nConsumed += arrMonths[i].nConsumed;
+		nAdded += arrMonths[i].nAdded;
+	}
+	Check(L"history_monthly_matches", (nEvents == 0) ||
+		((nConsumed == nConsumedFirst) && (nAdded == nAddedFirst)));
+
+	// Top consumers of the last year.
+	for (i = 0; i < nRuns; i++) {
+		Start(L"history_top");
+		arrConsumers = reader.GetTopConsumers(dwTopFrom, dwEnd,
+			BENCHMARK_HISTORY_TOP);
+		Stop();
+	}
+	bPassed = !arrConsumers.empty() &&
+		(arrConsumers[0].swName.compare(BENCHMARK_HISTORY_UNICODE_NAME) == 0) &&
+		(arrConsumers[0].nConsumed == (nEvents + 1));
+	for (i = 1; bPassed && (i < arrConsumers.size()); i++) {
+		wstring swName = arrConsumers[i].swName;
+		size_t nComponent = (size_t)_wtol(swName.substr(5).c_str());
+
+		bPassed = (nComponent < arrConsumed.size()) &&
+			(arrConsumers[i].nConsumed == (size_t)arrConsumed[nComponent]) &&
+			(arrConsumers[i].nConsumed <= arrConsumers[i - 1].nConsumed);
+	}
+	Check(L"history_top_matches", bPassed);
+	reader.Close();
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"events", nEvents, false);
+	AppendNumber(&swJSON, L"components", BENCHMARK_HISTORY_COMPONENTS, false);
+	AppendNumber(&swJSON, L"days", BENCHMARK_HISTORY_DAYS, false);
+	AppendNumber(&swJSON, L"range_events", nInRange, false);
+	AppendNumber(&swJSON, L"months", arrMonths.size(), true);
+	swJSON += L"}";
+	AddSection(L"history", swJSON);
+}
+
+/**
+ * Counts an event from the history.
+ *
+ * @param event   Event from the history.
+ * @param lpParam Pointer to the size_t counter.
+ */
+void Benchmark::CountEventsProc(const HistoryEvent *event, LPVOID lpParam) {
+	(*((size_t*)lpParam))++;
+}
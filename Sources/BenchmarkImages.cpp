@@ -0,0 +1,263 @@
+/**
+ * BenchmarkImages.cpp
+ * Checks the BMP decoder against small images built by hand.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "BmpImage.h"
+
+// Width of the striped test image.
+#define BENCHMARK_STRIPES_WIDTH 2000
+
+// Colors of the test images.
+#define TEST_RED   0x00FF0000UL
+#define TEST_GREEN 0x0000FF00UL
+#define TEST_BLUE  0x000000FFUL
+#define TEST_WHITE 0x00FFFFFFUL
+
+/**
+ * Checks that the BMP decoder gets the same pixels out of every format it
+ * supports, that it rejects broken files and that scaling down keeps every
+ * source pixel in the average.
+ */
+void Benchmark::RunImageChecks() {
+	const unsigned long aulColors[4] = { TEST_RED, TEST_GREEN, TEST_BLUE,
+		TEST_WHITE };
+	const unsigned long aulIndexes[4] = { 0, 1, 2, 3 };
+	const unsigned long aulMono[4] = { 0, 1, 1, 0 };
+	const unsigned long aulMonoColors[4] = { TEST_RED, TEST_GREEN, TEST_GREEN,
+		TEST_RED };
+	const unsigned long aul555[4] = { 0x7C00, 0x03E0, 0x001F, 0x7FFF };
+	const unsigned long aul565[4] = { 0xF800, 0x07E0, 0x001F, 0xFFFF };
+	const unsigned long aulMasks565[3] = { 0xF800, 0x07E0, 0x001F };
+	const unsigned long aulBgr[4] = { 0x000000FF, 0x0000FF00, 0x00FF0000,
+		0x00FFFFFF };
+	const unsigned long aulMasksBgr[3] = { 0x000000FF, 0x0000FF00, 0x00FF0000 };
+	vector<unsigned char> arrFile;
+	BmpImage imageScaled;
+	BmpImage image;
+	int x;
+
+	// Uncompressed formats.
+	Check(L"bmp_decodes_1bit", DecodesTo(BuildTestBmp(false, 1, BI_RGB, 2, 2,
+		2, NULL, EncodeTestRows(1, aulMono, false)), aulMonoColors));
+	Check(L"bmp_decodes_4bit", DecodesTo(BuildTestBmp(false, 4, BI_RGB, 2, 2,
+		4, NULL, EncodeTestRows(4, aulIndexes, false)), aulColors));
+	Check(L"bmp_decodes_8bit", DecodesTo(BuildTestBmp(false, 8, BI_RGB, 2, 2,
+		4, NULL, EncodeTestRows(8, aulIndexes, false)), aulColors));
+	Check(L"bmp_decodes_8bit_core", DecodesTo(BuildTestBmp(true, 8, BI_RGB, 2,
+		2, 4, NULL, EncodeTestRows(8, aulIndexes, false)), aulColors));
+	Check(L"bmp_decodes_16bit", DecodesTo(BuildTestBmp(false, 16, BI_RGB, 2,
+		2, 0, NULL, EncodeTestRows(16, aul555, false)), aulColors));
+	Check(L"bmp_decodes_16bit_bitfields", DecodesTo(BuildTestBmp(false, 16,
+		BI_BITFIELDS, 2, 2, 0, aulMasks565, EncodeTestRows(16, aul565, false)),
+		aulColors));
+	Check(L"bmp_decodes_24bit", DecodesTo(BuildTestBmp(false, 24, BI_RGB, 2,
+		2, 0, NULL, EncodeTestRows(24, aulColors, false)), aulColors));
+	Check(L"bmp_decodes_24bit_top_down", DecodesTo(BuildTestBmp(false, 24,
+		BI_RGB, 2, -2, 0, NULL, EncodeTestRows(24, aulColors, true)),
+		aulColors));
+	Check(L"bmp_decodes_32bit", DecodesTo(BuildTestBmp(false, 32, BI_RGB, 2,
+		2, 0, NULL, EncodeTestRows(32, aulColors, false)), aulColors));
+	Check(L"bmp_decodes_32bit_bitfields", DecodesTo(BuildTestBmp(false, 32,
+		BI_BITFIELDS, 2, 2, 0, aulMasksBgr, EncodeTestRows(32, aulBgr, false)),
+		aulColors));
+
+	// Compressed formats, bottom row first. The RLE4 bottom row is a single run
+	// that alternates between two indexes.
+	const unsigned char abRle8[] = { 1, 2, 1, 3, 0, 0, 1, 0, 1, 1, 0, 1 };
+	const unsigned char abRle4[] = { 2, 0x23, 0, 0, 1, 0x00, 1, 0x10, 0, 1 };
+	Check(L"bmp_decodes_rle8", DecodesTo(BuildTestBmp(false, 8, BI_RLE8, 2, 2,
+		4, NULL, vector<unsigned char>(abRle8, abRle8 + sizeof(abRle8))),
+		aulColors));
+	Check(L"bmp_decodes_rle4", DecodesTo(BuildTestBmp(false, 4, BI_RLE4, 2, 2,
+		4, NULL, vector<unsigned char>(abRle4, abRle4 + sizeof(abRle4))),
+		aulColors));
+
+	// Broken files.
+	arrFile = BuildTestBmp(false, 8, BI_RGB, 2, 2, 4, NULL,
+		EncodeTestRows(8, aulIndexes, false));
+	arrFile[14] = 0xF0;
+	arrFile[15] = 0xFF;
+	arrFile[16] = 0xFF;
+	arrFile[17] = 0xFF;
+	Check(L"bmp_rejects_huge_header", !image.Decode(&arrFile[0],
+		arrFile.size()));
+	arrFile = BuildTestBmp(false, 24, BI_RGB, 2, 2, 0, NULL,
+		EncodeTestRows(24, aulColors, false));
+	arrFile.resize(arrFile.size() - 1);
+	Check(L"bmp_rejects_truncated_rows", !image.Decode(&arrFile[0],
+		arrFile.size()));
+
+	// A wide row of alternating red and green pixels should average out to the
+	// same half way color no matter how much it's scaled down.
+	vector<unsigned char> arrStripes;
+	for (x = 0; x < BENCHMARK_STRIPES_WIDTH; x++)
+		arrStripes.push_back((unsigned char)(x & 1));
+	while (arrStripes.size() % 4)
+		arrStripes.push_back(0);
+	arrFile = BuildTestBmp(false, 8, BI_RGB, BENCHMARK_STRIPES_WIDTH, 1, 2,
+		NULL, arrStripes);
+	bool bAveraged = image.Decode(&arrFile[0], arrFile.size());
+	for (int nTarget = 1; bAveraged && (nTarget <= 7); nTarget += 3) {
+		bAveraged = image.ScaleTo(&imageScaled, nTarget, 1);
+		for (x = 0; bAveraged && (x < nTarget); x++) {
+			unsigned long ulRed = (imageScaled.GetPixels()[x] >> 16) & 0xFF;
+			unsigned long ulGreen = (imageScaled.GetPixels()[x] >> 8) & 0xFF;
+
+			bAveraged = (ulRed >= 126) && (ulRed <= 129) && (ulGreen >= 126) &&
+				(ulGreen <= 129);
+		}
+	}
+	Check(L"bmp_scale_averages_large_reductions", bAveraged);
+
+	// Flat colors should come out exactly the same.
+	const unsigned long aulFlat[4] = { 0x007F3F1F, 0x007F3F1F, 0x007F3F1F,
+		0x007F3F1F };
+	arrFile = BuildTestBmp(false, 24, BI_RGB, 2, 2, 0, NULL,
+		EncodeTestRows(24, aulFlat, false));
+	Check(L"bmp_scale_keeps_flat_colors", image.Decode(&arrFile[0],
+		arrFile.size()) && image.ScaleTo(&imageScaled, 1, 1) &&
+		(imageScaled.GetPixels()[0] == 0x007F3F1F));
+}
+
+/**
+ * Appends a little-endian value to a buffer.
+ *
+ * @param arrData Buffer to append to.
+ * @param ulValue Value to be appended.
+ * @param nBytes  Number of bytes of the value.
+ */
+void Benchmark::AppendLittleEndian(vector<unsigned char> *arrData,
+								   unsigned long ulValue, size_t nBytes) {
+	for (size_t i = 0; i < nBytes; i++)
+		arrData->push_back((unsigned char)((ulValue >> (i * 8)) & 0xFF));
+}
+
+/**
+ * Encodes the uncompressed rows of a 2x2 test image.
+ *
+ * @param  nBitCount Bits per pixel.
+ * @param  aulValues Raw values of the pixels, from the top left to the
+ *                   bottom right.
+ * @param  bTopDown  Should the rows be stored from the top down?
+ * @return           Encoded rows, padded to 4 bytes each.
+ */
+vector<unsigned char> Benchmark::EncodeTestRows(int nBitCount,
+												const unsigned long *aulValues,
+												bool bTopDown) {
+	vector<unsigned char> arrRows;
+
+	for (int nRow = 0; nRow < 2; nRow++) {
+		const unsigned long *aulRow = aulValues + ((bTopDown ? nRow : 1 - nRow) * 2);
+		size_t nStart = arrRows.size();
+
+		if (nBitCount < 8) {
+			// Indexes are packed from the most significant bit.
+			arrRows.push_back((unsigned char)((aulRow[0] << (8 - nBitCount)) |
+				(aulRow[1] << (8 - (2 * nBitCount)))));
+		} else {
+			AppendLittleEndian(&arrRows, aulRow[0], nBitCount / 8);
+			AppendLittleEndian(&arrRows, aulRow[1], nBitCount / 8);
+		}
+
+		while ((arrRows.size() - nStart) % 4)
+			arrRows.push_back(0);
+	}
+
+	return arrRows;
+}
+
+/**
+ * Builds a BMP file around some pixel data. Indexed images use the test colors
+ * as their palette, which is padded to every possible index in the old header
+ * since it can't say how many colors are used.
+ *
+ * @param  bCore         Use the old OS/2 header instead of the Windows one?
+ * @param  nBitCount     Bits per pixel.
+ * @param  ulCompression Compression type.
+ * @param  lWidth        Image width.
+ * @param  lHeight       Image height, negative if the rows are stored from the
+ *                       top down.
+ * @param  nColors       Number of colors in the palette.
+ * @param  aulMasks      Channel masks of a bit fields image or NULL.
+ * @param  arrPixels     Pixel data.
+ * @return               Contents of the file.
+ */
+vector<unsigned char> Benchmark::BuildTestBmp(bool bCore, int nBitCount,
+		unsigned long ulCompression, long lWidth, long lHeight, size_t nColors,
+		const unsigned long *aulMasks, const vector<unsigned char> &arrPixels) {
+	const unsigned long aulPalette[4] = { TEST_RED, TEST_GREEN, TEST_BLUE,
+		TEST_WHITE };
+	size_t nHeaderSize = bCore ? 12 : 40;
+	size_t nEntrySize = bCore ? 3 : 4;
+	size_t nEntries = (bCore && (nColors > 0)) ? ((size_t)1 << nBitCount) :
+		nColors;
+	size_t nMasksSize = (aulMasks != NULL) ? 12 : 0;
+	size_t nOffset = 14 + nHeaderSize + nMasksSize + (nEntries * nEntrySize);
+	vector<unsigned char> arrFile;
+	size_t i;
+
+	// File header.
+	arrFile.push_back('B');
+	arrFile.push_back('M');
+	AppendLittleEndian(&arrFile, nOffset + arrPixels.size(), 4);
+	AppendLittleEndian(&arrFile, 0, 4);
+	AppendLittleEndian(&arrFile, nOffset, 4);
+
+	// Information header.
+	AppendLittleEndian(&arrFile, nHeaderSize, 4);
+	if (bCore) {
+		AppendLittleEndian(&arrFile, lWidth, 2);
+		AppendLittleEndian(&arrFile, lHeight, 2);
+		AppendLittleEndian(&arrFile, 1, 2);
+		AppendLittleEndian(&arrFile, nBitCount, 2);
+	} else {
+		AppendLittleEndian(&arrFile, lWidth, 4);
+		AppendLittleEndian(&arrFile, (unsigned long)lHeight, 4);
+		AppendLittleEndian(&arrFile, 1, 2);
+		AppendLittleEndian(&arrFile, nBitCount, 2);
+		AppendLittleEndian(&arrFile, ulCompression, 4);
+		AppendLittleEndian(&arrFile, arrPixels.size(), 4);
+		AppendLittleEndian(&arrFile, 0, 4);
+		AppendLittleEndian(&arrFile, 0, 4);
+		AppendLittleEndian(&arrFile, nColors, 4);
+		AppendLittleEndian(&arrFile, 0, 4);
+	}
+	for (i = 0; i < nMasksSize / 4; i++)
+		AppendLittleEndian(&arrFile, aulMasks[i], 4);
+
+	// Palette and pixels.
+	for (i = 0; i < nEntries; i++) {
+		AppendLittleEndian(&arrFile, (i < nColors) ? aulPalette[i] : 0,
+			nEntrySize);
+	}
+	arrFile.insert(arrFile.end(), arrPixels.begin(), arrPixels.end());
+
+	return arrFile;
+}
+
+/**
+ * Decodes a 2x2 test image and compares it with what was expected.
+ *
+ * @param  arrFile     Contents of the BMP file.
+ * @param  aulExpected Expected pixels, from the top left to the bottom right.
+ * @return             TRUE if the image decoded to the expected pixels.
+ */
+bool Benchmark::DecodesTo(const vector<unsigned char> &arrFile,
+						  const unsigned long *aulExpected) {
+	BmpImage image;
+
+	if (!image.Decode(&arrFile[0], arrFile.size()) ||
+			(image.GetWidth() != 2) || (image.GetHeight() != 2))
+		return false;
+
+	for (int i = 0; i < 4; i++) {
+		if (image.GetPixels()[i] != aulExpected[i])
+			return false;
+	}
+
+	return true;
+}
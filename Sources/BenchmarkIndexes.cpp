@@ -0,0 +1,319 @@
+/**
+ * BenchmarkIndexes.cpp
+ * Times keeping the facets, the smart folders and the duplicates up to date
+ * against a synthetic workspace that only exists in memory.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <algorithm>
+#include "Benchmark.h"
+#include "SmartQuery.h"
+#include "SmartFolders.h"
+#include "DuplicateFinder.h"
+
+/**
+ * Times keeping the facet counts up to date as single components are edited
+ * in a synthetic workspace that only exists in memory, and checks that the
+ * counts end up the same as building them from scratch.
+ *
+ * @param nComponents Number of components in the workspace.
+ * @param nEdits      Number of components to be edited.
+ */
+void Benchmark::RunFacets(size_t nComponents, size_t nEdits) {
+	vector<Component> arrComponents;
+	FacetIndex facets;
+	FacetIndex facetsRebuilt;
+	size_t i;
+
+	generator.Generate(Directory(BENCHMARK_INDEX_ROOT), nComponents,
+		&arrComponents);
+	if (arrComponents.empty())
+		return;
+
+	// Build the facets from scratch.
+	Start(L"facets_build");
+	for (i = 0; i < arrComponents.size(); i++)
+		facets.ComponentAdded(&arrComponents[i]);
+	Stop();
+
+	// Edit components spread around the workspace.
+	Start(L"facets_edits");
+	for (i = 0; i < nEdits; i++)
+		facets.ComponentChanged(EditTestComponent(&arrComponents, i));
+	Stop();
+
+	// Compare against the facets built after all the edits.
+	for (i = 0; i < arrComponents.size(); i++)
+		facetsRebuilt.ComponentAdded(&arrComponents[i]);
+	Check(L"facets_edits_match_rebuild", SameFacets(&facets, &facetsRebuilt));
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"components", (DWORD)arrComponents.size(), false);
+	AppendNumber(&swJSON, L"edits", (DWORD)nEdits, false);
+	AppendNumber(&swJSON, L"per_edit_us", (nEdits == 0) ? 0 :
+		(DWORD)((GetResult(L"facets_edits")->dwTotal * 1000) / nEdits), false);
+	AppendNumber(&swJSON, L"categories",
+		(DWORD)facets.GetCategories().size(), false);
+	AppendNumber(&swJSON, L"packages", (DWORD)facets.GetPackages().size(),
+		true);
+	swJSON += L"}";
+	AddSection(L"facets", swJSON);
+}
+
+/**
+ * Times populating smart folders and keeping them up to date as single
+ * components are edited in a synthetic workspace that only exists in memory,
+ * and checks that they end up the same as populating them from scratch.
+ *
+ * @param nComponents Number of components in the workspace.
+ * @param nFolders    Number of smart folders.
+ * @param nEdits      Number of components to be edited.
+ */
+void Benchmark::RunSmartFolders(size_t nComponents, size_t nFolders,
+								size_t nEdits) {
+	vector<Component> arrComponents;
+	vector<SmartQuery> arrQueries;
+	SmartFolders folders;
+	SmartFolders foldersRebuilt;
+	size_t i;
+
+	generator.Generate(Directory(BENCHMARK_INDEX_ROOT), nComponents,
+		&arrComponents);
+	if (arrComponents.empty())
+		return;
+	for (i = 0; i < nFolders; i++)
+		arrQueries.push_back(BuildTestQuery(i));
+
+	// Populate every folder from scratch.
+	Start(L"smart_folders_build");
+	for (i = 0; i < arrQueries.size(); i++)
+		folders.AddQuery(arrQueries[i], &arrComponents);
+	Stop();
+
+	// Edit components spread around the workspace.
+	Start(L"smart_folders_edits");
+	for (i = 0; i < nEdits; i++)
+		folders.ComponentChanged(EditTestComponent(&arrComponents, i));
+	Stop();
+
+	// Compare against the folders populated after all the edits.
+	for (i = 0; i < arrQueries.size(); i++)
+		foldersRebuilt.AddQuery(arrQueries[i], &arrComponents);
+	bool bSame = folders.GetFoldersCount() == foldersRebuilt.GetFoldersCount();
+	size_t nMembers = 0;
+	for (i = 0; bSame && (i < folders.GetFoldersCount()); i++) {
+		bSame = SameCount(folders.GetFolderTotals(i),
+			foldersRebuilt.GetFolderTotals(i)) &&
+			(folders.GetMembers(i) == foldersRebuilt.GetMembers(i));
+		nMembers += folders.GetMembers(i).size();
+	}
+	Check(L"smart_folders_edits_match_rebuild", bSame);
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"components", (DWORD)arrComponents.size(), false);
+	AppendNumber(&swJSON, L"folders", (DWORD)arrQueries.size(), false);
+	AppendNumber(&swJSON, L"members", (DWORD)nMembers, false);
+	AppendNumber(&swJSON, L"edits", (DWORD)nEdits, false);
+	AppendNumber(&swJSON, L"per_edit_us", (nEdits == 0) ? 0 :
+		(DWORD)((GetResult(L"smart_folders_edits")->dwTotal * 1000) / nEdits),
+		true);
+	swJSON += L"}";
+	AddSection(L"smart_folders", swJSON);
+}
+
+/**
+ * Times scanning a synthetic workspace that only exists in memory for
+ * duplicates, after planting exact and near copies of some of its components,
+ * and checks that every exact copy was found.
+ *
+ * @param nComponents Number of components in the workspace.
+ * @param dSimilarity Smallest similarity of near duplicates.
+ */
+void Benchmark::RunDuplicates(size_t nComponents, double dSimilarity) {
+	vector<Component> arrComponents;
+	vector<DuplicateGroup> arrGroups;
+	size_t nPlanted = 0;
+	size_t i, j;
+
+	generator.Generate(Directory(BENCHMARK_INDEX_ROOT), nComponents,
+		&arrComponents);
+
+	// Plant the copies with their properties shuffled around.
+	for (i = 0; (i + 2) < arrComponents.size(); i += BENCHMARK_DUPLICATE_SPACING) {
+		vector<Property> arrProperties = arrComponents[i].GetProperties();
+		Property prop;
+
+		reverse(arrProperties.begin(), arrProperties.end());
+		*arrComponents[i + 1].GetEditableProperties() = arrProperties;
+
+		prop.SetName(L"Notes");
+		prop.SetValue(L"Planted near duplicate");
+		arrProperties.push_back(prop);
+		*arrComponents[i + 2].GetEditableProperties() = arrProperties;
+
+		nPlanted++;
+	}
+
+	DuplicateFinder finder(&arrComponents, dSimilarity);
+	Start(L"duplicates_find");
+	arrGroups = finder.Find();
+	Stop();
+
+	// Map every component to the groups it ended up in.
+	vector<size_t> arrExact(arrComponents.size(), arrGroups.size());
+	vector<size_t> arrSimilar(arrComponents.size(), arrGroups.size());
+	size_t nExact = 0;
+	for (i = 0; i < arrGroups.size(); i++) {
+		vector<size_t> *arrIndexes = &arrGroups[i].arrIndexes;
+		nExact += (arrGroups[i].bExact) ? 1 : 0;
+
+		for (j = 0; j < arrIndexes->size(); j++) {
+			if (arrGroups[i].bExact) {
+				arrExact[(*arrIndexes)[j]] = i;
+			} else {
+				arrSimilar[(*arrIndexes)[j]] = i;
+			}
+		}
+	}
+
+	// Every exact copy must have been found. Near ones are probabilistic.
+	bool bFoundExact = true;
+	size_t nFoundNear = 0;
+	for (i = 0; (i + 2) < arrComponents.size(); i += BENCHMARK_DUPLICATE_SPACING) {
+		bFoundExact &= (arrExact[i] != arrGroups.size()) &&
+			(arrExact[i] == arrExact[i + 1]);
+		if ((arrSimilar[i + 2] != arrGroups.size()) &&
+				((arrSimilar[i + 2] == arrSimilar[i]) ||
+				(arrSimilar[i + 2] == arrSimilar[i + 1])))
+			nFoundNear++;
+	}
+	Check(L"duplicates_finds_exact_copies", bFoundExact);
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"components", (DWORD)arrComponents.size(), false);
+	AppendNumber(&swJSON, L"planted", (DWORD)nPlanted, false);
+	AppendNumber(&swJSON, L"found_near", (DWORD)nFoundNear, false);
+	AppendNumber(&swJSON, L"exact_groups", (DWORD)nExact, false);
+	AppendNumber(&swJSON, L"similar_groups", (DWORD)(arrGroups.size() - nExact),
+		true);
+	swJSON += L"}";
+	AddSection(L"duplicates", swJSON);
+}
+
+/**
+ * Edits the quantity, package or category of one of the components of a
+ * synthetic workspace, spreading the edits around.
+ *
+ * @param  arrComponents Components of the workspace.
+ * @param  nEdit         Number of the edit.
+ * @return               Component that was edited.
+ */
+Component* Benchmark::EditTestComponent(vector<Component> *arrComponents,
+										size_t nEdit) {
+	Component *component = &(*arrComponents)[(nEdit * 7919) %
+		arrComponents->size()];
+	Property *prop = NULL;
+
+	if ((nEdit % 3) == 1) {
+		prop = component->GetProperty(PROPERTY_PACKAGE);
+	} else if ((nEdit % 3) == 2) {
+		prop = component->GetProperty(PROPERTY_CATEGORY);
+	}
+
+	if (prop != NULL) {
+		wstring swValue(prop->GetValue());
+		swValue += L" Edited";
+		prop->SetValue(swValue.c_str());
+	} else {
+		component->SetQuantity(component->GetQuantity() + 1);
+	}
+
+	return component;
+}
+
+/**
+ * Builds one of the queries of the smart folders of a synthetic workspace,
+ * mixing the kinds of folders people keep.
+ *
+ * @param  nFolder Number of the folder.
+ * @return         Smart folder query.
+ */
+SmartQuery Benchmark::BuildTestQuery(size_t nFolder) {
+	WCHAR szNumber[33];
+	wstring swNumber(_ltow((long)nFolder, szNumber, 10));
+	wstring swDefinition;
+
+	switch (nFolder % 5) {
+	case 0:
+		swDefinition = L"Low Stock " + swNumber + L"; Quantity < " +
+			_ltow((long)(10 + nFolder), szNumber, 10);
+		break;
+	case 1:
+		swDefinition = L"Category " + swNumber + L"; " PROPERTY_CATEGORY
+			L" = Category " + _ltow((long)(nFolder % 12), szNumber, 10);
+		break;
+	case 2:
+		swDefinition = L"SMD " + swNumber + L"; " PROPERTY_PACKAGE L" ~ 0 & "
+			L"Quantity > " + _ltow((long)nFolder, szNumber, 10);
+		break;
+	case 3:
+		swDefinition = L"Group " + swNumber + L"; " PROPERTY_CATEGORY
+			L" = Category " + _ltow((long)(nFolder % 12), szNumber, 10);
+		swDefinition += L" & " PROPERTY_SUBCATEGORY L" = Group ";
+		swDefinition += _ltow((long)(nFolder % 6), szNumber, 10);
+		break;
+	default:
+		swDefinition = L"Value " + swNumber + L"; " PROPERTY_VALUE L" ~ " +
+			_ltow((long)(nFolder % 10), szNumber, 10);
+		break;
+	}
+
+	return SmartQuery(swDefinition.c_str());
+}
+
+/**
+ * Checks if two facet indexes have the same counts.
+ *
+ * @param  first  Facet index to be compared.
+ * @param  second Facet index to compare against.
+ * @return        TRUE if every category and package has the same counts.
+ */
+bool Benchmark::SameFacets(FacetIndex *first, FacetIndex *second) {
+	vector<wstring> arrCategories = first->GetCategories();
+	vector<wstring> arrPackages = first->GetPackages();
+	size_t i;
+
+	if (!SameCount(first->GetTotal(), second->GetTotal()))
+		return false;
+	if ((arrCategories != second->GetCategories()) ||
+			(arrPackages != second->GetPackages()))
+		return false;
+
+	for (i = 0; i < arrCategories.size(); i++) {
+		if (!SameCount(first->GetCategory(arrCategories[i].c_str()),
+				second->GetCategory(arrCategories[i].c_str())))
+			return false;
+	}
+	for (i = 0; i < arrPackages.size(); i++) {
+		if (!SameCount(first->GetPackage(arrPackages[i].c_str()),
+				second->GetPackage(arrPackages[i].c_str())))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Checks if two facet counts are the same.
+ *
+ * @param  first  Facet count to be compared.
+ * @param  second Facet count to compare against.
+ * @return        TRUE if both have the same parts and stock.
+ */
+bool Benchmark::SameCount(FacetCount first, FacetCount second) {
+	return (first.nParts == second.nParts) && (first.nStock == second.nStock);
+}
@@ -0,0 +1,172 @@
+/**
+ * BenchmarkSelection.cpp
+ * Times selecting components through the background detail loader. It needs
+ * a window to be notified, so it is only built for the devices.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "AllocProfiler.h"
+
+/**
+ * Selects components through the background detail loader, the way the UI
+ * does, and measures how long it takes for each model to arrive. The models
+ * are checked against what the component has on disk and a quick succession
+ * of selections must only deliver the last one.
+ * @remark The models are posted to a hidden window of our own so that the
+ *         detail view never sees them.
+ *
+ * @param workspace   Opened synthetic workspace.
+ * @param nSelections Maximum number of components to be selected.
+ */
+void Benchmark::RunSelection(Workspace *workspace, size_t nSelections) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	DetailLoader loader;
+	DetailModel *model;
+	WNDCLASS wc;
+	size_t nReady = 0;
+	size_t nMatched = 0;
+	size_t i;
+
+	if (arrComponents->size() < 2)
+		return;
+
+	// Window that receives the models.
+	memset(&wc, 0, sizeof(WNDCLASS));
+	wc.lpfnWndProc = DefWindowProc;
+	wc.hInstance = GetModuleHandle(NULL);
+	wc.lpszClassName = BENCHMARK_DETAIL_CLASS;
+	RegisterClass(&wc);
+	HWND hwndNotify = CreateWindow(BENCHMARK_DETAIL_CLASS, L"", 0, 0, 0, 0, 0,
+		NULL, NULL, wc.hInstance, NULL);
+	if ((hwndNotify == NULL) || !loader.Start(hwndNotify)) {
+		Check(L"detail_all_selections_ready", false);
+		if (hwndNotify != NULL)
+			DestroyWindow(hwndNotify);
+
+		return;
+	}
+
+	// Select them one at a time.
+	for (i = 0; (i < arrComponents->size()) && (i < nSelections); i++) {
+		Component *component = &(*arrComponents)[i];
+		ComponentHandle hComponent = workspace->GetComponentHandle(i);
+
+		Start(L"component_select");
+		unsigned long ulRequest = loader.Request(hComponent, component,
+			GetTickCount());
+		model = WaitForDetail(hwndNotify);
+		Stop();
+		if (model == NULL)
+			continue;
+
+		if (loader.IsCurrent(model->ulGeneration) &&
+				(model->ulGeneration == ulRequest)) {
+			loader.RecordLatency(model->dwRequested);
+			nReady++;
+			if ((model->hComponent == hComponent) &&
+					MatchesDetail(component, model))
+				nMatched++;
+		}
+		DetailLoader::FreeModel(model);
+	}
+	Check(L"detail_all_selections_ready", nReady == i);
+	Check(L"detail_models_match", nMatched == i);
+
+	// Moving on quickly only gets us the latest selection.
+	ComponentHandle hLast = workspace->GetComponentHandle(1);
+	loader.Request(workspace->GetComponentHandle(0), &(*arrComponents)[0],
+		GetTickCount());
+	loader.Request(hLast, &(*arrComponents)[1], GetTickCount());
+	bool bLatestWins = false;
+	bool bStaleShown = false;
+	while ((model = WaitForDetail(hwndNotify)) != NULL) {
+		bool bCurrent = loader.IsCurrent(model->ulGeneration);
+
+		if (bCurrent && (model->hComponent != hLast))
+			bStaleShown = true;
+		if (bCurrent)
+			bLatestWins = true;
+		DetailLoader::FreeModel(model);
+
+		if (bCurrent)
+			break;
+	}
+	Check(L"detail_latest_request_wins", bLatestWins && !bStaleShown);
+
+	// Clean up whatever was posted after we stopped looking.
+	loader.Stop();
+	MSG msg;
+	while (PeekMessage(&msg, hwndNotify, WM_DETAILREADY, WM_DETAILREADY,
+			PM_REMOVE)) {
+		DetailLoader::FreeModel((DetailModel*)msg.lParam);
+	}
+	DestroyWindow(hwndNotify);
+
+	// Report.
+	DetailLatency latency = loader.GetLatency();
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"selections", latency.dwCount, false);
+	AppendNumber(&swJSON, L"average_ms", (latency.dwCount > 0) ?
+		latency.dwTotal / latency.dwCount : 0, false);
+	AppendNumber(&swJSON, L"max_ms", latency.dwMax, true);
+	swJSON += L"}";
+	AddSection(L"selection", swJSON);
+}
+
+/**
+ * Waits for the detail loader to post a model.
+ *
+ * @param  hwndNotify Window the models are posted to.
+ * @return            Model that was posted or NULL if none arrived in time.
+ */
+DetailModel* Benchmark::WaitForDetail(HWND hwndNotify) {
+	DWORD dwStarted = GetTickCount();
+	MSG msg;
+
+	while ((GetTickCount() - dwStarted) < BENCHMARK_DETAIL_TIMEOUT) {
+		if (PeekMessage(&msg, hwndNotify, WM_DETAILREADY, WM_DETAILREADY,
+				PM_REMOVE))
+			return (DetailModel*)msg.lParam;
+
+		Sleep(1);
+	}
+
+	return NULL;
+}
+
+/**
+ * Checks if a model has what the detail view should show for a component.
+ *
+ * @param  component Component that was selected.
+ * @param  model     Model prepared by the detail loader.
+ * @return           TRUE if the notes and properties match.
+ */
+bool Benchmark::MatchesDetail(Component *component, DetailModel *model) {
+	vector<Property> *arrProperties = component->GetEditableProperties();
+	wstring swNotes;
+
+	// Notes.
+	LPTSTR szNotes = component->GetNotes();
+	if (szNotes != NULL) {
+		swNotes = szNotes;
+		AllocProfiler::Free(szNotes);
+	}
+	if (swNotes != model->swNotes)
+		return false;
+
+	// Properties.
+	if (arrProperties->size() != model->arrProperties.size())
+		return false;
+	for (size_t i = 0; i < arrProperties->size(); i++) {
+		LPTSTR szCaption = (*arrProperties)[i].ToHumanString();
+		bool bEqual = model->arrProperties[i] == szCaption;
+
+		AllocProfiler::Free(szCaption);
+		if (!bEqual)
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,68 @@
+/**
+ * BenchmarkTracer.cpp
+ * Checks that the tracer records and nests its spans.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "Tracer.h"
+
+/**
+ * Checks that spans inside another are recorded within it on the same thread
+ * and that the ring buffer keeps the newest spans.
+ */
+void Benchmark::RunTraceChecks() {
+	bool bWasEnabled = Tracer::IsEnabled();
+	TraceEvent eventSecond;
+	TraceEvent eventInner;
+	TraceEvent eventOuter;
+
+	// Restarting the tracer throws away whatever was being traced.
+	if (!Tracer::Enable()) {
+		Check(L"trace_spans_nest", false);
+		return;
+	}
+
+	// Two spans one after the other inside another.
+	{
+		TraceSpan spanOuter(L"Benchmark::Outer");
+		{
+			TraceSpan spanInner(L"Benchmark::Inner");
+			Sleep(2);
+		}
+		{
+			TraceSpan spanSecond(L"Benchmark::Second");
+			Sleep(2);
+		}
+	}
+
+	// Spans are recorded as they end, so the outer one comes last.
+	bool bRecorded = (Tracer::GetEventCount() == 3) &&
+		Tracer::GetEvent(0, &eventInner) && Tracer::GetEvent(1, &eventSecond) &&
+		Tracer::GetEvent(2, &eventOuter) &&
+		(wcscmp(eventInner.szName, L"Benchmark::Inner") == 0) &&
+		(wcscmp(eventSecond.szName, L"Benchmark::Second") == 0) &&
+		(wcscmp(eventOuter.szName, L"Benchmark::Outer") == 0);
+	Check(L"trace_records_every_span", bRecorded);
+	Check(L"trace_spans_nest", bRecorded &&
+		(eventInner.dwThread == eventOuter.dwThread) &&
+		(eventSecond.dwThread == eventOuter.dwThread) &&
+		(eventInner.ullStart >= eventOuter.ullStart) &&
+		(eventSecond.ullStart >= (eventInner.ullStart +
+		eventInner.ullDuration)) &&
+		((eventSecond.ullStart + eventSecond.ullDuration) <=
+		(eventOuter.ullStart + eventOuter.ullDuration)));
+
+	// The oldest spans make room for the new ones.
+	for (size_t i = 0; i < TRACE_BUFFER_SIZE; i++) {
+		TraceSpan span(L"Benchmark::Filler");
+	}
+	Check(L"trace_ring_buffer_drops_oldest",
+		(Tracer::GetEventCount() == TRACE_BUFFER_SIZE) &&
+		Tracer::GetEvent(0, &eventInner) &&
+		(wcscmp(eventInner.szName, L"Benchmark::Filler") == 0));
+
+	if (!bWasEnabled)
+		Tracer::Disable();
+}
@@ -0,0 +1,174 @@
+/**
+ * BenchmarkTrees.cpp
+ * Checks patching, materializing and reclaiming the tree without a TreeView.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+
+/**
+ * Times a full comparison of a huge tree against patching just the folder
+ * that changed, and checks that both end up with the same tree.
+ */
+void Benchmark::RunTreeChecks() {
+	size_t nPerFolder = BENCHMARK_TREE_COMPONENTS / BENCHMARK_TREE_FOLDERS;
+	size_t nMoved = (BENCHMARK_TREE_COMPONENTS / 2) + (nPerFolder / 2);
+	size_t nFolder = nMoved / nPerFolder;
+	TreeModel modelWanted;
+	TreeModel modelNew;
+	TreeModel model;
+	TreeDiff diffPatch;
+	TreeDiff diffCheck;
+	TreeDiff diffFull;
+
+	// Rename a component to the top of its folder and rebuild everything.
+	BuildTestTree(&model, TREE_NODE_NONE, TREE_NODE_NONE);
+	BuildTestTree(&modelNew, nMoved, TREE_NODE_NONE);
+	Start(L"tree_diff_full");
+	diffFull.Compare(model, modelNew);
+	Stop();
+
+	// Only rebuild the folder that it's in.
+	BuildTestTree(&modelWanted, nMoved, nFolder);
+	Start(L"tree_patch");
+	diffPatch.Patch(&model, modelWanted);
+	Stop();
+
+	// The moved component is removed and inserted back. Nothing else changes.
+	diffCheck.Compare(model, modelNew);
+	Check(L"tree_patch_matches_rebuild",
+		diffCheck.GetOperations().size() == 0);
+	Check(L"tree_patch_touches_only_changes",
+		(diffPatch.GetOperations().size() == 2) &&
+		(model.GetRemovedCount() == 1));
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"nodes", (DWORD)modelNew.GetCount(), false);
+	AppendNumber(&swJSON, L"full_operations",
+		(DWORD)diffFull.GetOperations().size(), false);
+	AppendNumber(&swJSON, L"patch_operations",
+		(DWORD)diffPatch.GetOperations().size(), true);
+	swJSON += L"}";
+	AddSection(L"tree", swJSON);
+}
+
+/**
+ * Builds a synthetic tree with components spread evenly across folders, the
+ * same way the TreeView lists a huge workspace.
+ *
+ * @param model       Tree to be populated.
+ * @param nMoved      Component that was renamed to the top of its folder or
+ *                    TREE_NODE_NONE to leave every component in place.
+ * @param nOnlyFolder Only folder to be built or TREE_NODE_NONE for all of
+ *                    them.
+ */
+void Benchmark::BuildTestTree(TreeModel *model, size_t nMoved,
+							  size_t nOnlyFolder) {
+	size_t nPerFolder = BENCHMARK_TREE_COMPONENTS / BENCHMARK_TREE_FOLDERS;
+	WCHAR szNumber[33];
+	size_t i, j;
+
+	// Leave room for the patches like the TreeView does.
+	model->Reserve((nOnlyFolder == TREE_NODE_NONE) ?
+		(BENCHMARK_TREE_COMPONENTS * 2) : (nPerFolder + 1));
+	for (i = 0; i < BENCHMARK_TREE_FOLDERS; i++) {
+		if ((nOnlyFolder != TREE_NODE_NONE) && (i != nOnlyFolder))
+			continue;
+
+		_ltow((long)i, szNumber, 10);
+		size_t nNode = model->AddNode(TREE_NODE_NONE, L"c:" + wstring(szNumber),
+			L"Folder " + wstring(szNumber), -1, 0, true);
+
+		// The renamed component now sorts before everything else.
+		size_t nFirst = i * nPerFolder;
+		if ((nMoved >= nFirst) && (nMoved < (nFirst + nPerFolder)))
+			AddTestChip(model, nNode, nMoved, L"Renamed ");
+		for (j = nFirst; j < (nFirst + nPerFolder); j++) {
+			if (j != nMoved)
+				AddTestChip(model, nNode, j, L"Part ");
+		}
+	}
+}
+
+/**
+ * Adds a synthetic component to a tree.
+ *
+ * @param model      Tree to be populated.
+ * @param nParent    Folder node to add the component to.
+ * @param nComponent Number of the component.
+ * @param szPrefix   What comes before the number in the label.
+ */
+void Benchmark::AddTestChip(TreeModel *model, size_t nParent,
+							size_t nComponent, LPCTSTR szPrefix) {
+	WCHAR szNumber[33];
+
+	_ltow((long)nComponent, szNumber, 10);
+	model->AddNode(nParent, L"p" + wstring(szNumber),
+		wstring(szPrefix) + szNumber, (long)nComponent, 1, false);
+}
+
+/**
+ * Checks that the lazy TreeView only drops the children of folders that were
+ * collapsed and that the eager one never drops anything.
+ */
+void Benchmark::RunReclaimChecks() {
+	TreeMaterializer materializer;
+	vector<size_t> arrNodes;
+	TreeModel modelEmpty;
+	TreeModel model;
+	TreeDiff diff;
+
+	// A folder with a sub-folder and a component next to a plain folder.
+	size_t nFolder = model.AddNode(TREE_NODE_NONE, L"c:a", L"A", -1, 0, true);
+	size_t nSubFolder = model.AddNode(nFolder, L"c:s", L"S", -1, 0, true);
+	AddTestChip(&model, nSubFolder, 0, L"Part ");
+	AddTestChip(&model, nFolder, 1, L"Part ");
+	size_t nOther = model.AddNode(TREE_NODE_NONE, L"c:b", L"B", -1, 0, true);
+	AddTestChip(&model, nOther, 2, L"Part ");
+	diff.Compare(modelEmpty, model);
+
+	// Nothing is materialized until it's expanded, and only once.
+	materializer.SetLazy(true);
+	materializer.Update(model, diff);
+	bool bMaterialized = !materializer.IsMaterialized(nFolder) &&
+		materializer.Materialize(model, nFolder, &arrNodes) &&
+		!materializer.Materialize(model, nFolder, &arrNodes) &&
+		(arrNodes.size() == 2) && (arrNodes[0] == nSubFolder);
+	materializer.SetExpanded(nFolder, true);
+	materializer.Materialize(model, nSubFolder, &arrNodes);
+	materializer.SetExpanded(nSubFolder, true);
+	materializer.Materialize(model, nOther, &arrNodes);
+	materializer.SetExpanded(nOther, true);
+	Check(L"tree_lazy_materializes_once", bMaterialized &&
+		materializer.IsVisible(model, model.GetChildren(nSubFolder)[0]));
+
+	// Collapsing a folder lets everything under it go.
+	arrNodes.clear();
+	materializer.SetExpanded(nFolder, false);
+	materializer.Reclaim(model, &arrNodes);
+	Check(L"tree_reclaims_collapsed_folder", (arrNodes.size() == 1) &&
+		(arrNodes[0] == nFolder) && !materializer.IsMaterialized(nFolder) &&
+		!materializer.IsMaterialized(nSubFolder) &&
+		!materializer.IsVisible(model, model.GetChildren(nSubFolder)[0]));
+	Check(L"tree_reclaim_keeps_expanded_folders",
+		materializer.IsMaterialized(nOther));
+
+	// Reclaimed folders are populated again the next time they're expanded.
+	arrNodes.clear();
+	Check(L"tree_reclaimed_folder_materializes_again",
+		materializer.Materialize(model, nFolder, &arrNodes) &&
+		(arrNodes.size() == 2));
+
+	// The eager mode has everything in the TreeView all the time.
+	arrNodes.clear();
+	materializer.Clear();
+	materializer.SetLazy(false);
+	materializer.Update(model, diff);
+	materializer.SetExpanded(nFolder, false);
+	materializer.Reclaim(model, &arrNodes);
+	Check(L"tree_eager_reclaims_nothing", arrNodes.empty() &&
+		materializer.IsMaterialized(nFolder) &&
+		materializer.IsMaterialized(nSubFolder));
+}
@@ -0,0 +1,275 @@
+/**
+ * BenchmarkWorkspace.cpp
+ * Times opening, searching and saving the synthetic workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Benchmark.h"
+#include "BmpImage.h"
+#include "FileUtils.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
+
+/**
+ * Times opening and refreshing the synthetic workspace. The workspace is left
+ * open for the other operations.
+ *
+ * @param  szPath    Path of the workspace directory.
+ * @param  workspace Workspace object to be used.
+ * @return           TRUE if the workspace could be opened.
+ */
+bool Benchmark::RunWorkspace(LPCTSTR szPath, Workspace *workspace) {
+	size_t i;
+
+	// Open it from scratch.
+	for (i = 0; i < nRuns; i++) {
+		workspace->Close();
+
+		IoScope scope(IO_OP_OPEN);
+		Start(L"workspace_open");
+		bool bOpened = workspace->Open(Directory(szPath));
+		Stop();
+
+		if (!bOpened)
+			return false;
+	}
+
+	// Refresh it.
+	for (i = 0; i < nRuns; i++) {
+		IoScope scope(IO_OP_REFRESH);
+		Start(L"workspace_refresh");
+		bool bRefreshed = workspace->Refresh();
+		Stop();
+
+		if (!bRefreshed)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Times the operations done on individual components.
+ *
+ * @param workspace Opened synthetic workspace.
+ * @param nSaves    Maximum number of components to be saved.
+ */
+void Benchmark::RunComponents(Workspace *workspace, size_t nSaves) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	size_t i;
+
+	// Resolve and decode the images of every component.
+	for (i = 0; i < arrComponents->size(); i++) {
+		IoScope scope(IO_OP_SELECT);
+		Start(L"component_get_image");
+		LPTSTR szImage = (*arrComponents)[i].GetImage();
+		Stop();
+
+		// Decode it the same way the image loader does when nothing was cached.
+		if (szImage != NULL) {
+			BmpImage image;
+			LPBYTE lpData;
+			DWORD dwLength;
+
+			Start(L"component_decode_image");
+			if (FileUtils::ReadBytes(szImage, &lpData, &dwLength)) {
+				image.Decode(lpData, dwLength);
+				AllocProfiler::Free(lpData);
+			}
+			Stop();
+		}
+
+		// Read the notes as well so the I/O matches selecting it.
+		LPTSTR szNotes = (*arrComponents)[i].GetNotes();
+		if (szNotes != NULL)
+			AllocProfiler::Free(szNotes);
+		if (szImage != NULL)
+			AllocProfiler::Free(szImage);
+	}
+
+	// Save a change in the quantity of some of them.
+	for (i = 0; (i < arrComponents->size()) && (i < nSaves); i++) {
+		Component *component = &(*arrComponents)[i];
+		component->SetQuantity(component->GetQuantity() + 1);
+
+		IoScope scope(IO_OP_SAVE);
+		Start(L"component_save");
+		component->Save();
+		Stop();
+	}
+}
+
+/**
+ * Times searching the whole workspace with a query.
+ *
+ * @param workspace    Opened synthetic workspace.
+ * @param szExpression Query expression to search with.
+ */
+void Benchmark::RunSearch(Workspace *workspace, LPCTSTR szExpression) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	wstring swDefinition(L"Benchmark; ");
+
+	// Build the query.
+	swDefinition += szExpression;
+	SmartQuery query(swDefinition.c_str());
+	if (!query.IsValid())
+		return;
+
+	for (size_t i = 0; i < nRuns; i++) {
+		Start(L"search");
+		for (size_t j = 0; j < arrComponents->size(); j++)
+			query.Matches(&(*arrComponents)[j]);
+		Stop();
+	}
+}
+
+/**
+ * Checks that saving a component only writes the files of the fields that
+ * changed, by counting the writes done by each kind of change to a copy of
+ * the last component of the workspace.
+ *
+ * @param workspace Opened synthetic workspace.
+ */
+void Benchmark::RunSaveChecks(Workspace *workspace) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	LONG lUntouched;
+	LONG lQuantity;
+	LONG lProperties;
+	LONG lBoth;
+	LONG lNotesSame;
+	LONG lNotesChanged;
+
+	if (arrComponents->empty())
+		return;
+
+	IoScope scope(IO_OP_SAVE);
+	Component component(arrComponents->back().GetDirectory());
+
+	// Nothing changed.
+	LONG lStart = GetSaveWrites();
+	component.Save();
+	lUntouched = GetSaveWrites() - lStart;
+
+	// Quantity and version stamp.
+	component.SetQuantity(component.GetQuantity() + 1);
+	lStart = GetSaveWrites();
+	component.Save();
+	lQuantity = GetSaveWrites() - lStart;
+
+	// Manifest and version stamp.
+	Property *prop = component.GetProperty(PROPERTY_PACKAGE);
+	if (prop == NULL) {
+		Check(L"save_writes_changed_fields", false);
+		return;
+	}
+	wstring swPackage(prop->GetValue());
+	prop->SetValue((swPackage + L"-B").c_str());
+	lStart = GetSaveWrites();
+	component.Save();
+	lProperties = GetSaveWrites() - lStart;
+
+	// Everything but the notes, putting the package back.
+	component.SetQuantity(component.GetQuantity() - 1);
+	component.GetProperty(PROPERTY_PACKAGE)->SetValue(swPackage.c_str());
+	lStart = GetSaveWrites();
+	component.Save();
+	lBoth = GetSaveWrites() - lStart;
+
+	// Notes only when they change.
+	LPTSTR szNotes = component.GetNotes();
+	wstring swNotes((szNotes != NULL) ? szNotes : L"");
+	if (szNotes != NULL)
+		AllocProfiler::Free(szNotes);
+	component.SaveNotes(swNotes.c_str());
+	lStart = GetSaveWrites();
+	component.SaveNotes(swNotes.c_str());
+	lNotesSame = GetSaveWrites() - lStart;
+	lStart = GetSaveWrites();
+	component.SaveNotes((swNotes + L" ").c_str());
+	lNotesChanged = GetSaveWrites() - lStart;
+	component.SaveNotes(swNotes.c_str());
+
+	Check(L"save_untouched_writes_nothing", lUntouched == 0);
+	Check(L"save_quantity_writes_two_files", lQuantity == 2);
+	Check(L"save_properties_writes_two_files", lProperties == 2);
+	Check(L"save_both_writes_three_files", lBoth == 3);
+	Check(L"save_same_notes_writes_nothing", lNotesSame == 0);
+	Check(L"save_changed_notes_writes_once", lNotesChanged == 1);
+
+	// Report.
+	wstring swJSON(L"{");
+	AppendNumber(&swJSON, L"untouched", lUntouched, false);
+	AppendNumber(&swJSON, L"quantity", lQuantity, false);
+	AppendNumber(&swJSON, L"properties", lProperties, false);
+	AppendNumber(&swJSON, L"quantity_and_properties", lBoth, false);
+	AppendNumber(&swJSON, L"same_notes", lNotesSame, false);
+	AppendNumber(&swJSON, L"changed_notes", lNotesChanged, true);
+	swJSON += L"}";
+	AddSection(L"save_writes", swJSON);
+}
+
+/**
+ * Checks that saving the last component of the workspace as a new one, the
+ * same way the UI does it, leaves both of them findable by their folders and
+ * the facets the same as building them from scratch.
+ *
+ * @param workspace Opened synthetic workspace.
+ */
+void Benchmark::RunSaveAsChecks(Workspace *workspace) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	ComponentHandle hOriginal = COMPONENT_HANDLE_NONE;
+	FacetIndex facetsRebuilt;
+	size_t i;
+
+	if (arrComponents->empty())
+		return;
+
+	// The saves timed before don't tell the indexes, so bring them up to date.
+	vector<Component*> arrChanged;
+	for (i = 0; i < arrComponents->size(); i++)
+		arrChanged.push_back(&(*arrComponents)[i]);
+	workspace->NotifyComponentsChanged(arrChanged);
+
+	// Save it as a new component and load the original back.
+	ComponentHandle hCopy = workspace->GetComponentHandle(
+		arrComponents->size() - 1);
+	Component *component = workspace->GetComponentByHandle(hCopy);
+	Component componentOriginal(*component);
+	Directory dirOriginal = component->GetDirectory();
+	wstring swName(component->GetName());
+	swName += L" Copy";
+	component->SetName(swName.c_str());
+	if (!component->Save(dirOriginal.Parent(), true)) {
+		Check(L"save_as_keeps_both_paths", false);
+		return;
+	}
+	Directory dirCopy = component->GetDirectory();
+	workspace->NotifyComponentSavedAs(component, &componentOriginal);
+	workspace->AddComponent(dirOriginal, &hOriginal);
+
+	// Both of them should be where they are on disk.
+	Check(L"save_as_keeps_both_paths", (hOriginal != COMPONENT_HANDLE_NONE) &&
+		(workspace->FindComponent(dirOriginal.ToString()) == hOriginal) &&
+		(workspace->FindComponent(dirCopy.ToString()) == hCopy));
+
+	// The original was counted again and the copy counted once.
+	for (i = 0; i < arrComponents->size(); i++)
+		facetsRebuilt.ComponentAdded(&(*arrComponents)[i]);
+	Check(L"save_as_facets_match_rebuild",
+		SameFacets(workspace->GetFacets(), &facetsRebuilt));
+
+	// Leave the workspace as we found it.
+	component = workspace->GetComponentByHandle(hCopy);
+	if ((component != NULL) && component->Delete())
+		workspace->RemoveComponent(hCopy);
+}
+
+/**
+ * Gets the number of writes done so far on behalf of saves.
+ *
+ * @return Number of writes.
+ */
+LONG Benchmark::GetSaveWrites() {
+	return IoAccounting::GetCounters(IO_OP_SAVE).lWrites;
+}
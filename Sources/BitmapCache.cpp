@@ -0,0 +1,188 @@
+/**
+ * BitmapCache.cpp
+ * In-memory cache of decoded and resized bitmaps.
+ *
+ * This is a thin layer over LruCache that knows how to measure and free
+ * bitmaps and how to react to the system running low on memory.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "BitmapCache.h"
+
+/**
+ * Initializes an empty bitmap cache.
+ */
+BitmapCache::BitmapCache() : cache(BITMAP_CACHE_BUDGET, FreeBitmapProc, NULL) {
+}
+
+/**
+ * Gets a bitmap from the cache.
+ * @remark The bitmap belongs to the cache and must be released with Release
+ *         once it's no longer being used.
+ *
+ * @param  szPath  Path to the image file.
+ * @param  nWidth  Width the image was resized to.
+ * @param  nHeight Height the image was resized to.
+ * @return         Cached bitmap or NULL if it isn't in the cache.
+ */
+HBITMAP BitmapCache::Get(LPCTSTR szPath, int nWidth, int nHeight) {
+	return (HBITMAP)cache.Get(BuildKey(szPath, nWidth, nHeight));
+}
+
+/**
+ * Places a bitmap in the cache. The cache takes ownership of the bitmap.
+ * @remark The bitmap must be released with Release once it's no longer being
+ *         used.
+ *
+ * @param  szPath  Path to the image file.
+ * @param  nWidth  Width the image was resized to.
+ * @param  nHeight Height the image was resized to.
+ * @param  hBitmap Bitmap to be cached.
+ * @return         The bitmap or NULL if it couldn't be cached, in which case
+ *                 it's freed.
+ */
+HBITMAP BitmapCache::Put(LPCTSTR szPath, int nWidth, int nHeight,
+						 HBITMAP hBitmap) {
+	CheckMemoryLoad();
+
+	if (!cache.Put(BuildKey(szPath, nWidth, nHeight), hBitmap,
+			GetBitmapSize(hBitmap))) {
+		DeleteObject(hBitmap);
+		return NULL;
+	}
+
+	return hBitmap;
+}
+
+/**
+ * Tells the cache that a bitmap is no longer being used.
+ *
+ * @param szPath  Path to the image file.
+ * @param nWidth  Width the image was resized to.
+ * @param nHeight Height the image was resized to.
+ */
+void BitmapCache::Release(LPCTSTR szPath, int nWidth, int nHeight) {
+	cache.Release(BuildKey(szPath, nWidth, nHeight));
+}
+
+/**
+ * Checks if a bitmap is in the cache without pinning it.
+ *
+ * @param  szPath  Path to the image file.
+ * @param  nWidth  Width the image was resized to.
+ * @param  nHeight Height the image was resized to.
+ * @return         TRUE if the bitmap is cached.
+ */
+bool BitmapCache::Contains(LPCTSTR szPath, int nWidth, int nHeight) {
+	return cache.Contains(BuildKey(szPath, nWidth, nHeight));
+}
+
+/**
+ * Adjusts the budget of the cache to how much memory the system has left.
+ * Should be called every now and then, not only when bitmaps are added.
+ */
+void BitmapCache::CheckMemoryLoad() {
+	MEMORYSTATUS ms;
+
+	ms.dwLength = sizeof(MEMORYSTATUS);
+	GlobalMemoryStatus(&ms);
+	AdjustBudget(ms.dwMemoryLoad);
+}
+
+/**
+ * Halves the budget of the cache, down to a minimum, while the system is
+ * running low on memory and gives it back once the system recovers.
+ *
+ * @param dwMemoryLoad Percentage of the system memory that is in use.
+ */
+void BitmapCache::AdjustBudget(DWORD dwMemoryLoad) {
+	size_t nBudget = cache.GetBudget();
+
+	if (dwMemoryLoad >= BITMAP_CACHE_MEMORY_LOAD) {
+		nBudget /= 2;
+		if (nBudget < BITMAP_CACHE_MIN_BUDGET)
+			nBudget = BITMAP_CACHE_MIN_BUDGET;
+
+		cache.SetBudget(nBudget);
+	} else if ((dwMemoryLoad < BITMAP_CACHE_RESTORE_LOAD) &&
+			(nBudget < BITMAP_CACHE_BUDGET)) {
+		cache.SetBudget(BITMAP_CACHE_BUDGET);
+	}
+}
+
+/**
+ * Frees every bitmap that isn't being used and keeps the budget at its
+ * minimum until the memory load drops. Should be called when the system asks
+ * us to release memory.
+ */
+void BitmapCache::ReleaseMemory() {
+	cache.SetBudget(BITMAP_CACHE_MIN_BUDGET);
+	cache.Trim(0);
+}
+
+/**
+ * Gets the underlying cache in order to read its statistics.
+ *
+ * @return Underlying cache.
+ */
+LruCache* BitmapCache::GetStatistics() {
+	return &cache;
+}
+
+/**
+ * Accounts for the memory used by the cache, including the object itself and
+ * the cached bitmaps.
+ *
+ * @param report Report to add the memory to.
+ */
+void BitmapCache::AccountMemory(MemoryReport *report) {
+	cache.AccountMemory(report, MEMORY_IMAGES);
+}
+
+/**
+ * Builds the key of a bitmap in the cache.
+ *
+ * @param  szPath  Path to the image file.
+ * @param  nWidth  Width the image was resized to.
+ * @param  nHeight Height the image was resized to.
+ * @return         Cache key.
+ */
+wstring BitmapCache::BuildKey(LPCTSTR szPath, int nWidth, int nHeight) {
+	WCHAR szSize[32];
+	wstring swKey(szPath);
+
+	swprintf(szSize, L"|%dx%d", nWidth, nHeight);
+	swKey += szSize;
+
+	return swKey;
+}
+
+/**
+ * Gets the number of bytes used by the pixels of a bitmap.
+ *
+ * @param  hBitmap Bitmap to be measured.
+ * @return         Size of the bitmap in bytes.
+ */
+size_t BitmapCache::GetBitmapSize(HBITMAP hBitmap) {
+	BITMAP bmp = {0};
+
+	if (!GetObject(hBitmap, sizeof(BITMAP), &bmp))
+		return 0;
+
+	// Device dependent bitmaps may not tell us their stride.
+	if (bmp.bmWidthBytes == 0)
+		bmp.bmWidthBytes = ((bmp.bmWidth * bmp.bmBitsPixel + 31) / 32) * 4;
+
+	return (size_t)bmp.bmWidthBytes * (size_t)bmp.bmHeight;
+}
+
+/**
+ * Frees a bitmap that was evicted from the cache.
+ *
+ * @param lpData  Bitmap handle.
+ * @param lpParam Unused.
+ */
+void BitmapCache::FreeBitmapProc(void *lpData, void *lpParam) {
+	DeleteObject((HBITMAP)lpData);
+}
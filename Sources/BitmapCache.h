@@ -0,0 +1,56 @@
+/**
+ * BitmapCache.h
+ * In-memory cache of decoded and resized bitmaps.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _BITMAP_CACHE_H
+#define _BITMAP_CACHE_H
+
+#include <windows.h>
+#include <string>
+#include "LruCache.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Memory limits. The budget is halved down to the minimum while the memory
+// load is above the high mark and restored once it drops below the low one.
+#define BITMAP_CACHE_BUDGET       (512 * 1024)
+#define BITMAP_CACHE_MIN_BUDGET   (64 * 1024)
+#define BITMAP_CACHE_MEMORY_LOAD  90
+#define BITMAP_CACHE_RESTORE_LOAD 75
+
+class BitmapCache {
+protected:
+	LruCache cache;
+
+	// Helpers.
+	static wstring BuildKey(LPCTSTR szPath, int nWidth, int nHeight);
+	static size_t GetBitmapSize(HBITMAP hBitmap);
+	static void FreeBitmapProc(void *lpData, void *lpParam);
+
+public:
+	// Constructors and destructors.
+	BitmapCache();
+
+	// Operations.
+	HBITMAP Get(LPCTSTR szPath, int nWidth, int nHeight);
+	HBITMAP Put(LPCTSTR szPath, int nWidth, int nHeight, HBITMAP hBitmap);
+	void Release(LPCTSTR szPath, int nWidth, int nHeight);
+	bool Contains(LPCTSTR szPath, int nWidth, int nHeight);
+
+	// Memory pressure.
+	void CheckMemoryLoad();
+	void AdjustBudget(DWORD dwMemoryLoad);
+	void ReleaseMemory();
+
+	// Statistics.
+	LruCache* GetStatistics();
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _BITMAP_CACHE_H
@@ -0,0 +1,628 @@
+/**
+ * BmpImage.cpp
+ * Decodes BMP images into plain pixel buffers and scales them down.
+ *
+ * Supports 1, 2, 4, 8, 16, 24 and 32-bit images, RLE4 and RLE8 compression
+ * and bit field masks. Scaling is done by averaging the area of the source
+ * image that each scaled pixel covers, which looks a lot better than nearest
+ * neighbour when scaling photos down to thumbnails. The weights are 16-bit
+ * fixed point numbers, so even the largest reductions keep every source pixel
+ * in the average, and each channel is added up in its own 32-bit accumulator
+ * since they no longer fit side by side in a single word.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <string.h>
+#include "BmpImage.h"
+
+// Header sizes.
+#define BMP_FILE_HEADER_SIZE  14
+#define BMP_CORE_HEADER_SIZE  12
+#define BMP_INFO_HEADER_SIZE  40
+
+// Compression types.
+#define BMP_RGB       0
+#define BMP_RLE8      1
+#define BMP_RLE4      2
+#define BMP_BITFIELDS 3
+
+// Fixed point scale of the scaling weights. A channel times the sum of the
+// weights has to fit in 32 bits.
+#define BMP_WEIGHT_SHIFT 16
+#define BMP_WEIGHT_ONE   (1UL << BMP_WEIGHT_SHIFT)
+#define BMP_WEIGHT_HALF  (1UL << (BMP_WEIGHT_SHIFT - 1))
+
+/**
+ * Reads a little-endian 16-bit value.
+ *
+ * @param  lpData Data to read from.
+ * @return        Value that was read.
+ */
+static unsigned long ReadWord(const unsigned char *lpData) {
+	return (unsigned long)lpData[0] | ((unsigned long)lpData[1] << 8);
+}
+
+/**
+ * Reads a little-endian 32-bit value.
+ *
+ * @param  lpData Data to read from.
+ * @return        Value that was read.
+ */
+static unsigned long ReadLong(const unsigned char *lpData) {
+	return ((unsigned long)lpData[0] | ((unsigned long)lpData[1] << 8) |
+		((unsigned long)lpData[2] << 16) | ((unsigned long)lpData[3] << 24)) &
+		0xFFFFFFFFUL;
+}
+
+/**
+ * Initializes an empty image.
+ */
+BmpImage::BmpImage() {
+	nWidth = 0;
+	nHeight = 0;
+	lpPixels = NULL;
+}
+
+/**
+ * Frees the pixel buffer.
+ */
+BmpImage::~BmpImage() {
+	Free();
+}
+
+/**
+ * Decodes a BMP file that is in memory.
+ *
+ * @param  lpData  Contents of the BMP file.
+ * @param  nLength Size of the file.
+ * @return         TRUE if the image was decoded.
+ */
+bool BmpImage::Decode(const unsigned char *lpData, size_t nLength) {
+	BmpPixel aPalette[256];
+	BmpMasks masks;
+	size_t nHeaderSize;
+	size_t nEntrySize;
+	size_t nColors = 0;
+	unsigned long ulOffset;
+	unsigned long ulCompression;
+	unsigned long ulColorsUsed;
+	long lWidth;
+	long lHeight;
+	int nBitCount;
+	bool bTopDown = false;
+	bool bSuccess;
+
+	Free();
+
+	// Check the file header.
+	if ((nLength < (BMP_FILE_HEADER_SIZE + BMP_CORE_HEADER_SIZE)) ||
+			(lpData[0] != 'B') || (lpData[1] != 'M'))
+		return false;
+	ulOffset = ReadLong(lpData + 10);
+	nHeaderSize = ReadLong(lpData + 14);
+	if (nHeaderSize > nLength)
+		return false;
+
+	// Parse the information header.
+	if (nHeaderSize == BMP_CORE_HEADER_SIZE) {
+		lWidth = (long)ReadWord(lpData + 18);
+		lHeight = (long)ReadWord(lpData + 20);
+		nBitCount = (int)ReadWord(lpData + 24);
+		ulCompression = BMP_RGB;
+		ulColorsUsed = 0;
+		nEntrySize = 3;
+	} else if ((nHeaderSize >= BMP_INFO_HEADER_SIZE) &&
+			(nLength >= (BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE))) {
+		lWidth = (long)(int)ReadLong(lpData + 18);
+		lHeight = (long)(int)ReadLong(lpData + 22);
+		nBitCount = (int)ReadWord(lpData + 28);
+		ulCompression = ReadLong(lpData + 30);
+		ulColorsUsed = ReadLong(lpData + 46);
+		nEntrySize = 4;
+	} else {
+		return false;
+	}
+
+	// Negative heights are used by top-down images.
+	if (lHeight < 0) {
+		bTopDown = true;
+		lHeight = -lHeight;
+	}
+	if ((lWidth <= 0) || (lWidth > BMP_MAX_DIMENSION) || (lHeight == 0) ||
+			(lHeight > BMP_MAX_DIMENSION))
+		return false;
+
+	// Get the palette.
+	if (nBitCount <= 8) {
+		nColors = (ulColorsUsed > 0) ? ulColorsUsed : ((size_t)1 << nBitCount);
+		if (nColors > 256)
+			nColors = 256;
+
+		// The header size was checked against the length, so this can't wrap.
+		const unsigned char *lpEntry = lpData + BMP_FILE_HEADER_SIZE + nHeaderSize;
+		if ((BMP_FILE_HEADER_SIZE + nHeaderSize + (nColors * nEntrySize)) > nLength)
+			return false;
+
+		for (size_t i = 0; i < nColors; i++, lpEntry += nEntrySize) {
+			aPalette[i] = ((BmpPixel)lpEntry[2] << 16) |
+				((BmpPixel)lpEntry[1] << 8) | (BmpPixel)lpEntry[0];
+		}
+	}
+
+	// Get the channel masks.
+	if (nBitCount == 16) {
+		masks.aulMask[0] = 0x7C00;
+		masks.aulMask[1] = 0x03E0;
+		masks.aulMask[2] = 0x001F;
+	} else {
+		masks.aulMask[0] = 0x00FF0000;
+		masks.aulMask[1] = 0x0000FF00;
+		masks.aulMask[2] = 0x000000FF;
+	}
+	if (ulCompression == BMP_BITFIELDS) {
+		if (((nBitCount != 16) && (nBitCount != 32)) ||
+				(nHeaderSize < BMP_INFO_HEADER_SIZE) ||
+				(nLength < (BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + 12)))
+			return false;
+
+		const unsigned char *lpMasks = lpData + BMP_FILE_HEADER_SIZE +
+			BMP_INFO_HEADER_SIZE;
+		masks.aulMask[0] = ReadLong(lpMasks);
+		masks.aulMask[1] = ReadLong(lpMasks + 4);
+		masks.aulMask[2] = ReadLong(lpMasks + 8);
+	}
+	PrepareMasks(&masks);
+
+	// Decode the pixels.
+	if ((ulOffset >= nLength) || !Allocate((int)lWidth, (int)lHeight))
+		return false;
+	switch (ulCompression) {
+	case BMP_RGB:
+	case BMP_BITFIELDS:
+		bSuccess = DecodeRows(lpData + ulOffset, nLength - ulOffset, nBitCount,
+			aPalette, nColors, &masks, bTopDown);
+		break;
+	case BMP_RLE8:
+		bSuccess = (nBitCount == 8) && !bTopDown && DecodeRle(lpData + ulOffset,
+			nLength - ulOffset, false, aPalette, nColors);
+		break;
+	case BMP_RLE4:
+		bSuccess = (nBitCount == 4) && !bTopDown && DecodeRle(lpData + ulOffset,
+			nLength - ulOffset, true, aPalette, nColors);
+		break;
+	default:
+		bSuccess = false;
+		break;
+	}
+
+	if (!bSuccess)
+		Free();
+
+	return bSuccess;
+}
+
+/**
+ * Decodes uncompressed pixel rows.
+ *
+ * @param  lpData    Pixel data.
+ * @param  nLength   Size of the pixel data.
+ * @param  nBitCount Bits per pixel.
+ * @param  lpPalette Color palette of indexed images.
+ * @param  nColors   Number of colors in the palette.
+ * @param  masks     Channel masks of 16 and 32-bit images.
+ * @param  bTopDown  Are the rows stored from the top down?
+ * @return           TRUE if the pixels were decoded.
+ */
+bool BmpImage::DecodeRows(const unsigned char *lpData, size_t nLength,
+						  int nBitCount, const BmpPixel *lpPalette,
+						  size_t nColors, const BmpMasks *masks,
+						  bool bTopDown) {
+	size_t nStride = ((((size_t)nWidth * nBitCount) + 31) / 32) * 4;
+	bool bPlain32 = (masks->aulMask[0] == 0x00FF0000) &&
+		(masks->aulMask[1] == 0x0000FF00) && (masks->aulMask[2] == 0x000000FF);
+	int x;
+
+	// Make sure we have all the rows.
+	if ((nStride * nHeight) > nLength)
+		return false;
+
+	for (int y = 0; y < nHeight; y++) {
+		const unsigned char *lpRow = lpData + (nStride * y);
+		BmpPixel *lpOut = lpPixels + ((bTopDown ? y : (nHeight - 1 - y)) * nWidth);
+
+		switch (nBitCount) {
+		case 1:
+		case 2:
+		case 4:
+		case 8: {
+			unsigned int nMask = (1 << nBitCount) - 1;
+
+			for (x = 0; x < nWidth; x++) {
+				size_t nBit = (size_t)x * nBitCount;
+				size_t nIndex = (lpRow[nBit >> 3] >> (8 - nBitCount - (nBit & 7))) &
+					nMask;
+
+				lpOut[x] = (nIndex < nColors) ? lpPalette[nIndex] : 0;
+			}
+			break;
+		}
+		case 16:
+			for (x = 0; x < nWidth; x++)
+				lpOut[x] = ApplyMasks(ReadWord(lpRow + (x * 2)), masks);
+			break;
+		case 24:
+			for (x = 0; x < nWidth; x++, lpRow += 3) {
+				lpOut[x] = ((BmpPixel)lpRow[2] << 16) | ((BmpPixel)lpRow[1] << 8) |
+					(BmpPixel)lpRow[0];
+			}
+			break;
+		case 32:
+			if (bPlain32) {
+				for (x = 0; x < nWidth; x++)
+					lpOut[x] = ReadLong(lpRow + (x * 4)) & 0x00FFFFFF;
+			} else {
+				for (x = 0; x < nWidth; x++)
+					lpOut[x] = ApplyMasks(ReadLong(lpRow + (x * 4)), masks);
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Decodes RLE4 or RLE8 compressed pixels.
+ *
+ * @param  lpData    Compressed pixel data.
+ * @param  nLength   Size of the compressed data.
+ * @param  bRle4     Is this RLE4 instead of RLE8?
+ * @param  lpPalette Color palette.
+ * @param  nColors   Number of colors in the palette.
+ * @return           TRUE if the pixels were decoded.
+ */
+bool BmpImage::DecodeRle(const unsigned char *lpData, size_t nLength,
+						 bool bRle4, const BmpPixel *lpPalette,
+						 size_t nColors) {
+	size_t nPos = 0;
+	int x = 0;
+	int y = nHeight - 1;
+	unsigned int i;
+
+	// Pixels that are skipped are left black.
+	memset(lpPixels, 0, (size_t)nWidth * nHeight * sizeof(BmpPixel));
+
+	while (((nPos + 1) < nLength) && (y >= 0)) {
+		unsigned int nCount = lpData[nPos];
+		unsigned int nValue = lpData[nPos + 1];
+		nPos += 2;
+
+		if (nCount > 0) {
+			// Run of a single index (or a pair of them in RLE4).
+			for (i = 0; i < nCount; i++, x++) {
+				size_t nIndex = nValue;
+				if (bRle4)
+					nIndex = (i & 1) ? (nValue & 0x0F) : (nValue >> 4);
+
+				if ((x < nWidth) && (nIndex < nColors))
+					lpPixels[(y * nWidth) + x] = lpPalette[nIndex];
+			}
+
+			continue;
+		}
+
+		switch (nValue) {
+		case 0:
+			// End of line.
+			x = 0;
+			y--;
+			break;
+		case 1:
+			// End of bitmap.
+			return true;
+		case 2:
+			// Move the cursor.
+			if ((nPos + 1) >= nLength)
+				return false;
+			x += lpData[nPos];
+			y -= lpData[nPos + 1];
+			nPos += 2;
+			break;
+		default: {
+			// Literal indexes, padded to a word.
+			size_t nBytes = bRle4 ? ((nValue + 1) / 2) : nValue;
+			if ((nPos + nBytes) > nLength)
+				return false;
+
+			for (i = 0; i < nValue; i++, x++) {
+				size_t nIndex;
+				if (bRle4) {
+					nIndex = lpData[nPos + (i / 2)];
+					nIndex = (i & 1) ? (nIndex & 0x0F) : (nIndex >> 4);
+				} else {
+					nIndex = lpData[nPos + i];
+				}
+
+				if ((x < nWidth) && (nIndex < nColors))
+					lpPixels[(y * nWidth) + x] = lpPalette[nIndex];
+			}
+
+			nPos += (nBytes + 1) & ~((size_t)1);
+			break;
+		}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Figures out the shift and the number of bits of each channel mask.
+ *
+ * @param masks Masks to be prepared.
+ */
+void BmpImage::PrepareMasks(BmpMasks *masks) {
+	for (int i = 0; i < 3; i++) {
+		unsigned long ulMask = masks->aulMask[i];
+
+		masks->anShift[i] = 0;
+		masks->anBits[i] = 0;
+		if (ulMask == 0)
+			continue;
+
+		while ((ulMask & 1) == 0) {
+			ulMask >>= 1;
+			masks->anShift[i]++;
+		}
+		while (ulMask & 1) {
+			ulMask >>= 1;
+			masks->anBits[i]++;
+		}
+	}
+}
+
+/**
+ * Converts a masked 16 or 32-bit value into a pixel.
+ *
+ * @param  ulValue Raw pixel value.
+ * @param  masks   Prepared channel masks.
+ * @return         Pixel.
+ */
+BmpPixel BmpImage::ApplyMasks(unsigned long ulValue, const BmpMasks *masks) {
+	BmpPixel pixel = 0;
+
+	for (int i = 0; i < 3; i++) {
+		unsigned long ulChannel;
+		int nBits = masks->anBits[i];
+
+		if (nBits == 0) {
+			ulChannel = 0;
+		} else {
+			ulChannel = (ulValue & masks->aulMask[i]) >> masks->anShift[i];
+			if (nBits >= 8) {
+				ulChannel >>= nBits - 8;
+			} else {
+				ulChannel = (ulChannel * 255) / ((1UL << nBits) - 1);
+			}
+		}
+
+		pixel = (pixel << 8) | ulChannel;
+	}
+
+	return pixel;
+}
+
+/**
+ * Scales the image into another one by averaging the area that each pixel
+ * covers.
+ *
+ * @param  image   Image that will hold the scaled pixels.
+ * @param  nWidth  Width of the scaled image.
+ * @param  nHeight Height of the scaled image.
+ * @return         TRUE if the operation was successful.
+ */
+bool BmpImage::ScaleTo(BmpImage *image, int nWidth, int nHeight) {
+	vector<BmpContribution> arrColumns;
+	vector<BmpContribution> arrRows;
+	vector<size_t> arrColumnStarts;
+	vector<size_t> arrRowStarts;
+	int iCachedRow = -1;
+	int x;
+
+	// Check if we have something to scale.
+	if ((lpPixels == NULL) || (image == this) || (nWidth <= 0) ||
+			(nHeight <= 0) || (nWidth > BMP_MAX_DIMENSION) ||
+			(nHeight > BMP_MAX_DIMENSION))
+		return false;
+	if (!image->Allocate(nWidth, nHeight))
+		return false;
+
+	// Figure out which source pixels go into each scaled pixel.
+	BuildContributions(this->nWidth, nWidth, &arrColumns, &arrColumnStarts);
+	BuildContributions(this->nHeight, nHeight, &arrRows, &arrRowStarts);
+
+	// Scale the rows horizontally and then add them up vertically.
+	vector<BmpPixel> arrRow(nWidth);
+	vector<unsigned long> arrR(nWidth);
+	vector<unsigned long> arrG(nWidth);
+	vector<unsigned long> arrB(nWidth);
+	for (int y = 0; y < nHeight; y++) {
+		BmpPixel *lpOut = image->lpPixels + (y * nWidth);
+
+		for (x = 0; x < nWidth; x++) {
+			arrR[x] = BMP_WEIGHT_HALF;
+			arrG[x] = BMP_WEIGHT_HALF;
+			arrB[x] = BMP_WEIGHT_HALF;
+		}
+
+		for (size_t i = arrRowStarts[y]; i < arrRowStarts[y + 1]; i++) {
+			unsigned long ulWeight = arrRows[i].ulWeight;
+
+			// Consecutive scaled rows share a source row at their boundary.
+			if (arrRows[i].nIndex != iCachedRow) {
+				iCachedRow = arrRows[i].nIndex;
+				ScaleRow(lpPixels + (iCachedRow * this->nWidth), &arrRow[0],
+					nWidth, arrColumns, arrColumnStarts);
+			}
+
+			for (x = 0; x < nWidth; x++) {
+				arrR[x] += ((arrRow[x] >> 16) & 0xFF) * ulWeight;
+				arrG[x] += ((arrRow[x] >> 8) & 0xFF) * ulWeight;
+				arrB[x] += (arrRow[x] & 0xFF) * ulWeight;
+			}
+		}
+
+		for (x = 0; x < nWidth; x++) {
+			lpOut[x] = ((arrR[x] >> BMP_WEIGHT_SHIFT) << 16) |
+				((arrG[x] >> BMP_WEIGHT_SHIFT) << 8) | (arrB[x] >> BMP_WEIGHT_SHIFT);
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Calculates how much each source pixel contributes to each scaled pixel
+ * along one of the axes. The weights of each scaled pixel add up to
+ * BMP_WEIGHT_ONE and the rounding error is spread across them, since each
+ * weight is the difference between two rounded boundaries.
+ *
+ * @param nSource          Number of source pixels.
+ * @param nTarget          Number of scaled pixels.
+ * @param arrContributions Contributions of every scaled pixel, in order.
+ * @param arrStarts        Index of the first contribution of each scaled
+ *                         pixel, plus one past the last one.
+ */
+void BmpImage::BuildContributions(int nSource, int nTarget,
+								  vector<BmpContribution> *arrContributions,
+								  vector<size_t> *arrStarts) {
+	arrContributions->clear();
+	arrStarts->resize(nTarget + 1);
+
+	// Every source pixel is nTarget units wide and every scaled pixel is
+	// nSource units wide, so the overlaps are exact integers.
+	for (int d = 0; d < nTarget; d++) {
+		unsigned long ulStart = (unsigned long)d * nSource;
+		unsigned long ulEnd = ulStart + nSource;
+		unsigned long ulPrevious = 0;
+
+		(*arrStarts)[d] = arrContributions->size();
+		for (unsigned long i = ulStart / nTarget; (i * nTarget) < ulEnd; i++) {
+			unsigned long ulLow = i * nTarget;
+			unsigned long ulHigh = ulLow + nTarget;
+			BmpContribution contribution;
+
+			if (ulLow < ulStart)
+				ulLow = ulStart;
+			if (ulHigh > ulEnd)
+				ulHigh = ulEnd;
+
+			// Round where this pixel ends rather than its own width.
+			unsigned long ulBoundary = (((ulHigh - ulStart) * BMP_WEIGHT_ONE) +
+				(nSource / 2)) / nSource;
+			contribution.nIndex = (int)i;
+			contribution.ulWeight = ulBoundary - ulPrevious;
+			ulPrevious = ulBoundary;
+
+			// Slivers that round down to nothing don't need to be read.
+			if (contribution.ulWeight > 0)
+				arrContributions->push_back(contribution);
+		}
+	}
+
+	(*arrStarts)[nTarget] = arrContributions->size();
+}
+
+/**
+ * Scales a single row horizontally.
+ *
+ * @param lpSource         Source row.
+ * @param lpTarget         Scaled row.
+ * @param nTarget          Number of pixels in the scaled row.
+ * @param arrContributions Contributions of every scaled pixel.
+ * @param arrStarts        Index of the first contribution of each pixel.
+ */
+void BmpImage::ScaleRow(const BmpPixel *lpSource, BmpPixel *lpTarget,
+						int nTarget,
+						const vector<BmpContribution> &arrContributions,
+						const vector<size_t> &arrStarts) {
+	for (int x = 0; x < nTarget; x++) {
+		unsigned long ulR = BMP_WEIGHT_HALF;
+		unsigned long ulG = BMP_WEIGHT_HALF;
+		unsigned long ulB = BMP_WEIGHT_HALF;
+
+		for (size_t i = arrStarts[x]; i < arrStarts[x + 1]; i++) {
+			BmpPixel pixel = lpSource[arrContributions[i].nIndex];
+			unsigned long ulWeight = arrContributions[i].ulWeight;
+
+			ulR += ((pixel >> 16) & 0xFF) * ulWeight;
+			ulG += ((pixel >> 8) & 0xFF) * ulWeight;
+			ulB += (pixel & 0xFF) * ulWeight;
+		}
+
+		lpTarget[x] = ((ulR >> BMP_WEIGHT_SHIFT) << 16) |
+			((ulG >> BMP_WEIGHT_SHIFT) << 8) | (ulB >> BMP_WEIGHT_SHIFT);
+	}
+}
+
+/**
+ * Allocates the pixel buffer.
+ *
+ * @param  nWidth  Image width.
+ * @param  nHeight Image height.
+ * @return         TRUE if the buffer was allocated.
+ */
+bool BmpImage::Allocate(int nWidth, int nHeight) {
+	Free();
+
+	lpPixels = new BmpPixel[(size_t)nWidth * nHeight];
+	if (lpPixels == NULL)
+		return false;
+
+	this->nWidth = nWidth;
+	this->nHeight = nHeight;
+
+	return true;
+}
+
+/**
+ * Frees the pixel buffer.
+ */
+void BmpImage::Free() {
+	if (lpPixels != NULL)
+		delete[] lpPixels;
+
+	lpPixels = NULL;
+	nWidth = 0;
+	nHeight = 0;
+}
+
+/**
+ * Gets the width of the image.
+ *
+ * @return Image width.
+ */
+int BmpImage::GetWidth() {
+	return nWidth;
+}
+
+/**
+ * Gets the height of the image.
+ *
+ * @return Image height.
+ */
+int BmpImage::GetHeight() {
+	return nHeight;
+}
+
+/**
+ * Gets the pixels of the image, from the top down, as 0x00RRGGBB.
+ *
+ * @return Pixel buffer or NULL if there's no image.
+ */
+const BmpPixel* BmpImage::GetPixels() {
+	return lpPixels;
+}
@@ -0,0 +1,82 @@
+/**
+ * BmpImage.h
+ * Decodes BMP images into plain pixel buffers and scales them down.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _BMP_IMAGE_H
+#define _BMP_IMAGE_H
+
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+// Largest image dimension we are willing to decode.
+#define BMP_MAX_DIMENSION 8192
+
+// Pixels are stored top-down as 0x00RRGGBB.
+typedef unsigned long BmpPixel;
+
+class BmpImage {
+protected:
+	int nWidth;
+	int nHeight;
+	BmpPixel *lpPixels;
+
+	// Channel masks of 16 and 32-bit images.
+	typedef struct {
+		unsigned long aulMask[3];
+		int anShift[3];
+		int anBits[3];
+	} BmpMasks;
+
+	// Contribution of a source pixel to a scaled pixel.
+	typedef struct {
+		int nIndex;
+		unsigned long ulWeight;
+	} BmpContribution;
+
+	// Allocation.
+	bool Allocate(int nWidth, int nHeight);
+	void Free();
+
+	// Decoding.
+	bool DecodeRows(const unsigned char *lpData, size_t nLength, int nBitCount,
+		const BmpPixel *lpPalette, size_t nColors, const BmpMasks *masks,
+		bool bTopDown);
+	bool DecodeRle(const unsigned char *lpData, size_t nLength, bool bRle4,
+		const BmpPixel *lpPalette, size_t nColors);
+	static void PrepareMasks(BmpMasks *masks);
+	static BmpPixel ApplyMasks(unsigned long ulValue, const BmpMasks *masks);
+
+	// Scaling.
+	static void BuildContributions(int nSource, int nTarget,
+		vector<BmpContribution> *arrContributions, vector<size_t> *arrStarts);
+	static void ScaleRow(const BmpPixel *lpSource, BmpPixel *lpTarget,
+		int nTarget, const vector<BmpContribution> &arrContributions,
+		const vector<size_t> &arrStarts);
+
+private:
+	// Images can't be copied.
+	BmpImage(const BmpImage &image);
+	BmpImage& operator=(const BmpImage &image);
+
+public:
+	// Constructors and destructors.
+	BmpImage();
+	~BmpImage();
+
+	// Operations.
+	bool Decode(const unsigned char *lpData, size_t nLength);
+	bool ScaleTo(BmpImage *image, int nWidth, int nHeight);
+
+	// Getters.
+	int GetWidth();
+	int GetHeight();
+	const BmpPixel* GetPixels();
+};
+
+#endif  // _BMP_IMAGE_H
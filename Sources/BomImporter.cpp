@@ -0,0 +1,543 @@
+/**
+ * BomImporter.cpp
+ * Imports a bill of materials from a CSV file and matches its lines against
+ * the components in the workspace.
+ *
+ * The CSV file is read in fixed size blocks and its lines are matched in
+ * chunks, with each chunk split across threads. The match report is written
+ * to a file as each chunk is finished, so memory usage doesn't depend on the
+ * size of the BOM.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "BomImporter.h"
+#include "DuplicateFinder.h"
+#include "ParallelUtils.h"
+#include "FileUtils.h"
+
+// Character definitions.
+#define CR '\r'
+#define LF '\n'
+
+// Streaming parameters.
+#define BOM_READ_BUFFER 4096
+#define BOM_CHUNK_LINES 512
+
+// Fuzzy matching parameters.
+#define BOM_FUZZY_THRESHOLD 0.5
+#define BOM_MAX_POSTINGS    256
+#define BOM_NO_COMPONENT    ((size_t)-1)
+
+// Match method names used in the report.
+static LPCTSTR szMethodNames[] = {
+	L"None",
+	L"Part Number",
+	L"Value and Package",
+	L"Fuzzy Name"
+};
+
+/**
+ * Initializes the importer.
+ *
+ * @param arrComponents Components to match the BOM lines against.
+ */
+BomImporter::BomImporter(vector<Component> *arrComponents) {
+	this->arrComponents = arrComponents;
+}
+
+/**
+ * Imports a BOM and writes a report of how each line was matched.
+ *
+ * @param  szBomPath    Path to the BOM CSV file.
+ * @param  szReportPath Path to the CSV report that will be created.
+ * @return              TRUE if the operation was successful.
+ */
+bool BomImporter::Import(LPCTSTR szBomPath, LPCTSTR szReportPath) {
+	char szaBuffer[BOM_READ_BUFFER];
+	DWORD dwBytesRead;
+	HANDLE hFile;
+	HANDLE hReport;
+	wstring swLine;
+	bool bInQuotes = false;
+	bool bHeader = true;
+	bool bSuccess = true;
+
+	// Start fresh.
+	summary.nLines = 0;
+	summary.nMatched = 0;
+	summary.nUnmatched = 0;
+	summary.nInsufficient = 0;
+	mapRequired.clear();
+	arrLines.clear();
+	nFirstLine = 1;
+	iColPartNumber = -1;
+	iColValue = -1;
+	iColPackage = -1;
+	iColName = -1;
+	iColQuantity = -1;
+
+	// Open the BOM and the report files.
+	hFile = FileUtils::Open(szBomPath, GENERIC_READ, FILE_SHARE_READ,
+		OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	hReport = FileUtils::Open(szReportPath, GENERIC_WRITE, 0, CREATE_ALWAYS);
+	if (hReport == INVALID_HANDLE_VALUE) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	// Build the indexes and write the report header.
+	BuildIndexes();
+	bSuccess = FileUtils::WriteString(hReport,
+		L"Line,Method,Component,Required,In Stock,Sufficient\r\n");
+
+	// Read the file a block at a time.
+	while (bSuccess && FileUtils::Read(hFile, szaBuffer, BOM_READ_BUFFER,
+			&dwBytesRead) && (dwBytesRead > 0)) {
+		for (DWORD i = 0; i < dwBytesRead; i++) {
+			char c = szaBuffer[i];
+
+			// Newlines inside quoted fields are part of the field.
+			if (c == '"')
+				bInQuotes = !bInQuotes;
+			if ((c != LF) || bInQuotes) {
+				if (c != CR)
+					swLine += (WCHAR)(unsigned char)c;
+				continue;
+			}
+
+			// We have a complete line.
+			if (bHeader) {
+				ParseHeader(swLine);
+				bHeader = false;
+			} else if (swLine.length() > 0) {
+				arrLines.push_back(swLine);
+			}
+			swLine.erase();
+
+			// Match the lines we have so far.
+			if (arrLines.size() >= BOM_CHUNK_LINES)
+				bSuccess &= ProcessChunk(hReport);
+		}
+	}
+
+	// Take care of a last line without a newline and whatever was left over.
+	if (bSuccess) {
+		if (!bHeader && (swLine.length() > 0))
+			arrLines.push_back(swLine);
+		if (arrLines.size() > 0)
+			bSuccess &= ProcessChunk(hReport);
+	}
+
+	// Count the components that don't have enough stock for the whole BOM.
+	map<size_t, size_t>::iterator it;
+	for (it = mapRequired.begin(); it != mapRequired.end(); it++) {
+		if (it->second > (*arrComponents)[it->first].GetQuantity())
+			summary.nInsufficient++;
+	}
+
+	// Clean up.
+	CloseHandle(hFile);
+	CloseHandle(hReport);
+
+	return bSuccess;
+}
+
+/**
+ * Matches the lines in the current chunk and appends the results to the
+ * report.
+ *
+ * @param  hReport Report file handle.
+ * @return         TRUE if the report was written successfully.
+ */
+bool BomImporter::ProcessChunk(HANDLE hReport) {
+	WCHAR szNumber[33];
+	wstring swReport;
+
+	// Match the lines in parallel.
+	arrMatches.resize(arrLines.size());
+	ParallelUtils::ForEach(arrLines.size(), MatchLineProc, this);
+
+	// Build the report in order.
+	for (size_t i = 0; i < arrMatches.size(); i++) {
+		BomMatch *match = &arrMatches[i];
+		summary.nLines++;
+
+		_ltow((long)(nFirstLine + i), szNumber, 10);
+		swReport += szNumber;
+		swReport += L",";
+		swReport += szMethodNames[match->iMethod];
+		swReport += L",\"";
+
+		if (match->iMethod == BOM_MATCH_NONE) {
+			summary.nUnmatched++;
+
+			swReport += L"\",";
+			_ltow((long)match->nRequired, szNumber, 10);
+			swReport += szNumber;
+			swReport += L",,\r\n";
+			continue;
+		}
+
+		// Keep track of the stock needed by the whole BOM so far.
+		Component *component = &(*arrComponents)[match->nComponent];
+		summary.nMatched++;
+		mapRequired[match->nComponent] += match->nRequired;
+
+		// Escape the quotes in the name.
+		wstring swName(component->GetName());
+		for (size_t j = 0; j < swName.length(); j++) {
+			if (swName[j] == L'"')
+				swName.insert(j++, 1, L'"');
+		}
+
+		swReport += swName;
+		swReport += L"\",";
+		_ltow((long)match->nRequired, szNumber, 10);
+		swReport += szNumber;
+		swReport += L",";
+		_ltow((long)component->GetQuantity(), szNumber, 10);
+		swReport += szNumber;
+		swReport += L",";
+		if (mapRequired[match->nComponent] <= component->GetQuantity()) {
+			swReport += L"Yes\r\n";
+		} else {
+			swReport += L"No\r\n";
+		}
+	}
+
+	// Get ready for the next chunk.
+	nFirstLine += arrLines.size();
+	arrLines.clear();
+
+	return FileUtils::WriteString(hReport, swReport.c_str());
+}
+
+/**
+ * Parallel worker that matches a single line of the current chunk.
+ *
+ * @param nIndex  Line index in the chunk.
+ * @param lpParam Pointer to the BomImporter object.
+ */
+void BomImporter::MatchLineProc(size_t nIndex, LPVOID lpParam) {
+	((BomImporter*)lpParam)->MatchLine(nIndex);
+}
+
+/**
+ * Matches a single line of the current chunk to a component.
+ *
+ * @param nIndex Line index in the chunk.
+ */
+void BomImporter::MatchLine(size_t nIndex) {
+	BomMatch *match = &arrMatches[nIndex];
+	vector<wstring> arrFields;
+	map<wstring, size_t>::iterator it;
+
+	// Get the fields and the required quantity.
+	SplitFields(arrLines[nIndex], &arrFields);
+	wstring swPartNumber = GetField(&arrFields, iColPartNumber);
+	wstring swValue = GetField(&arrFields, iColValue);
+	wstring swPackage = GetField(&arrFields, iColPackage);
+	wstring swName = GetField(&arrFields, iColName);
+	long lRequired = _wtol(GetField(&arrFields, iColQuantity).c_str());
+	match->nRequired = (lRequired > 0) ? (size_t)lRequired : 1;
+	match->iMethod = BOM_MATCH_NONE;
+
+	// Try the part number first.
+	if (swPartNumber.length() > 0) {
+		it = mapPartNumbers.find(NormalizePartNumber(swPartNumber.c_str()));
+		if (it != mapPartNumbers.end()) {
+			match->iMethod = BOM_MATCH_PART_NUMBER;
+			match->nComponent = it->second;
+			return;
+		}
+	}
+
+	// Then the value and package combination.
+	if ((swValue.length() > 0) && (swPackage.length() > 0)) {
+		it = mapValuePackages.find(ValuePackageKey(swValue.c_str(),
+			swPackage.c_str()));
+		if (it != mapValuePackages.end()) {
+			match->iMethod = BOM_MATCH_VALUE_PACKAGE;
+			match->nComponent = it->second;
+			return;
+		}
+	}
+
+	// Finally try to guess from the name.
+	if (swName.length() == 0)
+		swName = swPartNumber;
+	match->nComponent = MatchFuzzyName(swName.c_str());
+	if (match->nComponent != BOM_NO_COMPONENT)
+		match->iMethod = BOM_MATCH_FUZZY_NAME;
+}
+
+/**
+ * Finds the component whose name shares the most tokens with a name.
+ *
+ * @param  szName Name to be matched.
+ * @return        Component index or BOM_NO_COMPONENT if nothing is similar
+ *                enough.
+ */
+size_t BomImporter::MatchFuzzyName(LPCTSTR szName) {
+	vector<wstring> arrTokens;
+	map<size_t, size_t> mapCommon;
+	map<size_t, size_t>::iterator it;
+	size_t nBest = BOM_NO_COMPONENT;
+	double dBestScore = 0;
+
+	// Count how many tokens each candidate shares with us.
+	Tokenize(szName, &arrTokens);
+	for (size_t i = 0; i < arrTokens.size(); i++) {
+		map<wstring, vector<size_t> >::iterator itToken;
+
+		// Tokens that are too common don't tell us anything.
+		itToken = mapNameTokens.find(arrTokens[i]);
+		if ((itToken == mapNameTokens.end()) ||
+				(itToken->second.size() > BOM_MAX_POSTINGS))
+			continue;
+
+		for (size_t j = 0; j < itToken->second.size(); j++)
+			mapCommon[itToken->second[j]]++;
+	}
+
+	// Pick the candidate with the best similarity.
+	for (it = mapCommon.begin(); it != mapCommon.end(); it++) {
+		vector<wstring> arrCandidate;
+		Tokenize((*arrComponents)[it->first].GetName(), &arrCandidate);
+
+		double dScore = (double)it->second / (double)(arrTokens.size() +
+			arrCandidate.size() - it->second);
+		if (dScore > dBestScore) {
+			dBestScore = dScore;
+			nBest = it->first;
+		}
+	}
+
+	if (dBestScore < BOM_FUZZY_THRESHOLD)
+		return BOM_NO_COMPONENT;
+
+	return nBest;
+}
+
+/**
+ * Builds the lookup indexes from the workspace components.
+ */
+void BomImporter::BuildIndexes() {
+	mapPartNumbers.clear();
+	mapValuePackages.clear();
+	mapNameTokens.clear();
+
+	for (size_t i = 0; i < arrComponents->size(); i++) {
+		Component *component = &(*arrComponents)[i];
+		vector<Property> *arrProperties = component->GetEditableProperties();
+		LPCTSTR szPackage = component->GetPackage();
+		vector<wstring> arrTokens;
+		size_t j;
+
+		// Component names are usually part numbers.
+		wstring swKey = NormalizePartNumber(component->GetName());
+		if (mapPartNumbers.find(swKey) == mapPartNumbers.end())
+			mapPartNumbers[swKey] = i;
+
+		// Go through the properties looking for part numbers and values.
+		for (j = 0; j < arrProperties->size(); j++) {
+			Property *prop = &(*arrProperties)[j];
+			wstring swName = DuplicateFinder::NormalizeKey(prop->GetName());
+
+			if ((swName.compare(L"mpn") == 0) || ((swName.length() >= 11) &&
+					(swName.compare(swName.length() - 11, 11, L"part-number") == 0))) {
+				swKey = NormalizePartNumber(prop->GetValue());
+				if (mapPartNumbers.find(swKey) == mapPartNumbers.end())
+					mapPartNumbers[swKey] = i;
+			} else if ((szPackage != NULL) &&
+					(swName.compare(0, 5, L"value") == 0)) {
+				swKey = ValuePackageKey(prop->GetValue(), szPackage);
+				if (mapValuePackages.find(swKey) == mapValuePackages.end())
+					mapValuePackages[swKey] = i;
+			}
+		}
+
+		// Index the name tokens for fuzzy matching.
+		Tokenize(component->GetName(), &arrTokens);
+		for (j = 0; j < arrTokens.size(); j++)
+			mapNameTokens[arrTokens[j]].push_back(i);
+	}
+}
+
+/**
+ * Normalizes a part number by ignoring case and anything that isn't a letter
+ * or a number.
+ *
+ * @param  szPartNumber Part number.
+ * @return              Normalized part number.
+ */
+wstring BomImporter::NormalizePartNumber(LPCTSTR szPartNumber) {
+	wstring swPartNumber;
+
+	for (; *szPartNumber != L'\0'; szPartNumber++) {
+		if (iswalnum(*szPartNumber))
+			swPartNumber += (WCHAR)towlower(*szPartNumber);
+	}
+
+	return swPartNumber;
+}
+
+/**
+ * Builds the key used to look up a value and package combination.
+ *
+ * @param  szValue   Component value.
+ * @param  szPackage Component package.
+ * @return           Lookup key.
+ */
+wstring BomImporter::ValuePackageKey(LPCTSTR szValue, LPCTSTR szPackage) {
+	wstring swKey = DuplicateFinder::NormalizeValue(szValue);
+
+	swKey += L'|';
+	swKey += NormalizePartNumber(szPackage);
+
+	return swKey;
+}
+
+/**
+ * Splits a string into unique lower case alphanumeric tokens.
+ *
+ * @param szString  String to be split.
+ * @param arrTokens Array where the tokens will be stored.
+ */
+void BomImporter::Tokenize(LPCTSTR szString, vector<wstring> *arrTokens) {
+	wstring swToken;
+
+	arrTokens->clear();
+	for (;; szString++) {
+		if ((*szString != L'\0') && iswalnum(*szString)) {
+			swToken += (WCHAR)towlower(*szString);
+			continue;
+		}
+
+		// End of a token.
+		if (swToken.length() > 0) {
+			bool bUnique = true;
+			for (size_t i = 0; i < arrTokens->size(); i++) {
+				if ((*arrTokens)[i].compare(swToken) == 0) {
+					bUnique = false;
+					break;
+				}
+			}
+
+			if (bUnique)
+				arrTokens->push_back(swToken);
+			swToken.erase();
+		}
+
+		if (*szString == L'\0')
+			break;
+	}
+}
+
+/**
+ * Splits a CSV line into its fields.
+ *
+ * @param swLine    CSV line.
+ * @param arrFields Array where the fields will be stored.
+ */
+void BomImporter::SplitFields(const wstring &swLine, vector<wstring> *arrFields) {
+	wstring swField;
+	bool bInQuotes = false;
+
+	arrFields->clear();
+	for (size_t i = 0; i < swLine.length(); i++) {
+		WCHAR c = swLine[i];
+
+		if (c == L'"') {
+			// Escaped quote inside a quoted field.
+			if (bInQuotes && ((i + 1) < swLine.length()) && (swLine[i + 1] == L'"')) {
+				swField += L'"';
+				i++;
+			} else {
+				bInQuotes = !bInQuotes;
+			}
+		} else if ((c == L',') && !bInQuotes) {
+			arrFields->push_back(swField);
+			swField.erase();
+		} else {
+			swField += c;
+		}
+	}
+
+	arrFields->push_back(swField);
+}
+
+/**
+ * Gets a trimmed field from a line.
+ *
+ * @param  arrFields Fields of the line.
+ * @param  iColumn   Column index or -1 if the column isn't present.
+ * @return           Field contents or an empty string.
+ */
+wstring BomImporter::GetField(vector<wstring> *arrFields, int iColumn) {
+	if ((iColumn < 0) || ((size_t)iColumn >= arrFields->size()))
+		return wstring();
+
+	wstring *swField = &(*arrFields)[iColumn];
+	wstring::size_type start = swField->find_first_not_of(L" \t");
+	wstring::size_type end = swField->find_last_not_of(L" \t");
+	if (start == wstring::npos)
+		return wstring();
+
+	return swField->substr(start, end - start + 1);
+}
+
+/**
+ * Figures out which columns hold the information that we need.
+ *
+ * @param swLine CSV header line.
+ */
+void BomImporter::ParseHeader(const wstring &swLine) {
+	vector<wstring> arrFields;
+
+	SplitFields(swLine, &arrFields);
+	for (size_t i = 0; i < arrFields.size(); i++) {
+		wstring swName = NormalizePartNumber(arrFields[i].c_str());
+		int iColumn = (int)i;
+
+		if ((iColPartNumber < 0) && ((swName.compare(L"partnumber") == 0) ||
+				(swName.compare(L"mpn") == 0) || (swName.compare(L"pn") == 0) ||
+				(swName.compare(L"manufacturerpartnumber") == 0))) {
+			iColPartNumber = iColumn;
+		} else if ((iColValue < 0) && ((swName.compare(L"value") == 0) ||
+				(swName.compare(L"comment") == 0))) {
+			iColValue = iColumn;
+		} else if ((iColPackage < 0) && ((swName.compare(L"package") == 0) ||
+				(swName.compare(L"footprint") == 0))) {
+			iColPackage = iColumn;
+		} else if ((iColName < 0) && ((swName.compare(L"name") == 0) ||
+				(swName.compare(L"description") == 0) ||
+				(swName.compare(L"part") == 0))) {
+			iColName = iColumn;
+		} else if ((iColQuantity < 0) && ((swName.compare(L"quantity") == 0) ||
+				(swName.compare(L"qty") == 0))) {
+			iColQuantity = iColumn;
+		}
+	}
+}
+
+/**
+ * Gets the totals of the last import.
+ *
+ * @return Import summary.
+ */
+BomSummary BomImporter::GetSummary() {
+	return summary;
+}
+
+/**
+ * Gets the stock needed by the last import.
+ *
+ * @return Quantity required of each matched component, by its index.
+ */
+map<size_t, size_t> BomImporter::GetRequired() {
+	return mapRequired;
+}
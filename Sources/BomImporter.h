@@ -0,0 +1,93 @@
+/**
+ * BomImporter.h
+ * Imports a bill of materials from a CSV file and matches its lines against
+ * the components in the workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _BOM_IMPORTER_H
+#define _BOM_IMPORTER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Component.h"
+
+using namespace std;
+
+// How a BOM line was matched to a component.
+#define BOM_MATCH_NONE          0
+#define BOM_MATCH_PART_NUMBER   1
+#define BOM_MATCH_VALUE_PACKAGE 2
+#define BOM_MATCH_FUZZY_NAME    3
+
+// Result of matching a single BOM line.
+typedef struct {
+	int iMethod;
+	size_t nComponent;
+	size_t nRequired;
+} BomMatch;
+
+// Totals of an import.
+typedef struct {
+	size_t nLines;
+	size_t nMatched;
+	size_t nUnmatched;
+	size_t nInsufficient;
+} BomSummary;
+
+class BomImporter {
+protected:
+	vector<Component> *arrComponents;
+
+	// Indexes.
+	map<wstring, size_t> mapPartNumbers;
+	map<wstring, size_t> mapValuePackages;
+	map<wstring, vector<size_t> > mapNameTokens;
+
+	// Columns.
+	int iColPartNumber;
+	int iColValue;
+	int iColPackage;
+	int iColName;
+	int iColQuantity;
+
+	// Current chunk.
+	vector<wstring> arrLines;
+	vector<BomMatch> arrMatches;
+	size_t nFirstLine;
+
+	// Results.
+	map<size_t, size_t> mapRequired;
+	BomSummary summary;
+
+	// Indexing.
+	void BuildIndexes();
+	static wstring NormalizePartNumber(LPCTSTR szPartNumber);
+	static wstring ValuePackageKey(LPCTSTR szValue, LPCTSTR szPackage);
+	static void Tokenize(LPCTSTR szString, vector<wstring> *arrTokens);
+
+	// Parsing.
+	static void SplitFields(const wstring &swLine, vector<wstring> *arrFields);
+	static wstring GetField(vector<wstring> *arrFields, int iColumn);
+	void ParseHeader(const wstring &swLine);
+
+	// Matching.
+	static void MatchLineProc(size_t nIndex, LPVOID lpParam);
+	void MatchLine(size_t nIndex);
+	size_t MatchFuzzyName(LPCTSTR szName);
+	bool ProcessChunk(HANDLE hReport);
+
+public:
+	// Constructors and destructors.
+	BomImporter(vector<Component> *arrComponents);
+
+	// Operations.
+	bool Import(LPCTSTR szBomPath, LPCTSTR szReportPath);
+	BomSummary GetSummary();
+	map<size_t, size_t> GetRequired();
+};
+
+#endif  // _BOM_IMPORTER_H
@@ -11,6 +11,13 @@
 #include "Constants.h"
 #include "Component.h"
 #include "FileUtils.h"
+#include "FileLock.h"
+#include "AssetStore.h"
+#include "Tracer.h"
+#include "AllocProfiler.h"
+
+// Maximum time to wait for another writer to finish saving a component.
+#define COMPONENT_LOCK_TIMEOUT 2000
 
 using namespace std;
 
@@ -31,10 +38,24 @@ Component::Component(Directory dirPath) {
 	PopulateFromDirectory();
 }
 
+/**
+ * Initializes a component that hasn't been saved yet without touching the
+ * disk.
+ *
+ * @param dirParent Folder where the component would be saved.
+ * @param szName    Component name.
+ */
+Component::Component(Directory dirParent, LPCTSTR szName) {
+	ClearFields();
+	dirPath = Directory(dirParent.Concatenate(szName));
+	SetName(szName);
+}
+
 /**
  * Populates the properties from the MANIFEST file.
  */
 void Component::PopulateProperties() {
+	TraceSpan span(L"Component::PopulateProperties");
 	HANDLE hFile;
 	wstring swLine;
 
@@ -42,9 +63,8 @@ void Component::PopulateProperties() {
 	arrProperties.clear();
 
 	// Open the MANIFEST file for reading.
-	hFile = CreateFile(dirPath.Concatenate(MANIFEST_FILE).ToString(),
-		GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
-		NULL);
+	hFile = FileUtils::Open(dirPath.Concatenate(MANIFEST_FILE).ToString(),
+		GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING);
 
 	// Go through the file line by line.
 	while (FileUtils::ReadLine(hFile, &swLine)) {
@@ -60,16 +80,20 @@ void Component::PopulateProperties() {
  * Populates this component with data from its directory.
  */
 void Component::PopulateFromDirectory() {
+	TraceSpan span(L"Component::PopulateFromDirectory");
+
 	// Populate the name and properties.
 	SetName(dirPath.FileName());
 	PopulateProperties();
 
 	// Populate the quantity.
-	LPTSTR szQuantity;
-	if (FileUtils::ReadContents(dirPath.Concatenate(QUANTITY_FILE).ToString(), &szQuantity)) {
-		nQuantity = _wtol(szQuantity);
-		LocalFree(szQuantity);
-	}
+	ReadQuantity(&nQuantity, &dwBatch);
+
+	// Remember what we've loaded to detect changes made by others.
+	dwVersion = ReadVersion();
+	RememberFields();
+	bNotesHashed = false;
+	bConflict = false;
 }
 
 /**
@@ -79,8 +103,10 @@ void Component::PopulateFromDirectory() {
  * @return           TRUE if the operation was successful.
  */
 bool Component::Rename(LPCTSTR szNewName) {
-	SetName(szNewName);
-	return dirPath.Rename(szNewName);
+	if (!dirPath.Rename(szNewName))
+		return false;
+
+	return SetName(szNewName);
 }
 
 /**
@@ -93,7 +119,12 @@ bool Component::Save() {
 }
 
 /**
- * Saves the component object to the file system.
+ * Saves the component object to the file system. Only the files of the fields
+ * that were actually changed are written.
+ * @remark If someone else saved the component since we loaded it their
+ *         changes are merged with ours. Quantities are merged by applying our
+ *         change on top of theirs. Properties are only merged if just one of
+ *         us changed them, otherwise the save fails and HasConflict is TRUE.
  *
  * @param  dirPath   Path to the component directory or to the component
  *                   container if we are creating.
@@ -101,42 +132,83 @@ bool Component::Save() {
  * @return           TRUE if the operation was successful.
  */
 bool Component::Save(Directory dirPath, bool bCreating) {
-	LPTSTR szBuffer;
 	bool bSuccess = true;
+	bool bWriteQuantity = bCreating || (nQuantity != nBaseQuantity);
+	bool bWriteManifest;
 
 	// Create directory first.
+	bConflict = false;
 	if (bCreating) {
 		this->dirPath = Directory(dirPath.Concatenate(szName));
 		if (!CreateDirectory(this->dirPath.ToString(), NULL))
 			return false;
 		
 		dirPath = this->dirPath;
+		dwVersion = 0;
+		bNotesHashed = false;
 	}
 
-	// Save quantity.
-	szBuffer = GetQuantityString();
-	bSuccess &= FileUtils::SaveContents(dirPath.Concatenate(QUANTITY_FILE).ToString(),
-		szBuffer);
-	LocalFree(szBuffer);
+	// Keep other writers out while we check and write.
+	FileLock lock(dirPath.Concatenate(LOCK_FILE));
+	if (!lock.Acquire(COMPONENT_LOCK_TIMEOUT))
+		return false;
 
-	// Save properties.
-	wstring swProperties;
-	if (arrProperties.size() == 0)
-		swProperties = L"\r\n";
-	for (size_t i = 0; i < arrProperties.size(); i++) {
-		szBuffer = arrProperties[i].ToString();
+	// Check if someone else saved the component since we loaded it.
+	wstring swProperties = BuildManifest();
+	DWORD dwHash = HashString(swProperties);
+	DWORD dwDiskVersion = ReadVersion();
+	bWriteManifest = bCreating || (dwHash != dwManifestHash);
+	if (dwDiskVersion != dwVersion) {
+		Component componentDisk(dirPath);
+		DWORD dwDiskHash = HashString(componentDisk.BuildManifest());
+
+		// Apply our quantity change on top of theirs.
+		nQuantity = MergeQuantity(componentDisk.GetQuantity());
+		dwBatch = componentDisk.dwBatch;
+
+		if (dwHash == dwManifestHash) {
+			// We haven't changed the properties, so take theirs.
+			arrProperties = componentDisk.arrProperties;
+			dwHash = dwDiskHash;
+			bWriteManifest = false;
+		} else if (dwDiskHash == dwHash) {
+			// We both made the same changes.
+			bWriteManifest = false;
+		} else if (dwDiskHash != dwManifestHash) {
+			// We both changed the properties.
+			bConflict = true;
+			return false;
+		}
+	}
 
-		swProperties += szBuffer;
-		swProperties += L"\r\n";
+	// Nothing changed, so there's nothing to write.
+	if (!bWriteQuantity && !bWriteManifest) {
+		dwVersion = dwDiskVersion;
+		RememberFields();
 
-		LocalFree(szBuffer);
+		return true;
+	}
+
+	// Save quantity.
+	if (bWriteQuantity)
+		bSuccess &= WriteQuantity();
+
+	// Save properties.
+	if (bWriteManifest) {
+		bSuccess &= FileUtils::SaveContents(dirPath.Concatenate(MANIFEST_FILE).ToString(),
+			swProperties.c_str());
 	}
-	bSuccess &= FileUtils::SaveContents(dirPath.Concatenate(MANIFEST_FILE).ToString(),
-		swProperties.c_str());
 
 	// TODO: Save image.
 
-	return bSuccess;
+	// Stamp the new version.
+	if (!bSuccess || !WriteVersion(dwDiskVersion + 1))
+		return false;
+
+	dwVersion = dwDiskVersion + 1;
+	RememberFields();
+
+	return true;
 }
 
 /**
@@ -195,7 +267,7 @@ bool Component::SetName(LPCTSTR szName) {
 
 /**
  * Get the component notes.
- * @remark Remember to free the string using LocalFree.
+ * @remark Remember to free the string using AllocProfiler::Free.
  *
  * @return Notes about the component or NULL if none were found.
  */
@@ -206,17 +278,51 @@ LPTSTR Component::GetNotes() {
 	if (!FileUtils::ReadContents(dirPath.Concatenate(NOTES_FILE).ToString(), &szNotes))
 		return NULL;
 
+	RememberNotes(szNotes);
 	return szNotes;
 }
 
 /**
- * Set the component notes.
+ * Set the component notes. The notes file is left untouched if they haven't
+ * changed since they were last read or saved.
  *
  * @param  szNotes Component notes.
  * @return         TRUE if the operation was successful.
  */
 bool Component::SaveNotes(LPCTSTR szNotes) {
-	return FileUtils::SaveContents(dirPath.Concatenate(NOTES_FILE).ToString(), szNotes);
+	if (!IsNotesChanged(szNotes))
+		return true;
+
+	if (!FileUtils::SaveContents(dirPath.Concatenate(NOTES_FILE).ToString(), szNotes))
+		return false;
+
+	RememberNotes(szNotes);
+	return true;
+}
+
+/**
+ * Remembers the notes that are currently on disk, for when they were read by
+ * someone else.
+ *
+ * @param szNotes Component notes as they are on disk.
+ */
+void Component::RememberNotes(LPCTSTR szNotes) {
+	dwNotesHash = HashString(wstring(szNotes));
+	bNotesHashed = true;
+}
+
+/**
+ * Checks if the notes are different from the ones on disk.
+ * @remark Notes that were never read or saved are always considered changed.
+ *
+ * @param  szNotes Component notes.
+ * @return         TRUE if the notes have changed.
+ */
+bool Component::IsNotesChanged(LPCTSTR szNotes) {
+	if (!bNotesHashed)
+		return true;
+
+	return HashString(wstring(szNotes)) != dwNotesHash;
 }
 
 /**
@@ -230,12 +336,13 @@ size_t Component::GetQuantity() {
 
 /**
  * Gets the quantity of components as a string.
- * @remark Remember to free this string with LocalFree.
+ * @remark Remember to free this string with AllocProfiler::Free.
  *
  * @return Number of components available as a string.
  */
 LPTSTR Component::GetQuantityString() {
-	LPTSTR szQuantity = (LPTSTR)LocalAlloc(LMEM_FIXED, 33 * sizeof(WCHAR));
+	LPTSTR szQuantity = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		33 * sizeof(WCHAR), L"Component::GetQuantityString");
 	_ltow(nQuantity, szQuantity, 10);
 
 	return szQuantity;
@@ -259,6 +366,305 @@ void Component::SetQuantity(LPCTSTR szQuantity) {
 	SetQuantity((size_t)_wtol(szQuantity));
 }
 
+/**
+ * Saves only the quantity of the component to the file system.
+ * @remark If someone else changed the quantity since we loaded it our change
+ *         is applied on top of theirs.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool Component::SaveQuantity() {
+	return SaveQuantity(QUANTITY_BATCH_NONE);
+}
+
+/**
+ * Saves only the quantity of the component to the file system as part of a
+ * journaled batch, stamping the component with the batch so that a replay of
+ * the journal knows the change was already applied.
+ * @remark If someone else changed the quantity since we loaded it our change
+ *         is applied on top of theirs.
+ *
+ * @param  dwBatch Batch that the change belongs to or QUANTITY_BATCH_NONE.
+ * @return         TRUE if the operation was successful.
+ */
+bool Component::SaveQuantity(DWORD dwBatch) {
+	size_t nDiskQuantity;
+	DWORD dwDiskBatch;
+
+	// Nothing to save if the quantity hasn't changed.
+	if (nQuantity == nBaseQuantity)
+		return true;
+
+	// Keep other writers out while we merge and write.
+	FileLock lock(dirPath.Concatenate(LOCK_FILE));
+	if (!lock.Acquire(COMPONENT_LOCK_TIMEOUT))
+		return false;
+
+	// Merge with the quantity on disk if someone else saved in the meantime.
+	DWORD dwDiskVersion = ReadVersion();
+	if (dwDiskVersion != dwVersion) {
+		if (ReadQuantity(&nDiskQuantity, &dwDiskBatch)) {
+			nQuantity = MergeQuantity(nDiskQuantity);
+			this->dwBatch = dwDiskBatch;
+		}
+	}
+
+	// Write it along with the batch stamp and stamp a new version.
+	if (dwBatch != QUANTITY_BATCH_NONE)
+		this->dwBatch = dwBatch;
+	if (!WriteQuantity() || !WriteVersion(dwDiskVersion + 1))
+		return false;
+
+	// Only claim the new version if we were up to date, otherwise we haven't
+	// seen the other changes to the manifest yet.
+	if (dwDiskVersion == dwVersion)
+		dwVersion = dwDiskVersion + 1;
+	nBaseQuantity = nQuantity;
+
+	return true;
+}
+
+/**
+ * Applies a quantity change from the journal straight to a component folder,
+ * on top of whatever quantity is on disk, unless the component was already
+ * stamped with the batch before we were interrupted.
+ *
+ * @param  dirComponent Component folder.
+ * @param  lDelta       Quantity change.
+ * @param  dwBatch      Batch that the change belongs to.
+ * @param  bApplied     Set to TRUE if the change was applied now.
+ * @return              TRUE if the change is on disk, now or from before.
+ */
+bool Component::ReplayQuantityDelta(Directory dirComponent, long lDelta,
+									DWORD dwBatch, bool *bApplied) {
+	Component component;
+	size_t nDiskQuantity;
+	long lQuantity;
+
+	*bApplied = false;
+	component.dirPath = dirComponent;
+
+	// Nothing left to change if the component was removed in the meantime.
+	if (!FileUtils::Exists(dirComponent.ToString()))
+		return true;
+
+	// Keep other writers out while we check and write.
+	FileLock lock(dirComponent.Concatenate(LOCK_FILE));
+	if (!lock.Acquire(COMPONENT_LOCK_TIMEOUT))
+		return false;
+
+	// Check if the change made it to disk before. Batches are applied in
+	// order, so a later stamp means this one is in there as well.
+	component.ReadQuantity(&nDiskQuantity, &component.dwBatch);
+	if ((component.dwBatch != QUANTITY_BATCH_NONE) &&
+			(component.dwBatch >= dwBatch))
+		return true;
+
+	// Apply it on top of the quantity on disk.
+	lQuantity = (long)nDiskQuantity + lDelta;
+	component.nQuantity = (lQuantity < 0) ? 0 : (size_t)lQuantity;
+	component.dwBatch = dwBatch;
+
+	// Write it along with the batch stamp and stamp a new version.
+	if (!component.WriteQuantity() ||
+			!component.WriteVersion(component.ReadVersion() + 1))
+		return false;
+
+	*bApplied = true;
+	return true;
+}
+
+/**
+ * Reads the quantity file, which holds the quantity and, after a tab, the last
+ * journaled batch of quantity changes that was applied to it.
+ *
+ * @param  nQuantity Quantity on disk.
+ * @param  dwBatch   Last batch applied or QUANTITY_BATCH_NONE if none was.
+ * @return           TRUE if the quantity file was read.
+ */
+bool Component::ReadQuantity(size_t *nQuantity, DWORD *dwBatch) {
+	LPTSTR szQuantity;
+	LPTSTR szBatch;
+
+	*nQuantity = 0;
+	*dwBatch = QUANTITY_BATCH_NONE;
+	if (!FileUtils::ReadContents(dirPath.Concatenate(QUANTITY_FILE).ToString(),
+			&szQuantity))
+		return false;
+
+	*nQuantity = (size_t)_wtol(szQuantity);
+	szBatch = wcschr(szQuantity, L'\t');
+	if (szBatch != NULL)
+		*dwBatch = (DWORD)_wtol(szBatch + 1);
+	AllocProfiler::Free(szQuantity);
+
+	return true;
+}
+
+/**
+ * Writes the quantity file without any checks. The batch stamp goes in the
+ * same write, so a change can never be on disk without it.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool Component::WriteQuantity() {
+	LPTSTR szQuantity = GetQuantityString();
+	WCHAR szBatch[33];
+	wstring swContents(szQuantity);
+	AllocProfiler::Free(szQuantity);
+
+	if (dwBatch != QUANTITY_BATCH_NONE) {
+		_ultow(dwBatch, szBatch, 10);
+		swContents += L'\t';
+		swContents += szBatch;
+	}
+
+	return FileUtils::SaveContents(
+		dirPath.Concatenate(QUANTITY_FILE).ToString(), swContents.c_str());
+}
+
+/**
+ * Applies the change we've made to the quantity on top of the quantity that
+ * someone else saved.
+ *
+ * @param  nDiskQuantity Quantity currently saved on disk.
+ * @return               Merged quantity.
+ */
+size_t Component::MergeQuantity(size_t nDiskQuantity) {
+	long lMerged = (long)nDiskQuantity + ((long)nQuantity - (long)nBaseQuantity);
+
+	if (lMerged < 0)
+		return 0;
+
+	return (size_t)lMerged;
+}
+
+/**
+ * Reads the version stamp of the component on disk.
+ *
+ * @return Version stamp or 0 if the component was never saved with one.
+ */
+DWORD Component::ReadVersion() {
+	Path pathVersion = dirPath.Concatenate(VERSION_FILE);
+	LPTSTR szVersion;
+	DWORD dwDiskVersion = 0;
+
+	// Components that were never saved since stamps exist don't have one.
+	if (!FileUtils::Exists(pathVersion.ToString()))
+		return 0;
+
+	if (FileUtils::ReadContents(pathVersion.ToString(), &szVersion)) {
+		dwDiskVersion = (DWORD)_wtol(szVersion);
+		AllocProfiler::Free(szVersion);
+	}
+
+	return dwDiskVersion;
+}
+
+/**
+ * Writes the version stamp of the component.
+ *
+ * @param  dwVersion Version stamp.
+ * @return           TRUE if the operation was successful.
+ */
+bool Component::WriteVersion(DWORD dwVersion) {
+	WCHAR szVersion[33];
+
+	_ultow(dwVersion, szVersion, 10);
+	return FileUtils::SaveContents(dirPath.Concatenate(VERSION_FILE).ToString(),
+		szVersion);
+}
+
+/**
+ * Builds the contents of the MANIFEST file from the properties.
+ *
+ * @return MANIFEST file contents.
+ */
+wstring Component::BuildManifest() {
+	wstring swProperties;
+	LPTSTR szBuffer;
+
+	if (arrProperties.size() == 0)
+		swProperties = L"\r\n";
+	for (size_t i = 0; i < arrProperties.size(); i++) {
+		szBuffer = arrProperties[i].ToString();
+
+		swProperties += szBuffer;
+		swProperties += L"\r\n";
+
+		AllocProfiler::Free(szBuffer);
+	}
+
+	return swProperties;
+}
+
+/**
+ * Remembers the fields as they are on disk to detect what was changed.
+ */
+void Component::RememberFields() {
+	nBaseQuantity = nQuantity;
+	dwManifestHash = HashString(BuildManifest());
+
+	arrPropertyHashes.clear();
+	arrPropertyHashes.reserve(arrProperties.size());
+	for (size_t i = 0; i < arrProperties.size(); i++)
+		arrPropertyHashes.push_back(HashProperty(arrProperties[i]));
+}
+
+/**
+ * Calculates a FNV-1a hash of a string to quickly compare manifests.
+ *
+ * @param  swString String to be hashed.
+ * @return          Hash of the string.
+ */
+DWORD Component::HashString(const wstring &swString) {
+	DWORD dwHash = 2166136261UL;
+
+	for (size_t i = 0; i < swString.length(); i++) {
+		dwHash ^= (DWORD)swString[i];
+		dwHash *= 16777619UL;
+	}
+
+	return dwHash;
+}
+
+/**
+ * Calculates the hash of a property as it's stored in the manifest.
+ *
+ * @param  property Property to be hashed.
+ * @return          Hash of the property.
+ */
+DWORD Component::HashProperty(Property &property) {
+	LPTSTR szProperty = property.ToString();
+	DWORD dwHash = HashString(wstring(szProperty));
+	AllocProfiler::Free(szProperty);
+
+	return dwHash;
+}
+
+/**
+ * Checks if the component has a quantity at which it should be reordered.
+ *
+ * @return TRUE if the component has a reorder level.
+ */
+bool Component::HasReorderLevel() {
+	return GetProperty(PROPERTY_REORDER) != NULL;
+}
+
+/**
+ * Gets the quantity at which the component should be reordered.
+ *
+ * @return Reorder level or 0 if the component doesn't have one.
+ */
+size_t Component::GetReorderLevel() {
+	Property *prop = GetProperty(PROPERTY_REORDER);
+
+	if (prop)
+		return (size_t)_wtol(prop->GetValue());
+
+	return 0;
+}
+
 /**
  * Gets the component category.
  *
@@ -287,6 +693,20 @@ LPCTSTR Component::GetSubCategory() {
 	return NULL;
 }
 
+/**
+ * Gets the component package.
+ *
+ * @return Package name or NULL if it doesn't have one.
+ */
+LPCTSTR Component::GetPackage() {
+	Property *prop = GetProperty(PROPERTY_PACKAGE);
+
+	if (prop)
+		return prop->GetValue();
+
+	return NULL;
+}
+
 /**
  * Gets a property from the component by its index.
  *
@@ -352,9 +772,25 @@ void Component::RemoveProperty(size_t index) {
 		arrProperties.erase(arrProperties.begin() + index);
 }
 
+/**
+ * Checks if a property is different from the one at the same position on disk.
+ *
+ * @param  index Index of the property.
+ * @return       TRUE if the property was changed or added.
+ */
+bool Component::IsPropertyChanged(size_t index) {
+	if (index >= arrProperties.size())
+		return false;
+	if (index >= arrPropertyHashes.size())
+		return true;
+
+	return HashProperty(arrProperties[index]) != arrPropertyHashes[index];
+}
+
 /**
  * Retrieves the component image path.
- * @remark The user should free the returned string using LocalFree.
+ * @remark The user should free the returned string using
+ *         AllocProfiler::Free.
  *
  * @return Path to the image or NULL if there isn't one associated with it.
  */
@@ -368,15 +804,17 @@ LPTSTR Component::GetImage() {
 		if (!FileUtils::ReadContents(pathImage.ToString(), &szImageName))
 			return NULL;
 		pathImage = GetImageFilePath(szImageName);
-		LocalFree(szImageName);
+		AllocProfiler::Free(szImageName);
 
-		// Check if the image bitmap exists.
-		if (pathImage.Exists()) {
+		// Check if the image bitmap exists, even if only in the asset store.
+		if (AssetStore::ResolveFile(dirPath.Parent().Parent(), pathImage,
+				&pathImage)) {
 			LPTSTR szImagePath;
 			
 			// Allocate memory for the string.
 			size_t nLen = wcslen(pathImage.ToString()) + 1;
-			szImagePath = (LPTSTR)LocalAlloc(LMEM_FIXED, nLen * sizeof(WCHAR));
+			szImagePath = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+				nLen * sizeof(WCHAR), L"Component::GetImage");
 
 			// Copy the string over and return.
 			wcscpy(szImagePath, pathImage.ToString());
@@ -391,13 +829,15 @@ LPTSTR Component::GetImage() {
 	if (prop) {
 		pathImage = GetImageFilePath(prop->GetValue());
 
-		// Check if the image bitmap exists.
-		if (pathImage.Exists()) {
+		// Check if the image bitmap exists, even if only in the asset store.
+		if (AssetStore::ResolveFile(dirPath.Parent().Parent(), pathImage,
+				&pathImage)) {
 			LPTSTR szImagePath;
 			
 			// Allocate memory for the string.
 			size_t nLen = wcslen(pathImage.ToString()) + 1;
-			szImagePath = (LPTSTR)LocalAlloc(LMEM_FIXED, nLen * sizeof(WCHAR));
+			szImagePath = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+				nLen * sizeof(WCHAR), L"Component::GetImage");
 
 			// Copy the string over and return.
 			wcscpy(szImagePath, pathImage.ToString());
@@ -438,6 +878,50 @@ Directory Component::GetDirectory() {
 	return dirPath;
 }
 
+/**
+ * Checks if the last save failed because someone else changed the properties
+ * at the same time as we did.
+ *
+ * @return TRUE if the last save had a conflict.
+ */
+bool Component::HasConflict() {
+	return bConflict;
+}
+
+/**
+ * Gets the fields that were changed since the component was loaded or saved.
+ *
+ * @param  szNotes Notes from the editor or NULL if they shouldn't be checked.
+ * @return         Combination of the COMPONENT_FIELD flags.
+ */
+DWORD Component::GetChangedFields(LPCTSTR szNotes) {
+	DWORD dwFields = 0;
+
+	if (wcscmp(szName, dirPath.FileName()) != 0)
+		dwFields |= COMPONENT_FIELD_NAME;
+	if (nQuantity != nBaseQuantity)
+		dwFields |= COMPONENT_FIELD_QUANTITY;
+	if (HashString(BuildManifest()) != dwManifestHash)
+		dwFields |= COMPONENT_FIELD_PROPERTIES;
+	if ((szNotes != NULL) && IsNotesChanged(szNotes))
+		dwFields |= COMPONENT_FIELD_NOTES;
+
+	return dwFields;
+}
+
+/**
+ * Accounts for the memory used by the component, including the object itself.
+ *
+ * @param report Report to add the memory to.
+ */
+void Component::AccountMemory(MemoryReport *report) {
+	// Its directory and name are fixed size buffers.
+	report->Add(MEMORY_PATHS, sizeof(dirPath) + sizeof(szName));
+	report->Add(MEMORY_COMPONENTS, sizeof(Component) - sizeof(dirPath) -
+		sizeof(szName) + (arrPropertyHashes.capacity() * sizeof(DWORD)));
+	report->Add(MEMORY_PROPERTIES, arrProperties.capacity() * sizeof(Property));
+}
+
 /**
  * Clears all the fields in the object.
  */
@@ -445,6 +929,14 @@ void Component::ClearFields() {
 	szName[0] = L'\0';
 	nQuantity = 0;
 	arrProperties.clear();
+	dwVersion = 0;
+	nBaseQuantity = 0;
+	dwBatch = QUANTITY_BATCH_NONE;
+	dwManifestHash = 0;
+	arrPropertyHashes.clear();
+	dwNotesHash = 0;
+	bNotesHashed = false;
+	bConflict = false;
 }
 
 /**
@@ -486,11 +978,11 @@ void Component::PrintDebug() {
 		OutputDebugString(prop.GetValue());
 		OutputDebugString(L"\r\n");
 
-		LocalFree(szBuffer);
+		AllocProfiler::Free(szBuffer);
 	}
 	OutputDebugString(L"\r\n");
 
 
-	LocalFree(szQuantity);
-	LocalFree(szNotes);
+	AllocProfiler::Free(szQuantity);
+	AllocProfiler::Free(szNotes);
 }
@@ -9,12 +9,23 @@
 #define _COMPONENT_H
 
 #include <windows.h>
+#include <string>
 #include <vector>
 #include "Directory.h"
 #include "Property.h"
+#include "MemoryReport.h"
 
 using namespace std;
 
+// Fields of a component that can be changed and saved separately.
+#define COMPONENT_FIELD_NAME       0x01
+#define COMPONENT_FIELD_QUANTITY   0x02
+#define COMPONENT_FIELD_PROPERTIES 0x04
+#define COMPONENT_FIELD_NOTES      0x08
+
+// Quantity change that isn't part of a journaled batch.
+#define QUANTITY_BATCH_NONE 0
+
 class Component {
 protected:
 	Directory dirPath;
@@ -22,15 +33,37 @@ protected:
 	size_t nQuantity;
 	vector<Property> arrProperties;
 
+	// What was on disk when we last loaded or saved.
+	DWORD dwVersion;
+	size_t nBaseQuantity;
+	DWORD dwBatch;
+	DWORD dwManifestHash;
+	vector<DWORD> arrPropertyHashes;
+	DWORD dwNotesHash;
+	bool bNotesHashed;
+	bool bConflict;
+
 	// Population.
 	void PopulateProperties();
 	void PopulateFromDirectory();
 	Path GetImageFilePath(LPCTSTR szImageName);
 
+	// Versioning.
+	DWORD ReadVersion();
+	bool WriteVersion(DWORD dwVersion);
+	bool ReadQuantity(size_t *nQuantity, DWORD *dwBatch);
+	bool WriteQuantity();
+	wstring BuildManifest();
+	size_t MergeQuantity(size_t nDiskQuantity);
+	void RememberFields();
+	static DWORD HashString(const wstring &swString);
+	static DWORD HashProperty(Property &property);
+
 public:
 	// Constructors and destructors.
 	Component();
 	Component(Directory dirPath);
+	Component(Directory dirParent, LPCTSTR szName);
 
 	// Name.
 	LPCTSTR GetName();
@@ -39,12 +72,20 @@ public:
 	// Notes.
 	LPTSTR GetNotes();
 	bool SaveNotes(LPCTSTR szNotes);
+	void RememberNotes(LPCTSTR szNotes);
+	bool IsNotesChanged(LPCTSTR szNotes);
 
 	// Quantity.
 	size_t GetQuantity();
 	LPTSTR GetQuantityString();
 	void SetQuantity(size_t nQuantity);
 	void SetQuantity(LPCTSTR szQuantity);
+	bool SaveQuantity();
+	bool SaveQuantity(DWORD dwBatch);
+	static bool ReplayQuantityDelta(Directory dirComponent, long lDelta,
+									DWORD dwBatch, bool *bApplied);
+	bool HasReorderLevel();
+	size_t GetReorderLevel();
 
 	// Image.
 	LPTSTR GetImage();
@@ -56,11 +97,15 @@ public:
 	vector<Property>* GetEditableProperties();
 	void AddProperty(Property property);
 	void RemoveProperty(size_t index);
+	bool IsPropertyChanged(size_t index);
 
 	// Categories and sub-categories.
 	LPCTSTR GetCategory();
 	LPCTSTR GetSubCategory();
 
+	// Package.
+	LPCTSTR GetPackage();
+
 	// File system.
 	bool Save();
 	bool Save(Directory dirPath, bool bCreating);
@@ -68,6 +113,9 @@ public:
 	static bool Create(Directory dirWorkspace, LPCTSTR szName);
 	bool Delete();
 	Directory GetDirectory();
+	bool HasConflict();
+	DWORD GetChangedFields(LPCTSTR szNotes);
+	void AccountMemory(MemoryReport *report);
 
 	// Misc.
 	void ClearFields();
@@ -12,9 +12,14 @@
 #define COMPONENTS_ROOT L"components"
 #define ASSETS_ROOT     L"assets"
 #define IMAGES_DIR      L"images"
+#define THUMBNAIL_CACHE_DIR L"cache"
+#define ASSETS_BLOBS_DIR    L"blobs"
 
 // PartCat workspace files.
 #define WORKSPACE_FILE L"PartCat.pcw"
+#define QUANTITY_JOURNAL_FILE L"QUANTITY.journal"
+#define QUANTITY_HISTORY_FILE L"QUANTITY.history"
+#define THUMBNAIL_INDEX_FILE  L"INDEX"
 
 // PartCat component files.
 #define MANIFEST_FILE  L"MANIFEST"
@@ -22,6 +27,8 @@
 #define IMAGE_FILE     L"IMAGE"
 #define DATASHEET_FILE L"datasheet.pdf"
 #define NOTES_FILE     L"notes.txt"
+#define VERSION_FILE   L"VERSION"
+#define LOCK_FILE      L"LOCK"
 
 // PartCat MANIFEST property keys.
 #define PROPERTY_NAME        L"Name"
@@ -29,9 +36,14 @@
 #define PROPERTY_SUBCATEGORY L"Sub-Category"
 #define PROPERTY_VALUE       L"Value"
 #define PROPERTY_PACKAGE     L"Package"
+#define PROPERTY_REORDER     L"Reorder-Level"
+
+// PartCat workspace file property keys.
+#define PROPERTY_SMART_FOLDER L"Smart-Folder"
 
 // File types.
 #define IMAGE_EXTENSION     L".bmp"
 #define WORKSPACE_EXTENSION L".pcw"
+#define BLOB_REF_EXTENSION  L".blob"
 
 #endif  //  _CONSTANTS_H
\ No newline at end of file
@@ -0,0 +1,262 @@
+/**
+ * DetailLoader.cpp
+ * Prepares the contents of the detail view in a background thread.
+ *
+ * Only the latest request matters, so instead of a queue there's a single
+ * pending slot that each new selection overwrites. The worker reads the notes
+ * and builds the property captions from its own copy of the component, so the
+ * UI thread is free to keep changing the original, and posts the finished
+ * model back as a WM_DETAILREADY message to be swapped in all at once.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "DetailLoader.h"
+#include "Constants.h"
+#include "FileUtils.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
+
+/**
+ * Initializes a loader that isn't running yet.
+ */
+DetailLoader::DetailLoader() {
+	hThread = NULL;
+	hWakeEvent = NULL;
+	hwndNotify = NULL;
+	hPendingComponent = COMPONENT_HANDLE_NONE;
+	dwPendingTime = 0;
+	ulGeneration = 0;
+	bPending = false;
+	bStopping = false;
+	InitializeCriticalSection(&csRequest);
+	ResetLatency();
+}
+
+/**
+ * Stops the worker thread.
+ */
+DetailLoader::~DetailLoader() {
+	Stop();
+	DeleteCriticalSection(&csRequest);
+}
+
+/**
+ * Starts the worker thread. Nothing is done if it's already running.
+ *
+ * @param  hwndNotify Window that will receive the WM_DETAILREADY messages.
+ * @return            TRUE if the worker is running.
+ */
+bool DetailLoader::Start(HWND hwndNotify) {
+	if (hThread != NULL)
+		return true;
+
+	this->hwndNotify = hwndNotify;
+	bStopping = false;
+
+	// Auto-reset event used to wake the worker up when there's work to do.
+	hWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (hWakeEvent == NULL)
+		return false;
+
+	hThread = CreateThread(NULL, 0, WorkerThreadProc, this, 0, NULL);
+	if (hThread == NULL) {
+		CloseHandle(hWakeEvent);
+		hWakeEvent = NULL;
+
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Stops the worker thread, waiting for the model it's preparing to finish.
+ */
+void DetailLoader::Stop() {
+	if (hThread == NULL)
+		return;
+
+	EnterCriticalSection(&csRequest);
+	bStopping = true;
+	bPending = false;
+	LeaveCriticalSection(&csRequest);
+
+	SetEvent(hWakeEvent);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	CloseHandle(hWakeEvent);
+	hThread = NULL;
+	hWakeEvent = NULL;
+}
+
+/**
+ * Requests the model of a component, replacing any request that hasn't been
+ * picked up by the worker yet.
+ *
+ * @param  hComponent  Handle of the component in the workspace.
+ * @param  component   Component to be prepared. A copy of it is used.
+ * @param  dwRequested Tick count of when the user selected the component.
+ * @return             Generation of the request.
+ */
+unsigned long DetailLoader::Request(ComponentHandle hComponent,
+									Component *component,
+									DWORD dwRequested) {
+	unsigned long ulRequest;
+
+	EnterCriticalSection(&csRequest);
+	compPending = *component;
+	hPendingComponent = hComponent;
+	dwPendingTime = dwRequested;
+	ulRequest = ++ulGeneration;
+	bPending = true;
+	LeaveCriticalSection(&csRequest);
+
+	if (hWakeEvent != NULL)
+		SetEvent(hWakeEvent);
+
+	return ulRequest;
+}
+
+/**
+ * Drops the pending request and makes any model that's being prepared stale.
+ */
+void DetailLoader::Cancel() {
+	EnterCriticalSection(&csRequest);
+	ulGeneration++;
+	bPending = false;
+	LeaveCriticalSection(&csRequest);
+}
+
+/**
+ * Checks if a model belongs to the latest request.
+ *
+ * @param  ulGeneration Generation of the model.
+ * @return              TRUE if no other request was made since.
+ */
+bool DetailLoader::IsCurrent(unsigned long ulGeneration) {
+	bool bCurrent;
+
+	EnterCriticalSection(&csRequest);
+	bCurrent = this->ulGeneration == ulGeneration;
+	LeaveCriticalSection(&csRequest);
+
+	return bCurrent;
+}
+
+/**
+ * Frees a model that was posted with WM_DETAILREADY.
+ *
+ * @param model Model to be freed.
+ */
+void DetailLoader::FreeModel(DetailModel *model) {
+	delete model;
+}
+
+/**
+ * Records how long it took for the detail view to be ready.
+ *
+ * @param dwRequested Tick count of when the user selected the component.
+ */
+void DetailLoader::RecordLatency(DWORD dwRequested) {
+	DWORD dwElapsed = GetTickCount() - dwRequested;
+
+	latency.dwCount++;
+	latency.dwTotal += dwElapsed;
+	latency.dwLast = dwElapsed;
+	if (dwElapsed > latency.dwMax)
+		latency.dwMax = dwElapsed;
+}
+
+/**
+ * Gets the selection latency statistics.
+ *
+ * @return Latency statistics in milliseconds.
+ */
+DetailLatency DetailLoader::GetLatency() {
+	return latency;
+}
+
+/**
+ * Resets the selection latency statistics.
+ */
+void DetailLoader::ResetLatency() {
+	memset(&latency, 0, sizeof(DetailLatency));
+}
+
+/**
+ * Entry point of the worker thread.
+ *
+ * @param  lpParam Pointer to the DetailLoader object.
+ * @return         Always 0.
+ */
+DWORD WINAPI DetailLoader::WorkerThreadProc(LPVOID lpParam) {
+	((DetailLoader*)lpParam)->Run();
+	return 0;
+}
+
+/**
+ * Prepares the requested models until we are told to stop.
+ */
+void DetailLoader::Run() {
+	// Everything we read is on behalf of the selection.
+	IoAccounting::SetOperation(IO_OP_SELECT);
+
+	while (WaitForSingleObject(hWakeEvent, INFINITE) == WAIT_OBJECT_0) {
+		Component component;
+		DetailModel *model;
+
+		// Take the pending request.
+		EnterCriticalSection(&csRequest);
+		if (bStopping) {
+			LeaveCriticalSection(&csRequest);
+			return;
+		}
+		if (!bPending) {
+			LeaveCriticalSection(&csRequest);
+			continue;
+		}
+		component = compPending;
+		model = new DetailModel;
+		model->hComponent = hPendingComponent;
+		model->dwRequested = dwPendingTime;
+		model->ulGeneration = ulGeneration;
+		bPending = false;
+		LeaveCriticalSection(&csRequest);
+
+		// Build it and hand it over to the UI thread.
+		Prepare(&component, model);
+		if (!PostMessage(hwndNotify, WM_DETAILREADY, 0, (LPARAM)model))
+			FreeModel(model);
+	}
+}
+
+/**
+ * Builds the model of a component.
+ *
+ * @param component Component to be prepared.
+ * @param model     Model to be populated.
+ */
+void DetailLoader::Prepare(Component *component, DetailModel *model) {
+	Path pathNotes = component->GetDirectory().Concatenate(NOTES_FILE);
+
+	// Read the notes, if there are any.
+	if (pathNotes.Exists()) {
+		LPTSTR szNotes = component->GetNotes();
+
+		if (szNotes != NULL) {
+			model->swNotes = szNotes;
+			AllocProfiler::Free(szNotes);
+		}
+	}
+
+	// Build the captions of the properties.
+	vector<Property> *arrProperties = component->GetEditableProperties();
+	model->arrProperties.reserve(arrProperties->size());
+	for (size_t i = 0; i < arrProperties->size(); i++) {
+		LPTSTR szCaption = (*arrProperties)[i].ToHumanString();
+
+		model->arrProperties.push_back(wstring(szCaption));
+		AllocProfiler::Free(szCaption);
+	}
+}
@@ -0,0 +1,85 @@
+/**
+ * DetailLoader.h
+ * Prepares the contents of the detail view in a background thread.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _DETAIL_LOADER_H
+#define _DETAIL_LOADER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Component.h"
+#include "Workspace.h"
+
+using namespace std;
+
+// Message posted to the notification window with a DetailModel as lParam.
+#define WM_DETAILREADY (WM_APP + 2)
+
+// Everything the detail view needs that isn't already in memory.
+typedef struct {
+	ComponentHandle hComponent;
+	unsigned long ulGeneration;
+	DWORD dwRequested;
+	wstring swNotes;
+	vector<wstring> arrProperties;
+} DetailModel;
+
+// Time it took for the detail view to be ready after a selection.
+typedef struct {
+	DWORD dwCount;
+	DWORD dwTotal;
+	DWORD dwMax;
+	DWORD dwLast;
+} DetailLatency;
+
+class DetailLoader {
+protected:
+	HANDLE hThread;
+	HANDLE hWakeEvent;
+	CRITICAL_SECTION csRequest;
+	HWND hwndNotify;
+	Component compPending;
+	ComponentHandle hPendingComponent;
+	DWORD dwPendingTime;
+	unsigned long ulGeneration;
+	bool bPending;
+	bool bStopping;
+	DetailLatency latency;
+
+	// Worker.
+	static DWORD WINAPI WorkerThreadProc(LPVOID lpParam);
+	void Run();
+	static void Prepare(Component *component, DetailModel *model);
+
+private:
+	// Loaders own a thread, so they can't be copied.
+	DetailLoader(const DetailLoader &loader);
+	DetailLoader& operator=(const DetailLoader &loader);
+
+public:
+	// Constructors and destructors.
+	DetailLoader();
+	~DetailLoader();
+
+	// Worker.
+	bool Start(HWND hwndNotify);
+	void Stop();
+
+	// Requests.
+	unsigned long Request(ComponentHandle hComponent, Component *component,
+						  DWORD dwRequested);
+	void Cancel();
+	bool IsCurrent(unsigned long ulGeneration);
+	static void FreeModel(DetailModel *model);
+
+	// Latency.
+	void RecordLatency(DWORD dwRequested);
+	DetailLatency GetLatency();
+	void ResetLatency();
+};
+
+#endif  // _DETAIL_LOADER_H
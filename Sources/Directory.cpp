@@ -6,6 +6,7 @@
  */
 
 #include "Directory.h"
+#include "FileUtils.h"
 
 /**
  * Initializes a directory from a Path.
@@ -26,7 +27,7 @@ bool Directory::DeleteRecursively() {
 	WIN32_FIND_DATA fndData;
 
 	// Find the first file in the directory.
-	hFind = FindFirstFile(this->Concatenate(L"\\*").ToString(), &fndData);
+	hFind = FileUtils::FindFirst(this->Concatenate(L"\\*").ToString(), &fndData);
 
 	// Go through the files in the directory removing them.
 	while (hFind != INVALID_HANDLE_VALUE) {
@@ -35,7 +36,7 @@ bool Directory::DeleteRecursively() {
 			if (!Directory(this->Concatenate(fndData.cFileName)).DeleteRecursively())
 				return false;
 		} else {
-			if (!DeleteFile(this->Concatenate(fndData.cFileName).ToString()))
+			if (!FileUtils::Delete(this->Concatenate(fndData.cFileName).ToString()))
 				return false;
 		}
 
@@ -70,7 +71,7 @@ vector<Directory> Directory::GetSubDirectories() {
 	vector<Directory> arr;
 
 	// Find the first file in the directory.
-	hFind = FindFirstFile(this->Concatenate(L"\\*").ToString(), &fndData);
+	hFind = FileUtils::FindFirst(this->Concatenate(L"\\*").ToString(), &fndData);
 
 	// Read directory contents.
 	while (hFind != INVALID_HANDLE_VALUE) {
@@ -108,7 +109,7 @@ size_t Directory::GetSubDirectoriesCount() {
 	WIN32_FIND_DATA fndData;
 
 	// Find the first file in the directory.
-	hFind = FindFirstFile(this->Concatenate(L"\\*").ToString(), &fndData);
+	hFind = FileUtils::FindFirst(this->Concatenate(L"\\*").ToString(), &fndData);
 
 	// Read directory contents.
 	while (hFind != INVALID_HANDLE_VALUE) {
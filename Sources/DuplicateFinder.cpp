@@ -0,0 +1,459 @@
+/**
+ * DuplicateFinder.cpp
+ * Finds components that have been entered more than once in a workspace by
+ * comparing their normalized properties.
+ *
+ * Every component gets its properties normalized (key case and order,
+ * whitespace and engineering notation of numeric values) into a signature.
+ * Components with the same signature are exact duplicates. Similar
+ * components are found by MinHashing the normalized properties and only
+ * comparing the components that share a LSH band.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <algorithm>
+#include <map>
+#include "DuplicateFinder.h"
+#include "ParallelUtils.h"
+
+// FNV-1a constants.
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME        16777619UL
+
+// Largest LSH bucket that gets compared pair by pair.
+#define LSH_MAX_PAIRWISE 64
+
+/**
+ * Initializes the duplicate finder.
+ *
+ * @param arrComponents Components to look into. They aren't modified.
+ * @param dSimilarity   Minimum similarity (0 to 1) for two components to be
+ *                      considered near duplicates.
+ */
+DuplicateFinder::DuplicateFinder(vector<Component> *arrComponents,
+								 double dSimilarity) {
+	this->arrComponents = arrComponents;
+	this->dSimilarity = dSimilarity;
+}
+
+/**
+ * Finds the duplicate components.
+ *
+ * @return Groups of exact duplicates followed by groups of similar components.
+ */
+vector<DuplicateGroup> DuplicateFinder::Find() {
+	vector<DuplicateGroup> arrGroups;
+
+	// Build the signatures in parallel.
+	arrSignatures.clear();
+	arrSignatures.resize(arrComponents->size());
+	ParallelUtils::ForEach(arrComponents->size(), BuildSignatureProc, this);
+
+	// Group them.
+	FindExact(&arrGroups);
+	FindSimilar(&arrGroups);
+
+	return arrGroups;
+}
+
+/**
+ * Parallel worker that builds the signature of a single component.
+ *
+ * @param nIndex  Component index.
+ * @param lpParam Pointer to the DuplicateFinder object.
+ */
+void DuplicateFinder::BuildSignatureProc(size_t nIndex, LPVOID lpParam) {
+	((DuplicateFinder*)lpParam)->BuildSignature(nIndex);
+}
+
+/**
+ * Builds the normalized signature of a component.
+ *
+ * @param nIndex Component index.
+ */
+void DuplicateFinder::BuildSignature(size_t nIndex) {
+	ComponentSignature *signature = &arrSignatures[nIndex];
+	vector<Property> *arrProperties = (*arrComponents)[nIndex].GetEditableProperties();
+	vector<wstring> arrPairs;
+	size_t i;
+
+	// Normalize every property into a "key=value" pair.
+	for (i = 0; i < arrProperties->size(); i++) {
+		wstring swPair = NormalizeKey((*arrProperties)[i].GetName());
+		swPair += L'=';
+		swPair += NormalizeValue((*arrProperties)[i].GetValue());
+
+		arrPairs.push_back(swPair);
+	}
+
+	// Make the property order irrelevant.
+	sort(arrPairs.begin(), arrPairs.end());
+	arrPairs.erase(unique(arrPairs.begin(), arrPairs.end()), arrPairs.end());
+
+	// Build the signature and the tokens used for similarity.
+	signature->swNormalized.erase();
+	signature->arrTokens.clear();
+	for (i = 0; i < arrPairs.size(); i++) {
+		signature->swNormalized += arrPairs[i];
+		signature->swNormalized += L'\n';
+		signature->arrTokens.push_back(Hash(arrPairs[i], 0));
+	}
+	sort(signature->arrTokens.begin(), signature->arrTokens.end());
+
+	signature->dwHash = Hash(signature->swNormalized, 0);
+	BuildMinHash(signature);
+}
+
+/**
+ * Builds the MinHash of the tokens of a signature.
+ *
+ * @param signature Signature with its tokens already populated.
+ */
+void DuplicateFinder::BuildMinHash(ComponentSignature *signature) {
+	for (size_t i = 0; i < MINHASH_COUNT; i++) {
+		DWORD dwMin = 0xFFFFFFFF;
+
+		for (size_t j = 0; j < signature->arrTokens.size(); j++) {
+			// Cheap integer mixing of the token with a per-function seed.
+			DWORD h = signature->arrTokens[j] ^ ((i + 1) * 0x9E3779B1UL);
+			h ^= h >> 16;
+			h *= 0x85EBCA6BUL;
+			h ^= h >> 13;
+			h *= 0xC2B2AE35UL;
+			h ^= h >> 16;
+
+			if (h < dwMin)
+				dwMin = h;
+		}
+
+		signature->adwMinHash[i] = dwMin;
+	}
+}
+
+/**
+ * Groups the components that have exactly the same normalized properties.
+ *
+ * @param arrGroups Array where the groups will be appended to.
+ */
+void DuplicateFinder::FindExact(vector<DuplicateGroup> *arrGroups) {
+	map<DWORD, vector<size_t> > mapBuckets;
+	map<DWORD, vector<size_t> >::iterator it;
+	size_t i, j;
+
+	// Every component starts in its own group.
+	arrExactGroup.resize(arrSignatures.size());
+	for (i = 0; i < arrSignatures.size(); i++)
+		arrExactGroup[i] = i;
+
+	// Bucket the components by their hash in a single pass.
+	for (i = 0; i < arrSignatures.size(); i++) {
+		if (arrSignatures[i].arrTokens.size() > 0)
+			mapBuckets[arrSignatures[i].dwHash].push_back(i);
+	}
+
+	// Go through the buckets separating hash collisions from duplicates.
+	for (it = mapBuckets.begin(); it != mapBuckets.end(); it++) {
+		vector<size_t> *arrBucket = &it->second;
+		if (arrBucket->size() < 2)
+			continue;
+
+		for (i = 0; i < arrBucket->size(); i++) {
+			size_t nFirst = (*arrBucket)[i];
+			DuplicateGroup group;
+
+			// Already part of a group.
+			if (arrExactGroup[nFirst] != nFirst)
+				continue;
+
+			group.bExact = true;
+			group.arrIndexes.push_back(nFirst);
+			for (j = i + 1; j < arrBucket->size(); j++) {
+				size_t nSecond = (*arrBucket)[j];
+
+				if (arrSignatures[nFirst].swNormalized.compare(
+						arrSignatures[nSecond].swNormalized) == 0) {
+					arrExactGroup[nSecond] = nFirst;
+					group.arrIndexes.push_back(nSecond);
+				}
+			}
+
+			if (group.arrIndexes.size() > 1)
+				arrGroups->push_back(group);
+		}
+	}
+}
+
+/**
+ * Groups the components that are similar but not exactly the same.
+ *
+ * @param arrGroups Array where the groups will be appended to.
+ */
+void DuplicateFinder::FindSimilar(vector<DuplicateGroup> *arrGroups) {
+	map<DWORD, vector<size_t> > mapBuckets;
+	map<DWORD, vector<size_t> >::iterator it;
+	map<size_t, vector<size_t> > mapSets;
+	map<size_t, vector<size_t> >::iterator itSet;
+	vector<size_t> arrParents(arrSignatures.size());
+	size_t i, j;
+
+	// Exact duplicates are already grouped together.
+	for (i = 0; i < arrSignatures.size(); i++)
+		arrParents[i] = arrExactGroup[i];
+
+	// Bucket the group representatives by each of their LSH bands.
+	for (i = 0; i < arrSignatures.size(); i++) {
+		if ((arrExactGroup[i] != i) || (arrSignatures[i].arrTokens.size() == 0))
+			continue;
+
+		for (size_t b = 0; b < LSH_BANDS; b++) {
+			DWORD dwKey = FNV_OFFSET_BASIS ^ (DWORD)b;
+
+			for (size_t r = 0; r < LSH_ROWS; r++) {
+				dwKey ^= arrSignatures[i].adwMinHash[(b * LSH_ROWS) + r];
+				dwKey *= FNV_PRIME;
+			}
+
+			mapBuckets[dwKey].push_back(i);
+		}
+	}
+
+	// Compare the candidates that share a bucket.
+	for (it = mapBuckets.begin(); it != mapBuckets.end(); it++) {
+		vector<size_t> *arrBucket = &it->second;
+		if (arrBucket->size() < 2)
+			continue;
+
+		for (i = 0; i < arrBucket->size(); i++) {
+			// Huge buckets are only compared against their first member.
+			size_t nEnd = arrBucket->size();
+			if ((nEnd > LSH_MAX_PAIRWISE) && (i > 0))
+				break;
+
+			for (j = i + 1; j < nEnd; j++) {
+				size_t nFirst = FindRoot(&arrParents, (*arrBucket)[i]);
+				size_t nSecond = FindRoot(&arrParents, (*arrBucket)[j]);
+
+				if (nFirst == nSecond)
+					continue;
+				if (Jaccard((*arrBucket)[i], (*arrBucket)[j]) >= dSimilarity)
+					arrParents[nSecond] = nFirst;
+			}
+		}
+	}
+
+	// Gather the sets of similar representatives.
+	for (i = 0; i < arrSignatures.size(); i++) {
+		if ((arrExactGroup[i] == i) && (arrSignatures[i].arrTokens.size() > 0))
+			mapSets[FindRoot(&arrParents, i)].push_back(i);
+	}
+
+	// Report the sets with more than one distinct component.
+	for (itSet = mapSets.begin(); itSet != mapSets.end(); itSet++) {
+		DuplicateGroup group;
+
+		if (itSet->second.size() < 2)
+			continue;
+
+		group.bExact = false;
+		group.arrIndexes = itSet->second;
+		arrGroups->push_back(group);
+	}
+}
+
+/**
+ * Calculates the Jaccard similarity between the tokens of two components.
+ *
+ * @param  nFirst  First component index.
+ * @param  nSecond Second component index.
+ * @return         Similarity between 0 and 1.
+ */
+double DuplicateFinder::Jaccard(size_t nFirst, size_t nSecond) {
+	vector<DWORD> *arrFirst = &arrSignatures[nFirst].arrTokens;
+	vector<DWORD> *arrSecond = &arrSignatures[nSecond].arrTokens;
+	size_t i = 0;
+	size_t j = 0;
+	size_t nCommon = 0;
+
+	// Both token arrays are sorted, so just merge them.
+	while ((i < arrFirst->size()) && (j < arrSecond->size())) {
+		if ((*arrFirst)[i] == (*arrSecond)[j]) {
+			nCommon++;
+			i++;
+			j++;
+		} else if ((*arrFirst)[i] < (*arrSecond)[j]) {
+			i++;
+		} else {
+			j++;
+		}
+	}
+
+	return (double)nCommon / (double)(arrFirst->size() + arrSecond->size() - nCommon);
+}
+
+/**
+ * Finds the root of a set while compressing the path to it.
+ *
+ * @param  arrParents Parent of each element.
+ * @param  nIndex     Element to find the root of.
+ * @return            Root element of the set.
+ */
+size_t DuplicateFinder::FindRoot(vector<size_t> *arrParents, size_t nIndex) {
+	size_t nRoot = nIndex;
+
+	while ((*arrParents)[nRoot] != nRoot)
+		nRoot = (*arrParents)[nRoot];
+
+	while ((*arrParents)[nIndex] != nRoot) {
+		size_t nNext = (*arrParents)[nIndex];
+		(*arrParents)[nIndex] = nRoot;
+		nIndex = nNext;
+	}
+
+	return nRoot;
+}
+
+/**
+ * Normalizes a property key so that differences in case and separators are
+ * ignored.
+ *
+ * @param  szKey Property key.
+ * @return       Normalized key.
+ */
+wstring DuplicateFinder::NormalizeKey(LPCTSTR szKey) {
+	wstring swKey;
+
+	for (; *szKey != L'\0'; szKey++) {
+		if ((*szKey == L' ') || (*szKey == L'\t') || (*szKey == L'_')) {
+			swKey += L'-';
+		} else {
+			swKey += (WCHAR)towlower(*szKey);
+		}
+	}
+
+	return swKey;
+}
+
+/**
+ * Normalizes a property value. Whitespace is collapsed, case is ignored and
+ * numbers in engineering notation (10k, 4k7, 100 nF, 0.1uF) are converted to
+ * a canonical representation.
+ *
+ * @param  szValue Property value.
+ * @return         Normalized value.
+ */
+wstring DuplicateFinder::NormalizeValue(LPCTSTR szValue) {
+	wstring swValue;
+	bool bSpace = false;
+	size_t i;
+
+	// Collapse the whitespace and trim.
+	for (; *szValue != L'\0'; szValue++) {
+		if ((*szValue == L' ') || (*szValue == L'\t')) {
+			bSpace = swValue.length() > 0;
+			continue;
+		}
+
+		if (bSpace)
+			swValue += L' ';
+		swValue += *szValue;
+		bSpace = false;
+	}
+
+	// Try to parse it as a number with an optional prefix and unit.
+	double dNumber = 0;
+	double dFraction = 0;
+	double dScale = 1;
+	double dMultiplier = 1;
+	bool bNumeric = false;
+	wstring swUnit;
+
+	for (i = 0; (i < swValue.length()) && iswdigit(swValue[i]); i++) {
+		dNumber = (dNumber * 10) + (swValue[i] - L'0');
+		bNumeric = true;
+	}
+
+	if (bNumeric) {
+		// Decimal point.
+		if ((i < swValue.length()) && (swValue[i] == L'.')) {
+			for (i++; (i < swValue.length()) && iswdigit(swValue[i]); i++) {
+				dScale /= 10;
+				dFraction += (swValue[i] - L'0') * dScale;
+			}
+		}
+		if ((i < swValue.length()) && (swValue[i] == L' '))
+			i++;
+
+		// Engineering prefix.
+		if (i < swValue.length()) {
+			switch (swValue[i]) {
+			case L'p': dMultiplier = 1e-12; break;
+			case L'n': dMultiplier = 1e-9; break;
+			case L'u':
+			case 0x00B5: dMultiplier = 1e-6; break;
+			case L'm': dMultiplier = 1e-3; break;
+			case L'k':
+			case L'K': dMultiplier = 1e3; break;
+			case L'M': dMultiplier = 1e6; break;
+			case L'G': dMultiplier = 1e9; break;
+			}
+
+			if (dMultiplier != 1) {
+				i++;
+
+				// Prefix used as a decimal point (4k7).
+				if ((dScale == 1) && (i < swValue.length()) &&
+						iswdigit(swValue[i])) {
+					for (; (i < swValue.length()) && iswdigit(swValue[i]); i++) {
+						dScale /= 10;
+						dFraction += (swValue[i] - L'0') * dScale;
+					}
+				}
+			}
+		}
+
+		// Whatever is left must be a unit.
+		for (; i < swValue.length(); i++) {
+			if (!iswalpha(swValue[i]) && (swValue[i] != 0x03A9)) {
+				bNumeric = false;
+				break;
+			}
+
+			swUnit += (WCHAR)towlower(swValue[i]);
+		}
+	}
+
+	// Not a number, so just ignore the case.
+	if (!bNumeric) {
+		for (i = 0; i < swValue.length(); i++)
+			swValue[i] = towlower(swValue[i]);
+
+		return swValue;
+	}
+
+	// Build the canonical representation of the number.
+	WCHAR szNumber[64];
+	swprintf(szNumber, L"%g", (dNumber + dFraction) * dMultiplier);
+	swValue = szNumber;
+	swValue += swUnit;
+
+	return swValue;
+}
+
+/**
+ * Calculates the FNV-1a hash of a string.
+ *
+ * @param  swString String to be hashed.
+ * @param  dwSeed   Value mixed into the initial state of the hash.
+ * @return          Hash of the string.
+ */
+DWORD DuplicateFinder::Hash(const wstring &swString, DWORD dwSeed) {
+	DWORD dwHash = FNV_OFFSET_BASIS ^ dwSeed;
+
+	for (size_t i = 0; i < swString.length(); i++) {
+		dwHash ^= (DWORD)swString[i];
+		dwHash *= FNV_PRIME;
+	}
+
+	return dwHash;
+}
@@ -0,0 +1,69 @@
+/**
+ * DuplicateFinder.h
+ * Finds components that have been entered more than once in a workspace by
+ * comparing their normalized properties.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _DUPLICATE_FINDER_H
+#define _DUPLICATE_FINDER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Component.h"
+
+using namespace std;
+
+// MinHash and LSH parameters.
+#define MINHASH_COUNT  16
+#define LSH_BANDS      4
+#define LSH_ROWS       (MINHASH_COUNT / LSH_BANDS)
+
+// A group of components that look like the same part.
+typedef struct {
+	bool bExact;
+	vector<size_t> arrIndexes;
+} DuplicateGroup;
+
+class DuplicateFinder {
+protected:
+	// Normalized representation of a component.
+	typedef struct {
+		wstring swNormalized;
+		DWORD dwHash;
+		vector<DWORD> arrTokens;
+		DWORD adwMinHash[MINHASH_COUNT];
+	} ComponentSignature;
+
+	vector<Component> *arrComponents;
+	vector<ComponentSignature> arrSignatures;
+	vector<size_t> arrExactGroup;
+	double dSimilarity;
+
+	// Signatures.
+	static void BuildSignatureProc(size_t nIndex, LPVOID lpParam);
+	void BuildSignature(size_t nIndex);
+	void BuildMinHash(ComponentSignature *signature);
+
+	// Grouping.
+	void FindExact(vector<DuplicateGroup> *arrGroups);
+	void FindSimilar(vector<DuplicateGroup> *arrGroups);
+	double Jaccard(size_t nFirst, size_t nSecond);
+	static size_t FindRoot(vector<size_t> *arrParents, size_t nIndex);
+
+public:
+	// Constructors and destructors.
+	DuplicateFinder(vector<Component> *arrComponents, double dSimilarity);
+
+	// Operations.
+	vector<DuplicateGroup> Find();
+
+	// Normalization.
+	static wstring NormalizeKey(LPCTSTR szKey);
+	static wstring NormalizeValue(LPCTSTR szValue);
+	static DWORD Hash(const wstring &swString, DWORD dwSeed);
+};
+
+#endif  // _DUPLICATE_FINDER_H
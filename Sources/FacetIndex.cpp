@@ -0,0 +1,350 @@
+/**
+ * FacetIndex.cpp
+ * Keeps running part and stock counts for each category, sub-category and
+ * package in a workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "FacetIndex.h"
+
+/**
+ * Initializes an empty facet index.
+ */
+FacetIndex::FacetIndex() {
+	ComponentsCleared();
+}
+
+/**
+ * Adds a component's contribution to the facets.
+ *
+ * @param component Component that was added to the workspace.
+ */
+void FacetIndex::ComponentAdded(Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+
+	// Make sure we never count the same component twice.
+	if (mapEntries.find(swKey) != mapEntries.end()) {
+		ComponentChanged(component);
+		return;
+	}
+
+	FacetEntry entry = BuildEntry(component);
+	Apply(entry, true);
+	mapEntries[swKey] = entry;
+}
+
+/**
+ * Replaces the previous contribution of a component with its current state.
+ *
+ * @param component Component that was changed.
+ */
+void FacetIndex::ComponentChanged(Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+	map<wstring, FacetEntry>::iterator it = mapEntries.find(swKey);
+
+	// Remove the old contribution if we had one.
+	if (it != mapEntries.end())
+		Apply(it->second, false);
+
+	// Add the new one.
+	FacetEntry entry = BuildEntry(component);
+	Apply(entry, true);
+	mapEntries[swKey] = entry;
+}
+
+/**
+ * Removes a component's contribution from the facets.
+ *
+ * @param component Component that is being removed from the workspace.
+ */
+void FacetIndex::ComponentRemoved(Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+	map<wstring, FacetEntry>::iterator it = mapEntries.find(swKey);
+
+	if (it == mapEntries.end())
+		return;
+
+	Apply(it->second, false);
+	mapEntries.erase(it);
+}
+
+/**
+ * Moves a component's contribution over to its new folder.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void FacetIndex::ComponentRenamed(Component *component, Directory dirOld) {
+	map<wstring, FacetEntry>::iterator it;
+
+	it = mapEntries.find(wstring(dirOld.ToString()));
+	if (it != mapEntries.end()) {
+		Apply(it->second, false);
+		mapEntries.erase(it);
+	}
+
+	ComponentAdded(component);
+}
+
+/**
+ * Clears all the facets.
+ */
+void FacetIndex::ComponentsCleared() {
+	mapEntries.clear();
+	mapCategories.clear();
+	mapSubCategories.clear();
+	mapPackages.clear();
+
+	fcTotal.nParts = 0;
+	fcTotal.nStock = 0;
+}
+
+/**
+ * Takes a snapshot of the parts of a component that are relevant to us.
+ *
+ * @param  component Component to take the snapshot of.
+ * @return           Facet entry for the component.
+ */
+FacetIndex::FacetEntry FacetIndex::BuildEntry(Component *component) {
+	FacetEntry entry;
+	LPCTSTR szCategory = component->GetCategory();
+	LPCTSTR szSubCategory = component->GetSubCategory();
+	LPCTSTR szPackage = component->GetPackage();
+
+	// Uncategorized components are grouped under an empty category.
+	if (szCategory != NULL)
+		entry.swCategory = szCategory;
+
+	// Sub-categories only make sense inside a category.
+	entry.bHasSubCategory = (szCategory != NULL) && (szSubCategory != NULL);
+	if (entry.bHasSubCategory)
+		entry.swSubCategory = SubCategoryKey(szCategory, szSubCategory);
+
+	entry.bHasPackage = szPackage != NULL;
+	if (entry.bHasPackage)
+		entry.swPackage = szPackage;
+
+	entry.nQuantity = component->GetQuantity();
+	return entry;
+}
+
+/**
+ * Adds or subtracts a component contribution from all the facets.
+ *
+ * @param entry   Component contribution.
+ * @param bAdding Are we adding the contribution?
+ */
+void FacetIndex::Apply(FacetEntry entry, bool bAdding) {
+	Accumulate(&mapCategories, entry.swCategory, entry.nQuantity, bAdding);
+
+	if (entry.bHasSubCategory) {
+		Accumulate(&mapSubCategories, entry.swSubCategory, entry.nQuantity,
+			bAdding);
+	}
+
+	if (entry.bHasPackage)
+		Accumulate(&mapPackages, entry.swPackage, entry.nQuantity, bAdding);
+
+	// Update the totals.
+	if (bAdding) {
+		fcTotal.nParts++;
+		fcTotal.nStock += entry.nQuantity;
+	} else {
+		fcTotal.nParts--;
+		fcTotal.nStock -= entry.nQuantity;
+	}
+}
+
+/**
+ * Adds or subtracts a component from a single facet, removing the facet if it
+ * gets empty.
+ *
+ * @param mapFacets Facet map to be updated.
+ * @param swKey     Facet key.
+ * @param nQuantity Component quantity.
+ * @param bAdding   Are we adding the component?
+ */
+void FacetIndex::Accumulate(map<wstring, FacetCount> *mapFacets, wstring swKey,
+							size_t nQuantity, bool bAdding) {
+	map<wstring, FacetCount>::iterator it = mapFacets->find(swKey);
+
+	if (bAdding) {
+		if (it == mapFacets->end()) {
+			FacetCount count;
+			count.nParts = 1;
+			count.nStock = nQuantity;
+
+			(*mapFacets)[swKey] = count;
+			return;
+		}
+
+		it->second.nParts++;
+		it->second.nStock += nQuantity;
+		return;
+	}
+
+	// Nothing to subtract from.
+	if (it == mapFacets->end())
+		return;
+
+	// Get rid of empty facets so that they don't show up in listings.
+	if (it->second.nParts <= 1) {
+		mapFacets->erase(it);
+		return;
+	}
+
+	it->second.nParts--;
+	it->second.nStock -= nQuantity;
+}
+
+/**
+ * Looks up a facet count.
+ *
+ * @param  mapFacets Facet map to look into.
+ * @param  swKey     Facet key.
+ * @return           Facet count or zeros if the facet doesn't exist.
+ */
+FacetCount FacetIndex::Lookup(map<wstring, FacetCount> *mapFacets, wstring swKey) {
+	map<wstring, FacetCount>::iterator it = mapFacets->find(swKey);
+
+	if (it == mapFacets->end()) {
+		FacetCount count;
+		count.nParts = 0;
+		count.nStock = 0;
+
+		return count;
+	}
+
+	return it->second;
+}
+
+/**
+ * Builds the key used to identify a sub-category.
+ *
+ * @param  szCategory    Category name.
+ * @param  szSubCategory Sub-category name.
+ * @return               Sub-category key.
+ */
+wstring FacetIndex::SubCategoryKey(LPCTSTR szCategory, LPCTSTR szSubCategory) {
+	wstring swKey(szCategory);
+
+	swKey += L'\\';
+	swKey += szSubCategory;
+
+	return swKey;
+}
+
+/**
+ * Gets the totals for the whole workspace.
+ *
+ * @return Number of parts and stock in the workspace.
+ */
+FacetCount FacetIndex::GetTotal() {
+	return fcTotal;
+}
+
+/**
+ * Gets the totals for a category.
+ *
+ * @param  szCategory Category name or NULL for the uncategorized components.
+ * @return            Number of parts and stock in the category.
+ */
+FacetCount FacetIndex::GetCategory(LPCTSTR szCategory) {
+	if (szCategory == NULL)
+		return Lookup(&mapCategories, wstring());
+
+	return Lookup(&mapCategories, wstring(szCategory));
+}
+
+/**
+ * Gets the totals for a sub-category.
+ *
+ * @param  szCategory    Category name.
+ * @param  szSubCategory Sub-category name.
+ * @return               Number of parts and stock in the sub-category.
+ */
+FacetCount FacetIndex::GetSubCategory(LPCTSTR szCategory, LPCTSTR szSubCategory) {
+	return Lookup(&mapSubCategories, SubCategoryKey(szCategory, szSubCategory));
+}
+
+/**
+ * Gets the totals for a package.
+ *
+ * @param  szPackage Package name.
+ * @return           Number of parts and stock using this package.
+ */
+FacetCount FacetIndex::GetPackage(LPCTSTR szPackage) {
+	return Lookup(&mapPackages, wstring(szPackage));
+}
+
+/**
+ * Gets the names of all the categories that currently have components.
+ * @remark Uncategorized components are listed as an empty string.
+ *
+ * @return Array of category names.
+ */
+vector<wstring> FacetIndex::GetCategories() {
+	vector<wstring> arrNames;
+	map<wstring, FacetCount>::iterator it;
+
+	for (it = mapCategories.begin(); it != mapCategories.end(); it++)
+		arrNames.push_back(it->first);
+
+	return arrNames;
+}
+
+/**
+ * Gets the names of all the packages that are currently in use.
+ *
+ * @return Array of package names.
+ */
+vector<wstring> FacetIndex::GetPackages() {
+	vector<wstring> arrNames;
+	map<wstring, FacetCount>::iterator it;
+
+	for (it = mapPackages.begin(); it != mapPackages.end(); it++)
+		arrNames.push_back(it->first);
+
+	return arrNames;
+}
+
+/**
+ * Accounts for the memory used by the index, including the object itself.
+ * The category and sub-category totals are what the category tree is built
+ * from, so they are attributed to the categories.
+ *
+ * @param report Report to add the memory to.
+ */
+void FacetIndex::AccountMemory(MemoryReport *report) {
+	map<wstring, FacetEntry>::iterator itEntry;
+	map<wstring, FacetCount>::iterator itCount;
+
+	report->Add(MEMORY_INDEXES, sizeof(FacetIndex));
+
+	// What each component contributed.
+	report->AddMapNodes(MEMORY_INDEXES, mapEntries.size(),
+		sizeof(wstring) + sizeof(FacetEntry));
+	for (itEntry = mapEntries.begin(); itEntry != mapEntries.end(); itEntry++) {
+		report->AddString(MEMORY_INDEXES, itEntry->first);
+		report->AddString(MEMORY_INDEXES, itEntry->second.swCategory);
+		report->AddString(MEMORY_INDEXES, itEntry->second.swSubCategory);
+		report->AddString(MEMORY_INDEXES, itEntry->second.swPackage);
+	}
+
+	// Totals.
+	report->AddMapNodes(MEMORY_CATEGORIES, mapCategories.size() +
+		mapSubCategories.size(), sizeof(wstring) + sizeof(FacetCount));
+	for (itCount = mapCategories.begin(); itCount != mapCategories.end();
+			itCount++) {
+		report->AddString(MEMORY_CATEGORIES, itCount->first);
+	}
+	for (itCount = mapSubCategories.begin(); itCount != mapSubCategories.end();
+			itCount++) {
+		report->AddString(MEMORY_CATEGORIES, itCount->first);
+	}
+	report->AddMapNodes(MEMORY_INDEXES, mapPackages.size(),
+		sizeof(wstring) + sizeof(FacetCount));
+	for (itCount = mapPackages.begin(); itCount != mapPackages.end(); itCount++)
+		report->AddString(MEMORY_INDEXES, itCount->first);
+}
@@ -0,0 +1,77 @@
+/**
+ * FacetIndex.h
+ * Keeps running part and stock counts for each category, sub-category and
+ * package in a workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _FACET_INDEX_H
+#define _FACET_INDEX_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Component.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Aggregated counts of a single facet.
+typedef struct {
+	size_t nParts;
+	size_t nStock;
+} FacetCount;
+
+class FacetIndex : public WorkspaceListener {
+protected:
+	// What a single component contributed to the facets.
+	typedef struct {
+		wstring swCategory;
+		wstring swSubCategory;
+		wstring swPackage;
+		bool bHasSubCategory;
+		bool bHasPackage;
+		size_t nQuantity;
+	} FacetEntry;
+
+	map<wstring, FacetEntry> mapEntries;
+	map<wstring, FacetCount> mapCategories;
+	map<wstring, FacetCount> mapSubCategories;
+	map<wstring, FacetCount> mapPackages;
+	FacetCount fcTotal;
+
+	// Aggregation.
+	FacetEntry BuildEntry(Component *component);
+	void Apply(FacetEntry entry, bool bAdding);
+	static void Accumulate(map<wstring, FacetCount> *mapFacets, wstring swKey,
+						   size_t nQuantity, bool bAdding);
+	static FacetCount Lookup(map<wstring, FacetCount> *mapFacets, wstring swKey);
+	static wstring SubCategoryKey(LPCTSTR szCategory, LPCTSTR szSubCategory);
+
+public:
+	// Constructors and destructors.
+	FacetIndex();
+
+	// Workspace events.
+	void ComponentAdded(Component *component);
+	void ComponentChanged(Component *component);
+	void ComponentRemoved(Component *component);
+	void ComponentRenamed(Component *component, Directory dirOld);
+	void ComponentsCleared();
+
+	// Queries.
+	FacetCount GetTotal();
+	FacetCount GetCategory(LPCTSTR szCategory);
+	FacetCount GetSubCategory(LPCTSTR szCategory, LPCTSTR szSubCategory);
+	FacetCount GetPackage(LPCTSTR szPackage);
+	vector<wstring> GetCategories();
+	vector<wstring> GetPackages();
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _FACET_INDEX_H
@@ -0,0 +1,114 @@
+/**
+ * FileLock.cpp
+ * Advisory lock based on holding a lock file open without sharing it.
+ *
+ * Since the lock file is opened without any sharing, the operating system
+ * (or the file server) takes care of keeping everyone else out and of letting
+ * go of the lock if the process that held it dies. The file is deleted when
+ * the lock is released so it doesn't linger in the component folders, unless
+ * someone else already grabbed it, in which case they'll delete it instead.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "FileLock.h"
+#include "FileUtils.h"
+
+// Number of times anyone had to wait for a lock.
+LONG FileLock::lContended = 0;
+
+/**
+ * Initializes a lock that isn't held yet.
+ *
+ * @param pathLock Path to the lock file.
+ */
+FileLock::FileLock(Path pathLock) {
+	this->pathLock = pathLock;
+	hLock = INVALID_HANDLE_VALUE;
+}
+
+/**
+ * Releases the lock if it's still held.
+ */
+FileLock::~FileLock() {
+	Release();
+}
+
+/**
+ * Tries to get the lock, waiting for someone else to release it if needed.
+ * @remark Gives up straight away if the lock file can't be opened for any
+ *         other reason, like a folder that doesn't exist or is read-only.
+ *
+ * @param  dwTimeout Maximum time to wait in milliseconds.
+ * @return           TRUE if the lock was acquired.
+ */
+bool FileLock::Acquire(DWORD dwTimeout) {
+	DWORD dwStart = GetTickCount();
+	bool bWaited = false;
+
+	if (IsHeld())
+		return true;
+
+	for (;;) {
+		hLock = FileUtils::Open(pathLock.ToString(),
+			GENERIC_READ | GENERIC_WRITE, 0, OPEN_ALWAYS);
+		if (hLock != INVALID_HANDLE_VALUE)
+			return true;
+
+		// Waiting won't fix anything but someone else holding it.
+		if (GetLastError() != ERROR_SHARING_VIOLATION)
+			return false;
+
+		// Someone else is holding it.
+		if (!bWaited) {
+			InterlockedIncrement(&lContended);
+			bWaited = true;
+		}
+
+		// Give up if we waited for too long.
+		if ((GetTickCount() - dwStart) >= dwTimeout)
+			return false;
+
+		Sleep(LOCK_RETRY_INTERVAL);
+	}
+}
+
+/**
+ * Releases the lock and deletes the lock file.
+ */
+void FileLock::Release() {
+	if (!IsHeld())
+		return;
+
+	CloseHandle(hLock);
+	hLock = INVALID_HANDLE_VALUE;
+
+	// Fails harmlessly if someone else is already holding it.
+	FileUtils::Delete(pathLock.ToString());
+}
+
+/**
+ * Checks if we are holding the lock.
+ *
+ * @return TRUE if the lock is held by us.
+ */
+bool FileLock::IsHeld() {
+	return hLock != INVALID_HANDLE_VALUE;
+}
+
+/**
+ * Gets the number of times anyone had to wait for a lock since the counter
+ * was last reset.
+ *
+ * @return Number of contended acquisitions.
+ */
+LONG FileLock::GetContended() {
+	return lContended;
+}
+
+/**
+ * Resets the contended acquisitions counter.
+ */
+void FileLock::ResetContended() {
+	InterlockedExchange(&lContended, 0);
+}
@@ -0,0 +1,45 @@
+/**
+ * FileLock.h
+ * Advisory lock based on holding a lock file open without sharing it.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _FILE_LOCK_H
+#define _FILE_LOCK_H
+
+#include <windows.h>
+#include "Path.h"
+
+// Time to wait between attempts to get the lock.
+#define LOCK_RETRY_INTERVAL 25
+
+class FileLock {
+protected:
+	Path pathLock;
+	HANDLE hLock;
+
+	// Number of times anyone had to wait for a lock.
+	static LONG lContended;
+
+private:
+	// Locks can't be copied.
+	FileLock(const FileLock &lock);
+	FileLock& operator=(const FileLock &lock);
+
+public:
+	// Constructors and destructors.
+	FileLock(Path pathLock);
+	~FileLock();
+
+	// Locking.
+	bool Acquire(DWORD dwTimeout);
+	void Release();
+	bool IsHeld();
+
+	// Statistics.
+	static LONG GetContended();
+	static void ResetContended();
+};
+
+#endif  // _FILE_LOCK_H
@@ -7,11 +7,17 @@
 
 #include "FileUtils.h"
 #include "StringUtils.h"
+#include "Tracer.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
 
 // Character definitions.
 #define CR '\r'
 #define LF '\n'
 
+// Size of the buffer used to hash and compare files.
+#define HASH_BUFFER_SIZE 4096
+
 /**
  * Reads a line from a file and returns it wituout the newline character.
  * @remark This function will increment the file hanfle cursor.
@@ -21,15 +27,61 @@
  * @return        TRUE if we read a line or FALSE if we reached the EOF.
  */
 bool FileUtils::ReadLine(HANDLE hFile, wstring *swLine) {
+	string sLine;
+
+	// Start fresh.
+	swLine->clear();
+	if (!ReadBytesLine(hFile, &sLine))
+		return false;
+
+	// Every byte is a character.
+	for (size_t i = 0; i < sLine.length(); i++)
+		swLine->push_back((WCHAR)(unsigned char)sLine[i]);
+
+	return true;
+}
+
+/**
+ * Reads a UTF-8 encoded line from a file and returns it without the newline
+ * character.
+ * @remark This function will increment the file handle cursor.
+ *
+ * @param  hFile  File handle.
+ * @param  swLine Pointer to the string that will receive the read line.
+ * @return        TRUE if we read a line or FALSE if we reached the EOF.
+ */
+bool FileUtils::ReadUtf8Line(HANDLE hFile, wstring *swLine) {
+	string sLine;
+
+	// Start fresh.
+	swLine->clear();
+	if (!ReadBytesLine(hFile, &sLine))
+		return false;
+
+	// Lines that aren't valid UTF-8 are still lines.
+	StringUtils::Utf8ToUnicode(swLine, sLine);
+	return true;
+}
+
+/**
+ * Reads the bytes of a line from a file without the newline character.
+ * @remark This function will increment the file handle cursor.
+ *
+ * @param  hFile Handle of the file.
+ * @param  sLine Pointer to the string that will receive the bytes.
+ * @return       TRUE if we read a line or FALSE if we reached the EOF.
+ */
+bool FileUtils::ReadBytesLine(HANDLE hFile, string *sLine) {
 	DWORD nBytesRead;
 	BOOL bResult;
 	char c;
 
 	// Start fresh.
-	swLine->clear();
+	sLine->erase();
 
 	// Go through the file looking for a newline character.
 	bResult = ReadFile(hFile, &c, 1, &nBytesRead, NULL);
+	IoAccounting::CountRead(nBytesRead);
 	while (bResult && (nBytesRead != 0)) {
 		// Found a newline character.
 		if (c == LF)
@@ -37,14 +89,15 @@ bool FileUtils::ReadLine(HANDLE hFile, wstring *swLine) {
 
 		// Append character to the string.
 		if (c != CR)
-			swLine->push_back(c);
+			sLine->push_back(c);
 
 		// Read the next character.
 		bResult = ReadFile(hFile, &c, 1, &nBytesRead, NULL);
+		IoAccounting::CountRead(nBytesRead);
 	}
 
 	// Check if we have a file without a terminating newline.
-	if (swLine->length() > 0)
+	if (sLine->length() > 0)
 		return true;
 
 	return false;
@@ -52,7 +105,7 @@ bool FileUtils::ReadLine(HANDLE hFile, wstring *swLine) {
 
 /**
  * Slurps a file and stores its contents inside a buffer.
- * @remark Remember to free the contents buffer with LocalFree.
+ * @remark Remember to free the contents buffer with AllocProfiler::Free.
  *
  * @param  szPath         Path to the file to be read.
  * @param  szFileContents File contents buffer. Allocated globally by this
@@ -60,6 +113,7 @@ bool FileUtils::ReadLine(HANDLE hFile, wstring *swLine) {
  * @return                TRUE if the operation was successful.
  */
 bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
+	TraceSpan span(L"FileUtils::ReadContents");
 	DWORD dwFileSize;
 	DWORD dwBytesRead;
 	HANDLE hFile;
@@ -67,6 +121,7 @@ bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
 	char *szaBuffer;
 	
 	// Open the file.
+	IoAccounting::CountOpen();
 	hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, NULL,
 		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
 	if (hFile == INVALID_HANDLE_VALUE) {
@@ -80,9 +135,10 @@ bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
 	dwFileSize = GetFileSize(hFile, NULL);
 	
 	// Allocate the memory for the file contents.
-	*szFileContents = (LPTSTR)LocalAlloc(LMEM_FIXED, (dwFileSize + 1) *
-		sizeof(TCHAR));
-	szaBuffer = (char*)LocalAlloc(LMEM_FIXED, (dwFileSize + 1) * sizeof(char));
+	*szFileContents = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		(dwFileSize + 1) * sizeof(TCHAR), L"FileUtils::ReadContents");
+	szaBuffer = (char*)AllocProfiler::Alloc(LMEM_FIXED,
+		(dwFileSize + 1) * sizeof(char), L"FileUtils::ReadContents");
 	
 	// Read the file into the buffer.
 	if (!ReadFile(hFile, szaBuffer, dwFileSize, &dwBytesRead, NULL)) {
@@ -91,6 +147,7 @@ bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
 			L"Read File Error", MB_OK | MB_ICONERROR);
 		bSuccess = false;
 	}
+	IoAccounting::CountRead(dwBytesRead);
 
 	// Terminate the buffer and convert it.
 	szaBuffer[dwBytesRead] = '\0';
@@ -98,13 +155,58 @@ bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
 		MessageBox(NULL, L"Failed to convert file buffer from ASCII to Unicode",
 			L"Conversion Failed", MB_OK | MB_ICONERROR);
 
-		LocalFree(*szFileContents);
+		AllocProfiler::Free(*szFileContents);
 		bSuccess = false;
 	}
     
 	// Clean up.
 	CloseHandle(hFile);
-	LocalFree(szaBuffer);
+	AllocProfiler::Free(szaBuffer);
+
+	return bSuccess;
+}
+
+/**
+ * Reads the raw bytes of a file into a buffer in one go.
+ * @remark Remember to free the buffer with AllocProfiler::Free.
+ *
+ * @param  szPath   Path to the file to be read.
+ * @param  lpData   Pointer to the buffer that will be allocated by this
+ *                  function.
+ * @param  dwLength Pointer to where the number of bytes will be stored.
+ * @return          TRUE if the whole file was read.
+ */
+bool FileUtils::ReadBytes(LPCTSTR szPath, LPBYTE *lpData, DWORD *dwLength) {
+	DWORD dwBytesRead;
+	HANDLE hFile;
+	bool bSuccess;
+
+	// Open the file.
+	hFile = Open(szPath, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Read the whole thing into memory.
+	*dwLength = GetFileSize(hFile, NULL);
+	if ((*dwLength == 0xFFFFFFFF) || (*dwLength == 0)) {
+		CloseHandle(hFile);
+		return false;
+	}
+	*lpData = (LPBYTE)AllocProfiler::Alloc(LMEM_FIXED, *dwLength,
+		L"FileUtils::ReadBytes");
+	if (*lpData == NULL) {
+		CloseHandle(hFile);
+		return false;
+	}
+	bSuccess = Read(hFile, *lpData, *dwLength, &dwBytesRead) &&
+		(dwBytesRead == *dwLength);
+	CloseHandle(hFile);
+
+	// Don't hand out half a file.
+	if (!bSuccess) {
+		AllocProfiler::Free(*lpData);
+		*lpData = NULL;
+	}
 
 	return bSuccess;
 }
@@ -117,17 +219,110 @@ bool FileUtils::ReadContents(LPCTSTR szPath, LPTSTR *szFileContents) {
  * @return            TRUE if the operation was successful.
  */
 bool FileUtils::SaveContents(LPCTSTR szFilePath, LPCTSTR szContents) {
-    HANDLE hFile;
+	TraceSpan span(L"FileUtils::SaveContents");
+	return WriteAsciiContents(szFilePath, szContents, false);
+}
+
+/**
+ * Appends contents to the end of a file, creating it if it doesn't exist.
+ *
+ * @param  szFilePath Path to the file to be appended to.
+ * @param  szContents Contents to place at the end of the file.
+ * @return            TRUE if the operation was successful.
+ */
+bool FileUtils::AppendContents(LPCTSTR szFilePath, LPCTSTR szContents) {
+	TraceSpan span(L"FileUtils::AppendContents");
+	return WriteAsciiContents(szFilePath, szContents, true);
+}
+
+/**
+ * Save contents to a file encoded as UTF-8.
+ *
+ * @param  szFilePath Path to the file to be overwritten.
+ * @param  szContents Contents to place inside the file.
+ * @return            TRUE if the operation was successful.
+ */
+bool FileUtils::SaveUtf8Contents(LPCTSTR szFilePath, LPCTSTR szContents) {
+	TraceSpan span(L"FileUtils::SaveUtf8Contents");
+	string sContents;
+
+	if (!StringUtils::UnicodeToUtf8(&sContents, szContents))
+		return false;
+
+	return WriteContents(szFilePath, sContents.data(), sContents.length(),
+		false);
+}
+
+/**
+ * Appends contents encoded as UTF-8 to the end of a file, creating it if it
+ * doesn't exist.
+ *
+ * @param  szFilePath Path to the file to be appended to.
+ * @param  szContents Contents to place at the end of the file.
+ * @return            TRUE if the operation was successful.
+ */
+bool FileUtils::AppendUtf8Contents(LPCTSTR szFilePath, LPCTSTR szContents) {
+	TraceSpan span(L"FileUtils::AppendUtf8Contents");
+	string sContents;
+
+	if (!StringUtils::UnicodeToUtf8(&sContents, szContents))
+		return false;
+
+	return WriteContents(szFilePath, sContents.data(), sContents.length(),
+		true);
+}
+
+/**
+ * Converts contents to ASCII and writes them to a file.
+ *
+ * @param  szFilePath Path to the file to be written.
+ * @param  szContents Contents to place inside the file.
+ * @param  bAppend    Should we keep what is already in the file?
+ * @return            TRUE if the operation was successful.
+ */
+bool FileUtils::WriteAsciiContents(LPCTSTR szFilePath, LPCTSTR szContents,
+								   bool bAppend) {
 	DWORD dwTextLength;
-	DWORD dwBytesWritten;
 	char *szaBuffer;
+	bool bSuccess;
 
-	// Get text length.
+	// Convert text to ASCII before writing to the file.
 	dwTextLength = wcslen(szContents);
+	szaBuffer = (char*)AllocProfiler::Alloc(LMEM_FIXED,
+		(dwTextLength + 1) * sizeof(char), L"FileUtils::WriteAsciiContents");
+	if (!StringUtils::UnicodeToAscii(szaBuffer, szContents)) {
+		MessageBox(NULL, L"Failed to convert contents buffer from Unicode to "
+			L"ASCII.", L"Conversion Failed", MB_OK | MB_ICONERROR);
+
+		AllocProfiler::Free(szaBuffer);
+		return false;
+	}
+
+	bSuccess = WriteContents(szFilePath, szaBuffer, dwTextLength, bAppend);
+	AllocProfiler::Free(szaBuffer);
+
+	return bSuccess;
+}
+
+/**
+ * Writes contents to a file with a single write, either replacing what was in
+ * it or after what is already there.
+ *
+ * @param  szFilePath Path to the file to be written.
+ * @param  szaBuffer  Bytes to place inside the file.
+ * @param  dwLength   Number of bytes to be written.
+ * @param  bAppend    Should we keep what is already in the file?
+ * @return            TRUE if the operation was successful.
+ */
+bool FileUtils::WriteContents(LPCTSTR szFilePath, const char *szaBuffer,
+							  DWORD dwLength, bool bAppend) {
+    HANDLE hFile;
+	DWORD dwBytesWritten;
 
 	// Open file for writing.
+	IoAccounting::CountOpen();
     hFile = CreateFile(szFilePath, GENERIC_WRITE, FILE_SHARE_WRITE, NULL,
-        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        (bAppend) ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
 		// TODO: Use GetLastError.
 		MessageBox(NULL, L"Couldn't open file to write contents.",
@@ -135,32 +330,61 @@ bool FileUtils::SaveContents(LPCTSTR szFilePath, LPCTSTR szContents) {
 		return false;
 	}
 
-	// Convert text to ASCII before writing to the file.
-	szaBuffer = (char*)LocalAlloc(LMEM_FIXED, (dwTextLength + 1) * sizeof(char));
-	if (!StringUtils::UnicodeToAscii(szaBuffer, szContents)) {
-		MessageBox(NULL, L"Failed to convert contents buffer from Unicode to "
-			L"ASCII.", L"Conversion Failed", MB_OK | MB_ICONERROR);
-
+	// Go to the end of the file if we are appending.
+	if (bAppend && (SetFilePointer(hFile, 0, NULL, FILE_END) == 0xFFFFFFFF)) {
 		CloseHandle(hFile);
-		LocalFree(szaBuffer);
 		return false;
 	}
 
 	// Write to the file.
-	if (!WriteFile(hFile, szaBuffer, dwTextLength, &dwBytesWritten, NULL)) {
+	if (!WriteFile(hFile, szaBuffer, dwLength, &dwBytesWritten, NULL) ||
+			(dwBytesWritten != dwLength)) {
 		// TODO: Use GetLastError.
 		MessageBox(NULL, L"Couldn't write contents to file.",
 			L"Write File Error", MB_OK | MB_ICONERROR);
+
+		CloseHandle(hFile);
 		return false;
 	}
+	IoAccounting::CountWrite(dwBytesWritten);
 	
 	// Clean up.
 	CloseHandle(hFile);
-	LocalFree(szaBuffer);
 
     return true;
 }
 
+/**
+ * Writes a string to an already opened file.
+ *
+ * @param  hFile    File handle.
+ * @param  szString String to be written to the file.
+ * @return          TRUE if the operation was successful.
+ */
+bool FileUtils::WriteString(HANDLE hFile, LPCTSTR szString) {
+	DWORD dwTextLength;
+	DWORD dwBytesWritten;
+	char *szaBuffer;
+	bool bSuccess;
+
+	// Convert text to ASCII before writing to the file.
+	dwTextLength = wcslen(szString);
+	szaBuffer = (char*)AllocProfiler::Alloc(LMEM_FIXED,
+		(dwTextLength + 1) * sizeof(char), L"FileUtils::WriteString");
+	if (!StringUtils::UnicodeToAscii(szaBuffer, szString)) {
+		AllocProfiler::Free(szaBuffer);
+		return false;
+	}
+
+	// Write to the file.
+	bSuccess = WriteFile(hFile, szaBuffer, dwTextLength, &dwBytesWritten,
+		NULL) != 0;
+	IoAccounting::CountWrite(dwBytesWritten);
+	AllocProfiler::Free(szaBuffer);
+
+	return bSuccess && (dwBytesWritten == dwTextLength);
+}
+
 /**
  * Checks if a file exists.
  *
@@ -168,5 +392,200 @@ bool FileUtils::SaveContents(LPCTSTR szFilePath, LPCTSTR szContents) {
  * @return        TRUE if the file exists.
  */
 bool FileUtils::Exists(LPCTSTR szPath) {
+	IoAccounting::CountProbe();
 	return GetFileAttributes(szPath) != 0xFFFFFFFF;
-}
\ No newline at end of file
+}
+
+/**
+ * Gets the size, attributes and timestamps of a file.
+ *
+ * @param  szPath Path to the file.
+ * @param  wfd    Pointer to where the information will be stored.
+ * @return        TRUE if the file exists.
+ */
+bool FileUtils::GetInfo(LPCTSTR szPath, WIN32_FIND_DATA *wfd) {
+	IoAccounting::CountProbe();
+	HANDLE hFind = FindFirstFile(szPath, wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return false;
+
+	FindClose(hFind);
+	return true;
+}
+
+/**
+ * Calculates a FNV-1a hash of the contents of a file.
+ *
+ * @param  szPath Path to the file.
+ * @param  dwHash Pointer to where the hash will be stored.
+ * @return        TRUE if the file could be read.
+ */
+bool FileUtils::HashContents(LPCTSTR szPath, DWORD *dwHash) {
+	BYTE abBuffer[HASH_BUFFER_SIZE];
+	DWORD dwBytesRead;
+	HANDLE hFile;
+
+	IoAccounting::CountOpen();
+	hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	*dwHash = 2166136261UL;
+	while (ReadFile(hFile, abBuffer, HASH_BUFFER_SIZE, &dwBytesRead, NULL) &&
+			(dwBytesRead > 0)) {
+		IoAccounting::CountRead(dwBytesRead);
+		for (DWORD i = 0; i < dwBytesRead; i++) {
+			*dwHash ^= abBuffer[i];
+			*dwHash *= 16777619UL;
+		}
+	}
+	CloseHandle(hFile);
+
+	return true;
+}
+
+/**
+ * Checks if two files have exactly the same contents.
+ *
+ * @param  szFirst  Path to the first file.
+ * @param  szSecond Path to the second file.
+ * @return          TRUE if both files could be read and are identical.
+ */
+bool FileUtils::CompareContents(LPCTSTR szFirst, LPCTSTR szSecond) {
+	BYTE abFirst[HASH_BUFFER_SIZE];
+	BYTE abSecond[HASH_BUFFER_SIZE];
+	DWORD dwFirstRead;
+	DWORD dwSecondRead;
+	HANDLE hFirst;
+	HANDLE hSecond;
+	bool bEqual = true;
+
+	// Open both files.
+	IoAccounting::CountOpen();
+	hFirst = CreateFile(szFirst, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFirst == INVALID_HANDLE_VALUE)
+		return false;
+	IoAccounting::CountOpen();
+	hSecond = CreateFile(szSecond, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hSecond == INVALID_HANDLE_VALUE) {
+		CloseHandle(hFirst);
+		return false;
+	}
+
+	// Compare them block by block.
+	if (GetFileSize(hFirst, NULL) != GetFileSize(hSecond, NULL))
+		bEqual = false;
+	while (bEqual) {
+		if (!ReadFile(hFirst, abFirst, HASH_BUFFER_SIZE, &dwFirstRead, NULL) ||
+				!ReadFile(hSecond, abSecond, HASH_BUFFER_SIZE, &dwSecondRead, NULL) ||
+				(dwFirstRead != dwSecondRead)) {
+			bEqual = false;
+			break;
+		}
+
+		IoAccounting::CountRead(dwFirstRead);
+		IoAccounting::CountRead(dwSecondRead);
+		if (dwFirstRead == 0)
+			break;
+
+		bEqual = memcmp(abFirst, abSecond, dwFirstRead) == 0;
+	}
+
+	CloseHandle(hFirst);
+	CloseHandle(hSecond);
+
+	return bEqual;
+}
+
+/**
+ * Opens or creates a file.
+ *
+ * @param  szPath      Path to the file.
+ * @param  dwAccess    Access to the file, as in CreateFile.
+ * @param  dwShareMode How others may share the file, as in CreateFile.
+ * @param  dwCreation  What to do if the file exists or not, as in CreateFile.
+ * @return             File handle or INVALID_HANDLE_VALUE if it failed.
+ */
+HANDLE FileUtils::Open(LPCTSTR szPath, DWORD dwAccess, DWORD dwShareMode,
+					   DWORD dwCreation) {
+	IoAccounting::CountOpen();
+	return CreateFile(szPath, dwAccess, dwShareMode, NULL, dwCreation,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+/**
+ * Reads bytes from an already opened file.
+ *
+ * @param  hFile       File handle.
+ * @param  lpBuffer    Buffer that will receive the bytes.
+ * @param  dwLength    Maximum number of bytes to be read.
+ * @param  dwBytesRead Pointer to where the number of bytes read will be
+ *                     stored. Zero means we reached the EOF.
+ * @return             TRUE if the operation was successful.
+ */
+bool FileUtils::Read(HANDLE hFile, LPVOID lpBuffer, DWORD dwLength,
+					 DWORD *dwBytesRead) {
+	*dwBytesRead = 0;
+	bool bSuccess = ReadFile(hFile, lpBuffer, dwLength, dwBytesRead,
+		NULL) != 0;
+	IoAccounting::CountRead(*dwBytesRead);
+
+	return bSuccess;
+}
+
+/**
+ * Writes bytes to an already opened file.
+ *
+ * @param  hFile    File handle.
+ * @param  lpBuffer Bytes to be written.
+ * @param  dwLength Number of bytes to be written.
+ * @return          TRUE if every byte was written.
+ */
+bool FileUtils::Write(HANDLE hFile, LPCVOID lpBuffer, DWORD dwLength) {
+	DWORD dwBytesWritten = 0;
+	bool bSuccess = WriteFile(hFile, lpBuffer, dwLength, &dwBytesWritten,
+		NULL) != 0;
+	IoAccounting::CountWrite(dwBytesWritten);
+
+	return bSuccess && (dwBytesWritten == dwLength);
+}
+
+/**
+ * Moves the cursor of an already opened file. Nothing is read from the disk,
+ * so it isn't counted.
+ *
+ * @param  hFile    File handle.
+ * @param  dwOffset Offset from the start of the file.
+ * @return          TRUE if the operation was successful.
+ */
+bool FileUtils::Seek(HANDLE hFile, DWORD dwOffset) {
+	return SetFilePointer(hFile, (LONG)dwOffset, NULL, FILE_BEGIN) !=
+		0xFFFFFFFF;
+}
+
+/**
+ * Starts going through the files that match a query.
+ *
+ * @param  szQuery Path with wildcards of the files to go through.
+ * @param  wfd     Pointer to where the first file will be stored.
+ * @return         Search handle to be used with FindNextFile or
+ *                 INVALID_HANDLE_VALUE if nothing matched.
+ */
+HANDLE FileUtils::FindFirst(LPCTSTR szQuery, WIN32_FIND_DATA *wfd) {
+	IoAccounting::CountEnumeration();
+	return FindFirstFile(szQuery, wfd);
+}
+
+/**
+ * Deletes a file.
+ *
+ * @param  szPath Path to the file to be deleted.
+ * @return        TRUE if the file was deleted.
+ */
+bool FileUtils::Delete(LPCTSTR szPath) {
+	IoAccounting::CountDelete();
+	return DeleteFile(szPath) != 0;
+}
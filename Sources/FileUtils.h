@@ -17,14 +17,42 @@ class FileUtils {
 private:
 	FileUtils() {}
 
+	// Reading and writing.
+	static bool ReadBytesLine(HANDLE hFile, string *sLine);
+	static bool WriteAsciiContents(LPCTSTR szFilePath, LPCTSTR szContents,
+								   bool bAppend);
+	static bool WriteContents(LPCTSTR szFilePath, const char *szaBuffer,
+							  DWORD dwLength, bool bAppend);
+
 public:
 	// Reading and writing.
 	static bool ReadLine(HANDLE hFile, wstring *swLine);
+	static bool ReadUtf8Line(HANDLE hFile, wstring *swLine);
 	static bool ReadContents(LPCTSTR szPath, LPTSTR *szFileContents);
+	static bool ReadBytes(LPCTSTR szPath, LPBYTE *lpData, DWORD *dwLength);
 	static bool SaveContents(LPCTSTR szFilePath, LPCTSTR szContents);
+	static bool AppendContents(LPCTSTR szFilePath, LPCTSTR szContents);
+	static bool SaveUtf8Contents(LPCTSTR szFilePath, LPCTSTR szContents);
+	static bool AppendUtf8Contents(LPCTSTR szFilePath, LPCTSTR szContents);
+	static bool WriteString(HANDLE hFile, LPCTSTR szString);
+
+	// Contents.
+	static bool HashContents(LPCTSTR szPath, DWORD *dwHash);
+	static bool CompareContents(LPCTSTR szFirst, LPCTSTR szSecond);
 
 	// Existance.
 	static bool Exists(LPCTSTR szPath);
+	static bool GetInfo(LPCTSTR szPath, WIN32_FIND_DATA *wfd);
+
+	// Counted file system calls.
+	static HANDLE Open(LPCTSTR szPath, DWORD dwAccess, DWORD dwShareMode,
+					   DWORD dwCreation);
+	static bool Read(HANDLE hFile, LPVOID lpBuffer, DWORD dwLength,
+					 DWORD *dwBytesRead);
+	static bool Write(HANDLE hFile, LPCVOID lpBuffer, DWORD dwLength);
+	static bool Seek(HANDLE hFile, DWORD dwOffset);
+	static HANDLE FindFirst(LPCTSTR szQuery, WIN32_FIND_DATA *wfd);
+	static bool Delete(LPCTSTR szPath);
 };
 
 #endif  // _FILE_UTILS_H
\ No newline at end of file
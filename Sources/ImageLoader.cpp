@@ -0,0 +1,269 @@
+/**
+ * ImageLoader.cpp
+ * Loads the component images in a background thread.
+ *
+ * The UI thread tells the loader which image was selected and which ones are
+ * likely to be selected next. The worker loads them through the thumbnail
+ * cache, in the order decided by a PrefetchQueue, and posts each one back to
+ * the notification window as a WM_IMAGELOADED message.
+ *
+ * The loader owns the only thumbnail cache of the application, so that its
+ * index is never written by two objects at once. The UI thread goes through
+ * the loader to rebuild it, under the same lock the worker holds while it
+ * loads an image.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "ImageLoader.h"
+#include "IoAccounting.h"
+
+/**
+ * Initializes a loader that isn't running yet.
+ */
+ImageLoader::ImageLoader() {
+	hThread = NULL;
+	hWakeEvent = NULL;
+	hwndNotify = NULL;
+	nWidth = 0;
+	nHeight = 0;
+	bWorkspaceChanged = false;
+	bStopping = false;
+	InitializeCriticalSection(&csQueue);
+	InitializeCriticalSection(&csThumbnails);
+}
+
+/**
+ * Stops the worker thread.
+ */
+ImageLoader::~ImageLoader() {
+	Stop();
+	DeleteCriticalSection(&csQueue);
+	DeleteCriticalSection(&csThumbnails);
+}
+
+/**
+ * Starts the worker thread. Nothing is done if it's already running.
+ *
+ * @param  hwndNotify Window that will receive the WM_IMAGELOADED messages.
+ * @param  nWidth     Width the images are scaled to.
+ * @param  nHeight    Height the images are scaled to.
+ * @return            TRUE if the worker is running.
+ */
+bool ImageLoader::Start(HWND hwndNotify, int nWidth, int nHeight) {
+	if (hThread != NULL)
+		return true;
+
+	this->hwndNotify = hwndNotify;
+	this->nWidth = nWidth;
+	this->nHeight = nHeight;
+	bStopping = false;
+
+	// Auto-reset event used to wake the worker up when there's work to do.
+	hWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (hWakeEvent == NULL)
+		return false;
+
+	hThread = CreateThread(NULL, 0, WorkerThreadProc, this, 0, NULL);
+	if (hThread == NULL) {
+		CloseHandle(hWakeEvent);
+		hWakeEvent = NULL;
+
+		return false;
+	}
+
+	// Keep the UI responsive while we work.
+	SetThreadPriority(hThread, THREAD_PRIORITY_BELOW_NORMAL);
+
+	return true;
+}
+
+/**
+ * Stops the worker thread, waiting for the image it's loading to finish.
+ */
+void ImageLoader::Stop() {
+	if (hThread == NULL)
+		return;
+
+	EnterCriticalSection(&csQueue);
+	bStopping = true;
+	queue.Clear();
+	LeaveCriticalSection(&csQueue);
+
+	SetEvent(hWakeEvent);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	CloseHandle(hWakeEvent);
+	hThread = NULL;
+	hWakeEvent = NULL;
+}
+
+/**
+ * Sets the workspace the images belong to.
+ *
+ * @param dirWorkspace Workspace root directory.
+ */
+void ImageLoader::SetWorkspace(Directory dirWorkspace) {
+	EnterCriticalSection(&csQueue);
+	this->dirWorkspace = dirWorkspace;
+	bWorkspaceChanged = true;
+	queue.Clear();
+	LeaveCriticalSection(&csQueue);
+}
+
+/**
+ * Requests the selected image and prefetches the images of its neighbours.
+ * Anything still pending from the previous request is dropped.
+ *
+ * @param  szSelected    Path to the selected image or NULL if it doesn't have
+ *                       to be loaded.
+ * @param  arrNeighbours Paths to the images that may be selected next, most
+ *                       likely ones first.
+ * @return               Generation of the request.
+ */
+unsigned long ImageLoader::Request(LPCTSTR szSelected,
+								   vector<wstring> arrNeighbours) {
+	unsigned long ulGeneration;
+
+	EnterCriticalSection(&csQueue);
+	ulGeneration = queue.Select((szSelected != NULL) ? wstring(szSelected) :
+		wstring(), arrNeighbours);
+	LeaveCriticalSection(&csQueue);
+
+	if (hWakeEvent != NULL)
+		SetEvent(hWakeEvent);
+
+	return ulGeneration;
+}
+
+/**
+ * Drops every pending request.
+ */
+void ImageLoader::Cancel() {
+	EnterCriticalSection(&csQueue);
+	queue.Clear();
+	LeaveCriticalSection(&csQueue);
+}
+
+/**
+ * Checks if a loaded image belongs to the latest request.
+ *
+ * @param  ulGeneration Generation of the loaded image.
+ * @return              TRUE if no other request was made since.
+ */
+bool ImageLoader::IsCurrent(unsigned long ulGeneration) {
+	bool bCurrent;
+
+	EnterCriticalSection(&csQueue);
+	bCurrent = queue.IsCurrent(ulGeneration);
+	LeaveCriticalSection(&csQueue);
+
+	return bCurrent;
+}
+
+/**
+ * Frees a loaded image that wasn't used.
+ *
+ * @param image Image that was posted with WM_IMAGELOADED.
+ */
+void ImageLoader::FreeResult(LoadedImage *image) {
+	if (image->hBitmap != NULL)
+		DeleteObject(image->hBitmap);
+
+	delete image;
+}
+
+/**
+ * Removes the stale thumbnails of the workspace and builds the missing ones.
+ * The worker waits for this to finish before loading anything else.
+ *
+ * @param nWidth     Width of the thumbnails.
+ * @param nHeight    Height of the thumbnails.
+ * @param nRemoved   Number of stale thumbnails that were removed.
+ * @param nGenerated Number of thumbnails that were built.
+ */
+void ImageLoader::RebuildThumbnails(int nWidth, int nHeight, size_t *nRemoved,
+									size_t *nGenerated) {
+	Directory dirOpen;
+
+	EnterCriticalSection(&csQueue);
+	dirOpen = dirWorkspace;
+	LeaveCriticalSection(&csQueue);
+
+	EnterCriticalSection(&csThumbnails);
+	thumbnails.Open(dirOpen, nWidth, nHeight);
+	*nRemoved = thumbnails.RemoveStale();
+	*nGenerated = thumbnails.GenerateAll();
+	LeaveCriticalSection(&csThumbnails);
+}
+
+/**
+ * Accounts for the memory used by the thumbnail cache.
+ *
+ * @param report Report to add the memory to.
+ */
+void ImageLoader::AccountMemory(MemoryReport *report) {
+	EnterCriticalSection(&csThumbnails);
+	thumbnails.AccountMemory(report);
+	LeaveCriticalSection(&csThumbnails);
+}
+
+/**
+ * Entry point of the worker thread.
+ *
+ * @param  lpParam Pointer to the ImageLoader object.
+ * @return         Always 0.
+ */
+DWORD WINAPI ImageLoader::WorkerThreadProc(LPVOID lpParam) {
+	((ImageLoader*)lpParam)->Run();
+	return 0;
+}
+
+/**
+ * Loads the requested images until we are told to stop.
+ */
+void ImageLoader::Run() {
+	PrefetchRequest request;
+
+	// Everything we read is on behalf of the selection.
+	IoAccounting::SetOperation(IO_OP_SELECT);
+
+	while (WaitForSingleObject(hWakeEvent, INFINITE) == WAIT_OBJECT_0) {
+		for (;;) {
+			Directory dirOpen;
+			bool bOpen = false;
+
+			// Get the next request.
+			EnterCriticalSection(&csQueue);
+			if (bStopping) {
+				LeaveCriticalSection(&csQueue);
+				return;
+			}
+			if (!queue.Pop(&request)) {
+				LeaveCriticalSection(&csQueue);
+				break;
+			}
+			if (bWorkspaceChanged) {
+				dirOpen = dirWorkspace;
+				bWorkspaceChanged = false;
+				bOpen = true;
+			}
+			LeaveCriticalSection(&csQueue);
+
+			// Load the image and hand it over to the UI thread.
+			LoadedImage *image = new LoadedImage;
+			image->swPath = request.swKey;
+			image->bSelected = request.bSelected;
+			image->ulGeneration = request.ulGeneration;
+
+			EnterCriticalSection(&csThumbnails);
+			if (bOpen)
+				thumbnails.Open(dirOpen, nWidth, nHeight);
+			image->hBitmap = thumbnails.GetThumbnail(request.swKey.c_str());
+			LeaveCriticalSection(&csThumbnails);
+
+			if (!PostMessage(hwndNotify, WM_IMAGELOADED, 0, (LPARAM)image))
+				FreeResult(image);
+		}
+	}
+}
@@ -0,0 +1,77 @@
+/**
+ * ImageLoader.h
+ * Loads the component images in a background thread.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _IMAGE_LOADER_H
+#define _IMAGE_LOADER_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Directory.h"
+#include "ThumbnailCache.h"
+#include "PrefetchQueue.h"
+
+using namespace std;
+
+// Message posted to the notification window with a LoadedImage as lParam.
+#define WM_IMAGELOADED (WM_APP + 1)
+
+// An image that was loaded in the background.
+typedef struct {
+	wstring swPath;
+	HBITMAP hBitmap;
+	bool bSelected;
+	unsigned long ulGeneration;
+} LoadedImage;
+
+class ImageLoader {
+protected:
+	HANDLE hThread;
+	HANDLE hWakeEvent;
+	CRITICAL_SECTION csQueue;
+	CRITICAL_SECTION csThumbnails;
+	HWND hwndNotify;
+	PrefetchQueue queue;
+	ThumbnailCache thumbnails;
+	Directory dirWorkspace;
+	int nWidth;
+	int nHeight;
+	bool bWorkspaceChanged;
+	bool bStopping;
+
+	// Worker.
+	static DWORD WINAPI WorkerThreadProc(LPVOID lpParam);
+	void Run();
+
+private:
+	// Loaders own a thread, so they can't be copied.
+	ImageLoader(const ImageLoader &loader);
+	ImageLoader& operator=(const ImageLoader &loader);
+
+public:
+	// Constructors and destructors.
+	ImageLoader();
+	~ImageLoader();
+
+	// Worker.
+	bool Start(HWND hwndNotify, int nWidth, int nHeight);
+	void Stop();
+
+	// Requests.
+	void SetWorkspace(Directory dirWorkspace);
+	unsigned long Request(LPCTSTR szSelected, vector<wstring> arrNeighbours);
+	void Cancel();
+	bool IsCurrent(unsigned long ulGeneration);
+	static void FreeResult(LoadedImage *image);
+
+	// Thumbnails.
+	void RebuildThumbnails(int nWidth, int nHeight, size_t *nRemoved,
+						   size_t *nGenerated);
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _IMAGE_LOADER_H
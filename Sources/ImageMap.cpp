@@ -0,0 +1,404 @@
+/**
+ * ImageMap.cpp
+ * Resolves the images of the components in a workspace without touching the
+ * filesystem.
+ *
+ * The images folder is listed once when the workspace is opened, including
+ * the images that were moved into the asset store, and each
+ * component is resolved to an image ID by its package as it's added. The
+ * IMAGE file that may override the package is only looked for the first time
+ * the image of a component is asked for, so opening a workspace doesn't probe
+ * every component folder. After that the map is kept up to date by the image
+ * and component events, so looking up the image of a component is just a
+ * couple of map lookups.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "ImageMap.h"
+#include "Constants.h"
+#include "FileUtils.h"
+#include "AllocProfiler.h"
+
+/**
+ * Initializes an empty image map.
+ */
+ImageMap::ImageMap() {
+}
+
+/**
+ * Lists the images of a workspace. Components must be added afterwards.
+ *
+ * @param dirWorkspace Workspace root directory.
+ */
+void ImageMap::Open(Directory dirWorkspace) {
+	Close();
+	this->dirWorkspace = dirWorkspace;
+	dirImages = Directory(dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(IMAGES_DIR));
+
+	vector<wstring> arrImages = ListImages();
+	for (size_t i = 0; i < arrImages.size(); i++)
+		ImageAdded(arrImages[i].c_str());
+}
+
+/**
+ * Forgets about every image and component.
+ */
+void ImageMap::Close() {
+	arrPaths.clear();
+	mapNames.clear();
+	mapEntries.clear();
+}
+
+/**
+ * Lists the images folder again and figures out which images were added or
+ * removed behind our back. The map itself isn't changed, the caller should
+ * send the image events.
+ *
+ * @param arrAdded   Names of the images that were added.
+ * @param arrRemoved Names of the images that were removed.
+ */
+void ImageMap::Rescan(vector<wstring> *arrAdded, vector<wstring> *arrRemoved) {
+	map<wstring, long>::iterator it;
+	map<wstring, bool> mapFound;
+
+	// New images.
+	vector<wstring> arrImages = ListImages();
+	for (size_t i = 0; i < arrImages.size(); i++) {
+		wstring swName = NormalizeName(arrImages[i].c_str());
+
+		mapFound[swName] = true;
+		if (LookupExisting(swName) == IMAGE_NONE)
+			arrAdded->push_back(arrImages[i]);
+	}
+
+	// Images that are gone.
+	for (it = mapNames.begin(); it != mapNames.end(); it++) {
+		if (!arrPaths[it->second].empty() &&
+				(mapFound.find(it->first) == mapFound.end()))
+			arrRemoved->push_back(it->first);
+	}
+}
+
+/**
+ * An image was added to the images folder.
+ *
+ * @param szName Name of the image without its extension.
+ */
+void ImageMap::ImageAdded(LPCTSTR szName) {
+	wstring swName = NormalizeName(szName);
+	long lImageId = Lookup(swName);
+
+	// Images keep their ID if they are removed and added back.
+	if (lImageId == IMAGE_NONE) {
+		lImageId = (long)arrPaths.size();
+		arrPaths.push_back(wstring());
+		mapNames[swName] = lImageId;
+	}
+
+	// Images that were moved into the asset store keep their path in the images
+	// folder, whoever reads them resolves it.
+	Path pathImage = dirImages.Concatenate(szName);
+	pathImage.AppendString(IMAGE_EXTENSION);
+	arrPaths[lImageId] = pathImage.ToString();
+
+	Resolve(swName, lImageId);
+}
+
+/**
+ * An image was removed from the images folder.
+ *
+ * @param szName Name of the image without its extension.
+ */
+void ImageMap::ImageRemoved(LPCTSTR szName) {
+	wstring swName = NormalizeName(szName);
+	long lImageId = Lookup(swName);
+
+	if (lImageId == IMAGE_NONE)
+		return;
+
+	arrPaths[lImageId].erase();
+	Resolve(swName, IMAGE_NONE);
+}
+
+/**
+ * Resolves the image of a component that was added to the workspace.
+ *
+ * @param component Component that was added.
+ */
+void ImageMap::ComponentAdded(Component *component) {
+	ImageEntry entry;
+
+	entry.swWanted = BuildWanted(component);
+	entry.lImageId = LookupExisting(entry.swWanted);
+	entry.bExplicit = false;
+	entry.bChecked = false;
+
+	mapEntries[wstring(component->GetDirectory().ToString())] = entry;
+}
+
+/**
+ * Resolves the image of a component again, since its package may have
+ * changed. An IMAGE file that was already found still wins.
+ *
+ * @param component Component that was changed.
+ */
+void ImageMap::ComponentChanged(Component *component) {
+	map<wstring, ImageEntry>::iterator it;
+
+	it = mapEntries.find(wstring(component->GetDirectory().ToString()));
+	if ((it != mapEntries.end()) && it->second.bExplicit)
+		return;
+
+	ComponentAdded(component);
+}
+
+/**
+ * Forgets about a component.
+ *
+ * @param component Component that is being removed from the workspace.
+ */
+void ImageMap::ComponentRemoved(Component *component) {
+	mapEntries.erase(wstring(component->GetDirectory().ToString()));
+}
+
+/**
+ * Moves a component over to its new folder.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void ImageMap::ComponentRenamed(Component *component, Directory dirOld) {
+	mapEntries.erase(wstring(dirOld.ToString()));
+	ComponentAdded(component);
+}
+
+/**
+ * Forgets about every component. The images are kept.
+ */
+void ImageMap::ComponentsCleared() {
+	mapEntries.clear();
+}
+
+/**
+ * Gets the ID of the image a component resolved to.
+ *
+ * @param  component Component to get the image for.
+ * @return           Image ID or IMAGE_NONE if the component doesn't have one.
+ */
+long ImageMap::GetImageId(Component *component) {
+	map<wstring, ImageEntry>::iterator it;
+
+	it = mapEntries.find(wstring(component->GetDirectory().ToString()));
+	if (it == mapEntries.end())
+		return IMAGE_NONE;
+	if (!it->second.bChecked)
+		CheckExplicit(component, &it->second);
+
+	return it->second.lImageId;
+}
+
+/**
+ * Gets the path to an image.
+ *
+ * @param  lImageId Image ID.
+ * @return          Path to the image or NULL if it doesn't exist.
+ */
+LPCTSTR ImageMap::GetImagePath(long lImageId) {
+	if ((lImageId < 0) || (lImageId >= (long)arrPaths.size()) ||
+			arrPaths[lImageId].empty())
+		return NULL;
+
+	return arrPaths[lImageId].c_str();
+}
+
+/**
+ * Gets the path to the image of a component.
+ * @remark The returned string belongs to the map and is only valid until the
+ *         next image event. The image may have been moved into the asset
+ *         store, so it has to be resolved before being read.
+ *
+ * @param  component Component to get the image for.
+ * @return           Path to the image or NULL if there isn't one.
+ */
+LPCTSTR ImageMap::GetImage(Component *component) {
+	return GetImagePath(GetImageId(component));
+}
+
+/**
+ * Accounts for the memory used by the map, including the object itself.
+ *
+ * @param report Report to add the memory to.
+ */
+void ImageMap::AccountMemory(MemoryReport *report) {
+	map<wstring, ImageEntry>::iterator itEntry;
+	map<wstring, long>::iterator itName;
+
+	report->Add(MEMORY_IMAGES, sizeof(ImageMap) +
+		(arrPaths.capacity() * sizeof(wstring)));
+	for (size_t i = 0; i < arrPaths.size(); i++)
+		report->AddString(MEMORY_IMAGES, arrPaths[i]);
+
+	// Image files by name.
+	report->AddMapNodes(MEMORY_IMAGES, mapNames.size(),
+		sizeof(wstring) + sizeof(long));
+	for (itName = mapNames.begin(); itName != mapNames.end(); itName++)
+		report->AddString(MEMORY_IMAGES, itName->first);
+
+	// Images of each component.
+	report->AddMapNodes(MEMORY_IMAGES, mapEntries.size(),
+		sizeof(wstring) + sizeof(ImageEntry));
+	for (itEntry = mapEntries.begin(); itEntry != mapEntries.end(); itEntry++) {
+		report->AddString(MEMORY_IMAGES, itEntry->first);
+		report->AddString(MEMORY_IMAGES, itEntry->second.swWanted);
+	}
+}
+
+/**
+ * Lists the bitmaps and asset store references in the images folder in one
+ * go.
+ *
+ * @return Names of the images without their extensions.
+ */
+vector<wstring> ImageMap::ListImages() {
+	vector<wstring> arrImages;
+	WIN32_FIND_DATA wfd;
+	HANDLE hFind;
+
+	hFind = FileUtils::FindFirst(dirImages.Concatenate(L"*").ToString(), &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return arrImages;
+
+	do {
+		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		// Strip the extensions to get the image name.
+		wstring swName(wfd.cFileName);
+		StripExtension(&swName, BLOB_REF_EXTENSION);
+		if (StripExtension(&swName, IMAGE_EXTENSION))
+			arrImages.push_back(swName);
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+
+	return arrImages;
+}
+
+/**
+ * Gets the ID of an image by its normalized name.
+ *
+ * @param  swName Normalized image name.
+ * @return        Image ID or IMAGE_NONE if we've never seen it.
+ */
+long ImageMap::Lookup(const wstring &swName) {
+	map<wstring, long>::iterator it;
+
+	if (swName.empty())
+		return IMAGE_NONE;
+
+	it = mapNames.find(swName);
+	if (it == mapNames.end())
+		return IMAGE_NONE;
+
+	return it->second;
+}
+
+/**
+ * Gets the ID of an image that is currently in the images folder.
+ *
+ * @param  swName Normalized image name.
+ * @return        Image ID or IMAGE_NONE if the image doesn't exist.
+ */
+long ImageMap::LookupExisting(const wstring &swName) {
+	long lImageId = Lookup(swName);
+
+	if ((lImageId != IMAGE_NONE) && arrPaths[lImageId].empty())
+		return IMAGE_NONE;
+
+	return lImageId;
+}
+
+/**
+ * Points every component that wants an image to a new image ID.
+ *
+ * @param swName   Normalized image name.
+ * @param lImageId New image ID.
+ */
+void ImageMap::Resolve(const wstring &swName, long lImageId) {
+	map<wstring, ImageEntry>::iterator it;
+
+	for (it = mapEntries.begin(); it != mapEntries.end(); it++) {
+		if (it->second.swWanted == swName)
+			it->second.lImageId = lImageId;
+	}
+}
+
+/**
+ * Looks for an IMAGE file in the folder of a component, which takes
+ * precedence over its package. This is only done once for each component.
+ *
+ * @param component Component to be checked.
+ * @param entry     Image entry of the component.
+ */
+void ImageMap::CheckExplicit(Component *component, ImageEntry *entry) {
+	Path pathImage = component->GetDirectory().Concatenate(IMAGE_FILE);
+	LPTSTR szImageName;
+
+	entry->bChecked = true;
+	if (!pathImage.Exists() ||
+			!FileUtils::ReadContents(pathImage.ToString(), &szImageName))
+		return;
+
+	entry->swWanted = NormalizeName(szImageName);
+	entry->lImageId = LookupExisting(entry->swWanted);
+	entry->bExplicit = true;
+	AllocProfiler::Free(szImageName);
+}
+
+/**
+ * Figures out the name of the image a component wants by its package.
+ *
+ * @param  component Component to get the image name for.
+ * @return           Normalized image name or an empty string.
+ */
+wstring ImageMap::BuildWanted(Component *component) {
+	// Use the package.
+	Property *prop = component->GetProperty(PROPERTY_PACKAGE);
+	if (prop)
+		return NormalizeName(prop->GetValue());
+
+	return wstring();
+}
+
+/**
+ * Normalizes an image name, since file names aren't case sensitive.
+ *
+ * @param  szName Image name.
+ * @return        Lowercase image name.
+ */
+wstring ImageMap::NormalizeName(LPCTSTR szName) {
+	wstring swName;
+
+	for (; *szName != L'\0'; szName++)
+		swName += (WCHAR)towlower(*szName);
+
+	return swName;
+}
+
+/**
+ * Removes an extension from the end of a file name.
+ *
+ * @param  swName      File name.
+ * @param  szExtension Extension to be removed.
+ * @return             TRUE if the name ended with the extension.
+ */
+bool ImageMap::StripExtension(wstring *swName, LPCTSTR szExtension) {
+	size_t nLength = wcslen(szExtension);
+
+	if ((swName->length() <= nLength) || (_wcsicmp(swName->c_str() +
+			(swName->length() - nLength), szExtension) != 0))
+		return false;
+
+	swName->erase(swName->length() - nLength);
+	return true;
+}
@@ -0,0 +1,81 @@
+/**
+ * ImageMap.h
+ * Resolves the images of the components in a workspace without touching the
+ * filesystem.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _IMAGE_MAP_H
+#define _IMAGE_MAP_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Directory.h"
+#include "Component.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Component without an image.
+#define IMAGE_NONE -1
+
+class ImageMap : public WorkspaceListener {
+protected:
+	// Image a single component wants and the one it resolved to.
+	typedef struct {
+		wstring swWanted;
+		long lImageId;
+		bool bExplicit;
+		bool bChecked;
+	} ImageEntry;
+
+	Directory dirWorkspace;
+	Directory dirImages;
+	vector<wstring> arrPaths;
+	map<wstring, long> mapNames;
+	map<wstring, ImageEntry> mapEntries;
+
+	// Helpers.
+	vector<wstring> ListImages();
+	long Lookup(const wstring &swName);
+	long LookupExisting(const wstring &swName);
+	void Resolve(const wstring &swName, long lImageId);
+	void CheckExplicit(Component *component, ImageEntry *entry);
+	static wstring BuildWanted(Component *component);
+	static wstring NormalizeName(LPCTSTR szName);
+	static bool StripExtension(wstring *swName, LPCTSTR szExtension);
+
+public:
+	// Constructors and destructors.
+	ImageMap();
+
+	// Operations.
+	void Open(Directory dirWorkspace);
+	void Close();
+	void Rescan(vector<wstring> *arrAdded, vector<wstring> *arrRemoved);
+
+	// Image events.
+	void ImageAdded(LPCTSTR szName);
+	void ImageRemoved(LPCTSTR szName);
+
+	// Workspace events.
+	void ComponentAdded(Component *component);
+	void ComponentChanged(Component *component);
+	void ComponentRemoved(Component *component);
+	void ComponentRenamed(Component *component, Directory dirOld);
+	void ComponentsCleared();
+
+	// Queries.
+	long GetImageId(Component *component);
+	LPCTSTR GetImagePath(long lImageId);
+	LPCTSTR GetImage(Component *component);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _IMAGE_MAP_H
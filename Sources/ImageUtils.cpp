@@ -6,6 +6,8 @@
  */
 
 #include "ImageUtils.h"
+#include "FileUtils.h"
+#include "AllocProfiler.h"
 
 /**
  * Loads a bitmap from a file.
@@ -14,7 +16,45 @@
  * @return        HBITMAP structure or NULL if an error occured.
  */
 HBITMAP ImageUtils::LoadBitmap(LPCTSTR szPath) {
-	return SHLoadDIBitmap(szPath);
+	BmpImage image;
+
+	// Let the system deal with anything our decoder doesn't understand.
+	if (!DecodeFile(szPath, &image))
+		return SHLoadDIBitmap(szPath);
+
+	return CreateBitmap(&image);
+}
+
+/**
+ * Loads a bitmap from a file and scales it by averaging the pixels, which
+ * looks a lot better than StretchBlt when making thumbnails of photos.
+ * @remark The returned bitmap must be freed using DeleteObject().
+ *
+ * @param  szPath  Path to the bitmap file.
+ * @param  nWidth  Width of the scaled bitmap.
+ * @param  nHeight Height of the scaled bitmap.
+ * @return         Scaled bitmap or NULL if an error occured.
+ */
+HBITMAP ImageUtils::LoadScaledBitmap(LPCTSTR szPath, int nWidth, int nHeight) {
+	BmpImage image;
+	BmpImage scaled;
+
+	// Fall back to the system decoder and StretchBlt.
+	if (!DecodeFile(szPath, &image)) {
+		HBITMAP hOriginal = SHLoadDIBitmap(szPath);
+		if (hOriginal == NULL)
+			return NULL;
+
+		HBITMAP hBitmap = ResizeBitmap(hOriginal, nWidth, nHeight);
+		DeleteObject(hOriginal);
+
+		return hBitmap;
+	}
+
+	if (!image.ScaleTo(&scaled, nWidth, nHeight))
+		return NULL;
+
+	return CreateBitmap(&scaled);
 }
 
 /**
@@ -51,4 +91,148 @@ HBITMAP ImageUtils::ResizeBitmap(HBITMAP hbmpOriginal, int nWidth, int nHeight)
 	DeleteDC(hdcNewBmp);
 
 	return hBitmap;
-}
\ No newline at end of file
+}
+
+/**
+ * Saves a bitmap to a 24-bit BMP file.
+ *
+ * @param  hBitmap Bitmap to be saved.
+ * @param  szPath  Path to the file to be created.
+ * @return         TRUE if the operation was successful.
+ */
+bool ImageUtils::SaveBitmap(HBITMAP hBitmap, LPCTSTR szPath) {
+	BITMAPFILEHEADER bfh = {0};
+	BITMAPINFO bmi = {0};
+	BITMAP bmp = {0};
+	LPVOID lpBits = NULL;
+	DWORD dwStride;
+	bool bSuccess = true;
+
+	// Get the bitmap dimensions.
+	if (!GetObject(hBitmap, sizeof(BITMAP), &bmp))
+		return false;
+
+	// Describe a 24-bit bottom-up DIB.
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = bmp.bmWidth;
+	bmi.bmiHeader.biHeight = bmp.bmHeight;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 24;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	dwStride = ((bmp.bmWidth * 3) + 3) & ~3;
+	bmi.bmiHeader.biSizeImage = dwStride * bmp.bmHeight;
+
+	// Copy the bitmap into a DIB section so that we can get to its bits.
+	HDC hdcScreen = GetWindowDC(NULL);
+	HDC hdcSource = CreateCompatibleDC(hdcScreen);
+	HDC hdcDib = CreateCompatibleDC(hdcScreen);
+	HBITMAP hDib = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &lpBits,
+		NULL, 0);
+	if (hDib == NULL) {
+		DeleteDC(hdcSource);
+		DeleteDC(hdcDib);
+		ReleaseDC(NULL, hdcScreen);
+
+		return false;
+	}
+	HGDIOBJ hOldSource = SelectObject(hdcSource, hBitmap);
+	HGDIOBJ hOldDib = SelectObject(hdcDib, hDib);
+	BitBlt(hdcDib, 0, 0, bmp.bmWidth, bmp.bmHeight, hdcSource, 0, 0, SRCCOPY);
+
+	// Build the file header.
+	bfh.bfType = 0x4D42;
+	bfh.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	bfh.bfSize = bfh.bfOffBits + bmi.bmiHeader.biSizeImage;
+
+	// Write everything to the file.
+	HANDLE hFile = FileUtils::Open(szPath, GENERIC_WRITE, 0, CREATE_ALWAYS);
+	if (hFile != INVALID_HANDLE_VALUE) {
+		bSuccess &= FileUtils::Write(hFile, &bfh, sizeof(BITMAPFILEHEADER));
+		bSuccess &= FileUtils::Write(hFile, &bmi.bmiHeader,
+			sizeof(BITMAPINFOHEADER));
+		bSuccess &= FileUtils::Write(hFile, lpBits, bmi.bmiHeader.biSizeImage);
+		CloseHandle(hFile);
+
+		// Don't leave a broken file behind.
+		if (!bSuccess)
+			FileUtils::Delete(szPath);
+	} else {
+		bSuccess = false;
+	}
+
+	// Clean up.
+	SelectObject(hdcSource, hOldSource);
+	SelectObject(hdcDib, hOldDib);
+	DeleteObject(hDib);
+	DeleteDC(hdcSource);
+	DeleteDC(hdcDib);
+	ReleaseDC(NULL, hdcScreen);
+
+	return bSuccess;
+}
+
+/**
+ * Reads a BMP file and decodes it.
+ *
+ * @param  szPath Path to the bitmap file.
+ * @param  image  Image that will hold the decoded pixels.
+ * @return        TRUE if the image was decoded.
+ */
+bool ImageUtils::DecodeFile(LPCTSTR szPath, BmpImage *image) {
+	LPBYTE lpData;
+	DWORD dwFileSize;
+	bool bSuccess;
+
+	// Read the whole thing into memory.
+	if (!FileUtils::ReadBytes(szPath, &lpData, &dwFileSize))
+		return false;
+
+	// Decode it.
+	bSuccess = image->Decode(lpData, dwFileSize);
+
+	AllocProfiler::Free(lpData);
+	return bSuccess;
+}
+
+/**
+ * Creates a bitmap out of a decoded image. This is the only part of loading
+ * an image that goes through GDI.
+ * @remark The returned bitmap must be freed using DeleteObject().
+ *
+ * @param  image Decoded image.
+ * @return       32-bit DIB section or NULL if an error occured.
+ */
+HBITMAP ImageUtils::CreateBitmap(BmpImage *image) {
+	BITMAPINFO bmi = {0};
+	LPVOID lpBits = NULL;
+	const BmpPixel *lpPixels = image->GetPixels();
+	int nWidth = image->GetWidth();
+	int nHeight = image->GetHeight();
+
+	// Describe a 32-bit bottom-up DIB.
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = nWidth;
+	bmi.bmiHeader.biHeight = nHeight;
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+	bmi.bmiHeader.biSizeImage = nWidth * nHeight * sizeof(DWORD);
+
+	HDC hdcScreen = GetWindowDC(NULL);
+	HBITMAP hBitmap = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &lpBits,
+		NULL, 0);
+	ReleaseDC(NULL, hdcScreen);
+	if (hBitmap == NULL)
+		return NULL;
+
+	// Copy the pixels over, flipping the rows.
+	for (int y = 0; y < nHeight; y++) {
+		DWORD *lpRow = (DWORD*)lpBits + ((nHeight - 1 - y) * nWidth);
+		const BmpPixel *lpSource = lpPixels + (y * nWidth);
+
+		for (int x = 0; x < nWidth; x++)
+			lpRow[x] = (DWORD)lpSource[x];
+	}
+
+	return hBitmap;
+}
@@ -9,14 +9,20 @@
 #define _IMAGE_UTILS_H
 
 #include <windows.h>
+#include "BmpImage.h"
 
 class ImageUtils {
 private:
 	ImageUtils() {}
 
+	static bool DecodeFile(LPCTSTR szPath, BmpImage *image);
+	static HBITMAP CreateBitmap(BmpImage *image);
+
 public:
 	static HBITMAP LoadBitmap(LPCTSTR szPath);
+	static HBITMAP LoadScaledBitmap(LPCTSTR szPath, int nWidth, int nHeight);
 	static HBITMAP ResizeBitmap(HBITMAP hbmpOriginal, int nWidth, int nHeight);
+	static bool SaveBitmap(HBITMAP hBitmap, LPCTSTR szPath);
 };
 
 #endif  // _IMAGE_UTILS_H
\ No newline at end of file
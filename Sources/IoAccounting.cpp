@@ -0,0 +1,209 @@
+/**
+ * IoAccounting.cpp
+ * Counts the file system operations done on behalf of each user action.
+ *
+ * User actions wrap their work in an IoScope, which sets the action that the
+ * current thread is working on. The counting calls sprinkled through the file
+ * system layer then add to the counters of that action. Worker threads open
+ * their own scopes for the action they are helping with, and everything done
+ * outside of a scope is counted as "other".
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "IoAccounting.h"
+
+// Value of an unallocated thread local storage index.
+#ifndef TLS_OUT_OF_INDEXES
+	#define TLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
+#endif
+
+// Static members.
+IoCounters IoAccounting::aCounters[IO_OP_COUNT];
+DWORD IoAccounting::dwTlsIndex = TLS_OUT_OF_INDEXES;
+
+// Names of the user actions.
+static LPCTSTR aszOperations[IO_OP_COUNT] = { L"other", L"open", L"refresh",
+	L"select", L"save" };
+
+/**
+ * Allocates the slot that keeps the action of each thread.
+ * @remark Must be called before any other thread is started.
+ */
+void IoAccounting::Initialize() {
+	if (dwTlsIndex == TLS_OUT_OF_INDEXES)
+		dwTlsIndex = TlsAlloc();
+	Reset();
+}
+
+/**
+ * Frees the slot that keeps the action of each thread.
+ * @remark Must only be called when no other threads are running.
+ */
+void IoAccounting::Release() {
+	if (dwTlsIndex != TLS_OUT_OF_INDEXES) {
+		TlsFree(dwTlsIndex);
+		dwTlsIndex = TLS_OUT_OF_INDEXES;
+	}
+}
+
+/**
+ * Gets the action that the current thread is working on.
+ *
+ * @return User action.
+ */
+int IoAccounting::GetOperation() {
+	if (dwTlsIndex == TLS_OUT_OF_INDEXES)
+		return IO_OP_OTHER;
+
+	// The slot starts out as NULL, which is the same as "other".
+	return (int)(DWORD_PTR)TlsGetValue(dwTlsIndex);
+}
+
+/**
+ * Sets the action that the current thread is working on.
+ *
+ * @param nOperation User action.
+ */
+void IoAccounting::SetOperation(int nOperation) {
+	if (dwTlsIndex != TLS_OUT_OF_INDEXES)
+		TlsSetValue(dwTlsIndex, (LPVOID)(DWORD_PTR)nOperation);
+}
+
+/**
+ * Counts a user action being done.
+ *
+ * @param nOperation User action.
+ */
+void IoAccounting::CountCall(int nOperation) {
+	InterlockedIncrement(&aCounters[nOperation].lCalls);
+}
+
+/**
+ * Counts a file being opened.
+ */
+void IoAccounting::CountOpen() {
+	InterlockedIncrement(&aCounters[GetOperation()].lOpens);
+}
+
+/**
+ * Counts a read from a file.
+ *
+ * @param dwBytes Number of bytes read.
+ */
+void IoAccounting::CountRead(DWORD dwBytes) {
+	IoCounters *counters = &aCounters[GetOperation()];
+
+	InterlockedIncrement(&counters->lReads);
+	InterlockedExchangeAdd(&counters->lBytesRead, (LONG)dwBytes);
+}
+
+/**
+ * Counts a write to a file.
+ *
+ * @param dwBytes Number of bytes written.
+ */
+void IoAccounting::CountWrite(DWORD dwBytes) {
+	IoCounters *counters = &aCounters[GetOperation()];
+
+	InterlockedIncrement(&counters->lWrites);
+	InterlockedExchangeAdd(&counters->lBytesWritten, (LONG)dwBytes);
+}
+
+/**
+ * Counts a directory listing.
+ */
+void IoAccounting::CountEnumeration() {
+	InterlockedIncrement(&aCounters[GetOperation()].lEnumerations);
+}
+
+/**
+ * Counts a check for the existence of a file.
+ */
+void IoAccounting::CountProbe() {
+	InterlockedIncrement(&aCounters[GetOperation()].lProbes);
+}
+
+/**
+ * Counts the deletion of a file.
+ */
+void IoAccounting::CountDelete() {
+	InterlockedIncrement(&aCounters[GetOperation()].lDeletes);
+}
+
+/**
+ * Gets the counters of a user action.
+ *
+ * @param  nOperation User action.
+ * @return            File system operations done by the action.
+ */
+IoCounters IoAccounting::GetCounters(int nOperation) {
+	return aCounters[nOperation];
+}
+
+/**
+ * Gets the name of a user action.
+ *
+ * @param  nOperation User action.
+ * @return            Name of the action.
+ */
+LPCTSTR IoAccounting::GetOperationName(int nOperation) {
+	return aszOperations[nOperation];
+}
+
+/**
+ * Resets every counter.
+ */
+void IoAccounting::Reset() {
+	memset(aCounters, 0, sizeof(aCounters));
+}
+
+/**
+ * Builds a JSON object with the counters of every user action.
+ *
+ * @return Counters as a JSON object.
+ */
+wstring IoAccounting::ToJSON() {
+	WCHAR szLine[320];
+	wstring swJSON(L"{");
+
+	for (int i = 0; i < IO_OP_COUNT; i++) {
+		IoCounters counters = aCounters[i];
+
+		swprintf(szLine, L"%s\r\n\t\t\"%s\": {\"calls\": %ld, \"opens\": %ld, "
+			L"\"reads\": %ld, \"bytes_read\": %ld, \"writes\": %ld, "
+			L"\"bytes_written\": %ld, \"enumerations\": %ld, \"probes\": %ld, "
+			L"\"deletes\": %ld}",
+			(i == 0) ? L"" : L",", aszOperations[i], counters.lCalls,
+			counters.lOpens, counters.lReads, counters.lBytesRead,
+			counters.lWrites, counters.lBytesWritten, counters.lEnumerations,
+			counters.lProbes, counters.lDeletes);
+		swJSON += szLine;
+	}
+	swJSON += L"\r\n\t}";
+
+	return swJSON;
+}
+
+/**
+ * Attributes everything the current thread does to a user action until the
+ * object goes out of scope. A scope inside another one of the same action
+ * isn't counted as a new call.
+ *
+ * @param nOperation User action.
+ */
+IoScope::IoScope(int nOperation) {
+	nPrevious = IoAccounting::GetOperation();
+	if (nPrevious == nOperation)
+		return;
+
+	IoAccounting::SetOperation(nOperation);
+	IoAccounting::CountCall(nOperation);
+}
+
+/**
+ * Goes back to the action that was being done before.
+ */
+IoScope::~IoScope() {
+	IoAccounting::SetOperation(nPrevious);
+}
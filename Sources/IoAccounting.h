@@ -0,0 +1,84 @@
+/**
+ * IoAccounting.h
+ * Counts the file system operations done on behalf of each user action.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _IO_ACCOUNTING_H
+#define _IO_ACCOUNTING_H
+
+#include <windows.h>
+#include <string>
+
+using namespace std;
+
+// User actions that file system operations are attributed to.
+#define IO_OP_OTHER   0
+#define IO_OP_OPEN    1
+#define IO_OP_REFRESH 2
+#define IO_OP_SELECT  3
+#define IO_OP_SAVE    4
+#define IO_OP_COUNT   5
+
+// File system operations done by a user action.
+typedef struct {
+	LONG lCalls;
+	LONG lOpens;
+	LONG lReads;
+	LONG lBytesRead;
+	LONG lWrites;
+	LONG lBytesWritten;
+	LONG lEnumerations;
+	LONG lProbes;
+	LONG lDeletes;
+} IoCounters;
+
+class IoAccounting {
+private:
+	static IoCounters aCounters[IO_OP_COUNT];
+	static DWORD dwTlsIndex;
+
+	IoAccounting() {}
+
+public:
+	// Initialization.
+	static void Initialize();
+	static void Release();
+
+	// Attribution.
+	static int GetOperation();
+	static void SetOperation(int nOperation);
+
+	// Counting.
+	static void CountCall(int nOperation);
+	static void CountOpen();
+	static void CountRead(DWORD dwBytes);
+	static void CountWrite(DWORD dwBytes);
+	static void CountEnumeration();
+	static void CountProbe();
+	static void CountDelete();
+
+	// Reporting.
+	static IoCounters GetCounters(int nOperation);
+	static LPCTSTR GetOperationName(int nOperation);
+	static void Reset();
+	static wstring ToJSON();
+};
+
+class IoScope {
+protected:
+	int nPrevious;
+
+private:
+	// Scopes can't be copied.
+	IoScope(const IoScope &scope);
+	IoScope& operator=(const IoScope &scope);
+
+public:
+	// Constructors and destructors.
+	IoScope(int nOperation);
+	~IoScope();
+};
+
+#endif  // _IO_ACCOUNTING_H
@@ -0,0 +1,303 @@
+/**
+ * LruCache.cpp
+ * Least recently used cache of arbitrary objects with a budget in bytes.
+ *
+ * Objects that are being used can be pinned, in which case they are never
+ * evicted, even if that means going over the budget for a while. Every Get
+ * or Put that returns an object pins it, and it must be unpinned with Release
+ * once it's no longer being used.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "LruCache.h"
+
+/**
+ * Initializes an empty cache.
+ *
+ * @param nBudget     Maximum number of bytes used by unpinned objects.
+ * @param lpFreeProc  Function used to free objects when they are evicted.
+ * @param lpFreeParam Parameter to be passed to the free function.
+ */
+LruCache::LruCache(size_t nBudget, LruFreeProc lpFreeProc, void *lpFreeParam) {
+	this->nBudget = nBudget;
+	this->lpFreeProc = lpFreeProc;
+	this->lpFreeParam = lpFreeParam;
+	nUsed = 0;
+	ResetStatistics();
+}
+
+/**
+ * Initializes an empty cache with the same settings as another one.
+ * @remark Cached objects are owned by a single cache, so they aren't copied.
+ *
+ * @param cache Cache to get the settings from.
+ */
+LruCache::LruCache(const LruCache &cache) {
+	nBudget = cache.nBudget;
+	lpFreeProc = cache.lpFreeProc;
+	lpFreeParam = cache.lpFreeParam;
+	nUsed = 0;
+	ResetStatistics();
+}
+
+/**
+ * Empties the cache and takes the settings of another one.
+ * @remark Cached objects are owned by a single cache, so they aren't copied.
+ *
+ * @param  cache Cache to get the settings from.
+ * @return       This cache.
+ */
+LruCache& LruCache::operator=(const LruCache &cache) {
+	if (this == &cache)
+		return *this;
+
+	Clear();
+	nBudget = cache.nBudget;
+	lpFreeProc = cache.lpFreeProc;
+	lpFreeParam = cache.lpFreeParam;
+	ResetStatistics();
+
+	return *this;
+}
+
+/**
+ * Frees every object in the cache.
+ */
+LruCache::~LruCache() {
+	Clear();
+}
+
+/**
+ * Gets an object from the cache and pins it.
+ *
+ * @param  swKey Key of the object.
+ * @return       The object or NULL if it isn't cached.
+ */
+void* LruCache::Get(const wstring &swKey) {
+	map<wstring, LruList::iterator>::iterator it;
+
+	it = mapEntries.find(swKey);
+	if (it == mapEntries.end()) {
+		nMisses++;
+		return NULL;
+	}
+
+	// Move it to the front of the list.
+	nHits++;
+	lstEntries.splice(lstEntries.begin(), lstEntries, it->second);
+	it->second->nPins++;
+
+	return it->second->lpData;
+}
+
+/**
+ * Places an object in the cache and pins it. The cache takes ownership of the
+ * object and older objects are evicted to stay within the budget.
+ *
+ * @param  swKey  Key of the object.
+ * @param  lpData Object to be cached.
+ * @param  nBytes Number of bytes used by the object.
+ * @return        FALSE if there's already a pinned object with the same key,
+ *                in which case the cache doesn't take ownership of this one.
+ */
+bool LruCache::Put(const wstring &swKey, void *lpData, size_t nBytes) {
+	map<wstring, LruList::iterator>::iterator it;
+	LruEntry entry;
+
+	// Replace an older version of the object.
+	it = mapEntries.find(swKey);
+	if (it != mapEntries.end()) {
+		if (it->second->nPins > 0)
+			return false;
+
+		Evict(it->second);
+	}
+
+	// Make room for it.
+	Trim((nBytes < nBudget) ? nBudget - nBytes : 0);
+
+	// Add it to the front of the list.
+	entry.swKey = swKey;
+	entry.lpData = lpData;
+	entry.nBytes = nBytes;
+	entry.nPins = 1;
+	lstEntries.push_front(entry);
+	mapEntries[swKey] = lstEntries.begin();
+	nUsed += nBytes;
+
+	return true;
+}
+
+/**
+ * Unpins an object that was returned by Get or Put.
+ *
+ * @param swKey Key of the object.
+ */
+void LruCache::Release(const wstring &swKey) {
+	map<wstring, LruList::iterator>::iterator it;
+
+	it = mapEntries.find(swKey);
+	if ((it == mapEntries.end()) || (it->second->nPins == 0))
+		return;
+
+	it->second->nPins--;
+
+	// We may have gone over the budget while it was pinned.
+	if (nUsed > nBudget)
+		Trim(nBudget);
+}
+
+/**
+ * Checks if an object is in the cache without pinning it or counting it as a
+ * hit or miss.
+ *
+ * @param  swKey Key of the object.
+ * @return       TRUE if the object is cached.
+ */
+bool LruCache::Contains(const wstring &swKey) {
+	return mapEntries.find(swKey) != mapEntries.end();
+}
+
+/**
+ * Evicts the least recently used objects that aren't pinned until the cache
+ * is using at most a number of bytes.
+ *
+ * @param  nTarget Number of bytes the cache should be using.
+ * @return         Number of bytes that were freed.
+ */
+size_t LruCache::Trim(size_t nTarget) {
+	LruList::iterator it = lstEntries.end();
+	size_t nFreed = 0;
+
+	while ((nUsed > nTarget) && (it != lstEntries.begin())) {
+		it--;
+
+		// Pinned objects can't go anywhere.
+		if (it->nPins > 0)
+			continue;
+
+		nFreed += it->nBytes;
+		Evict(it++);
+		nEvictions++;
+	}
+
+	return nFreed;
+}
+
+/**
+ * Frees every object in the cache, pinned or not.
+ */
+void LruCache::Clear() {
+	while (!lstEntries.empty())
+		Evict(lstEntries.begin());
+}
+
+/**
+ * Removes an object from the cache and frees it.
+ *
+ * @param it Position of the object in the list.
+ */
+void LruCache::Evict(LruList::iterator it) {
+	nUsed -= it->nBytes;
+	if (lpFreeProc != NULL)
+		lpFreeProc(it->lpData, lpFreeParam);
+
+	mapEntries.erase(it->swKey);
+	lstEntries.erase(it);
+}
+
+/**
+ * Gets the maximum number of bytes used by unpinned objects.
+ *
+ * @return Budget in bytes.
+ */
+size_t LruCache::GetBudget() {
+	return nBudget;
+}
+
+/**
+ * Sets the maximum number of bytes used by unpinned objects, evicting objects
+ * if needed.
+ *
+ * @param nBudget Budget in bytes.
+ */
+void LruCache::SetBudget(size_t nBudget) {
+	this->nBudget = nBudget;
+	Trim(nBudget);
+}
+
+/**
+ * Gets the number of bytes used by the objects in the cache.
+ *
+ * @return Used bytes.
+ */
+size_t LruCache::GetUsedBytes() {
+	return nUsed;
+}
+
+/**
+ * Gets the number of objects in the cache.
+ *
+ * @return Number of objects.
+ */
+size_t LruCache::GetCount() {
+	return mapEntries.size();
+}
+
+/**
+ * Gets the number of times Get found the object it was looking for.
+ *
+ * @return Number of cache hits.
+ */
+size_t LruCache::GetHits() {
+	return nHits;
+}
+
+/**
+ * Gets the number of times Get didn't find the object it was looking for.
+ *
+ * @return Number of cache misses.
+ */
+size_t LruCache::GetMisses() {
+	return nMisses;
+}
+
+/**
+ * Gets the number of objects that were evicted to make room for others.
+ *
+ * @return Number of evictions.
+ */
+size_t LruCache::GetEvictions() {
+	return nEvictions;
+}
+
+/**
+ * Resets the hit, miss and eviction counters.
+ */
+void LruCache::ResetStatistics() {
+	nHits = 0;
+	nMisses = 0;
+	nEvictions = 0;
+}
+
+/**
+ * Accounts for the memory used by the cache, including the object itself and
+ * the cached objects.
+ *
+ * @param report     Report to add the memory to.
+ * @param nSubsystem Subsystem that the cache belongs to.
+ */
+void LruCache::AccountMemory(MemoryReport *report, int nSubsystem) {
+	report->Add(nSubsystem, sizeof(LruCache) + nUsed +
+		(lstEntries.size() * (MEMORY_LIST_NODE + sizeof(LruEntry))));
+	report->AddMapNodes(nSubsystem, mapEntries.size(),
+		sizeof(wstring) + sizeof(LruList::iterator));
+
+	// Each key is kept twice.
+	for (LruList::iterator it = lstEntries.begin(); it != lstEntries.end();
+			it++) {
+		report->AddString(nSubsystem, it->swKey);
+		report->AddString(nSubsystem, it->swKey);
+	}
+}
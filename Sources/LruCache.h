@@ -0,0 +1,80 @@
+/**
+ * LruCache.h
+ * Least recently used cache of arbitrary objects with a budget in bytes.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _LRU_CACHE_H
+#define _LRU_CACHE_H
+
+#include <stddef.h>
+#include <string>
+#include <list>
+#include <map>
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Function that frees an object that was evicted from the cache.
+typedef void (*LruFreeProc)(void *lpData, void *lpParam);
+
+class LruCache {
+protected:
+	// A cached object.
+	typedef struct {
+		wstring swKey;
+		void *lpData;
+		size_t nBytes;
+		size_t nPins;
+	} LruEntry;
+	typedef list<LruEntry> LruList;
+
+	LruList lstEntries;
+	map<wstring, LruList::iterator> mapEntries;
+	LruFreeProc lpFreeProc;
+	void *lpFreeParam;
+	size_t nBudget;
+	size_t nUsed;
+
+	// Statistics.
+	size_t nHits;
+	size_t nMisses;
+	size_t nEvictions;
+
+	// Entries.
+	void Evict(LruList::iterator it);
+
+public:
+	// Constructors and destructors.
+	LruCache(size_t nBudget, LruFreeProc lpFreeProc, void *lpFreeParam);
+	LruCache(const LruCache &cache);
+	LruCache& operator=(const LruCache &cache);
+	~LruCache();
+
+	// Operations.
+	void* Get(const wstring &swKey);
+	bool Put(const wstring &swKey, void *lpData, size_t nBytes);
+	void Release(const wstring &swKey);
+	bool Contains(const wstring &swKey);
+	size_t Trim(size_t nTarget);
+	void Clear();
+
+	// Budget.
+	size_t GetBudget();
+	void SetBudget(size_t nBudget);
+	size_t GetUsedBytes();
+	size_t GetCount();
+
+	// Statistics.
+	size_t GetHits();
+	size_t GetMisses();
+	size_t GetEvictions();
+	void ResetStatistics();
+
+	// Memory.
+	void AccountMemory(MemoryReport *report, int nSubsystem);
+};
+
+#endif  // _LRU_CACHE_H
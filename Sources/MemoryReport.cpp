@@ -0,0 +1,134 @@
+/**
+ * MemoryReport.cpp
+ * Adds up how many bytes each subsystem of the application is holding on to.
+ *
+ * Each class that holds a significant amount of memory knows how to account
+ * for itself, so the report is built by walking the live objects rather than
+ * by watching the allocator. The figures are the sizes of the objects plus
+ * what their strings and containers allocated, with an estimate of the STL's
+ * own bookkeeping. They don't include the allocator's overhead or anything
+ * held by the system on our behalf, such as the TreeView items themselves.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "MemoryReport.h"
+
+// Names of the subsystems.
+static const wchar_t *aszSubsystems[MEMORY_SUBSYSTEMS] = { L"properties",
+	L"paths", L"components", L"categories", L"tree", L"images", L"indexes" };
+
+/**
+ * Initializes an empty report.
+ */
+MemoryReport::MemoryReport() {
+	Clear();
+}
+
+/**
+ * Attributes some memory to a subsystem.
+ *
+ * @param nSubsystem Subsystem that holds the memory.
+ * @param nBytes     Number of bytes.
+ */
+void MemoryReport::Add(int nSubsystem, size_t nBytes) {
+	anBytes[nSubsystem] += nBytes;
+}
+
+/**
+ * Attributes the characters of a string to a subsystem. The string object
+ * itself should be accounted for by whatever contains it.
+ *
+ * @param nSubsystem Subsystem that holds the string.
+ * @param swString   String to be accounted for.
+ */
+void MemoryReport::AddString(int nSubsystem, const wstring &swString) {
+	anBytes[nSubsystem] += (swString.capacity() + 1) * sizeof(wchar_t);
+}
+
+/**
+ * Attributes the nodes of a map to a subsystem. Whatever the keys and values
+ * point to should be accounted for separately.
+ *
+ * @param nSubsystem Subsystem that holds the map.
+ * @param nCount     Number of nodes in the map.
+ * @param nValueSize Size of the key and value pair of each node.
+ */
+void MemoryReport::AddMapNodes(int nSubsystem, size_t nCount,
+							   size_t nValueSize) {
+	anBytes[nSubsystem] += nCount * (MEMORY_MAP_NODE + nValueSize);
+}
+
+/**
+ * Adds to the number of components that were accounted for.
+ *
+ * @param nCount Number of components.
+ */
+void MemoryReport::AddComponents(size_t nCount) {
+	nComponents += nCount;
+}
+
+/**
+ * Starts the report from scratch.
+ */
+void MemoryReport::Clear() {
+	for (int i = 0; i < MEMORY_SUBSYSTEMS; i++)
+		anBytes[i] = 0;
+	nComponents = 0;
+}
+
+/**
+ * Gets the memory held by a subsystem.
+ *
+ * @param  nSubsystem Subsystem.
+ * @return            Number of bytes.
+ */
+size_t MemoryReport::GetBytes(int nSubsystem) {
+	return anBytes[nSubsystem];
+}
+
+/**
+ * Gets the memory held by every subsystem.
+ *
+ * @return Number of bytes.
+ */
+size_t MemoryReport::GetTotal() {
+	size_t nTotal = 0;
+
+	for (int i = 0; i < MEMORY_SUBSYSTEMS; i++)
+		nTotal += anBytes[i];
+
+	return nTotal;
+}
+
+/**
+ * Gets the number of components that were accounted for.
+ *
+ * @return Number of components.
+ */
+size_t MemoryReport::GetComponents() {
+	return nComponents;
+}
+
+/**
+ * Gets how much memory each component costs on average, including its share
+ * of everything that grows with the number of components.
+ *
+ * @return Number of bytes per component or 0 if there are no components.
+ */
+size_t MemoryReport::GetPerComponent() {
+	if (nComponents == 0)
+		return 0;
+
+	return GetTotal() / nComponents;
+}
+
+/**
+ * Gets the name of a subsystem.
+ *
+ * @param  nSubsystem Subsystem.
+ * @return            Name of the subsystem.
+ */
+const wchar_t* MemoryReport::GetSubsystemName(int nSubsystem) {
+	return aszSubsystems[nSubsystem];
+}
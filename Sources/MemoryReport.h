@@ -0,0 +1,55 @@
+/**
+ * MemoryReport.h
+ * Adds up how many bytes each subsystem of the application is holding on to.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _MEMORY_REPORT_H
+#define _MEMORY_REPORT_H
+
+#include <stddef.h>
+#include <string>
+
+using namespace std;
+
+// Subsystems that memory is attributed to.
+#define MEMORY_PROPERTIES 0
+#define MEMORY_PATHS      1
+#define MEMORY_COMPONENTS 2
+#define MEMORY_CATEGORIES 3
+#define MEMORY_TREE       4
+#define MEMORY_IMAGES     5
+#define MEMORY_INDEXES    6
+#define MEMORY_SUBSYSTEMS 7
+
+// Estimated bookkeeping of each node of the STL containers.
+#define MEMORY_MAP_NODE  (sizeof(int) + (3 * sizeof(void*)))
+#define MEMORY_LIST_NODE (2 * sizeof(void*))
+
+class MemoryReport {
+protected:
+	size_t anBytes[MEMORY_SUBSYSTEMS];
+	size_t nComponents;
+
+public:
+	// Constructors and destructors.
+	MemoryReport();
+
+	// Accounting.
+	void Add(int nSubsystem, size_t nBytes);
+	void AddString(int nSubsystem, const wstring &swString);
+	void AddMapNodes(int nSubsystem, size_t nCount, size_t nValueSize);
+	void AddComponents(size_t nCount);
+	void Clear();
+
+	// Results.
+	size_t GetBytes(int nSubsystem);
+	size_t GetTotal();
+	size_t GetComponents();
+	size_t GetPerComponent();
+	static const wchar_t* GetSubsystemName(int nSubsystem);
+};
+
+#endif  // _MEMORY_REPORT_H
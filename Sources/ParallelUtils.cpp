@@ -0,0 +1,103 @@
+/**
+ * ParallelUtils.cpp
+ * A bunch of utilities to split work across multiple threads.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "ParallelUtils.h"
+
+// Limits.
+#define MAX_WORKERS         8
+#define MIN_ITEMS_PER_CHUNK 64
+
+// A contiguous range of items handled by a single worker.
+typedef struct {
+	size_t nStart;
+	size_t nEnd;
+	ParallelItemProc lpProc;
+	LPVOID lpParam;
+} WorkerChunk;
+
+/**
+ * Gets the number of workers that should be used for parallel operations.
+ *
+ * @return Number of processors available.
+ */
+size_t ParallelUtils::GetWorkerCount() {
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+
+	if (si.dwNumberOfProcessors < 1)
+		return 1;
+	if (si.dwNumberOfProcessors > MAX_WORKERS)
+		return MAX_WORKERS;
+
+	return si.dwNumberOfProcessors;
+}
+
+/**
+ * Calls a function for every item in a range, splitting the range into chunks
+ * that are processed by different threads.
+ * @remark The calling thread processes the first chunk itself and only returns
+ *         after every item has been processed.
+ *
+ * @param nCount  Number of items to process.
+ * @param lpProc  Function that processes a single item.
+ * @param lpParam Parameter passed to the function.
+ */
+void ParallelUtils::ForEach(size_t nCount, ParallelItemProc lpProc,
+							LPVOID lpParam) {
+	WorkerChunk chunks[MAX_WORKERS];
+	HANDLE hThreads[MAX_WORKERS];
+	size_t nWorkers = GetWorkerCount();
+	size_t nChunkSize;
+	size_t i;
+
+	// Don't bother with threads for small jobs.
+	if ((nCount / MIN_ITEMS_PER_CHUNK) < nWorkers)
+		nWorkers = (nCount / MIN_ITEMS_PER_CHUNK) + 1;
+	nChunkSize = (nCount + nWorkers - 1) / nWorkers;
+
+	// Split the work.
+	for (i = 0; i < nWorkers; i++) {
+		chunks[i].nStart = i * nChunkSize;
+		chunks[i].nEnd = chunks[i].nStart + nChunkSize;
+		if (chunks[i].nEnd > nCount)
+			chunks[i].nEnd = nCount;
+		chunks[i].lpProc = lpProc;
+		chunks[i].lpParam = lpParam;
+	}
+
+	// Start the workers. If a thread can't be created we do its work ourselves.
+	hThreads[0] = NULL;
+	for (i = 1; i < nWorkers; i++) {
+		hThreads[i] = CreateThread(NULL, 0, WorkerThreadProc, &chunks[i], 0, NULL);
+		if (hThreads[i] == NULL)
+			WorkerThreadProc(&chunks[i]);
+	}
+
+	// Do our part and wait for everyone else.
+	WorkerThreadProc(&chunks[0]);
+	for (i = 1; i < nWorkers; i++) {
+		if (hThreads[i] != NULL) {
+			WaitForSingleObject(hThreads[i], INFINITE);
+			CloseHandle(hThreads[i]);
+		}
+	}
+}
+
+/**
+ * Processes a chunk of items.
+ *
+ * @param  lpParam Pointer to the WorkerChunk to be processed.
+ * @return         Always 0.
+ */
+DWORD WINAPI ParallelUtils::WorkerThreadProc(LPVOID lpParam) {
+	WorkerChunk *chunk = (WorkerChunk*)lpParam;
+
+	for (size_t i = chunk->nStart; i < chunk->nEnd; i++)
+		chunk->lpProc(i, chunk->lpParam);
+
+	return 0;
+}
@@ -0,0 +1,27 @@
+/**
+ * ParallelUtils.h
+ * A bunch of utilities to split work across multiple threads.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _PARALLEL_UTILS_H
+#define _PARALLEL_UTILS_H
+
+#include <windows.h>
+
+// Function that processes a single item of a parallel operation.
+typedef void (*ParallelItemProc)(size_t nIndex, LPVOID lpParam);
+
+class ParallelUtils {
+private:
+	ParallelUtils() {}
+
+	static DWORD WINAPI WorkerThreadProc(LPVOID lpParam);
+
+public:
+	static size_t GetWorkerCount();
+	static void ForEach(size_t nCount, ParallelItemProc lpProc, LPVOID lpParam);
+};
+
+#endif  // _PARALLEL_UTILS_H
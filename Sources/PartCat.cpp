@@ -16,6 +16,12 @@
 #include "TreeView.h"
 #include "Workspace.h"
 #include "UIManager.h"
+#include "ImageLoader.h"
+#include "DetailLoader.h"
+#include "Tracer.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
+#include "Benchmark.h"
 
 // Styling stuff.
 #define DEFAULT_UI_MARGIN 7
@@ -45,6 +51,8 @@ TreeView treeView;
 Workspace workspace;
 Settings settings;
 UIManager uiManager;
+ImageLoader imageLoader;
+DetailLoader detailLoader;
 
 #ifdef SHELL_AYGSHELL
 // Pocket PC specific components.
@@ -71,11 +79,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	HACCEL hAccel;
 	int rc;
 
+	// Copies of ourselves started by the benchmark never show up.
+	if (Benchmark::IsChild(lpCmdLine))
+		return Benchmark::RunChild(lpCmdLine);
+
 	// Initialize the application.
 	rc = InitializeApplication(hInstance);
 	if (rc)
 		return 0;
 
+	// Start counting the file system operations.
+	IoAccounting::Initialize();
+
 	// Initialize this single instance.
 	hwndMain = InitializeInstance(hInstance, lpCmdLine, nShowCmd);
 	if (hwndMain == 0)
@@ -236,6 +251,14 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lPar
 		return WndMainSettingChange(hWnd, wMsg, wParam, lParam);
 	case WM_ACTIVATE:
 		return WndMainActivate(hWnd, wMsg, wParam, lParam);
+	case WM_HIBERNATE:
+		return WndMainHibernate(hWnd, wMsg, wParam, lParam);
+	case WM_TIMER:
+		return WndMainTimer(hWnd, wMsg, wParam, lParam);
+	case WM_IMAGELOADED:
+		return uiManager.ImageLoaded((LoadedImage*)lParam);
+	case WM_DETAILREADY:
+		return uiManager.DetailReady((DetailModel*)lParam);
 	case WM_CLOSE:
 		return WndMainClose(hWnd, wMsg, wParam, lParam);
 	case WM_DESTROY:
@@ -356,7 +379,8 @@ LRESULT WndMainCreate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 	// Initialize settings and UI manager.
 	settings = Settings(&hInst, &hwndMain);
 	uiManager = UIManager(&hInst, &hwndMain, &settings, &workspace, &treeView, &hIml,
-		&hwndDetail, (DLGPROC)DetailDlgProc);
+		&hwndDetail, (DLGPROC)DetailDlgProc, &imageLoader,
+		&detailLoader);
 
 	// Load the last opened workspace if available.
 	if (settings.GetLastOpenedWorkspace() != NULL) {
@@ -364,6 +388,9 @@ LRESULT WndMainCreate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 		uiManager.OpenWorkspace(true);
 	}
 
+	// Keep an eye on the memory load every now and then.
+	SetTimer(hWnd, IDT_MEMORY_LOAD, MEMORY_LOAD_INTERVAL, NULL);
+
 	return 0;
 }
 
@@ -387,12 +414,26 @@ LRESULT WndMainInitMenuPopUp(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam)
 	// Enable and disable workspace related items.
 	if (workspace.IsOpened()) {
 		EnableMenuItem(hMenu, IDM_FILE_NEW_COMP, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_NEW_SMARTFOLDER, MF_BYCOMMAND | MF_ENABLED);
 		EnableMenuItem(hMenu, IDM_FILE_REFRESHWS, MF_BYCOMMAND | MF_ENABLED);
 		EnableMenuItem(hMenu, IDM_FILE_CLOSEWS, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_EXPORTREORDER, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_FINDDUPLICATES, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_IMPORTBOM, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_TOPCONSUMERS, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_REBUILDTHUMBS, MF_BYCOMMAND | MF_ENABLED);
+		EnableMenuItem(hMenu, IDM_FILE_DEDUPASSETS, MF_BYCOMMAND | MF_ENABLED);
 	} else {
 		EnableMenuItem(hMenu, IDM_FILE_NEW_COMP, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_NEW_SMARTFOLDER, MF_BYCOMMAND | MF_GRAYED);
 		EnableMenuItem(hMenu, IDM_FILE_REFRESHWS, MF_BYCOMMAND | MF_GRAYED);
 		EnableMenuItem(hMenu, IDM_FILE_CLOSEWS, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_EXPORTREORDER, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_FINDDUPLICATES, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_IMPORTBOM, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_TOPCONSUMERS, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_REBUILDTHUMBS, MF_BYCOMMAND | MF_GRAYED);
+		EnableMenuItem(hMenu, IDM_FILE_DEDUPASSETS, MF_BYCOMMAND | MF_GRAYED);
 	}
 
 	// Enable and disable component related items.
@@ -441,6 +482,8 @@ LRESULT WndMainCommand(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 	case IDC_BTNEWWS:
 	case IDM_FILE_NEW_WORKSPACE:
 		return uiManager.CreateWorkspace();
+	case IDM_FILE_NEW_SMARTFOLDER:
+		return uiManager.CreateSmartFolder();
 	case IDC_BTOPENWS:
 	case IDM_FILE_OPENWS:
 		return uiManager.OpenWorkspace(false);
@@ -448,6 +491,18 @@ LRESULT WndMainCommand(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 		return uiManager.RefreshWorkspace();
 	case IDM_FILE_CLOSEWS:
 		return uiManager.CloseWorkspace();
+	case IDM_FILE_EXPORTREORDER:
+		return uiManager.ExportReorderList();
+	case IDM_FILE_FINDDUPLICATES:
+		return uiManager.FindDuplicates();
+	case IDM_FILE_IMPORTBOM:
+		return uiManager.ImportBom();
+	case IDM_FILE_TOPCONSUMERS:
+		return uiManager.ShowTopConsumers();
+	case IDM_FILE_REBUILDTHUMBS:
+		return uiManager.RebuildThumbnails();
+	case IDM_FILE_DEDUPASSETS:
+		return uiManager.DeduplicateAssets();
 	case IDM_FILE_EXIT:
 		return SendMessage(hWnd, WM_CLOSE, 0, 0);
 	case IDC_BTSAVECOMP:
@@ -471,6 +526,18 @@ LRESULT WndMainCommand(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 		return uiManager.ShowDatasheet();
 //	case IDM_TOOLS_SETTINGS:
 //		return settings.ShowDialog();
+	case IDM_HELP_LATENCY:
+		return uiManager.ShowSelectionLatency();
+	case IDM_HELP_BENCHMARK:
+		return uiManager.RunBenchmark();
+	case IDM_HELP_TRACE:
+		return uiManager.ToggleTracing();
+	case IDM_HELP_SAVETRACE:
+		return uiManager.SaveTrace();
+	case IDM_HELP_IOSTATS:
+		return uiManager.ShowIoStatistics();
+	case IDM_HELP_MEMORY:
+		return uiManager.ShowMemoryUsage();
 	case IDM_HELP_ABOUT:
 		DialogBox(hInst, MAKEINTRESOURCE(IDD_ABOUTBOX), hWnd, (DLGPROC)AboutDlgProc);
 		return 0;
@@ -492,6 +559,10 @@ LRESULT WndMainNotify(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 	switch (((LPNMHDR)lParam)->code) {
 	case TVN_SELCHANGED:
 		return uiManager.TreeViewSelectionChanged(hWnd, wMsg, wParam, lParam);
+	case TVN_ITEMEXPANDING:
+		return uiManager.TreeViewItemExpanding(hWnd, wMsg, wParam, lParam);
+	case TVN_ITEMEXPANDED:
+		return uiManager.TreeViewItemExpanded(hWnd, wMsg, wParam, lParam);
 	}
 
 	return 0;
@@ -533,6 +604,38 @@ LRESULT WndMainActivate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
 	return 0;
 }
 
+/**
+ * Process the WM_HIBERNATE message for the window, which is sent when the
+ * system is running low on memory.
+ *
+ * @param  hWnd   Window handler.
+ * @param  wMsg   Message type.
+ * @param  wParam Message parameter.
+ * @param  lParam Message parameter.
+ * @return        0 if everything worked.
+ */
+LRESULT WndMainHibernate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
+	uiManager.ReleaseMemory();
+	return 0;
+}
+
+/**
+ * Process the WM_TIMER message for the window.
+ *
+ * @param  hWnd   Window handler.
+ * @param  wMsg   Message type.
+ * @param  wParam Timer ID.
+ * @param  lParam Message parameter.
+ * @return        0 if everything worked.
+ */
+LRESULT WndMainTimer(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
+	// Keep the caches in line with how much memory the system has left.
+	if (wParam == IDT_MEMORY_LOAD)
+		uiManager.CheckMemoryLoad();
+
+	return 0;
+}
+
 /**
  * Process the WM_CLOSE message for the window.
  *
@@ -564,6 +667,16 @@ LRESULT WndMainClose(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
  * @return        0 if everything worked.
  */
 LRESULT WndMainDestroy(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam) {
+	// Stop checking the memory load.
+	KillTimer(hWnd, IDT_MEMORY_LOAD);
+
+	// Stop loading images and details in the background.
+	imageLoader.Stop();
+	detailLoader.Stop();
+	Tracer::Release();
+	AllocProfiler::Release();
+	IoAccounting::Release();
+
 	// Post quit message and return.
 	PostQuitMessage(0);
 	return 0;
@@ -32,6 +32,10 @@
 #define IDC_BTEDITPROP 217
 #define IDC_BTDELPROP  218
 
+// Timers.
+#define IDT_MEMORY_LOAD      1
+#define MEMORY_LOAD_INTERVAL 5000
+
 // Number of bitmaps in the standard and view image lists.
 #define STD_BMPS_LEN  STD_PRINT + 1
 #define VIEW_BMPS_LEN VIEW_NEWFOLDER + 1
@@ -53,6 +57,8 @@ LRESULT WndMainInitMenuPopUp(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam)
 LRESULT WndMainNotify(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
 LRESULT WndMainSettingChange(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
 LRESULT WndMainActivate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
+LRESULT WndMainHibernate(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
+LRESULT WndMainTimer(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
 LRESULT WndMainClose(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
 LRESULT WndMainDestroy(HWND hWnd, UINT wMsg, WPARAM wParam, LPARAM lParam);
 
@@ -0,0 +1,143 @@
+/**
+ * PrefetchQueue.cpp
+ * Decides which images should be loaded in the background and in which order.
+ *
+ * Every time the selection changes a new generation starts. Whatever was
+ * still waiting to be loaded for the previous selection is dropped, since the
+ * user has already moved on, and the queue is refilled with the selected
+ * image followed by the images of its neighbours, closest ones first.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "PrefetchQueue.h"
+
+/**
+ * Initializes an empty queue with the default limit.
+ */
+PrefetchQueue::PrefetchQueue() {
+	ulGeneration = 0;
+	nMaxPending = PREFETCH_MAX_PENDING;
+}
+
+/**
+ * Initializes an empty queue.
+ *
+ * @param nMaxPending Maximum number of requests waiting to be loaded.
+ */
+PrefetchQueue::PrefetchQueue(size_t nMaxPending) {
+	ulGeneration = 0;
+	this->nMaxPending = nMaxPending;
+}
+
+/**
+ * Starts a new generation for a new selection.
+ *
+ * @param  swSelected    Key of the selected image or an empty string if it
+ *                       doesn't have to be loaded.
+ * @param  arrNeighbours Keys of the images that may be selected next, most
+ *                       likely ones first. Empty keys are ignored.
+ * @return               Generation of the new selection.
+ */
+unsigned long PrefetchQueue::Select(const wstring &swSelected,
+									const vector<wstring> &arrNeighbours) {
+	ulGeneration++;
+	queRequests.clear();
+
+	// The selected image always goes first.
+	if (!swSelected.empty())
+		Push(swSelected, true);
+
+	// Followed by as many neighbours as we are allowed to.
+	for (size_t i = 0; i < arrNeighbours.size(); i++) {
+		if (queRequests.size() >= nMaxPending)
+			break;
+
+		if (!arrNeighbours[i].empty() && !IsQueued(arrNeighbours[i]))
+			Push(arrNeighbours[i], false);
+	}
+
+	return ulGeneration;
+}
+
+/**
+ * Takes the next request out of the queue.
+ *
+ * @param  request Request to be populated.
+ * @return         FALSE if there's nothing left to load.
+ */
+bool PrefetchQueue::Pop(PrefetchRequest *request) {
+	if (queRequests.empty())
+		return false;
+
+	*request = queRequests.front();
+	queRequests.pop_front();
+
+	return true;
+}
+
+/**
+ * Drops every pending request.
+ */
+void PrefetchQueue::Clear() {
+	ulGeneration++;
+	queRequests.clear();
+}
+
+/**
+ * Checks if a request belongs to the current selection.
+ *
+ * @param  ulGeneration Generation of the request.
+ * @return              TRUE if the selection hasn't changed since.
+ */
+bool PrefetchQueue::IsCurrent(unsigned long ulGeneration) {
+	return this->ulGeneration == ulGeneration;
+}
+
+/**
+ * Gets the generation of the current selection.
+ *
+ * @return Current generation.
+ */
+unsigned long PrefetchQueue::GetGeneration() {
+	return ulGeneration;
+}
+
+/**
+ * Gets the number of requests waiting to be loaded.
+ *
+ * @return Pending requests.
+ */
+size_t PrefetchQueue::GetPending() {
+	return queRequests.size();
+}
+
+/**
+ * Checks if an image is already waiting to be loaded.
+ *
+ * @param  swKey Key of the image.
+ * @return       TRUE if it's in the queue.
+ */
+bool PrefetchQueue::IsQueued(const wstring &swKey) {
+	for (size_t i = 0; i < queRequests.size(); i++) {
+		if (queRequests[i].swKey == swKey)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Adds a request to the end of the queue.
+ *
+ * @param swKey     Key of the image.
+ * @param bSelected Is this the selected image?
+ */
+void PrefetchQueue::Push(const wstring &swKey, bool bSelected) {
+	PrefetchRequest request;
+
+	request.swKey = swKey;
+	request.bSelected = bSelected;
+	request.ulGeneration = ulGeneration;
+	queRequests.push_back(request);
+}
@@ -0,0 +1,56 @@
+/**
+ * PrefetchQueue.h
+ * Decides which images should be loaded in the background and in which order.
+ * @remark This class doesn't depend on any platform specific API and isn't
+ *         thread safe on its own.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _PREFETCH_QUEUE_H
+#define _PREFETCH_QUEUE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+// Maximum number of requests waiting to be loaded.
+#define PREFETCH_MAX_PENDING 8
+
+// A single image to be loaded.
+typedef struct {
+	wstring swKey;
+	bool bSelected;
+	unsigned long ulGeneration;
+} PrefetchRequest;
+
+class PrefetchQueue {
+protected:
+	deque<PrefetchRequest> queRequests;
+	unsigned long ulGeneration;
+	size_t nMaxPending;
+
+	// Helpers.
+	bool IsQueued(const wstring &swKey);
+	void Push(const wstring &swKey, bool bSelected);
+
+public:
+	// Constructors and destructors.
+	PrefetchQueue();
+	PrefetchQueue(size_t nMaxPending);
+
+	// Scheduling.
+	unsigned long Select(const wstring &swSelected,
+						 const vector<wstring> &arrNeighbours);
+	bool Pop(PrefetchRequest *request);
+	void Clear();
+
+	// Status.
+	bool IsCurrent(unsigned long ulGeneration);
+	unsigned long GetGeneration();
+	size_t GetPending();
+};
+
+#endif  // _PREFETCH_QUEUE_H
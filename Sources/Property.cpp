@@ -7,6 +7,7 @@
 
 #include "Property.h"
 #include "Constants.h"
+#include "AllocProfiler.h"
 
 /**
  * Initializes an empty property.
@@ -83,8 +84,8 @@ LPTSTR Property::GetHumanName() {
 	LPTSTR szName;
 
 	// Allocate memory for the string and copy it.
-	szName = (LPTSTR)LocalAlloc(LMEM_FIXED, (wcslen(this->szName) + 1) *
-		sizeof(WCHAR));
+	szName = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		(wcslen(this->szName) + 1) * sizeof(WCHAR), L"Property::GetHumanName");
 	wcscpy(szName, this->szName);
 
 	// Substitute the dashes for spaces.
@@ -126,7 +127,8 @@ void Property::SetHumanName(LPCTSTR szName) {
 	// Check for keys that should have Value- prepended.
 	if ((swBuffer.compare(PROPERTY_CATEGORY) != 0) &&
 		(swBuffer.compare(PROPERTY_SUBCATEGORY) != 0) &&
-		(swBuffer.compare(PROPERTY_PACKAGE) != 0)) {
+		(swBuffer.compare(PROPERTY_PACKAGE) != 0) &&
+		(swBuffer.compare(PROPERTY_REORDER) != 0)) {
 		swBuffer.insert(0, L"-");
 		swBuffer.insert(0, PROPERTY_VALUE);
 	}
@@ -190,14 +192,15 @@ LPTSTR Property::ToHumanString() {
 
 	// Allocate the memory for the string.
 	size_t nLen = wcslen(szName) + wcslen(szValue) + 3;
-	LPTSTR szBuffer = (LPTSTR)LocalAlloc(LMEM_FIXED, nLen * sizeof(WCHAR));
+	LPTSTR szBuffer = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		nLen * sizeof(WCHAR), L"Property::ToHumanString");
 
 	// Build the string.
 	wcscpy(szBuffer, szName);
 	wcscat(szBuffer, L": ");
 	wcscat(szBuffer, szValue);
 
-	LocalFree(szName);
+	AllocProfiler::Free(szName);
 	return szBuffer;
 }
 
@@ -210,7 +213,8 @@ LPTSTR Property::ToHumanString() {
 LPTSTR Property::ToString() {
 	// Allocate the memory for the string.
 	size_t nLen = wcslen(szName) + wcslen(szValue) + 3;
-	LPTSTR szBuffer = (LPTSTR)LocalAlloc(LMEM_FIXED, nLen * sizeof(WCHAR));
+	LPTSTR szBuffer = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		nLen * sizeof(WCHAR), L"Property::ToString");
 
 	// Build the string.
 	wcscpy(szBuffer, szName);
@@ -8,6 +8,7 @@
 #include "PropertyEditor.h"
 #include "Constants.h"
 #include "resource.h"
+#include "AllocProfiler.h"
 
 extern "C" {
 	void *lpPropertyEditorThis;
@@ -52,18 +53,20 @@ void PropertyEditor::UpdateProperty(HWND hDlg) {
 	// Sync property name.
 	hCtl = GetDlgItem(hDlg, IDC_CBPROP);
 	nLength = GetWindowTextLength(hCtl) + 1;
-	szBuffer = (LPTSTR)LocalAlloc(LMEM_FIXED, nLength * sizeof(WCHAR));
+	szBuffer = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		nLength * sizeof(WCHAR), L"PropertyEditor::UpdateProperty");
 	if (GetWindowText(hCtl, szBuffer, nLength) != 0)
 		property->SetHumanName(szBuffer);
-	LocalFree(szBuffer);
+	AllocProfiler::Free(szBuffer);
 
 	// Sync property value.
 	hCtl = GetDlgItem(hDlg, IDC_EDVALUE);
 	nLength = GetWindowTextLength(hCtl) + 1;
-	szBuffer = (LPTSTR)LocalAlloc(LMEM_FIXED, nLength * sizeof(WCHAR));
+	szBuffer = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		nLength * sizeof(WCHAR), L"PropertyEditor::UpdateProperty");
 	if (GetWindowText(hCtl, szBuffer, nLength) != 0)
 		property->SetValue(szBuffer);
-	LocalFree(szBuffer);
+	AllocProfiler::Free(szBuffer);
 
 	bUpdated = true;
 }
@@ -95,7 +98,7 @@ int PropertyEditor::DlgProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lParam)
 		// Set the name of the current property.
 		LPTSTR szName = property->GetHumanName();
 		SetDlgItemText(hDlg, IDC_CBPROP, szName);
-		LocalFree(szName);
+		AllocProfiler::Free(szName);
 
 		// Set the valud of the current property.
 		SetDlgItemText(hDlg, IDC_EDVALUE, property->GetValue());
@@ -0,0 +1,981 @@
+/**
+ * QuantityHistory.cpp
+ * Append-only store of the quantity changes of every component in a
+ * workspace, kept in a compact block based file.
+ *
+ * The history file is made of fixed size blocks. Each block starts with the
+ * time of its first and last events, the number of events and the number of
+ * bytes used, followed by the events themselves. Every event is stored as
+ * three varints: the time since the previous event, the component ID and the
+ * zigzag encoded quantity delta, which usually adds up to 3 to 5 bytes. The
+ * component names are kept in a separate file where the line number is the
+ * component ID, so queries never have to touch the component folders.
+ *
+ * The same workspace may be open in more than one instance of the application
+ * (or device) at a time, so changes are queued in memory and written while
+ * holding a lock file, after picking up the tail block and any names that the
+ * others wrote in the meantime.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <algorithm>
+#include "QuantityHistory.h"
+#include "FileUtils.h"
+#include "FileLock.h"
+#include "Tracer.h"
+
+// Extension of the component names file.
+#define HISTORY_NAMES_EXTENSION L".names"
+
+// Extension of the lock file that keeps other writers out.
+#define HISTORY_LOCK_EXTENSION L".lock"
+
+// Maximum time to wait for another writer to finish appending.
+#define HISTORY_LOCK_TIMEOUT 2000
+
+// Number of FILETIME ticks in a second.
+#define FILETIME_TICKS 10000000
+
+// Context of the monthly consumption aggregation.
+typedef struct {
+	size_t nComponent;
+	DWORD dwMonthStart;
+	DWORD dwMonthEnd;
+	vector<MonthlyConsumption> *arrMonths;
+} MonthlyContext;
+
+/**
+ * Initializes an empty history that isn't associated with any file.
+ */
+QuantityHistory::QuantityHistory() {
+	nTailBlock = 0;
+	dwNamesSize = 0;
+	memset(&ftNamesWrite, 0, sizeof(FILETIME));
+	ResetTail();
+}
+
+/**
+ * Opens the history file of a workspace, creating it if needed on the first
+ * change.
+ *
+ * @param  pathHistory Path to the history file.
+ * @return             TRUE if the existing history could be loaded.
+ */
+bool QuantityHistory::Open(Path pathHistory) {
+	Close();
+
+	swHistoryPath = pathHistory.ToString();
+	swNamesPath = swHistoryPath + HISTORY_NAMES_EXTENSION;
+
+	if (!LoadNames())
+		return false;
+
+	return LoadTail();
+}
+
+/**
+ * Forgets everything about the current history file.
+ */
+void QuantityHistory::Close() {
+	// Give the changes that couldn't be written a last chance.
+	if (!swHistoryPath.empty())
+		Commit();
+
+	swHistoryPath.erase();
+	swNamesPath.erase();
+	arrNames.clear();
+	mapIds.clear();
+	mapQuantities.clear();
+	arrPending.clear();
+	nTailBlock = 0;
+	ResetTail();
+}
+
+/**
+ * Loads the component names table, replacing the one in memory.
+ *
+ * @return TRUE if the table was loaded or didn't exist yet.
+ */
+bool QuantityHistory::LoadNames() {
+	TraceSpan span(L"QuantityHistory::LoadNames");
+	HANDLE hFile;
+	wstring swLine;
+
+	arrNames.clear();
+	mapIds.clear();
+	RememberNames();
+
+	// Nothing has been recorded yet.
+	if (!FileUtils::Exists(swNamesPath.c_str()))
+		return true;
+
+	hFile = FileUtils::Open(swNamesPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// The line number is the component ID.
+	while (FileUtils::ReadUtf8Line(hFile, &swLine)) {
+		mapIds[swLine] = arrNames.size();
+		arrNames.push_back(swLine);
+	}
+	CloseHandle(hFile);
+
+	return true;
+}
+
+/**
+ * Writes the whole component names table.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool QuantityHistory::SaveNames() {
+	wstring swNames;
+
+	for (size_t i = 0; i < arrNames.size(); i++) {
+		swNames += arrNames[i];
+		swNames += L"\r\n";
+	}
+
+	bool bSaved = FileUtils::SaveUtf8Contents(swNamesPath.c_str(),
+		swNames.c_str());
+	RememberNames();
+
+	return bSaved;
+}
+
+/**
+ * Checks if someone else changed the component names table since we last
+ * loaded or wrote it.
+ *
+ * @return TRUE if the table should be loaded again.
+ */
+bool QuantityHistory::NamesChanged() {
+	WIN32_FIND_DATA wfd;
+
+	if (!FileUtils::GetInfo(swNamesPath.c_str(), &wfd))
+		return dwNamesSize != 0;
+
+	return (wfd.nFileSizeLow != dwNamesSize) ||
+		(CompareFileTime(&wfd.ftLastWriteTime, &ftNamesWrite) != 0);
+}
+
+/**
+ * Remembers the size and modification time of the component names table, so
+ * we can tell when someone else changes it.
+ */
+void QuantityHistory::RememberNames() {
+	WIN32_FIND_DATA wfd;
+
+	dwNamesSize = 0;
+	memset(&ftNamesWrite, 0, sizeof(FILETIME));
+
+	if (!FileUtils::GetInfo(swNamesPath.c_str(), &wfd))
+		return;
+
+	dwNamesSize = wfd.nFileSizeLow;
+	ftNamesWrite = wfd.ftLastWriteTime;
+}
+
+/**
+ * Loads the component names table again if someone else changed it since we
+ * last loaded or wrote it.
+ *
+ * @return TRUE if the table in memory is up to date.
+ */
+bool QuantityHistory::RefreshNames() {
+	if (!NamesChanged())
+		return true;
+
+	// Don't read it while someone is rewriting it.
+	FileLock lock(Path((swHistoryPath + HISTORY_LOCK_EXTENSION).c_str()));
+	if (!lock.Acquire(HISTORY_LOCK_TIMEOUT))
+		return false;
+
+	return LoadNames();
+}
+
+/**
+ * Gets the ID of a component in the history, adding it to the names table if
+ * it isn't there yet.
+ * @remark The history lock must be held.
+ * @remark The ID is only handed out once the name is in the names file, so no
+ *         event is ever written with an ID that doesn't have a name.
+ *
+ * @param  szName Name of the component folder.
+ * @return        Component ID or HISTORY_NO_COMPONENT if the name couldn't be
+ *                written.
+ */
+size_t QuantityHistory::GetComponentId(LPCTSTR szName) {
+	wstring swName(szName);
+	map<wstring, size_t>::iterator it;
+
+	// Check if we already know about it.
+	it = mapIds.find(swName);
+	if (it != mapIds.end())
+		return it->second;
+
+	// Append it to the names file.
+	if (!FileUtils::AppendUtf8Contents(swNamesPath.c_str(),
+			(swName + L"\r\n").c_str()))
+		return HISTORY_NO_COMPONENT;
+	RememberNames();
+
+	// Add it to the table.
+	size_t nId = arrNames.size();
+	mapIds[swName] = nId;
+	arrNames.push_back(swName);
+
+	return nId;
+}
+
+/**
+ * Moves the ID of a component over to its new name, so that its past events
+ * follow it.
+ *
+ * @param szOldName Old name of the component folder.
+ * @param szNewName New name of the component folder.
+ */
+void QuantityHistory::RenameComponent(LPCTSTR szOldName, LPCTSTR szNewName) {
+	map<wstring, size_t>::iterator it;
+
+	// Changes that are still waiting to be written.
+	for (size_t i = 0; i < arrPending.size(); i++) {
+		if (arrPending[i].swName.compare(szOldName) == 0)
+			arrPending[i].swName = szNewName;
+	}
+
+	// Work on the latest table since we are going to rewrite it.
+	FileLock lock(Path((swHistoryPath + HISTORY_LOCK_EXTENSION).c_str()));
+	if (!lock.Acquire(HISTORY_LOCK_TIMEOUT))
+		return;
+	if (NamesChanged() && !LoadNames())
+		return;
+
+	// Components that never changed don't have an ID.
+	it = mapIds.find(wstring(szOldName));
+	if (it == mapIds.end())
+		return;
+
+	size_t nId = it->second;
+	mapIds.erase(it);
+
+	// A component that used to have this name is gone, so its events are left
+	// without one instead of being mixed with the ones of this component.
+	it = mapIds.find(wstring(szNewName));
+	if (it != mapIds.end())
+		arrNames[it->second].erase();
+
+	mapIds[wstring(szNewName)] = nId;
+	arrNames[nId] = szNewName;
+
+	SaveNames();
+}
+
+/**
+ * Loads the last block of the history file so that we can keep appending to
+ * it.
+ *
+ * @return TRUE if the block was loaded or the history is empty.
+ */
+bool QuantityHistory::LoadTail() {
+	HANDLE hFile;
+	DWORD dwFileSize;
+	DWORD dwBytesRead;
+
+	nTailBlock = 0;
+	ResetTail();
+
+	// Nothing has been recorded yet.
+	if (!FileUtils::Exists(swHistoryPath.c_str()))
+		return true;
+
+	hFile = FileUtils::Open(swHistoryPath.c_str(), GENERIC_READ,
+		FILE_SHARE_READ, OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Go to the last complete block.
+	dwFileSize = GetFileSize(hFile, NULL);
+	if (dwFileSize < HISTORY_BLOCK_SIZE) {
+		CloseHandle(hFile);
+		return true;
+	}
+	nTailBlock = (dwFileSize / HISTORY_BLOCK_SIZE) - 1;
+
+	// Read it.
+	if (!FileUtils::Seek(hFile, nTailBlock * HISTORY_BLOCK_SIZE) ||
+			!FileUtils::Read(hFile, abTail, HISTORY_BLOCK_SIZE, &dwBytesRead) ||
+			(dwBytesRead != HISTORY_BLOCK_SIZE)) {
+		CloseHandle(hFile);
+		ResetTail();
+		return false;
+	}
+	CloseHandle(hFile);
+
+	// Parse the header.
+	dwTailFirst = ReadDword(abTail);
+	dwTailLast = ReadDword(abTail + 4);
+	wTailCount = (WORD)(abTail[8] | (abTail[9] << 8));
+	wTailUsed = (WORD)(abTail[10] | (abTail[11] << 8));
+	if ((wTailUsed < HISTORY_HEADER_SIZE) || (wTailUsed > HISTORY_BLOCK_SIZE)) {
+		ResetTail();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Empties the tail block.
+ */
+void QuantityHistory::ResetTail() {
+	memset(abTail, 0, HISTORY_BLOCK_SIZE);
+	dwTailFirst = 0;
+	dwTailLast = 0;
+	wTailCount = 0;
+	wTailUsed = HISTORY_HEADER_SIZE;
+}
+
+/**
+ * Appends an event to the tail block, starting a new block if it's full.
+ *
+ * @param  nComponent Component ID.
+ * @param  lDelta     Quantity change.
+ * @param  dwTime     Time of the change.
+ * @return            FALSE if a full block couldn't be written.
+ */
+bool QuantityHistory::AppendEvent(size_t nComponent, long lDelta, DWORD dwTime) {
+	BYTE abEvent[HISTORY_MAX_EVENT];
+	DWORD dwZigZag = ((DWORD)lDelta << 1) ^ (DWORD)(lDelta >> 31);
+	size_t nLength;
+
+	// Keep the events in order even if the clock goes backwards.
+	if ((wTailCount > 0) && (dwTime < dwTailLast))
+		dwTime = dwTailLast;
+
+	// Encode the event.
+	nLength = WriteVarint(abEvent, (wTailCount > 0) ? dwTime - dwTailLast : 0);
+	nLength += WriteVarint(abEvent + nLength, (DWORD)nComponent);
+	nLength += WriteVarint(abEvent + nLength, dwZigZag);
+
+	// Start a new block if this one is full.
+	if ((wTailUsed + nLength) > HISTORY_BLOCK_SIZE) {
+		if (!FlushTail())
+			return false;
+
+		nTailBlock++;
+		ResetTail();
+
+		// The first event of a block is relative to the block itself.
+		nLength = WriteVarint(abEvent, 0);
+		nLength += WriteVarint(abEvent + nLength, (DWORD)nComponent);
+		nLength += WriteVarint(abEvent + nLength, dwZigZag);
+	}
+
+	// Append it.
+	memcpy(abTail + wTailUsed, abEvent, nLength);
+	wTailUsed = (WORD)(wTailUsed + nLength);
+	if (wTailCount == 0)
+		dwTailFirst = dwTime;
+	dwTailLast = dwTime;
+	wTailCount++;
+
+	return true;
+}
+
+/**
+ * Writes the tail block to the history file.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool QuantityHistory::FlushTail() {
+	HANDLE hFile;
+	bool bSuccess;
+
+	// Update the header.
+	WriteDword(abTail, dwTailFirst);
+	WriteDword(abTail + 4, dwTailLast);
+	abTail[8] = (BYTE)(wTailCount & 0xFF);
+	abTail[9] = (BYTE)(wTailCount >> 8);
+	abTail[10] = (BYTE)(wTailUsed & 0xFF);
+	abTail[11] = (BYTE)(wTailUsed >> 8);
+
+	// Write the block in place.
+	hFile = FileUtils::Open(swHistoryPath.c_str(), GENERIC_WRITE, 0,
+		OPEN_ALWAYS);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bSuccess = FileUtils::Seek(hFile, nTailBlock * HISTORY_BLOCK_SIZE) &&
+		FileUtils::Write(hFile, abTail, HISTORY_BLOCK_SIZE);
+	CloseHandle(hFile);
+
+	return bSuccess;
+}
+
+/**
+ * Records the change in quantity of a component since we last saw it.
+ *
+ * @param component Component that was saved.
+ * @param dwTime    Time of the change.
+ */
+void QuantityHistory::RecordChange(Component *component, DWORD dwTime) {
+	wstring swPath(component->GetDirectory().ToString());
+	map<wstring, size_t>::iterator it;
+	size_t nQuantity = component->GetQuantity();
+
+	// New components only give us a starting point.
+	it = mapQuantities.find(swPath);
+	if (it == mapQuantities.end()) {
+		mapQuantities[swPath] = nQuantity;
+		return;
+	}
+
+	// Check if the quantity actually changed.
+	if (it->second == nQuantity)
+		return;
+
+	HistoryPending pending;
+	pending.swName = component->GetDirectory().FileName();
+	pending.lDelta = (long)nQuantity - (long)it->second;
+	pending.dwTime = dwTime;
+	arrPending.push_back(pending);
+	it->second = nQuantity;
+}
+
+/**
+ * Writes the queued changes to the history file. Anything that couldn't be
+ * written is kept for the next time.
+ *
+ * @return TRUE if every change was written.
+ */
+bool QuantityHistory::Commit() {
+	size_t nWritten = 0;
+	size_t i;
+
+	if (arrPending.empty())
+		return true;
+
+	// Keep other writers out while we append.
+	FileLock lock(Path((swHistoryPath + HISTORY_LOCK_EXTENSION).c_str()));
+	if (!lock.Acquire(HISTORY_LOCK_TIMEOUT))
+		return false;
+
+	// Pick up what the others wrote since we last looked.
+	if (NamesChanged() && !LoadNames())
+		return false;
+	if (!LoadTail())
+		return false;
+
+	// Append the changes.
+	for (i = 0; i < arrPending.size(); i++) {
+		size_t nBlock = nTailBlock;
+		size_t nComponent = GetComponentId(arrPending[i].swName.c_str());
+		if ((nComponent == HISTORY_NO_COMPONENT) ||
+				!AppendEvent(nComponent, arrPending[i].lDelta,
+					arrPending[i].dwTime))
+			break;
+
+		// Filling up a block wrote everything that came before this one.
+		if (nTailBlock != nBlock)
+			nWritten = i;
+	}
+	if ((i == arrPending.size()) && FlushTail())
+		nWritten = arrPending.size();
+
+	arrPending.erase(arrPending.begin(), arrPending.begin() + nWritten);
+	return arrPending.empty();
+}
+
+/**
+ * Remembers the quantity of a component that was loaded.
+ *
+ * @param component Component that was added to the workspace.
+ */
+void QuantityHistory::ComponentAdded(Component *component) {
+	mapQuantities[wstring(component->GetDirectory().ToString())] =
+		component->GetQuantity();
+}
+
+/**
+ * Records the quantity change of a component that was saved.
+ *
+ * @param component Component that was changed.
+ */
+void QuantityHistory::ComponentChanged(Component *component) {
+	if (swHistoryPath.empty())
+		return;
+
+	RecordChange(component, Now());
+	Commit();
+}
+
+/**
+ * Records the quantity changes of a batch of components with a single write.
+ *
+ * @param arrComponents Components that were changed.
+ */
+void QuantityHistory::ComponentsChanged(vector<Component*> arrComponents) {
+	if (swHistoryPath.empty())
+		return;
+
+	DWORD dwTime = Now();
+	for (size_t i = 0; i < arrComponents.size(); i++)
+		RecordChange(arrComponents[i], dwTime);
+
+	Commit();
+}
+
+/**
+ * Stops tracking a component. Its history is kept.
+ *
+ * @param component Component that is being removed from the workspace.
+ */
+void QuantityHistory::ComponentRemoved(Component *component) {
+	mapQuantities.erase(wstring(component->GetDirectory().ToString()));
+}
+
+/**
+ * Keeps tracking a component under its new folder and carries its history
+ * over to the new name.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void QuantityHistory::ComponentRenamed(Component *component, Directory dirOld) {
+	map<wstring, size_t>::iterator it;
+
+	if (!swHistoryPath.empty())
+		RenameComponent(dirOld.FileName(), component->GetDirectory().FileName());
+
+	// Carry over the last quantity we saw.
+	it = mapQuantities.find(wstring(dirOld.ToString()));
+	if (it == mapQuantities.end()) {
+		ComponentAdded(component);
+		return;
+	}
+
+	size_t nQuantity = it->second;
+	mapQuantities.erase(it);
+	mapQuantities[wstring(component->GetDirectory().ToString())] = nQuantity;
+}
+
+/**
+ * Stops tracking every component.
+ */
+void QuantityHistory::ComponentsCleared() {
+	mapQuantities.clear();
+}
+
+/**
+ * Records a quantity change that was written straight to a component folder
+ * without the component being loaded, like when the quantity journal is
+ * replayed.
+ *
+ * @param szName Name of the component folder.
+ * @param lDelta Quantity change.
+ */
+void QuantityHistory::RecordDelta(LPCTSTR szName, long lDelta) {
+	if (swHistoryPath.empty() || (lDelta == 0))
+		return;
+
+	HistoryPending pending;
+	pending.swName = szName;
+	pending.lDelta = lDelta;
+	pending.dwTime = Now();
+	arrPending.push_back(pending);
+
+	Commit();
+}
+
+/**
+ * Records a batch of quantity changes that were written straight to component
+ * folders, each at its own time, with a single write.
+ *
+ * @param arrDeltas Quantity changes in chronological order.
+ */
+void QuantityHistory::RecordDeltas(const vector<HistoryPending> &arrDeltas) {
+	if (swHistoryPath.empty())
+		return;
+
+	for (size_t i = 0; i < arrDeltas.size(); i++) {
+		if (arrDeltas[i].lDelta != 0)
+			arrPending.push_back(arrDeltas[i]);
+	}
+
+	Commit();
+}
+
+/**
+ * Goes through the events in a time range in chronological order. Blocks that
+ * are entirely outside of the range aren't decoded.
+ *
+ * @param  dwFrom  Start of the range, inclusive.
+ * @param  dwTo    End of the range, inclusive.
+ * @param  lpProc  Function to be called for each event.
+ * @param  lpParam Parameter to be passed to the function.
+ * @return         TRUE if the history could be read.
+ */
+bool QuantityHistory::ForEachEvent(DWORD dwFrom, DWORD dwTo,
+								   HistoryEventProc lpProc, LPVOID lpParam) {
+	BYTE abBlock[HISTORY_BLOCK_SIZE];
+	DWORD dwBytesRead;
+	HANDLE hFile;
+
+	// Nothing has been recorded yet.
+	if (swHistoryPath.empty() || !FileUtils::Exists(swHistoryPath.c_str()))
+		return true;
+
+	hFile = FileUtils::Open(swHistoryPath.c_str(), GENERIC_READ,
+		FILE_SHARE_READ, OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	while (FileUtils::Read(hFile, abBlock, HISTORY_BLOCK_SIZE, &dwBytesRead) &&
+			(dwBytesRead == HISTORY_BLOCK_SIZE)) {
+		// Skip blocks before the range and stop after it.
+		if (ReadDword(abBlock + 4) < dwFrom)
+			continue;
+		if (ReadDword(abBlock) > dwTo)
+			break;
+
+		DecodeBlock(abBlock, dwFrom, dwTo, lpProc, lpParam);
+	}
+	CloseHandle(hFile);
+
+	return true;
+}
+
+/**
+ * Decodes the events in a block.
+ *
+ * @param lpBlock Block to be decoded.
+ * @param dwFrom  Start of the range, inclusive.
+ * @param dwTo    End of the range, inclusive.
+ * @param lpProc  Function to be called for each event in the range.
+ * @param lpParam Parameter to be passed to the function.
+ */
+void QuantityHistory::DecodeBlock(const BYTE *lpBlock, DWORD dwFrom, DWORD dwTo,
+								  HistoryEventProc lpProc, LPVOID lpParam) {
+	HistoryEvent event;
+	WORD wCount = (WORD)(lpBlock[8] | (lpBlock[9] << 8));
+	WORD wUsed = (WORD)(lpBlock[10] | (lpBlock[11] << 8));
+	size_t nPos = HISTORY_HEADER_SIZE;
+	DWORD dwValue;
+	size_t nLength;
+
+	// Don't trust a corrupted header.
+	if (wUsed > HISTORY_BLOCK_SIZE)
+		return;
+
+	event.dwTime = ReadDword(lpBlock);
+	for (WORD i = 0; i < wCount; i++) {
+		// Time.
+		if ((nLength = ReadVarint(lpBlock + nPos, wUsed - nPos, &dwValue)) == 0)
+			return;
+		nPos += nLength;
+		event.dwTime += dwValue;
+
+		// Component.
+		if ((nLength = ReadVarint(lpBlock + nPos, wUsed - nPos, &dwValue)) == 0)
+			return;
+		nPos += nLength;
+		event.nComponent = dwValue;
+
+		// Delta.
+		if ((nLength = ReadVarint(lpBlock + nPos, wUsed - nPos, &dwValue)) == 0)
+			return;
+		nPos += nLength;
+		event.lDelta = (long)(dwValue >> 1) ^ -(long)(dwValue & 1);
+
+		if ((event.dwTime >= dwFrom) && (event.dwTime <= dwTo))
+			lpProc(&event, lpParam);
+	}
+}
+
+/**
+ * Gets how much of a component was consumed and added in each month of a
+ * time range.
+ *
+ * @param  component Component to be queried.
+ * @param  dwFrom    Start of the range, inclusive.
+ * @param  dwTo      End of the range, inclusive.
+ * @return           Months that had any changes, in chronological order.
+ */
+vector<MonthlyConsumption> QuantityHistory::GetMonthlyConsumption(
+		Component *component, DWORD dwFrom, DWORD dwTo) {
+	Directory dirComponent = component->GetDirectory();
+	map<wstring, size_t>::iterator it;
+	vector<MonthlyConsumption> arrMonths;
+	MonthlyContext context;
+
+	// Components that never changed don't have an ID.
+	RefreshNames();
+	it = mapIds.find(wstring(dirComponent.FileName()));
+	if (it == mapIds.end())
+		return arrMonths;
+
+	context.nComponent = it->second;
+	context.dwMonthStart = 1;
+	context.dwMonthEnd = 0;
+	context.arrMonths = &arrMonths;
+	ForEachEvent(dwFrom, dwTo, MonthlyConsumptionProc, &context);
+
+	return arrMonths;
+}
+
+/**
+ * Adds an event to the monthly consumption of a component.
+ *
+ * @param event   Event to be added.
+ * @param lpParam Pointer to the MonthlyContext.
+ */
+void QuantityHistory::MonthlyConsumptionProc(const HistoryEvent *event,
+											 LPVOID lpParam) {
+	MonthlyContext *context = (MonthlyContext*)lpParam;
+	SYSTEMTIME st;
+
+	if (event->nComponent != context->nComponent)
+		return;
+
+	// Start a new month if needed.
+	if ((event->dwTime < context->dwMonthStart) ||
+			(event->dwTime >= context->dwMonthEnd)) {
+		MonthlyConsumption month;
+
+		// Figure out the boundaries of the month.
+		ToSystemTime(event->dwTime, &st);
+		month.wYear = st.wYear;
+		month.wMonth = st.wMonth;
+		month.nConsumed = 0;
+		month.nAdded = 0;
+
+		st.wDay = 1;
+		st.wHour = 0;
+		st.wMinute = 0;
+		st.wSecond = 0;
+		st.wMilliseconds = 0;
+		context->dwMonthStart = FromSystemTime(&st);
+		if (++st.wMonth > 12) {
+			st.wMonth = 1;
+			st.wYear++;
+		}
+		context->dwMonthEnd = FromSystemTime(&st);
+
+		context->arrMonths->push_back(month);
+	}
+
+	// Add up the change.
+	if (event->lDelta < 0) {
+		context->arrMonths->back().nConsumed += (size_t)(-event->lDelta);
+	} else {
+		context->arrMonths->back().nAdded += (size_t)event->lDelta;
+	}
+}
+
+/**
+ * Gets the components that were consumed the most in a time range.
+ *
+ * @param  dwFrom Start of the range, inclusive.
+ * @param  dwTo   End of the range, inclusive.
+ * @param  nCount Maximum number of components to return.
+ * @return        Components ordered from the most consumed.
+ */
+vector<HistoryConsumer> QuantityHistory::GetTopConsumers(DWORD dwFrom,
+		DWORD dwTo, size_t nCount) {
+	vector<pair<size_t, size_t> > arrRanking;
+	vector<HistoryConsumer> arrConsumers;
+	vector<size_t> arrConsumed;
+	size_t i;
+
+	// Add up the consumption of every component, including the ones that
+	// others added since we last looked.
+	RefreshNames();
+	arrConsumed.resize(arrNames.size(), 0);
+	ForEachEvent(dwFrom, dwTo, TopConsumersProc, &arrConsumed);
+
+	// Rank them.
+	for (i = 0; i < arrConsumed.size(); i++) {
+		if (arrConsumed[i] > 0)
+			arrRanking.push_back(pair<size_t, size_t>(arrConsumed[i], i));
+	}
+	sort(arrRanking.begin(), arrRanking.end());
+
+	// Get the top ones.
+	for (i = arrRanking.size(); (i > 0) && (arrConsumers.size() < nCount); i--) {
+		HistoryConsumer consumer;
+		consumer.swName = arrNames[arrRanking[i - 1].second];
+		consumer.nConsumed = arrRanking[i - 1].first;
+
+		arrConsumers.push_back(consumer);
+	}
+
+	return arrConsumers;
+}
+
+/**
+ * Adds an event to the total consumption of its component.
+ *
+ * @param event   Event to be added.
+ * @param lpParam Pointer to the vector of consumed quantities.
+ */
+void QuantityHistory::TopConsumersProc(const HistoryEvent *event,
+									   LPVOID lpParam) {
+	vector<size_t> *arrConsumed = (vector<size_t>*)lpParam;
+
+	// Names that couldn't be written are ignored.
+	if ((event->lDelta >= 0) || (event->nComponent >= arrConsumed->size()))
+		return;
+
+	(*arrConsumed)[event->nComponent] += (size_t)(-event->lDelta);
+}
+
+/**
+ * Writes an unsigned varint.
+ *
+ * @param  lpBuffer Buffer with space for at least 5 bytes.
+ * @param  dwValue  Value to be written.
+ * @return          Number of bytes written.
+ */
+size_t QuantityHistory::WriteVarint(BYTE *lpBuffer, DWORD dwValue) {
+	size_t nLength = 0;
+
+	while (dwValue >= 0x80) {
+		lpBuffer[nLength++] = (BYTE)((dwValue & 0x7F) | 0x80);
+		dwValue >>= 7;
+	}
+	lpBuffer[nLength++] = (BYTE)dwValue;
+
+	return nLength;
+}
+
+/**
+ * Reads an unsigned varint.
+ *
+ * @param  lpBuffer Buffer to read from.
+ * @param  nLength  Number of bytes available in the buffer.
+ * @param  dwValue  Pointer to where the value will be stored.
+ * @return          Number of bytes read or 0 if the varint is invalid.
+ */
+size_t QuantityHistory::ReadVarint(const BYTE *lpBuffer, size_t nLength,
+								   DWORD *dwValue) {
+	*dwValue = 0;
+
+	for (size_t i = 0; (i < nLength) && (i < 5); i++) {
+		*dwValue |= (DWORD)(lpBuffer[i] & 0x7F) << (7 * i);
+		if ((lpBuffer[i] & 0x80) == 0)
+			return i + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Writes a little-endian DWORD.
+ *
+ * @param lpBuffer Buffer with space for at least 4 bytes.
+ * @param dwValue  Value to be written.
+ */
+void QuantityHistory::WriteDword(BYTE *lpBuffer, DWORD dwValue) {
+	lpBuffer[0] = (BYTE)(dwValue & 0xFF);
+	lpBuffer[1] = (BYTE)((dwValue >> 8) & 0xFF);
+	lpBuffer[2] = (BYTE)((dwValue >> 16) & 0xFF);
+	lpBuffer[3] = (BYTE)((dwValue >> 24) & 0xFF);
+}
+
+/**
+ * Reads a little-endian DWORD.
+ *
+ * @param  lpBuffer Buffer to read from.
+ * @return          Value that was read.
+ */
+DWORD QuantityHistory::ReadDword(const BYTE *lpBuffer) {
+	return (DWORD)lpBuffer[0] | ((DWORD)lpBuffer[1] << 8) |
+		((DWORD)lpBuffer[2] << 16) | ((DWORD)lpBuffer[3] << 24);
+}
+
+/**
+ * Gets the current time in the format used by the history.
+ *
+ * @return Seconds since the start of 2000 (UTC).
+ */
+DWORD QuantityHistory::Now() {
+	SYSTEMTIME st;
+
+	GetSystemTime(&st);
+	return FromSystemTime(&st);
+}
+
+/**
+ * Converts a SYSTEMTIME into the format used by the history.
+ *
+ * @param  st System time to be converted.
+ * @return    Seconds since the start of 2000 or 0 if it's before that.
+ */
+DWORD QuantityHistory::FromSystemTime(const SYSTEMTIME *st) {
+	SYSTEMTIME stEpoch = { 2000, 1, 0, 1, 0, 0, 0, 0 };
+	FILETIME ftEpoch;
+	FILETIME ft;
+	ULARGE_INTEGER uliEpoch;
+	ULARGE_INTEGER uli;
+
+	SystemTimeToFileTime(&stEpoch, &ftEpoch);
+	SystemTimeToFileTime(st, &ft);
+	uliEpoch.LowPart = ftEpoch.dwLowDateTime;
+	uliEpoch.HighPart = ftEpoch.dwHighDateTime;
+	uli.LowPart = ft.dwLowDateTime;
+	uli.HighPart = ft.dwHighDateTime;
+
+	if (uli.QuadPart < uliEpoch.QuadPart)
+		return 0;
+
+	return (DWORD)((uli.QuadPart - uliEpoch.QuadPart) / FILETIME_TICKS);
+}
+
+/**
+ * Converts a time in the format used by the history into a SYSTEMTIME.
+ *
+ * @param dwTime Seconds since the start of 2000.
+ * @param st     Pointer to where the system time will be stored.
+ */
+void QuantityHistory::ToSystemTime(DWORD dwTime, SYSTEMTIME *st) {
+	SYSTEMTIME stEpoch = { 2000, 1, 0, 1, 0, 0, 0, 0 };
+	FILETIME ft;
+	ULARGE_INTEGER uli;
+
+	SystemTimeToFileTime(&stEpoch, &ft);
+	uli.LowPart = ft.dwLowDateTime;
+	uli.HighPart = ft.dwHighDateTime;
+	uli.QuadPart += (ULONGLONG)dwTime * FILETIME_TICKS;
+
+	ft.dwLowDateTime = uli.LowPart;
+	ft.dwHighDateTime = uli.HighPart;
+	FileTimeToSystemTime(&ft, st);
+}
+
+/**
+ * Accounts for the memory used by the history, including the object itself.
+ * Only the names and the block being appended to are kept in memory.
+ *
+ * @param report Report to add the memory to.
+ */
+void QuantityHistory::AccountMemory(MemoryReport *report) {
+	map<wstring, size_t>::iterator it;
+
+	report->Add(MEMORY_INDEXES, sizeof(QuantityHistory) +
+		(arrNames.capacity() * sizeof(wstring)));
+	report->AddString(MEMORY_INDEXES, swHistoryPath);
+	report->AddString(MEMORY_INDEXES, swNamesPath);
+	for (size_t i = 0; i < arrNames.size(); i++)
+		report->AddString(MEMORY_INDEXES, arrNames[i]);
+
+	// Lookups by name.
+	report->AddMapNodes(MEMORY_INDEXES, mapIds.size() + mapQuantities.size(),
+		sizeof(wstring) + sizeof(size_t));
+	for (it = mapIds.begin(); it != mapIds.end(); it++)
+		report->AddString(MEMORY_INDEXES, it->first);
+	for (it = mapQuantities.begin(); it != mapQuantities.end(); it++)
+		report->AddString(MEMORY_INDEXES, it->first);
+}
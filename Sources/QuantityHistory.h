@@ -0,0 +1,149 @@
+/**
+ * QuantityHistory.h
+ * Append-only store of the quantity changes of every component in a
+ * workspace, kept in a compact block based file.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _QUANTITY_HISTORY_H
+#define _QUANTITY_HISTORY_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Component.h"
+#include "Path.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Block layout.
+#define HISTORY_BLOCK_SIZE  256
+#define HISTORY_HEADER_SIZE 12
+#define HISTORY_MAX_EVENT   15
+
+// Component ID of a name that couldn't be added to the names table.
+#define HISTORY_NO_COMPONENT ((size_t)-1)
+
+// A single quantity change.
+typedef struct {
+	DWORD dwTime;
+	size_t nComponent;
+	long lDelta;
+} HistoryEvent;
+
+// A quantity change that wasn't written to the history file yet.
+typedef struct {
+	wstring swName;
+	long lDelta;
+	DWORD dwTime;
+} HistoryPending;
+
+// Consumption of a component in a single month.
+typedef struct {
+	WORD wYear;
+	WORD wMonth;
+	size_t nConsumed;
+	size_t nAdded;
+} MonthlyConsumption;
+
+// Total consumption of a component in a period.
+typedef struct {
+	wstring swName;
+	size_t nConsumed;
+} HistoryConsumer;
+
+// Callback used to go through the events in the store.
+typedef void (*HistoryEventProc)(const HistoryEvent *event, LPVOID lpParam);
+
+class QuantityHistory : public WorkspaceListener {
+protected:
+	wstring swHistoryPath;
+	wstring swNamesPath;
+
+	// Component names.
+	vector<wstring> arrNames;
+	map<wstring, size_t> mapIds;
+	map<wstring, size_t> mapQuantities;
+	DWORD dwNamesSize;
+	FILETIME ftNamesWrite;
+
+	// Changes waiting to be written.
+	vector<HistoryPending> arrPending;
+
+	// Block that is currently being appended to.
+	BYTE abTail[HISTORY_BLOCK_SIZE];
+	size_t nTailBlock;
+	DWORD dwTailFirst;
+	DWORD dwTailLast;
+	WORD wTailCount;
+	WORD wTailUsed;
+
+	// Names.
+	bool LoadNames();
+	bool SaveNames();
+	size_t GetComponentId(LPCTSTR szName);
+	void RenameComponent(LPCTSTR szOldName, LPCTSTR szNewName);
+	bool NamesChanged();
+	void RememberNames();
+	bool RefreshNames();
+
+	// Blocks.
+	bool LoadTail();
+	void ResetTail();
+	bool AppendEvent(size_t nComponent, long lDelta, DWORD dwTime);
+	bool FlushTail();
+	void RecordChange(Component *component, DWORD dwTime);
+	bool Commit();
+
+	// Encoding.
+	static size_t WriteVarint(BYTE *lpBuffer, DWORD dwValue);
+	static size_t ReadVarint(const BYTE *lpBuffer, size_t nLength, DWORD *dwValue);
+	static void WriteDword(BYTE *lpBuffer, DWORD dwValue);
+	static DWORD ReadDword(const BYTE *lpBuffer);
+	static void DecodeBlock(const BYTE *lpBlock, DWORD dwFrom, DWORD dwTo,
+		HistoryEventProc lpProc, LPVOID lpParam);
+
+	// Aggregation.
+	static void MonthlyConsumptionProc(const HistoryEvent *event, LPVOID lpParam);
+	static void TopConsumersProc(const HistoryEvent *event, LPVOID lpParam);
+
+public:
+	// Constructors and destructors.
+	QuantityHistory();
+
+	// Storage.
+	bool Open(Path pathHistory);
+	void Close();
+
+	// Workspace events.
+	void ComponentAdded(Component *component);
+	void ComponentChanged(Component *component);
+	void ComponentsChanged(vector<Component*> arrComponents);
+	void ComponentRemoved(Component *component);
+	void ComponentRenamed(Component *component, Directory dirOld);
+	void ComponentsCleared();
+	void RecordDelta(LPCTSTR szName, long lDelta);
+	void RecordDeltas(const vector<HistoryPending> &arrDeltas);
+
+	// Queries.
+	bool ForEachEvent(DWORD dwFrom, DWORD dwTo, HistoryEventProc lpProc,
+		LPVOID lpParam);
+	vector<MonthlyConsumption> GetMonthlyConsumption(Component *component,
+		DWORD dwFrom, DWORD dwTo);
+	vector<HistoryConsumer> GetTopConsumers(DWORD dwFrom, DWORD dwTo,
+		size_t nCount);
+
+	// Time.
+	static DWORD Now();
+	static DWORD FromSystemTime(const SYSTEMTIME *st);
+	static void ToSystemTime(DWORD dwTime, SYSTEMTIME *st);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _QUANTITY_HISTORY_H
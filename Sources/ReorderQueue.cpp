@@ -0,0 +1,198 @@
+/**
+ * ReorderQueue.cpp
+ * Keeps the components ordered by how close they are to running out of stock.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "ReorderQueue.h"
+#include "FileUtils.h"
+
+/**
+ * Initializes an empty reorder queue.
+ */
+ReorderQueue::ReorderQueue() {
+}
+
+/**
+ * Places a new component in the queue. Components without a reorder level
+ * aren't tracked, since we have no idea when they should be reordered.
+ *
+ * @param component Component that was added to the workspace.
+ */
+void ReorderQueue::ComponentAdded(Component *component) {
+	ReorderEntry entry;
+
+	// Make sure we don't end up with the same component twice.
+	ComponentRemoved(component);
+	if (!component->HasReorderLevel())
+		return;
+
+	// Build the entry.
+	entry.swPath = component->GetDirectory().ToString();
+	entry.swName = component->GetName();
+	entry.nQuantity = component->GetQuantity();
+	entry.nReorderLevel = component->GetReorderLevel();
+
+	// Place it in the queue and remember where it went.
+	mapPositions[entry.swPath] = mapQueue.insert(QueueMap::value_type(
+		Margin(entry.nQuantity, entry.nReorderLevel), entry));
+}
+
+/**
+ * Moves a changed component to its new position in the queue.
+ *
+ * @param component Component that was changed.
+ */
+void ReorderQueue::ComponentChanged(Component *component) {
+	ComponentAdded(component);
+}
+
+/**
+ * Removes a component from the queue.
+ *
+ * @param component Component that is being removed from the workspace.
+ */
+void ReorderQueue::ComponentRemoved(Component *component) {
+	map<wstring, QueueMap::iterator>::iterator it;
+
+	it = mapPositions.find(wstring(component->GetDirectory().ToString()));
+	if (it == mapPositions.end())
+		return;
+
+	mapQueue.erase(it->second);
+	mapPositions.erase(it);
+}
+
+/**
+ * Moves a component over to its new folder in the queue.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void ReorderQueue::ComponentRenamed(Component *component, Directory dirOld) {
+	map<wstring, QueueMap::iterator>::iterator it;
+
+	it = mapPositions.find(wstring(dirOld.ToString()));
+	if (it != mapPositions.end()) {
+		mapQueue.erase(it->second);
+		mapPositions.erase(it);
+	}
+
+	ComponentAdded(component);
+}
+
+/**
+ * Empties the queue.
+ */
+void ReorderQueue::ComponentsCleared() {
+	mapQueue.clear();
+	mapPositions.clear();
+}
+
+/**
+ * Calculates how far a component is from its reorder level.
+ *
+ * @param  nQuantity     Quantity in stock.
+ * @param  nReorderLevel Quantity at which we should reorder.
+ * @return               Negative if we are below the reorder level.
+ */
+long ReorderQueue::Margin(size_t nQuantity, size_t nReorderLevel) {
+	return (long)nQuantity - (long)nReorderLevel;
+}
+
+/**
+ * Gets the components that are closest to running out.
+ *
+ * @param  nCount Maximum number of components to return.
+ * @return        Components ordered from the most to the least urgent.
+ */
+vector<ReorderEntry> ReorderQueue::GetClosestToRunningOut(size_t nCount) {
+	vector<ReorderEntry> arrEntries;
+	QueueMap::iterator it;
+
+	for (it = mapQueue.begin(); (it != mapQueue.end()) &&
+			(arrEntries.size() < nCount); it++) {
+		arrEntries.push_back(it->second);
+	}
+
+	return arrEntries;
+}
+
+/**
+ * Gets the components that have less stock than their reorder level.
+ *
+ * @return Components ordered from the most to the least urgent.
+ */
+vector<ReorderEntry> ReorderQueue::GetBelowReorderLevel() {
+	vector<ReorderEntry> arrEntries;
+	QueueMap::iterator it;
+
+	for (it = mapQueue.begin(); (it != mapQueue.end()) && (it->first < 0); it++)
+		arrEntries.push_back(it->second);
+
+	return arrEntries;
+}
+
+/**
+ * Exports a list of components to a CSV file.
+ *
+ * @param  szPath     Path to the CSV file.
+ * @param  arrEntries Components to be exported.
+ * @return            TRUE if the operation was successful.
+ */
+bool ReorderQueue::Export(LPCTSTR szPath, vector<ReorderEntry> arrEntries) {
+	WCHAR szNumber[33];
+	wstring swContents(L"Name,Quantity,Reorder Level\r\n");
+
+	for (size_t i = 0; i < arrEntries.size(); i++) {
+		wstring swName(arrEntries[i].swName);
+
+		// Escape the quotes in the name.
+		for (size_t j = 0; j < swName.length(); j++) {
+			if (swName[j] == L'"')
+				swName.insert(j++, 1, L'"');
+		}
+
+		// Build the line.
+		swContents += L"\"";
+		swContents += swName;
+		swContents += L"\",";
+		_ltow((long)arrEntries[i].nQuantity, szNumber, 10);
+		swContents += szNumber;
+		swContents += L",";
+		_ltow((long)arrEntries[i].nReorderLevel, szNumber, 10);
+		swContents += szNumber;
+		swContents += L"\r\n";
+	}
+
+	return FileUtils::SaveContents(szPath, swContents.c_str());
+}
+
+/**
+ * Accounts for the memory used by the queue, including the object itself.
+ *
+ * @param report Report to add the memory to.
+ */
+void ReorderQueue::AccountMemory(MemoryReport *report) {
+	map<wstring, QueueMap::iterator>::iterator itPosition;
+	QueueMap::iterator it;
+
+	report->Add(MEMORY_INDEXES, sizeof(ReorderQueue));
+
+	// Queue.
+	report->AddMapNodes(MEMORY_INDEXES, mapQueue.size(),
+		sizeof(long) + sizeof(ReorderEntry));
+	for (it = mapQueue.begin(); it != mapQueue.end(); it++) {
+		report->AddString(MEMORY_INDEXES, it->second.swPath);
+		report->AddString(MEMORY_INDEXES, it->second.swName);
+	}
+
+	// Where each component is in the queue.
+	report->AddMapNodes(MEMORY_INDEXES, mapPositions.size(),
+		sizeof(wstring) + sizeof(QueueMap::iterator));
+	for (itPosition = mapPositions.begin(); itPosition != mapPositions.end();
+			itPosition++) {
+		report->AddString(MEMORY_INDEXES, itPosition->first);
+	}
+}
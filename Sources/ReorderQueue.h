@@ -0,0 +1,61 @@
+/**
+ * ReorderQueue.h
+ * Keeps the components ordered by how close they are to running out of stock.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _REORDER_QUEUE_H
+#define _REORDER_QUEUE_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Component.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// A component in the reorder queue.
+typedef struct {
+	wstring swPath;
+	wstring swName;
+	size_t nQuantity;
+	size_t nReorderLevel;
+} ReorderEntry;
+
+class ReorderQueue : public WorkspaceListener {
+protected:
+	typedef multimap<long, ReorderEntry> QueueMap;
+
+	QueueMap mapQueue;
+	map<wstring, QueueMap::iterator> mapPositions;
+
+	// Ordering.
+	static long Margin(size_t nQuantity, size_t nReorderLevel);
+
+public:
+	// Constructors and destructors.
+	ReorderQueue();
+
+	// Workspace events.
+	void ComponentAdded(Component *component);
+	void ComponentChanged(Component *component);
+	void ComponentRemoved(Component *component);
+	void ComponentRenamed(Component *component, Directory dirOld);
+	void ComponentsCleared();
+
+	// Queries.
+	vector<ReorderEntry> GetClosestToRunningOut(size_t nCount);
+	vector<ReorderEntry> GetBelowReorderLevel();
+
+	// Exporting.
+	static bool Export(LPCTSTR szPath, vector<ReorderEntry> arrEntries);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _REORDER_QUEUE_H
@@ -0,0 +1,247 @@
+/**
+ * SmartFolders.cpp
+ * Virtual folders whose contents are defined by saved queries and kept up to
+ * date as components change.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "SmartFolders.h"
+#include "Constants.h"
+
+/**
+ * Initializes an empty list of smart folders.
+ */
+SmartFolders::SmartFolders() {
+}
+
+/**
+ * Loads the smart folder queries from the workspace properties.
+ * @remark This will drop all the current memberships.
+ *
+ * @param arrProperties Workspace properties.
+ */
+void SmartFolders::LoadQueries(vector<Property> arrProperties) {
+	arrQueries.clear();
+	arrMembers.clear();
+	arrCounts.clear();
+
+	for (size_t i = 0; i < arrProperties.size(); i++) {
+		if (wcscmp(arrProperties[i].GetName(), PROPERTY_SMART_FOLDER) != 0)
+			continue;
+
+		// Only keep the queries that make sense and the first folder of each name.
+		SmartQuery query(arrProperties[i].GetValue());
+		if (query.IsValid() && !HasFolder(query.GetName()))
+			AddQuery(query, NULL);
+	}
+}
+
+/**
+ * Adds a new smart folder and populates it.
+ *
+ * @param query         Query that defines the folder.
+ * @param arrComponents Components to populate the folder with or NULL if it
+ *                      should start empty.
+ */
+void SmartFolders::AddQuery(SmartQuery query, vector<Component> *arrComponents) {
+	FacetCount count;
+	count.nParts = 0;
+	count.nStock = 0;
+
+	arrQueries.push_back(query);
+	arrMembers.push_back(map<wstring, size_t>());
+	arrCounts.push_back(count);
+
+	// Populate the new folder.
+	if (arrComponents != NULL) {
+		for (size_t i = 0; i < arrComponents->size(); i++)
+			UpdateMembership(arrQueries.size() - 1, &(*arrComponents)[i]);
+	}
+}
+
+/**
+ * Checks a new component against every folder.
+ *
+ * @param component Component that was added to the workspace.
+ */
+void SmartFolders::ComponentAdded(Component *component) {
+	for (size_t i = 0; i < arrQueries.size(); i++)
+		UpdateMembership(i, component);
+}
+
+/**
+ * Re-checks a changed component against every folder.
+ *
+ * @param component Component that was changed.
+ */
+void SmartFolders::ComponentChanged(Component *component) {
+	for (size_t i = 0; i < arrQueries.size(); i++)
+		UpdateMembership(i, component);
+}
+
+/**
+ * Removes a component from every folder.
+ *
+ * @param component Component that is being removed from the workspace.
+ */
+void SmartFolders::ComponentRemoved(Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+
+	for (size_t i = 0; i < arrQueries.size(); i++)
+		RemoveMember(i, swKey);
+}
+
+/**
+ * Moves a component over to its new folder in every smart folder.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void SmartFolders::ComponentRenamed(Component *component, Directory dirOld) {
+	wstring swKey(dirOld.ToString());
+
+	for (size_t i = 0; i < arrQueries.size(); i++)
+		RemoveMember(i, swKey);
+
+	ComponentAdded(component);
+}
+
+/**
+ * Empties every folder while keeping their queries.
+ */
+void SmartFolders::ComponentsCleared() {
+	for (size_t i = 0; i < arrQueries.size(); i++) {
+		arrMembers[i].clear();
+		arrCounts[i].nParts = 0;
+		arrCounts[i].nStock = 0;
+	}
+}
+
+/**
+ * Checks a single component against a folder query and updates the folder
+ * membership accordingly.
+ *
+ * @param nFolder   Folder index.
+ * @param component Component to be checked.
+ */
+void SmartFolders::UpdateMembership(size_t nFolder, Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+
+	// Drop the previous state of the component.
+	RemoveMember(nFolder, swKey);
+
+	// Add it back if it still matches.
+	if (arrQueries[nFolder].Matches(component)) {
+		arrMembers[nFolder][swKey] = component->GetQuantity();
+		arrCounts[nFolder].nParts++;
+		arrCounts[nFolder].nStock += component->GetQuantity();
+	}
+}
+
+/**
+ * Removes a component from a folder.
+ *
+ * @param nFolder Folder index.
+ * @param swKey   Component directory path.
+ */
+void SmartFolders::RemoveMember(size_t nFolder, wstring swKey) {
+	map<wstring, size_t>::iterator it = arrMembers[nFolder].find(swKey);
+
+	if (it == arrMembers[nFolder].end())
+		return;
+
+	arrCounts[nFolder].nParts--;
+	arrCounts[nFolder].nStock -= it->second;
+	arrMembers[nFolder].erase(it);
+}
+
+/**
+ * Gets the number of smart folders.
+ *
+ * @return Number of smart folders.
+ */
+size_t SmartFolders::GetFoldersCount() {
+	return arrQueries.size();
+}
+
+/**
+ * Gets the name of a smart folder.
+ *
+ * @param  nFolder Folder index.
+ * @return         Folder name.
+ */
+LPCTSTR SmartFolders::GetFolderName(size_t nFolder) {
+	return arrQueries[nFolder].GetName();
+}
+
+/**
+ * Checks if there's already a smart folder with a given name. Names are used
+ * to identify the folders, so they must be unique.
+ *
+ * @param  szName Folder name.
+ * @return        TRUE if a folder with this name exists.
+ */
+bool SmartFolders::HasFolder(LPCTSTR szName) {
+	for (size_t i = 0; i < arrQueries.size(); i++) {
+		if (wcscmp(arrQueries[i].GetName(), szName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Gets the number of parts and stock inside a smart folder.
+ *
+ * @param  nFolder Folder index.
+ * @return         Part and stock counts of the folder.
+ */
+FacetCount SmartFolders::GetFolderTotals(size_t nFolder) {
+	return arrCounts[nFolder];
+}
+
+/**
+ * Checks if a component is inside a smart folder.
+ *
+ * @param  nFolder   Folder index.
+ * @param  component Component to look for.
+ * @return           TRUE if the component belongs to the folder.
+ */
+bool SmartFolders::Contains(size_t nFolder, Component *component) {
+	wstring swKey(component->GetDirectory().ToString());
+	return arrMembers[nFolder].find(swKey) != arrMembers[nFolder].end();
+}
+
+/**
+ * Gets the members of a smart folder.
+ *
+ * @param  nFolder Folder index.
+ * @return         Quantities of the members keyed by their directory paths.
+ */
+const map<wstring, size_t>& SmartFolders::GetMembers(size_t nFolder) {
+	return arrMembers[nFolder];
+}
+
+/**
+ * Accounts for the memory used by the smart folders, including the object
+ * itself. They are shown as categories, so that's where they are attributed.
+ *
+ * @param report Report to add the memory to.
+ */
+void SmartFolders::AccountMemory(MemoryReport *report) {
+	report->Add(MEMORY_CATEGORIES, sizeof(SmartFolders) +
+		(arrQueries.capacity() * sizeof(SmartQuery)) +
+		(arrMembers.capacity() * sizeof(map<wstring, size_t>)) +
+		(arrCounts.capacity() * sizeof(FacetCount)));
+
+	// Members of each folder.
+	for (size_t i = 0; i < arrMembers.size(); i++) {
+		map<wstring, size_t>::iterator it;
+
+		report->AddMapNodes(MEMORY_CATEGORIES, arrMembers[i].size(),
+			sizeof(wstring) + sizeof(size_t));
+		for (it = arrMembers[i].begin(); it != arrMembers[i].end(); it++)
+			report->AddString(MEMORY_CATEGORIES, it->first);
+	}
+}
@@ -0,0 +1,62 @@
+/**
+ * SmartFolders.h
+ * Virtual folders whose contents are defined by saved queries and kept up to
+ * date as components change.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _SMART_FOLDERS_H
+#define _SMART_FOLDERS_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Component.h"
+#include "Property.h"
+#include "SmartQuery.h"
+#include "FacetIndex.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+class SmartFolders : public WorkspaceListener {
+protected:
+	vector<SmartQuery> arrQueries;
+	vector< map<wstring, size_t> > arrMembers;
+	vector<FacetCount> arrCounts;
+
+	// Membership.
+	void UpdateMembership(size_t nFolder, Component *component);
+	void RemoveMember(size_t nFolder, wstring swKey);
+
+public:
+	// Constructors and destructors.
+	SmartFolders();
+
+	// Queries.
+	void LoadQueries(vector<Property> arrProperties);
+	void AddQuery(SmartQuery query, vector<Component> *arrComponents);
+
+	// Workspace events.
+	void ComponentAdded(Component *component);
+	void ComponentChanged(Component *component);
+	void ComponentRemoved(Component *component);
+	void ComponentRenamed(Component *component, Directory dirOld);
+	void ComponentsCleared();
+
+	// Folders.
+	size_t GetFoldersCount();
+	LPCTSTR GetFolderName(size_t nFolder);
+	bool HasFolder(LPCTSTR szName);
+	FacetCount GetFolderTotals(size_t nFolder);
+	bool Contains(size_t nFolder, Component *component);
+	const map<wstring, size_t>& GetMembers(size_t nFolder);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _SMART_FOLDERS_H
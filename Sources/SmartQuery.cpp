@@ -0,0 +1,250 @@
+/**
+ * SmartQuery.cpp
+ * A saved query that can be checked against a single component.
+ *
+ * Queries are stored as "Name; Condition & Condition & ..." where each
+ * condition is a "Field op Value" triplet. Fields are either "Name",
+ * "Quantity" or any MANIFEST property key, and the operators are =, !=, <, <=,
+ * >, >= and ~ (contains). A property that is missing from the component is
+ * treated as an empty string.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "SmartQuery.h"
+
+// Query special fields.
+#define QUERY_FIELD_NAME     L"name"
+#define QUERY_FIELD_QUANTITY L"quantity"
+
+/**
+ * Initializes an empty query.
+ */
+SmartQuery::SmartQuery() {
+}
+
+/**
+ * Initializes a query from its definition.
+ *
+ * @param szDefinition Query definition in the "Name; Expression" format.
+ */
+SmartQuery::SmartQuery(LPCTSTR szDefinition) {
+	wstring swDefinition(szDefinition);
+	wstring::size_type pos = swDefinition.find_first_of(L";");
+
+	// Definitions without a name aren't valid.
+	if (pos == wstring::npos)
+		return;
+
+	swName = Trim(swDefinition.substr(0, pos));
+	if (!ParseExpression(Trim(swDefinition.substr(pos + 1))))
+		arrConditions.clear();
+}
+
+/**
+ * Parses a query expression into its conditions.
+ *
+ * @param  swExpression Query expression.
+ * @return              TRUE if the expression was parsed successfully.
+ */
+bool SmartQuery::ParseExpression(wstring swExpression) {
+	wstring::size_type start = 0;
+	wstring::size_type pos;
+
+	this->swExpression = swExpression;
+	arrConditions.clear();
+
+	// Go through the conditions.
+	while ((pos = swExpression.find_first_of(L"&", start)) != wstring::npos) {
+		if (!ParseCondition(swExpression.substr(start, pos - start)))
+			return false;
+
+		start = pos + 1;
+	}
+
+	return ParseCondition(swExpression.substr(start));
+}
+
+/**
+ * Parses a single "Field op Value" condition.
+ *
+ * @param  swCondition Condition string.
+ * @return             TRUE if the condition was parsed successfully.
+ */
+bool SmartQuery::ParseCondition(wstring swCondition) {
+	QueryCondition condition;
+	wstring::size_type pos;
+	size_t nOpLen = 0;
+
+	// Look for the first operator in the string.
+	for (pos = 0; pos < swCondition.length(); pos++) {
+		wstring swOperator = swCondition.substr(pos, 2);
+
+		if (swOperator.compare(L"!=") == 0) {
+			condition.iOperator = QUERY_OP_NOTEQUAL;
+			nOpLen = 2;
+		} else if (swOperator.compare(L"<=") == 0) {
+			condition.iOperator = QUERY_OP_LESSEQUAL;
+			nOpLen = 2;
+		} else if (swOperator.compare(L">=") == 0) {
+			condition.iOperator = QUERY_OP_GREATEREQUAL;
+			nOpLen = 2;
+		} else if (swCondition[pos] == L'=') {
+			condition.iOperator = QUERY_OP_EQUAL;
+			nOpLen = 1;
+		} else if (swCondition[pos] == L'<') {
+			condition.iOperator = QUERY_OP_LESS;
+			nOpLen = 1;
+		} else if (swCondition[pos] == L'>') {
+			condition.iOperator = QUERY_OP_GREATER;
+			nOpLen = 1;
+		} else if (swCondition[pos] == L'~') {
+			condition.iOperator = QUERY_OP_CONTAINS;
+			nOpLen = 1;
+		}
+
+		if (nOpLen > 0)
+			break;
+	}
+
+	// Check if we actually found an operator and a field.
+	if (nOpLen == 0)
+		return false;
+	condition.swField = Trim(swCondition.substr(0, pos));
+	if (condition.swField.length() == 0)
+		return false;
+
+	// Get the value and store the condition.
+	condition.swValue = Trim(swCondition.substr(pos + nOpLen));
+	arrConditions.push_back(condition);
+
+	return true;
+}
+
+/**
+ * Checks if a component matches all the conditions of the query.
+ *
+ * @param  component Component to be checked.
+ * @return           TRUE if the component matches the query.
+ */
+bool SmartQuery::Matches(Component *component) {
+	if (!IsValid())
+		return false;
+
+	for (size_t i = 0; i < arrConditions.size(); i++) {
+		if (!MatchesCondition(component, &arrConditions[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Checks if a component matches a single condition.
+ *
+ * @param  component Component to be checked.
+ * @param  condition Condition to check against.
+ * @return           TRUE if the component matches the condition.
+ */
+bool SmartQuery::MatchesCondition(Component *component,
+								  QueryCondition *condition) {
+	wstring swField = ToLower(condition->swField);
+	wstring swActual;
+	long lActual;
+	long lExpected = _wtol(condition->swValue.c_str());
+
+	// Get the value that we are going to compare.
+	if (swField.compare(QUERY_FIELD_QUANTITY) == 0) {
+		WCHAR szQuantity[33];
+
+		lActual = (long)component->GetQuantity();
+		_ltow(lActual, szQuantity, 10);
+		swActual = szQuantity;
+	} else {
+		if (swField.compare(QUERY_FIELD_NAME) == 0) {
+			swActual = component->GetName();
+		} else {
+			Property *prop = component->GetProperty(condition->swField.c_str());
+			if (prop)
+				swActual = prop->GetValue();
+		}
+
+		lActual = _wtol(swActual.c_str());
+	}
+
+	// Compare the values.
+	switch (condition->iOperator) {
+	case QUERY_OP_EQUAL:
+		return ToLower(swActual).compare(ToLower(condition->swValue)) == 0;
+	case QUERY_OP_NOTEQUAL:
+		return ToLower(swActual).compare(ToLower(condition->swValue)) != 0;
+	case QUERY_OP_LESS:
+		return lActual < lExpected;
+	case QUERY_OP_LESSEQUAL:
+		return lActual <= lExpected;
+	case QUERY_OP_GREATER:
+		return lActual > lExpected;
+	case QUERY_OP_GREATEREQUAL:
+		return lActual >= lExpected;
+	case QUERY_OP_CONTAINS:
+		return ToLower(swActual).find(ToLower(condition->swValue)) != wstring::npos;
+	}
+
+	return false;
+}
+
+/**
+ * Removes the leading and trailing whitespace from a string.
+ *
+ * @param  swString String to be trimmed.
+ * @return          Trimmed string.
+ */
+wstring SmartQuery::Trim(wstring swString) {
+	wstring::size_type start = swString.find_first_not_of(L" \t");
+	wstring::size_type end = swString.find_last_not_of(L" \t");
+
+	if (start == wstring::npos)
+		return wstring();
+
+	return swString.substr(start, end - start + 1);
+}
+
+/**
+ * Converts a string to lower case.
+ *
+ * @param  swString String to be converted.
+ * @return          Lower case version of the string.
+ */
+wstring SmartQuery::ToLower(wstring swString) {
+	for (size_t i = 0; i < swString.length(); i++)
+		swString[i] = towlower(swString[i]);
+
+	return swString;
+}
+
+/**
+ * Gets the name of the query.
+ *
+ * @return Query name.
+ */
+LPCTSTR SmartQuery::GetName() {
+	return swName.c_str();
+}
+
+/**
+ * Gets the expression of the query.
+ *
+ * @return Query expression.
+ */
+LPCTSTR SmartQuery::GetExpression() {
+	return swExpression.c_str();
+}
+
+/**
+ * Checks if the query was parsed successfully.
+ *
+ * @return TRUE if the query has a name and at least one condition.
+ */
+bool SmartQuery::IsValid() {
+	return (swName.length() > 0) && (arrConditions.size() > 0);
+}
@@ -0,0 +1,63 @@
+/**
+ * SmartQuery.h
+ * A saved query that can be checked against a single component.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _SMART_QUERY_H
+#define _SMART_QUERY_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Component.h"
+
+using namespace std;
+
+// Query condition operators.
+#define QUERY_OP_EQUAL         0
+#define QUERY_OP_NOTEQUAL      1
+#define QUERY_OP_LESS          2
+#define QUERY_OP_LESSEQUAL     3
+#define QUERY_OP_GREATER       4
+#define QUERY_OP_GREATEREQUAL  5
+#define QUERY_OP_CONTAINS      6
+
+class SmartQuery {
+protected:
+	// A single "Field op Value" condition.
+	typedef struct {
+		wstring swField;
+		wstring swValue;
+		int iOperator;
+	} QueryCondition;
+
+	wstring swName;
+	wstring swExpression;
+	vector<QueryCondition> arrConditions;
+
+	// Parsing.
+	bool ParseExpression(wstring swExpression);
+	bool ParseCondition(wstring swCondition);
+	static wstring Trim(wstring swString);
+	static wstring ToLower(wstring swString);
+
+	// Evaluation.
+	bool MatchesCondition(Component *component, QueryCondition *condition);
+
+public:
+	// Constructors and destructors.
+	SmartQuery();
+	SmartQuery(LPCTSTR szDefinition);
+
+	// Evaluation.
+	bool Matches(Component *component);
+
+	// Getters.
+	LPCTSTR GetName();
+	LPCTSTR GetExpression();
+	bool IsValid();
+};
+
+#endif  // _SMART_QUERY_H
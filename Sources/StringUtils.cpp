@@ -6,6 +6,7 @@
  */
 
 #include "StringUtils.h"
+#include "AllocProfiler.h"
 
 /**
  * Allocates space for a string and copies it to a destination.
@@ -15,11 +16,12 @@
  */
 void StringUtils::AllocCopy(LPTSTR *szDestination, LPCTSTR szSource) {
 	// Free the destination string first if it is allocated already.
-	if (szDestination)
-		LocalFree(szDestination);
+	if (*szDestination != NULL)
+		AllocProfiler::Free(*szDestination);
 
 	size_t len = wcslen(szSource);
-	*szDestination = (LPTSTR)LocalAlloc(LMEM_FIXED, (len + 1) * sizeof(WCHAR));
+	*szDestination = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		(len + 1) * sizeof(WCHAR), L"StringUtils::AllocCopy");
 	wcscpy(*szDestination, szSource);
 }
 
@@ -57,4 +59,52 @@ bool StringUtils::UnicodeToAscii(char *szASCII, LPCTSTR szUnicode) {
     }
 
     return TRUE;
-}
\ No newline at end of file
+}
+
+/**
+ * Converts a UTF-8 string into a Unicode string.
+ *
+ * @param  swUnicode Pointer to the string that will receive the result.
+ * @param  sUTF8     Original UTF-8 string.
+ * @return           TRUE if the conversion was successful.
+ */
+bool StringUtils::Utf8ToUnicode(wstring *swUnicode, const string &sUTF8) {
+	swUnicode->erase();
+	if (sUTF8.empty())
+		return true;
+
+	// Figure out how long it's going to be and convert it.
+	int nLength = MultiByteToWideChar(CP_UTF8, 0, sUTF8.data(),
+		(int)sUTF8.length(), NULL, 0);
+	if (nLength == 0)
+		return false;
+
+	swUnicode->resize(nLength);
+	return MultiByteToWideChar(CP_UTF8, 0, sUTF8.data(), (int)sUTF8.length(),
+		&(*swUnicode)[0], nLength) == nLength;
+}
+
+/**
+ * Converts a Unicode string into a UTF-8 string.
+ *
+ * @param  sUTF8     Pointer to the string that will receive the result.
+ * @param  szUnicode Original Unicode string.
+ * @return           TRUE if the conversion was successful.
+ */
+bool StringUtils::UnicodeToUtf8(string *sUTF8, LPCTSTR szUnicode) {
+	int nUnicode = (int)wcslen(szUnicode);
+
+	sUTF8->erase();
+	if (nUnicode == 0)
+		return true;
+
+	// Figure out how long it's going to be and convert it.
+	int nLength = WideCharToMultiByte(CP_UTF8, 0, szUnicode, nUnicode, NULL, 0,
+		NULL, NULL);
+	if (nLength == 0)
+		return false;
+
+	sUTF8->resize(nLength);
+	return WideCharToMultiByte(CP_UTF8, 0, szUnicode, nUnicode, &(*sUTF8)[0],
+		nLength, NULL, NULL) == nLength;
+}
@@ -9,6 +9,9 @@
 #define _STRING_UTILS_H
 
 #include <windows.h>
+#include <string>
+
+using namespace std;
 
 class StringUtils {
 private:
@@ -18,6 +21,8 @@ public:
 	static void AllocCopy(LPTSTR *szDestination, LPCTSTR szSource);
 	static bool AsciiToUnicode(LPTSTR szUnicode, const char *szASCII);
 	static bool UnicodeToAscii(char *szASCII, LPCTSTR szUnicode);
+	static bool Utf8ToUnicode(wstring *swUnicode, const string &sUTF8);
+	static bool UnicodeToUtf8(string *sUTF8, LPCTSTR szUnicode);
 };
 
 #endif  // _STRING_UTILS_H
\ No newline at end of file
@@ -0,0 +1,439 @@
+/**
+ * ThumbnailCache.cpp
+ * Persistent cache of the component images already scaled down to the size
+ * used by the detail view.
+ *
+ * Thumbnails live in a cache folder inside the images folder and are named
+ * after the hash of the contents of their source image and their size, so
+ * identical images share a thumbnail and every UI layout gets its own. An
+ * index file remembers the modification time, size and hash of every source
+ * image, so that we only have to hash an image again when it changes. The
+ * index is keyed by the name of the image in the images folder, even if the
+ * image was moved into the asset store, in which case its contents are read
+ * from the blob it references.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include <stdio.h>
+#include "ThumbnailCache.h"
+#include "Constants.h"
+#include "FileUtils.h"
+#include "ImageUtils.h"
+#include "ParallelUtils.h"
+#include "AssetStore.h"
+#include "Tracer.h"
+
+/**
+ * Initializes a cache that isn't associated with any workspace.
+ */
+ThumbnailCache::ThumbnailCache() {
+	nWidth = 0;
+	nHeight = 0;
+}
+
+/**
+ * Opens the thumbnail cache of a workspace. Nothing is done if the cache is
+ * already opened with the same parameters.
+ *
+ * @param  dirWorkspace Workspace root directory.
+ * @param  nWidth       Width of the thumbnails.
+ * @param  nHeight      Height of the thumbnails.
+ * @return              TRUE if the cache index could be loaded.
+ */
+bool ThumbnailCache::Open(Directory dirWorkspace, int nWidth, int nHeight) {
+	Directory dirImages(dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(IMAGES_DIR));
+
+	// Check if we are already opened.
+	if ((wcscmp(this->dirImages.ToString(), dirImages.ToString()) == 0) &&
+			(this->nWidth == nWidth) && (this->nHeight == nHeight))
+		return true;
+
+	this->dirWorkspace = dirWorkspace;
+	this->dirImages = dirImages;
+	this->dirCache = Directory(dirImages.Concatenate(THUMBNAIL_CACHE_DIR));
+	this->nWidth = nWidth;
+	this->nHeight = nHeight;
+
+	return LoadIndex();
+}
+
+/**
+ * Gets the thumbnail of an image, building it if it isn't in the cache yet.
+ * @remark The returned bitmap must be freed using DeleteObject().
+ *
+ * @param  szImagePath Path to the full size image in the images folder, even
+ *                     if it was moved into the asset store.
+ * @return             Thumbnail bitmap or NULL if an error occured.
+ */
+HBITMAP ThumbnailCache::GetThumbnail(LPCTSTR szImagePath) {
+	ThumbnailSource source;
+	wstring swName(Path(szImagePath).FileName());
+	Path pathSource;
+
+	// Check if the source image changed since we last saw it.
+	if (!ResolveSource(swName.c_str(), &pathSource) ||
+			!GetSourceInfo(pathSource.ToString(), &source))
+		return NULL;
+	if (IsFresh(swName.c_str(), &source)) {
+		source.dwHash = mapSources[swName].dwHash;
+	} else {
+		if (!FileUtils::HashContents(pathSource.ToString(), &source.dwHash))
+			return NULL;
+
+		mapSources[swName] = source;
+		SaveIndex();
+	}
+
+	// Try to use the cached thumbnail.
+	Path pathThumbnail = GetThumbnailPath(source.dwHash);
+	if (pathThumbnail.Exists()) {
+		HBITMAP hBitmap = ImageUtils::LoadBitmap(pathThumbnail.ToString());
+		if (hBitmap != NULL)
+			return hBitmap;
+	}
+
+	return BuildThumbnail(pathSource.ToString(), source.dwHash);
+}
+
+/**
+ * Builds the thumbnails of every image in the workspace that doesn't have one
+ * yet, in parallel.
+ *
+ * @return Number of thumbnails that were built.
+ */
+size_t ThumbnailCache::GenerateAll() {
+	size_t nGenerated = 0;
+
+	// Get the list of images to go through.
+	arrBatchNames = ListImages(dirImages, true);
+	arrBatchSources.resize(arrBatchNames.size());
+	arrBatchGenerated.assign(arrBatchNames.size(), 0);
+
+	// Build the thumbnails. The index is only read during this and each worker
+	// only writes to its own items, which is why the flags aren't packed into
+	// bits.
+	ParallelUtils::ForEach(arrBatchNames.size(), GenerateProc, this);
+
+	// Update the index with what was built.
+	for (size_t i = 0; i < arrBatchNames.size(); i++) {
+		if (arrBatchGenerated[i]) {
+			mapSources[arrBatchNames[i]] = arrBatchSources[i];
+			nGenerated++;
+		}
+	}
+	if (nGenerated > 0)
+		SaveIndex();
+
+	// Clean up.
+	arrBatchNames.clear();
+	arrBatchSources.clear();
+	arrBatchGenerated.clear();
+
+	return nGenerated;
+}
+
+/**
+ * Parallel worker that builds the thumbnail of a single image.
+ *
+ * @param nIndex  Index of the image in the batch.
+ * @param lpParam Pointer to the ThumbnailCache object.
+ */
+void ThumbnailCache::GenerateProc(size_t nIndex, LPVOID lpParam) {
+	ThumbnailCache *cache = (ThumbnailCache*)lpParam;
+	ThumbnailSource *source = &cache->arrBatchSources[nIndex];
+	LPCTSTR szName = cache->arrBatchNames[nIndex].c_str();
+	Path pathSource;
+
+	// Skip images that already have an up to date thumbnail.
+	if (!cache->ResolveSource(szName, &pathSource) ||
+			!GetSourceInfo(pathSource.ToString(), source))
+		return;
+	if (cache->IsFresh(szName, source)) {
+		source->dwHash = cache->mapSources.find(wstring(szName))->second.dwHash;
+		if (cache->GetThumbnailPath(source->dwHash).Exists())
+			return;
+	} else if (!FileUtils::HashContents(pathSource.ToString(), &source->dwHash)) {
+		return;
+	}
+
+	// Build it.
+	HBITMAP hBitmap = cache->BuildThumbnail(pathSource.ToString(),
+		source->dwHash);
+	if (hBitmap == NULL)
+		return;
+
+	DeleteObject(hBitmap);
+	cache->arrBatchGenerated[nIndex] = 1;
+}
+
+/**
+ * Removes the index entries of images that changed or no longer exist, and
+ * the thumbnails that no image uses anymore.
+ *
+ * @return Number of thumbnails that were removed.
+ */
+size_t ThumbnailCache::RemoveStale() {
+	map<wstring, ThumbnailSource>::iterator it;
+	map<wstring, bool> mapUsed;
+	size_t nRemoved = 0;
+
+	// Drop the index entries of images that changed or disappeared.
+	for (it = mapSources.begin(); it != mapSources.end();) {
+		ThumbnailSource source;
+		Path pathSource;
+
+		if (!ResolveSource(it->first.c_str(), &pathSource) ||
+				!GetSourceInfo(pathSource.ToString(), &source) ||
+				!IsFresh(it->first.c_str(), &source)) {
+			mapSources.erase(it++);
+		} else {
+			mapUsed[wstring(GetThumbnailPath(it->second.dwHash).FileName())] = true;
+			it++;
+		}
+	}
+	SaveIndex();
+
+	// Delete the thumbnails that aren't used anymore.
+	vector<wstring> arrThumbnails = ListImages(dirCache, false);
+	for (size_t i = 0; i < arrThumbnails.size(); i++) {
+		if (mapUsed.find(arrThumbnails[i]) != mapUsed.end())
+			continue;
+
+		if (FileUtils::Delete(dirCache.Concatenate(
+				arrThumbnails[i].c_str()).ToString()))
+			nRemoved++;
+	}
+
+	return nRemoved;
+}
+
+/**
+ * Accounts for the memory used by the index of the cache, including the object
+ * itself. The thumbnails live on disk, so they don't count.
+ *
+ * @param report Report to add the memory to.
+ */
+void ThumbnailCache::AccountMemory(MemoryReport *report) {
+	map<wstring, ThumbnailSource>::iterator it;
+
+	report->Add(MEMORY_IMAGES, sizeof(ThumbnailCache) +
+		(arrBatchNames.capacity() * sizeof(wstring)) +
+		(arrBatchSources.capacity() * sizeof(ThumbnailSource)) +
+		arrBatchGenerated.capacity());
+	for (size_t i = 0; i < arrBatchNames.size(); i++)
+		report->AddString(MEMORY_IMAGES, arrBatchNames[i]);
+
+	// Source images.
+	report->AddMapNodes(MEMORY_IMAGES, mapSources.size(),
+		sizeof(wstring) + sizeof(ThumbnailSource));
+	for (it = mapSources.begin(); it != mapSources.end(); it++)
+		report->AddString(MEMORY_IMAGES, it->first);
+}
+
+/**
+ * Checks if an index entry still matches its source image.
+ *
+ * @param  szName Name of the source image.
+ * @param  source Current information about the source image.
+ * @return        TRUE if the image didn't change since it was indexed.
+ */
+bool ThumbnailCache::IsFresh(LPCTSTR szName, const ThumbnailSource *source) {
+	map<wstring, ThumbnailSource>::iterator it;
+
+	it = mapSources.find(wstring(szName));
+	if (it == mapSources.end())
+		return false;
+
+	return (CompareFileTime(&it->second.ftModified, &source->ftModified) == 0) &&
+		(it->second.dwSize == source->dwSize);
+}
+
+/**
+ * Builds the path of a thumbnail.
+ *
+ * @param  dwHash Hash of the source image contents.
+ * @return        Path to the thumbnail.
+ */
+Path ThumbnailCache::GetThumbnailPath(DWORD dwHash) {
+	WCHAR szName[MAX_PATH];
+
+	swprintf(szName, L"%08lX_%dx%d%s", dwHash, nWidth, nHeight, IMAGE_EXTENSION);
+	return dirCache.Concatenate(szName);
+}
+
+/**
+ * Scales an image down and stores it in the cache.
+ * @remark The returned bitmap must be freed using DeleteObject().
+ *
+ * @param  szSourcePath Path to the full size image.
+ * @param  dwHash       Hash of the source image contents.
+ * @return              Thumbnail bitmap or NULL if an error occured.
+ */
+HBITMAP ThumbnailCache::BuildThumbnail(LPCTSTR szSourcePath, DWORD dwHash) {
+	HBITMAP hThumbnail;
+
+	// Scale the image down.
+	hThumbnail = ImageUtils::LoadScaledBitmap(szSourcePath, nWidth, nHeight);
+	if (hThumbnail == NULL)
+		return NULL;
+
+	// Store it. Not being able to cache it isn't a reason to fail.
+	if (!FileUtils::Exists(dirCache.ToString()))
+		CreateDirectory(dirCache.ToString(), NULL);
+	ImageUtils::SaveBitmap(hThumbnail, GetThumbnailPath(dwHash).ToString());
+
+	return hThumbnail;
+}
+
+/**
+ * Loads the cache index.
+ *
+ * @return TRUE if the index was loaded or didn't exist yet.
+ */
+bool ThumbnailCache::LoadIndex() {
+	TraceSpan span(L"ThumbnailCache::LoadIndex");
+	Path pathIndex = dirCache.Concatenate(THUMBNAIL_INDEX_FILE);
+	HANDLE hFile;
+	wstring swLine;
+
+	mapSources.clear();
+	if (!pathIndex.Exists())
+		return true;
+
+	hFile = FileUtils::Open(pathIndex.ToString(), GENERIC_READ,
+		FILE_SHARE_READ, OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Each line has the name, modification time, size and hash of an image.
+	while (FileUtils::ReadLine(hFile, &swLine)) {
+		ThumbnailSource source;
+		LPTSTR szField;
+
+		wstring::size_type pos = swLine.find(L'\t');
+		if (pos == wstring::npos)
+			continue;
+
+		szField = (LPTSTR)swLine.c_str() + pos + 1;
+		source.ftModified.dwHighDateTime = wcstoul(szField, &szField, 16);
+		source.ftModified.dwLowDateTime = wcstoul(szField, &szField, 16);
+		source.dwSize = wcstoul(szField, &szField, 16);
+		source.dwHash = wcstoul(szField, &szField, 16);
+
+		mapSources[swLine.substr(0, pos)] = source;
+	}
+	CloseHandle(hFile);
+
+	return true;
+}
+
+/**
+ * Saves the cache index.
+ *
+ * @return TRUE if the operation was successful.
+ */
+bool ThumbnailCache::SaveIndex() {
+	map<wstring, ThumbnailSource>::iterator it;
+	WCHAR szFields[64];
+	wstring swIndex;
+
+	for (it = mapSources.begin(); it != mapSources.end(); it++) {
+		swprintf(szFields, L"\t%08lX %08lX %lX %08lX\r\n",
+			it->second.ftModified.dwHighDateTime,
+			it->second.ftModified.dwLowDateTime, it->second.dwSize,
+			it->second.dwHash);
+
+		swIndex += it->first;
+		swIndex += szFields;
+	}
+
+	// Make sure the cache folder exists.
+	if (!FileUtils::Exists(dirCache.ToString()))
+		CreateDirectory(dirCache.ToString(), NULL);
+
+	return FileUtils::SaveContents(
+		dirCache.Concatenate(THUMBNAIL_INDEX_FILE).ToString(), swIndex.c_str());
+}
+
+/**
+ * Lists the bitmap images in a directory.
+ *
+ * @param  dirPath     Directory to be listed.
+ * @param  bReferences Also list the images that were moved into the asset
+ *                     store, by their original name.
+ * @return             Names of the images.
+ */
+vector<wstring> ThumbnailCache::ListImages(Directory dirPath, bool bReferences) {
+	map<wstring, bool> mapNames;
+	vector<wstring> arrNames;
+	WIN32_FIND_DATA wfd;
+	HANDLE hFind;
+
+	Path pathQuery = dirPath.Concatenate(L"*");
+	pathQuery.AppendString(IMAGE_EXTENSION);
+	hFind = FileUtils::FindFirst(pathQuery.ToString(), &wfd);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				arrNames.push_back(wstring(wfd.cFileName));
+				mapNames[arrNames.back()] = true;
+			}
+		} while (FindNextFile(hFind, &wfd));
+		FindClose(hFind);
+	}
+	if (!bReferences)
+		return arrNames;
+
+	// Images that were moved into the store, unless the file itself is back.
+	pathQuery.AppendString(BLOB_REF_EXTENSION);
+	hFind = FileUtils::FindFirst(pathQuery.ToString(), &wfd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return arrNames;
+
+	do {
+		wstring swName(wfd.cFileName);
+
+		if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		swName.erase(swName.length() - wcslen(BLOB_REF_EXTENSION));
+		if (mapNames.find(swName) == mapNames.end())
+			arrNames.push_back(swName);
+	} while (FindNextFile(hFind, &wfd));
+	FindClose(hFind);
+
+	return arrNames;
+}
+
+/**
+ * Gets the path to the contents of an image in the images folder, which may
+ * have been moved into the asset store.
+ *
+ * @param  szName     Name of the image in the images folder.
+ * @param  pathSource Path to the image or to the blob it references.
+ * @return            TRUE if the image exists in one of the two forms.
+ */
+bool ThumbnailCache::ResolveSource(LPCTSTR szName, Path *pathSource) {
+	return AssetStore::ResolveFile(dirWorkspace, dirImages.Concatenate(szName),
+		pathSource);
+}
+
+/**
+ * Gets the modification time and size of an image.
+ *
+ * @param  szPath Path to the image.
+ * @param  source Structure to be populated. The hash isn't touched.
+ * @return        TRUE if the image exists.
+ */
+bool ThumbnailCache::GetSourceInfo(LPCTSTR szPath, ThumbnailSource *source) {
+	WIN32_FIND_DATA wfd;
+
+	if (!FileUtils::GetInfo(szPath, &wfd))
+		return false;
+
+	source->ftModified = wfd.ftLastWriteTime;
+	source->dwSize = wfd.nFileSizeLow;
+
+	return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * ThumbnailCache.h
+ * Persistent cache of the component images already scaled down to the size
+ * used by the detail view.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _THUMBNAIL_CACHE_H
+#define _THUMBNAIL_CACHE_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "Directory.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+// What we know about a source image.
+typedef struct {
+	FILETIME ftModified;
+	DWORD dwSize;
+	DWORD dwHash;
+} ThumbnailSource;
+
+class ThumbnailCache {
+protected:
+	Directory dirWorkspace;
+	Directory dirImages;
+	Directory dirCache;
+	int nWidth;
+	int nHeight;
+	map<wstring, ThumbnailSource> mapSources;
+
+	// Batch generation.
+	vector<wstring> arrBatchNames;
+	vector<ThumbnailSource> arrBatchSources;
+	vector<unsigned char> arrBatchGenerated;
+
+	// Index.
+	bool LoadIndex();
+	bool SaveIndex();
+	bool IsFresh(LPCTSTR szName, const ThumbnailSource *source);
+
+	// Thumbnails.
+	Path GetThumbnailPath(DWORD dwHash);
+	HBITMAP BuildThumbnail(LPCTSTR szSourcePath, DWORD dwHash);
+	static void GenerateProc(size_t nIndex, LPVOID lpParam);
+
+	// Source images.
+	vector<wstring> ListImages(Directory dirPath, bool bReferences);
+	bool ResolveSource(LPCTSTR szName, Path *pathSource);
+	static bool GetSourceInfo(LPCTSTR szPath, ThumbnailSource *source);
+
+public:
+	// Constructors and destructors.
+	ThumbnailCache();
+
+	// Cache.
+	bool Open(Directory dirWorkspace, int nWidth, int nHeight);
+	HBITMAP GetThumbnail(LPCTSTR szImagePath);
+
+	// Maintenance.
+	size_t GenerateAll();
+	size_t RemoveStale();
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
+};
+
+#endif  // _THUMBNAIL_CACHE_H
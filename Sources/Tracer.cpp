@@ -0,0 +1,278 @@
+/**
+ * Tracer.cpp
+ * Records how long the core operations take in the Chrome trace event format.
+ *
+ * Operations are wrapped in a TraceSpan on the stack, which records a single
+ * complete event when it goes out of scope. Nested spans are simply the ones
+ * that start and end inside another on the same thread, which is how the
+ * trace viewers stack them. Events go into a fixed ring buffer that is only
+ * allocated when tracing is enabled, so a disabled tracer costs a flag check
+ * per span. Span names must be string literals since only the pointer is
+ * kept. Timestamps are 64-bit microseconds, since 32 bits would wrap after
+ * about 71 minutes of tracing.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "Tracer.h"
+#include "FileUtils.h"
+
+// Static members.
+TraceEvent *Tracer::arrEvents = NULL;
+size_t Tracer::nNext = 0;
+size_t Tracer::nCount = 0;
+bool Tracer::bEnabled = false;
+bool Tracer::bInitialized = false;
+CRITICAL_SECTION Tracer::csEvents;
+LARGE_INTEGER Tracer::liFrequency;
+LARGE_INTEGER Tracer::liBase;
+
+/**
+ * Starts recording a new trace, discarding the previous one.
+ * @remark Must be called from the main thread.
+ *
+ * @return TRUE if tracing is enabled.
+ */
+bool Tracer::Enable() {
+	if (!bInitialized) {
+		InitializeCriticalSection(&csEvents);
+		bInitialized = true;
+	}
+
+	// Allocate the ring buffer.
+	EnterCriticalSection(&csEvents);
+	if (arrEvents == NULL) {
+		arrEvents = (TraceEvent*)LocalAlloc(LMEM_FIXED,
+			TRACE_BUFFER_SIZE * sizeof(TraceEvent));
+		if (arrEvents == NULL) {
+			LeaveCriticalSection(&csEvents);
+			return false;
+		}
+	}
+	nNext = 0;
+	nCount = 0;
+
+	// Fall back to the tick count if there's no high resolution counter.
+	if (!QueryPerformanceFrequency(&liFrequency) ||
+			(liFrequency.QuadPart == 0)) {
+		liFrequency.QuadPart = 0;
+		liBase.QuadPart = GetTickCount();
+	} else {
+		QueryPerformanceCounter(&liBase);
+	}
+
+	bEnabled = true;
+	LeaveCriticalSection(&csEvents);
+
+	return true;
+}
+
+/**
+ * Stops recording. The events are kept until tracing is enabled again.
+ */
+void Tracer::Disable() {
+	bEnabled = false;
+}
+
+/**
+ * Checks if spans are being recorded.
+ *
+ * @return TRUE if tracing is enabled.
+ */
+bool Tracer::IsEnabled() {
+	return bEnabled;
+}
+
+/**
+ * Gets the current time.
+ *
+ * @return Microseconds since tracing was enabled.
+ */
+ULONGLONG Tracer::GetTimestamp() {
+	LARGE_INTEGER liNow;
+
+	if (liFrequency.QuadPart == 0)
+		return (ULONGLONG)(GetTickCount() - liBase.LowPart) * 1000;
+
+	// Split the seconds out so that fast counters don't overflow.
+	QueryPerformanceCounter(&liNow);
+	ULONGLONG ullTicks = (ULONGLONG)(liNow.QuadPart - liBase.QuadPart);
+	ULONGLONG ullFrequency = (ULONGLONG)liFrequency.QuadPart;
+	return ((ullTicks / ullFrequency) * 1000000) +
+		(((ullTicks % ullFrequency) * 1000000) / ullFrequency);
+}
+
+/**
+ * Records a span that just ended.
+ *
+ * @param szName   Name of the span. Must be a string literal.
+ * @param ullStart Timestamp of when the span started.
+ */
+void Tracer::Record(LPCTSTR szName, ULONGLONG ullStart) {
+	ULONGLONG ullEnd = GetTimestamp();
+
+	EnterCriticalSection(&csEvents);
+	if (bEnabled) {
+		TraceEvent *event = &arrEvents[nNext];
+
+		event->szName = szName;
+		event->dwThread = GetCurrentThreadId();
+		event->ullStart = ullStart;
+		event->ullDuration = ullEnd - ullStart;
+
+		nNext = (nNext + 1) % TRACE_BUFFER_SIZE;
+		if (nCount < TRACE_BUFFER_SIZE)
+			nCount++;
+	}
+	LeaveCriticalSection(&csEvents);
+}
+
+/**
+ * Gets the number of spans in the ring buffer.
+ *
+ * @return Number of recorded spans.
+ */
+size_t Tracer::GetEventCount() {
+	return nCount;
+}
+
+/**
+ * Gets a copy of a span in the ring buffer.
+ *
+ * @param  nIndex Index of the span, starting from the oldest one.
+ * @param  event  Where the span will be copied to.
+ * @return        TRUE if the span exists.
+ */
+bool Tracer::GetEvent(size_t nIndex, TraceEvent *event) {
+	bool bFound = false;
+
+	if (!bInitialized)
+		return false;
+
+	EnterCriticalSection(&csEvents);
+	if (nIndex < nCount) {
+		*event = *GetOrderedEvent(nIndex);
+		bFound = true;
+	}
+	LeaveCriticalSection(&csEvents);
+
+	return bFound;
+}
+
+/**
+ * Builds a Chrome trace event document with the recorded spans.
+ *
+ * @return Trace as a JSON document.
+ */
+wstring Tracer::ToJSON() {
+	WCHAR szNumber[33];
+	wstring swJSON(L"{\"traceEvents\": [");
+
+	if (!bInitialized)
+		return swJSON + L"]}\r\n";
+
+	// Go through the buffer from the oldest event to the newest.
+	EnterCriticalSection(&csEvents);
+	for (size_t i = 0; i < nCount; i++) {
+		TraceEvent *event = GetOrderedEvent(i);
+
+		swJSON += (i == 0) ? L"\r\n" : L",\r\n";
+		swJSON += L"{\"name\": \"";
+		swJSON += event->szName;
+		swJSON += L"\", \"cat\": \"partcat\", \"ph\": \"X\", \"pid\": 1, "
+			L"\"tid\": ";
+		swJSON += _ultow(event->dwThread, szNumber, 10);
+		swJSON += L", \"ts\": ";
+		AppendNumber(&swJSON, event->ullStart);
+		swJSON += L", \"dur\": ";
+		AppendNumber(&swJSON, event->ullDuration);
+		swJSON += L"}";
+	}
+	LeaveCriticalSection(&csEvents);
+
+	swJSON += L"\r\n], \"displayTimeUnit\": \"ms\"}\r\n";
+	return swJSON;
+}
+
+/**
+ * Saves the recorded spans to a file that can be loaded in chrome://tracing.
+ *
+ * @param  szPath Path of the file.
+ * @return        TRUE if the operation was successful.
+ */
+bool Tracer::Save(LPCTSTR szPath) {
+	return FileUtils::SaveContents(szPath, ToJSON().c_str());
+}
+
+/**
+ * Stops recording and frees the ring buffer.
+ * @remark Must only be called when no other threads are running.
+ */
+void Tracer::Release() {
+	bEnabled = false;
+	if (!bInitialized)
+		return;
+
+	if (arrEvents != NULL) {
+		LocalFree(arrEvents);
+		arrEvents = NULL;
+	}
+	nNext = 0;
+	nCount = 0;
+
+	DeleteCriticalSection(&csEvents);
+	bInitialized = false;
+}
+
+/**
+ * Gets a span in the ring buffer.
+ * @remark The events lock must be held by the caller.
+ *
+ * @param  nIndex Index of the span, starting from the oldest one.
+ * @return        Span in the ring buffer.
+ */
+TraceEvent* Tracer::GetOrderedEvent(size_t nIndex) {
+	size_t nFirst = (nNext + TRACE_BUFFER_SIZE - nCount) % TRACE_BUFFER_SIZE;
+	return &arrEvents[(nFirst + nIndex) % TRACE_BUFFER_SIZE];
+}
+
+/**
+ * Appends a 64-bit number to a JSON document.
+ *
+ * @param swJSON    Document to append to.
+ * @param ullNumber Number to be appended.
+ */
+void Tracer::AppendNumber(wstring *swJSON, ULONGLONG ullNumber) {
+	WCHAR szNumber[21];
+	int i = 20;
+
+	// Build the digits from the end of the buffer.
+	szNumber[i] = L'\0';
+	do {
+		szNumber[--i] = (WCHAR)(L'0' + (int)(ullNumber % 10));
+		ullNumber /= 10;
+	} while (ullNumber > 0);
+
+	*swJSON += szNumber + i;
+}
+
+/**
+ * Starts a span that lasts until the object goes out of scope.
+ *
+ * @param szName Name of the span. Must be a string literal.
+ */
+TraceSpan::TraceSpan(LPCTSTR szName) {
+	this->szName = NULL;
+	if (Tracer::IsEnabled()) {
+		this->szName = szName;
+		ullStart = Tracer::GetTimestamp();
+	}
+}
+
+/**
+ * Ends the span and records it.
+ */
+TraceSpan::~TraceSpan() {
+	if (szName != NULL)
+		Tracer::Record(szName, ullStart);
+}
@@ -0,0 +1,76 @@
+/**
+ * Tracer.h
+ * Records how long the core operations take in the Chrome trace event format.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _TRACER_H
+#define _TRACER_H
+
+#include <windows.h>
+#include <string>
+
+using namespace std;
+
+// Number of spans kept in the ring buffer before the oldest are overwritten.
+#define TRACE_BUFFER_SIZE 4096
+
+// A single finished span.
+typedef struct {
+	LPCTSTR szName;
+	DWORD dwThread;
+	ULONGLONG ullStart;
+	ULONGLONG ullDuration;
+} TraceEvent;
+
+class Tracer {
+private:
+	static TraceEvent *arrEvents;
+	static size_t nNext;
+	static size_t nCount;
+	static bool bEnabled;
+	static bool bInitialized;
+	static CRITICAL_SECTION csEvents;
+	static LARGE_INTEGER liFrequency;
+	static LARGE_INTEGER liBase;
+
+	Tracer() {}
+
+	// Helpers.
+	static TraceEvent* GetOrderedEvent(size_t nIndex);
+	static void AppendNumber(wstring *swJSON, ULONGLONG ullNumber);
+
+public:
+	// Recording.
+	static bool Enable();
+	static void Disable();
+	static bool IsEnabled();
+	static ULONGLONG GetTimestamp();
+	static void Record(LPCTSTR szName, ULONGLONG ullStart);
+
+	// Output.
+	static size_t GetEventCount();
+	static bool GetEvent(size_t nIndex, TraceEvent *event);
+	static wstring ToJSON();
+	static bool Save(LPCTSTR szPath);
+	static void Release();
+};
+
+class TraceSpan {
+protected:
+	LPCTSTR szName;
+	ULONGLONG ullStart;
+
+private:
+	// Spans can't be copied.
+	TraceSpan(const TraceSpan &span);
+	TraceSpan& operator=(const TraceSpan &span);
+
+public:
+	// Constructors and destructors.
+	TraceSpan(LPCTSTR szName);
+	~TraceSpan();
+};
+
+#endif  // _TRACER_H
@@ -0,0 +1,479 @@
+/**
+ * TreeDiff.cpp
+ * Compares two versions of a tree and lists the operations needed to turn the
+ * old one into the new one.
+ *
+ * Children are matched with the children of the same parent in the old tree
+ * by their keys, directly for the ones at the start and end that didn't change
+ * and through an index for the rest. Of the matched ones, the longest run that is already in the
+ * right order is kept where it is and everything else is moved, which gives
+ * the smallest number of moves. Nodes that are kept are renamed if their
+ * contents changed and have their own children compared the same way. Nodes
+ * that are inserted or moved have all of their children inserted, since most
+ * tree controls can't move a node to another place.
+ *
+ * Deletions always come first in the list of operations and everything else
+ * comes in the order of the new tree, so every parent and previous sibling
+ * already exists by the time a node is inserted after it.
+ *
+ * When only a few folders can have changed, the tree is patched in place
+ * instead, comparing just those folders with what they should look like. The
+ * nodes that are kept keep their indexes and everything else is replaced, so
+ * the operations are the same kind that a full comparison would give.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "TreeDiff.h"
+
+/**
+ * Initializes an empty comparison.
+ */
+TreeDiff::TreeDiff() {
+	for (int i = 0; i < TREE_OP_TYPES; i++)
+		anCounts[i] = 0;
+}
+
+/**
+ * Compares two versions of a tree.
+ *
+ * @param modelOld Tree as it is now.
+ * @param modelNew Tree as it should be.
+ */
+void TreeDiff::Compare(const TreeModel &modelOld, const TreeModel &modelNew) {
+	vector<TreeOperation> arrDeletions;
+
+	// Start from scratch.
+	arrOperations.clear();
+	arrKept.assign(modelNew.GetCount(), TREE_NODE_NONE);
+	for (int i = 0; i < TREE_OP_TYPES; i++)
+		anCounts[i] = 0;
+
+	// Compare everything and put the deletions in front.
+	CompareChildren(modelOld, modelNew, TREE_NODE_NONE, TREE_NODE_NONE,
+		&arrDeletions);
+	arrOperations.insert(arrOperations.begin(), arrDeletions.begin(),
+		arrDeletions.end());
+}
+
+/**
+ * Compares the children of a node that is kept between both trees.
+ *
+ * @param modelOld     Tree as it is now.
+ * @param modelNew     Tree as it should be.
+ * @param nOldParent   Parent node in the old tree.
+ * @param nParent      Same parent node in the new tree.
+ * @param arrDeletions Where to put the deletions.
+ */
+void TreeDiff::CompareChildren(const TreeModel &modelOld,
+							   const TreeModel &modelNew, size_t nOldParent,
+							   size_t nParent,
+							   vector<TreeOperation> *arrDeletions) {
+	const vector<size_t> &arrOld = modelOld.GetChildren(nOldParent);
+	const vector<size_t> &arrNew = modelNew.GetChildren(nParent);
+	vector<size_t> arrMatches;
+	vector<bool> arrUsed;
+	vector<bool> arrStable;
+	size_t i;
+
+	// Match the children and find the ones that are already in order.
+	MatchChildren(modelOld, arrOld, modelNew, arrNew, &arrMatches, &arrUsed,
+		&arrStable);
+
+	// Get rid of the children that are gone.
+	for (i = 0; i < arrOld.size(); i++) {
+		if (!arrUsed[i]) {
+			AddOperation(TREE_OP_DELETE, arrOld[i], TREE_NODE_NONE,
+				TREE_NODE_NONE, TREE_NODE_NONE, arrDeletions);
+		}
+	}
+
+	// Go through the new children in order.
+	size_t nAfter = TREE_NODE_NONE;
+	for (i = 0; i < arrNew.size(); i++) {
+		size_t nNode = arrNew[i];
+
+		if (arrMatches[i] == TREE_NODE_NONE) {
+			// Brand new node.
+			AddOperation(TREE_OP_INSERT, TREE_NODE_NONE, nNode, nParent,
+				nAfter, &arrOperations);
+			InsertChildren(modelNew, nNode);
+		} else if (arrStable[i]) {
+			// Node stays where it is.
+			size_t nOldNode = arrOld[arrMatches[i]];
+			arrKept[nNode] = nOldNode;
+
+			if (IsChanged(modelOld.GetNode(nOldNode), modelNew.GetNode(nNode))) {
+				AddOperation(TREE_OP_RENAME, nOldNode, nNode, nParent, nAfter,
+					&arrOperations);
+			}
+
+			CompareChildren(modelOld, modelNew, nOldNode, nNode, arrDeletions);
+		} else {
+			// Node is out of order.
+			AddOperation(TREE_OP_MOVE, arrOld[arrMatches[i]], nNode, nParent,
+				nAfter, &arrOperations);
+			InsertChildren(modelNew, nNode);
+		}
+
+		nAfter = nNode;
+	}
+}
+
+/**
+ * Patches the tree in place so that some of the folders at its root look like
+ * the ones in another tree, listing the operations to get there. Everything
+ * else is left untouched and isn't even looked at.
+ * @remark Folders of the wanted tree that don't exist yet are ignored, and
+ *         folders are never removed, so a full comparison is needed for that.
+ *
+ * @param model       Tree to be patched.
+ * @param modelWanted Tree with just the folders that may have changed, as
+ *                    they should be.
+ */
+void TreeDiff::Patch(TreeModel *model, const TreeModel &modelWanted) {
+	const vector<size_t> &arrWanted = modelWanted.GetChildren(TREE_NODE_NONE);
+	vector<TreeOperation> arrDeletions;
+	size_t nOldCount = model->GetCount();
+	size_t i;
+
+	// Start from scratch.
+	arrOperations.clear();
+	for (i = 0; i < TREE_OP_TYPES; i++)
+		anCounts[i] = 0;
+
+	// Patch each of the folders.
+	for (i = 0; i < arrWanted.size(); i++) {
+		const TreeNode &nodeWanted = modelWanted.GetNode(arrWanted[i]);
+		size_t nNode = model->FindChild(TREE_NODE_NONE, nodeWanted.swKey);
+		if (nNode == TREE_NODE_NONE)
+			continue;
+
+		if (IsChanged(model->GetNode(nNode), nodeWanted)) {
+			model->SetContents(nNode, nodeWanted.swLabel, nodeWanted.lParam,
+				nodeWanted.iImage);
+			AddOperation(TREE_OP_RENAME, nNode, nNode, TREE_NODE_NONE,
+				TREE_NODE_NONE, &arrOperations);
+		}
+
+		PatchChildren(model, modelWanted, nNode, arrWanted[i], &arrDeletions);
+	}
+	arrOperations.insert(arrOperations.begin(), arrDeletions.begin(),
+		arrDeletions.end());
+
+	// Everything that existed before and wasn't removed is kept.
+	arrKept.assign(model->GetCount(), TREE_NODE_NONE);
+	for (i = 0; i < nOldCount; i++) {
+		if (!model->GetNode(i).bRemoved)
+			arrKept[i] = i;
+	}
+}
+
+/**
+ * Patches the children of a node that is kept so that they look like the
+ * children of a node of another tree.
+ *
+ * @param model         Tree to be patched.
+ * @param modelWanted   Tree with the children as they should be.
+ * @param nParent       Parent node in the tree being patched.
+ * @param nWantedParent Same parent node in the wanted tree.
+ * @param arrDeletions  Where to put the deletions.
+ */
+void TreeDiff::PatchChildren(TreeModel *model, const TreeModel &modelWanted,
+							 size_t nParent, size_t nWantedParent,
+							 vector<TreeOperation> *arrDeletions) {
+	vector<size_t> arrOld = model->GetChildren(nParent);
+	const vector<size_t> &arrNew = modelWanted.GetChildren(nWantedParent);
+	vector<size_t> arrChildren;
+	vector<size_t> arrMatches;
+	vector<bool> arrUsed;
+	vector<bool> arrStable;
+	size_t i;
+
+	// Match the children and find the ones that are already in order.
+	MatchChildren(*model, arrOld, modelWanted, arrNew, &arrMatches, &arrUsed,
+		&arrStable);
+
+	// Nodes out of order are replaced, so they are gone as well.
+	for (i = 0; i < arrNew.size(); i++) {
+		if ((arrMatches[i] != TREE_NODE_NONE) && !arrStable[i])
+			arrUsed[arrMatches[i]] = false;
+	}
+	for (i = 0; i < arrOld.size(); i++) {
+		if (!arrUsed[i]) {
+			AddOperation(TREE_OP_DELETE, arrOld[i], TREE_NODE_NONE,
+				TREE_NODE_NONE, TREE_NODE_NONE, arrDeletions);
+		}
+	}
+
+	// Go through the wanted children in order.
+	arrChildren.reserve(arrNew.size());
+	size_t nAfter = TREE_NODE_NONE;
+	for (i = 0; i < arrNew.size(); i++) {
+		const TreeNode &nodeWanted = modelWanted.GetNode(arrNew[i]);
+		size_t nNode;
+
+		if ((arrMatches[i] != TREE_NODE_NONE) && arrStable[i]) {
+			// Node stays where it is.
+			nNode = arrOld[arrMatches[i]];
+			if (IsChanged(model->GetNode(nNode), nodeWanted)) {
+				model->SetContents(nNode, nodeWanted.swLabel, nodeWanted.lParam,
+					nodeWanted.iImage);
+				AddOperation(TREE_OP_RENAME, nNode, nNode, nParent, nAfter,
+					&arrOperations);
+			}
+
+			PatchChildren(model, modelWanted, nNode, arrNew[i], arrDeletions);
+		} else {
+			// New node or one that was out of order.
+			nNode = CopyNode(model, nParent, modelWanted, arrNew[i]);
+			AddOperation(TREE_OP_INSERT, TREE_NODE_NONE, nNode, nParent,
+				nAfter, &arrOperations);
+			InsertChildren(*model, nNode);
+		}
+
+		arrChildren.push_back(nNode);
+		nAfter = nNode;
+	}
+
+	model->ReplaceChildren(nParent, arrChildren);
+}
+
+/**
+ * Inserts all the children of a node that was just inserted or moved.
+ *
+ * @param modelNew Tree as it should be.
+ * @param nParent  Parent node in the new tree.
+ */
+void TreeDiff::InsertChildren(const TreeModel &modelNew, size_t nParent) {
+	const vector<size_t> &arrNew = modelNew.GetChildren(nParent);
+	size_t nAfter = TREE_NODE_NONE;
+
+	for (size_t i = 0; i < arrNew.size(); i++) {
+		AddOperation(TREE_OP_INSERT, TREE_NODE_NONE, arrNew[i], nParent,
+			nAfter, &arrOperations);
+		InsertChildren(modelNew, arrNew[i]);
+
+		nAfter = arrNew[i];
+	}
+}
+
+/**
+ * Appends an operation to a list.
+ *
+ * @param nType     Type of the operation.
+ * @param nOldNode  Node in the old tree or TREE_NODE_NONE.
+ * @param nNode     Node in the new tree or TREE_NODE_NONE.
+ * @param nParent   Parent in the new tree or TREE_NODE_NONE for the root.
+ * @param nAfter    Sibling in the new tree that comes right before the node
+ *                  or TREE_NODE_NONE if it's the first one.
+ * @param arrTarget List to append the operation to.
+ */
+void TreeDiff::AddOperation(int nType, size_t nOldNode, size_t nNode,
+							size_t nParent, size_t nAfter,
+							vector<TreeOperation> *arrTarget) {
+	TreeOperation op;
+
+	op.nType = nType;
+	op.nOldNode = nOldNode;
+	op.nNode = nNode;
+	op.nParent = nParent;
+	op.nAfter = nAfter;
+	arrTarget->push_back(op);
+
+	anCounts[nType]++;
+}
+
+/**
+ * Matches the children of a node in the old tree with the children of the
+ * same node in the new tree by their keys, directly for the ones at the start
+ * and end that didn't change and through an index for the rest.
+ *
+ * @param modelOld   Tree as it is now.
+ * @param arrOld     Children in the old tree.
+ * @param modelNew   Tree as it should be.
+ * @param arrNew     Children in the new tree.
+ * @param arrMatches Position of each new child in the old children or
+ *                   TREE_NODE_NONE if it's a new one.
+ * @param arrUsed    Set to TRUE for every old child that was matched.
+ * @param arrStable  Set to TRUE for every new child that was matched and is
+ *                   already in the right order.
+ */
+void TreeDiff::MatchChildren(const TreeModel &modelOld,
+							 const vector<size_t> &arrOld,
+							 const TreeModel &modelNew,
+							 const vector<size_t> &arrNew,
+							 vector<size_t> *arrMatches,
+							 vector<bool> *arrUsed, vector<bool> *arrStable) {
+	map<wstring, size_t> mapOld;
+	map<wstring, size_t>::iterator it;
+	vector<size_t> arrPositions;
+	vector<bool> arrRun;
+	size_t i;
+
+	arrMatches->assign(arrNew.size(), TREE_NODE_NONE);
+	arrUsed->assign(arrOld.size(), false);
+
+	// Children at the start and end that didn't change are matched directly.
+	size_t nStart = 0;
+	size_t nOldEnd = arrOld.size();
+	size_t nEnd = arrNew.size();
+	while ((nStart < nOldEnd) && (nStart < nEnd) &&
+			(modelOld.GetNode(arrOld[nStart]).swKey ==
+			modelNew.GetNode(arrNew[nStart]).swKey)) {
+		(*arrMatches)[nStart] = nStart;
+		(*arrUsed)[nStart] = true;
+		nStart++;
+	}
+	while ((nOldEnd > nStart) && (nEnd > nStart) &&
+			(modelOld.GetNode(arrOld[nOldEnd - 1]).swKey ==
+			modelNew.GetNode(arrNew[nEnd - 1]).swKey)) {
+		nOldEnd--;
+		nEnd--;
+		(*arrMatches)[nEnd] = nOldEnd;
+		(*arrUsed)[nOldEnd] = true;
+	}
+
+	// Index the rest of the old children by their keys.
+	for (i = nStart; i < nOldEnd; i++)
+		mapOld.insert(make_pair(modelOld.GetNode(arrOld[i]).swKey, i));
+
+	// Match the rest of the new children with the old ones.
+	for (i = nStart; i < nEnd; i++) {
+		it = mapOld.find(modelNew.GetNode(arrNew[i]).swKey);
+		if ((it != mapOld.end()) && !(*arrUsed)[it->second]) {
+			(*arrMatches)[i] = it->second;
+			(*arrUsed)[it->second] = true;
+		}
+	}
+
+	// Get the old positions of the matched children in their new order.
+	arrPositions.reserve(arrNew.size());
+	for (i = 0; i < arrNew.size(); i++) {
+		if ((*arrMatches)[i] != TREE_NODE_NONE)
+			arrPositions.push_back((*arrMatches)[i]);
+	}
+
+	// Find the ones that are already in the right order.
+	FindStable(arrPositions, &arrRun);
+	arrStable->assign(arrNew.size(), false);
+	size_t nMatched = 0;
+	for (i = 0; i < arrNew.size(); i++) {
+		if ((*arrMatches)[i] != TREE_NODE_NONE)
+			(*arrStable)[i] = arrRun[nMatched++];
+	}
+}
+
+/**
+ * Finds the longest run of positions that is already in increasing order.
+ *
+ * @param arrPositions Old positions of the matched children in their new
+ *                     order.
+ * @param arrStable    Set to TRUE for every position that is part of the run.
+ */
+void TreeDiff::FindStable(const vector<size_t> &arrPositions,
+						  vector<bool> *arrStable) {
+	vector<size_t> arrTails;
+	vector<size_t> arrPrevious(arrPositions.size(), TREE_NODE_NONE);
+
+	arrStable->assign(arrPositions.size(), false);
+	for (size_t i = 0; i < arrPositions.size(); i++) {
+		size_t nLow = 0;
+		size_t nHigh = arrTails.size();
+
+		// Find the shortest run that this position can extend.
+		while (nLow < nHigh) {
+			size_t nMiddle = (nLow + nHigh) / 2;
+
+			if (arrPositions[arrTails[nMiddle]] < arrPositions[i]) {
+				nLow = nMiddle + 1;
+			} else {
+				nHigh = nMiddle;
+			}
+		}
+
+		if (nLow > 0)
+			arrPrevious[i] = arrTails[nLow - 1];
+		if (nLow == arrTails.size()) {
+			arrTails.push_back(i);
+		} else {
+			arrTails[nLow] = i;
+		}
+	}
+
+	// Walk the longest run backwards.
+	if (arrTails.empty())
+		return;
+	for (size_t i = arrTails.back(); i != TREE_NODE_NONE; i = arrPrevious[i])
+		(*arrStable)[i] = true;
+}
+
+/**
+ * Copies a node and everything under it from another tree. The copy isn't
+ * added to the children of its parent.
+ *
+ * @param  model     Tree to copy the node into.
+ * @param  nParent   Parent of the copy or TREE_NODE_NONE for the root.
+ * @param  modelFrom Tree the node belongs to.
+ * @param  nNode     Node to be copied.
+ * @return           Index of the copy.
+ */
+size_t TreeDiff::CopyNode(TreeModel *model, size_t nParent,
+						  const TreeModel &modelFrom, size_t nNode) {
+	const TreeNode &node = modelFrom.GetNode(nNode);
+	vector<size_t> arrCopies;
+
+	size_t nCopy = model->CreateNode(nParent, node.swKey, node.swLabel,
+		node.lParam, node.iImage, node.bExpand);
+	arrCopies.reserve(node.arrChildren.size());
+	for (size_t i = 0; i < node.arrChildren.size(); i++) {
+		arrCopies.push_back(CopyNode(model, nCopy, modelFrom,
+			node.arrChildren[i]));
+	}
+	model->ReplaceChildren(nCopy, arrCopies);
+
+	return nCopy;
+}
+
+/**
+ * Checks if the contents of a node have changed.
+ *
+ * @param  nodeOld Node in the old tree.
+ * @param  nodeNew Same node in the new tree.
+ * @return         TRUE if the node has to be updated.
+ */
+bool TreeDiff::IsChanged(const TreeNode &nodeOld, const TreeNode &nodeNew) {
+	return (nodeOld.lParam != nodeNew.lParam) ||
+		(nodeOld.iImage != nodeNew.iImage) ||
+		(nodeOld.swLabel != nodeNew.swLabel);
+}
+
+/**
+ * Gets the operations needed to turn the old tree into the new one.
+ *
+ * @return Deletions followed by everything else in the order of the new tree.
+ */
+const vector<TreeOperation>& TreeDiff::GetOperations() const {
+	return arrOperations;
+}
+
+/**
+ * Gets the node of the old tree that is kept as a node of the new one.
+ *
+ * @param  nNode Node in the new tree.
+ * @return       Node in the old tree or TREE_NODE_NONE if it was inserted or
+ *               moved.
+ */
+size_t TreeDiff::GetKeptNode(size_t nNode) const {
+	return arrKept[nNode];
+}
+
+/**
+ * Gets the number of operations of a type.
+ *
+ * @param  nType Type of the operations.
+ * @return       Number of operations.
+ */
+size_t TreeDiff::GetCount(int nType) const {
+	return anCounts[nType];
+}
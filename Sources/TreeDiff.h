@@ -0,0 +1,79 @@
+/**
+ * TreeDiff.h
+ * Compares two versions of a tree and lists the operations needed to turn the
+ * old one into the new one.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _TREE_DIFF_H
+#define _TREE_DIFF_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "TreeModel.h"
+
+using namespace std;
+
+// Types of operations.
+#define TREE_OP_INSERT 0
+#define TREE_OP_DELETE 1
+#define TREE_OP_MOVE   2
+#define TREE_OP_RENAME 3
+#define TREE_OP_TYPES  4
+
+// A single operation to be applied to the old tree.
+typedef struct {
+	int nType;
+	size_t nOldNode;
+	size_t nNode;
+	size_t nParent;
+	size_t nAfter;
+} TreeOperation;
+
+class TreeDiff {
+protected:
+	vector<TreeOperation> arrOperations;
+	vector<size_t> arrKept;
+	size_t anCounts[TREE_OP_TYPES];
+
+	// Comparison.
+	void CompareChildren(const TreeModel &modelOld, const TreeModel &modelNew,
+						 size_t nOldParent, size_t nParent,
+						 vector<TreeOperation> *arrDeletions);
+	void PatchChildren(TreeModel *model, const TreeModel &modelWanted,
+					   size_t nParent, size_t nWantedParent,
+					   vector<TreeOperation> *arrDeletions);
+	void InsertChildren(const TreeModel &modelNew, size_t nParent);
+	void AddOperation(int nType, size_t nOldNode, size_t nNode,
+					  size_t nParent, size_t nAfter,
+					  vector<TreeOperation> *arrTarget);
+	static void MatchChildren(const TreeModel &modelOld,
+							  const vector<size_t> &arrOld,
+							  const TreeModel &modelNew,
+							  const vector<size_t> &arrNew,
+							  vector<size_t> *arrMatches,
+							  vector<bool> *arrUsed, vector<bool> *arrStable);
+	static void FindStable(const vector<size_t> &arrPositions,
+						   vector<bool> *arrStable);
+	static size_t CopyNode(TreeModel *model, size_t nParent,
+						   const TreeModel &modelFrom, size_t nNode);
+	static bool IsChanged(const TreeNode &nodeOld, const TreeNode &nodeNew);
+
+public:
+	// Constructors and destructors.
+	TreeDiff();
+
+	// Comparison.
+	void Compare(const TreeModel &modelOld, const TreeModel &modelNew);
+	void Patch(TreeModel *model, const TreeModel &modelWanted);
+
+	// Results.
+	const vector<TreeOperation>& GetOperations() const;
+	size_t GetKeptNode(size_t nNode) const;
+	size_t GetCount(int nType) const;
+};
+
+#endif  // _TREE_DIFF_H
@@ -0,0 +1,199 @@
+/**
+ * TreeMaterializer.cpp
+ * Decides which nodes of a tree should actually exist in the TreeView.
+ *
+ * A node is materialized once its children have been inserted into the
+ * TreeView. In the eager mode every node is materialized as soon as it's
+ * created. In the lazy mode only the root nodes exist at first and the
+ * children of a folder are only inserted the first time it's expanded, which
+ * keeps huge workspaces from paying for thousands of items nobody looks at.
+ * Folders that are collapsed again can later be reclaimed, dropping their
+ * children until they are expanded once more.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "TreeMaterializer.h"
+
+/**
+ * Initializes an empty eager materializer.
+ */
+TreeMaterializer::TreeMaterializer() {
+	bLazy = false;
+}
+
+/**
+ * Sets the mode of the materializer.
+ * @remark This should only be changed while the tree is empty.
+ *
+ * @param bLazy Should children only be materialized when a folder expands?
+ */
+void TreeMaterializer::SetLazy(bool bLazy) {
+	this->bLazy = bLazy;
+}
+
+/**
+ * Checks if the children are only materialized when a folder expands.
+ *
+ * @return TRUE if we are in the lazy mode.
+ */
+bool TreeMaterializer::IsLazy() const {
+	return bLazy;
+}
+
+/**
+ * Carries the state of the nodes that were kept over to a new version of the
+ * tree. Inserted and moved nodes start out collapsed in the lazy mode.
+ *
+ * @param model New version of the tree.
+ * @param diff  Differences between the old version and the new one.
+ */
+void TreeMaterializer::Update(const TreeModel &model, const TreeDiff &diff) {
+	vector<bool> arrNewMaterialized(model.GetCount(), !bLazy);
+	vector<bool> arrNewExpanded(model.GetCount(), false);
+
+	for (size_t i = 0; i < model.GetCount(); i++) {
+		size_t nOldNode = diff.GetKeptNode(i);
+
+		if (nOldNode != TREE_NODE_NONE) {
+			arrNewMaterialized[i] = arrMaterialized[nOldNode];
+			arrNewExpanded[i] = arrExpanded[nOldNode];
+		} else if (!bLazy) {
+			arrNewExpanded[i] = model.GetNode(i).bExpand;
+		}
+	}
+
+	arrMaterialized.swap(arrNewMaterialized);
+	arrExpanded.swap(arrNewExpanded);
+}
+
+/**
+ * Forgets the state of every node.
+ */
+void TreeMaterializer::Clear() {
+	arrMaterialized.clear();
+	arrExpanded.clear();
+}
+
+/**
+ * Checks if the children of a node exist in the TreeView.
+ *
+ * @param  nNode Node to be checked.
+ * @return       TRUE if the node has been materialized.
+ */
+bool TreeMaterializer::IsMaterialized(size_t nNode) const {
+	return arrMaterialized[nNode];
+}
+
+/**
+ * Checks if a node exists in the TreeView.
+ *
+ * @param  model Tree that the node belongs to.
+ * @param  nNode Node to be checked.
+ * @return       TRUE if the node is at the root or its parent is materialized.
+ */
+bool TreeMaterializer::IsVisible(const TreeModel &model, size_t nNode) const {
+	size_t nParent = model.GetNode(nNode).nParent;
+	return (nParent == TREE_NODE_NONE) || arrMaterialized[nParent];
+}
+
+/**
+ * Records that a node was expanded or collapsed by the user.
+ *
+ * @param nNode     Node that was expanded or collapsed.
+ * @param bExpanded Is the node expanded now?
+ */
+void TreeMaterializer::SetExpanded(size_t nNode, bool bExpanded) {
+	arrExpanded[nNode] = bExpanded;
+}
+
+/**
+ * Materializes a node that is about to be expanded.
+ *
+ * @param  model    Tree that the node belongs to.
+ * @param  nNode    Node that is about to be expanded.
+ * @param  arrNodes Children that have to be inserted, in order.
+ * @return          TRUE if the node wasn't materialized before.
+ */
+bool TreeMaterializer::Materialize(const TreeModel &model, size_t nNode,
+								   vector<size_t> *arrNodes) {
+	if (arrMaterialized[nNode])
+		return false;
+
+	const vector<size_t> &arrChildren = model.GetChildren(nNode);
+	arrNodes->insert(arrNodes->end(), arrChildren.begin(), arrChildren.end());
+	arrMaterialized[nNode] = true;
+
+	return true;
+}
+
+/**
+ * Finds the collapsed folders whose children can be dropped from the TreeView
+ * to save memory. Nothing is reclaimed in the eager mode.
+ *
+ * @param model    Tree to be reclaimed.
+ * @param arrNodes Folders that should have their children removed.
+ */
+void TreeMaterializer::Reclaim(const TreeModel &model,
+							   vector<size_t> *arrNodes) {
+	if (!bLazy)
+		return;
+
+	ReclaimChildren(model, TREE_NODE_NONE, arrNodes);
+}
+
+/**
+ * Accounts for the memory used by the materializer, including the object
+ * itself.
+ *
+ * @param report Report to add the memory to.
+ */
+void TreeMaterializer::AccountMemory(MemoryReport *report) const {
+	report->Add(MEMORY_TREE, sizeof(TreeMaterializer) +
+		((arrMaterialized.capacity() + arrExpanded.capacity()) / 8));
+}
+
+/**
+ * Goes through the children of an expanded node looking for collapsed
+ * folders to be reclaimed.
+ *
+ * @param model    Tree to be reclaimed.
+ * @param nParent  Expanded node or TREE_NODE_NONE for the root of the tree.
+ * @param arrNodes Folders that should have their children removed.
+ */
+void TreeMaterializer::ReclaimChildren(const TreeModel &model, size_t nParent,
+									   vector<size_t> *arrNodes) {
+	const vector<size_t> &arrChildren = model.GetChildren(nParent);
+
+	for (size_t i = 0; i < arrChildren.size(); i++) {
+		size_t nNode = arrChildren[i];
+
+		// Components and folders that were never opened have nothing to drop.
+		if (!arrMaterialized[nNode] || model.GetChildren(nNode).empty())
+			continue;
+
+		if (arrExpanded[nNode]) {
+			ReclaimChildren(model, nNode, arrNodes);
+		} else {
+			arrNodes->push_back(nNode);
+			Forget(model, nNode);
+		}
+	}
+}
+
+/**
+ * Marks a node and everything under it as not materialized.
+ *
+ * @param model Tree that the node belongs to.
+ * @param nNode Node to be forgotten.
+ */
+void TreeMaterializer::Forget(const TreeModel &model, size_t nNode) {
+	const vector<size_t> &arrChildren = model.GetChildren(nNode);
+
+	arrMaterialized[nNode] = false;
+	for (size_t i = 0; i < arrChildren.size(); i++) {
+		arrExpanded[arrChildren[i]] = false;
+		if (arrMaterialized[arrChildren[i]])
+			Forget(model, arrChildren[i]);
+	}
+}
@@ -0,0 +1,54 @@
+/**
+ * TreeMaterializer.h
+ * Decides which nodes of a tree should actually exist in the TreeView.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _TREE_MATERIALIZER_H
+#define _TREE_MATERIALIZER_H
+
+#include <vector>
+#include "TreeModel.h"
+#include "TreeDiff.h"
+#include "MemoryReport.h"
+
+using namespace std;
+
+class TreeMaterializer {
+protected:
+	vector<bool> arrMaterialized;
+	vector<bool> arrExpanded;
+	bool bLazy;
+
+	// Reclaiming.
+	void ReclaimChildren(const TreeModel &model, size_t nParent,
+						 vector<size_t> *arrNodes);
+	void Forget(const TreeModel &model, size_t nNode);
+
+public:
+	// Constructors and destructors.
+	TreeMaterializer();
+
+	// Mode.
+	void SetLazy(bool bLazy);
+	bool IsLazy() const;
+
+	// State.
+	void Update(const TreeModel &model, const TreeDiff &diff);
+	void Clear();
+	bool IsMaterialized(size_t nNode) const;
+	bool IsVisible(const TreeModel &model, size_t nNode) const;
+	void SetExpanded(size_t nNode, bool bExpanded);
+
+	// Materialization.
+	bool Materialize(const TreeModel &model, size_t nNode,
+					 vector<size_t> *arrNodes);
+	void Reclaim(const TreeModel &model, vector<size_t> *arrNodes);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report) const;
+};
+
+#endif  // _TREE_MATERIALIZER_H
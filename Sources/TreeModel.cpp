@@ -0,0 +1,323 @@
+/**
+ * TreeModel.cpp
+ * Describes the contents of a tree so that two versions of it can be compared.
+ *
+ * Nodes are identified by a key that only has to be unique among their
+ * siblings, and are stored in the order they were added, so parents always
+ * come before their children.
+ *
+ * A tree can also be patched in place, so that a small change doesn't cost a
+ * whole new tree. Nodes that are replaced stay where they are, marked as
+ * removed, which keeps the indexes of everything else stable. Nodes can be
+ * found by their values through an index that is only built the first time
+ * it's needed, since trees that are never patched don't need it.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "TreeModel.h"
+
+/**
+ * Initializes an empty tree.
+ */
+TreeModel::TreeModel() {
+	nRemoved = 0;
+	bIndexed = false;
+}
+
+/**
+ * Appends a node to the end of a parent's children.
+ *
+ * @param  nParent Parent node or TREE_NODE_NONE for the root of the tree.
+ * @param  swKey   Key that identifies the node among its siblings.
+ * @param  swLabel Node caption.
+ * @param  lParam  Value associated with the node.
+ * @param  iImage  Index of the node icon.
+ * @param  bExpand Should the node be expanded when it's created?
+ * @return         Index of the new node.
+ */
+size_t TreeModel::AddNode(size_t nParent, const wstring &swKey,
+						  const wstring &swLabel, long lParam, int iImage,
+						  bool bExpand) {
+	size_t nNode = CreateNode(nParent, swKey, swLabel, lParam, iImage,
+		bExpand);
+
+	if (nParent == TREE_NODE_NONE) {
+		arrRoots.push_back(nNode);
+	} else {
+		arrNodes[nParent].arrChildren.push_back(nNode);
+	}
+
+	return nNode;
+}
+
+/**
+ * Reserves space for a number of nodes to avoid reallocations.
+ *
+ * @param nCount Expected number of nodes.
+ */
+void TreeModel::Reserve(size_t nCount) {
+	arrNodes.reserve(nCount);
+}
+
+/**
+ * Removes every node from the tree.
+ */
+void TreeModel::Clear() {
+	arrNodes.clear();
+	arrRoots.clear();
+	mapParams.clear();
+	nRemoved = 0;
+	bIndexed = false;
+}
+
+/**
+ * Exchanges the contents of this tree with another one without copying them.
+ *
+ * @param model Tree to exchange contents with.
+ */
+void TreeModel::Swap(TreeModel &model) {
+	size_t nRemoved = this->nRemoved;
+	bool bIndexed = this->bIndexed;
+
+	arrNodes.swap(model.arrNodes);
+	arrRoots.swap(model.arrRoots);
+	mapParams.swap(model.mapParams);
+	this->nRemoved = model.nRemoved;
+	this->bIndexed = model.bIndexed;
+	model.nRemoved = nRemoved;
+	model.bIndexed = bIndexed;
+}
+
+/**
+ * Creates a node without adding it to the children of its parent, so that it
+ * can be put in place later with ReplaceChildren.
+ *
+ * @param  nParent Parent node or TREE_NODE_NONE for the root of the tree.
+ * @param  swKey   Key that identifies the node among its siblings.
+ * @param  swLabel Node caption.
+ * @param  lParam  Value associated with the node.
+ * @param  iImage  Index of the node icon.
+ * @param  bExpand Should the node be expanded when it's created?
+ * @return         Index of the new node.
+ */
+size_t TreeModel::CreateNode(size_t nParent, const wstring &swKey,
+							 const wstring &swLabel, long lParam, int iImage,
+							 bool bExpand) {
+	TreeNode node;
+	size_t nNode = arrNodes.size();
+
+	node.swKey = swKey;
+	node.swLabel = swLabel;
+	node.lParam = lParam;
+	node.iImage = iImage;
+	node.bExpand = bExpand;
+	node.bRemoved = false;
+	node.nParent = nParent;
+	arrNodes.push_back(node);
+	Index(nNode);
+
+	return nNode;
+}
+
+/**
+ * Replaces the children of a node. Previous children that aren't part of the
+ * new list are marked as removed along with everything under them.
+ *
+ * @param nParent     Parent node or TREE_NODE_NONE for the root of the tree.
+ * @param arrChildren New children in order. New nodes must have been created
+ *                    with this node as their parent.
+ */
+void TreeModel::ReplaceChildren(size_t nParent,
+								const vector<size_t> &arrChildren) {
+	vector<size_t> &arrOld = (nParent == TREE_NODE_NONE) ? arrRoots :
+		arrNodes[nParent].arrChildren;
+	size_t i;
+
+	// Mark the ones that are kept so we know which ones are gone.
+	for (i = 0; i < arrChildren.size(); i++)
+		arrNodes[arrChildren[i]].bRemoved = true;
+	for (i = 0; i < arrOld.size(); i++) {
+		if (!arrNodes[arrOld[i]].bRemoved)
+			MarkRemoved(arrOld[i]);
+	}
+	for (i = 0; i < arrChildren.size(); i++)
+		arrNodes[arrChildren[i]].bRemoved = false;
+
+	arrOld = arrChildren;
+}
+
+/**
+ * Changes what a node shows without changing its place in the tree.
+ *
+ * @param nNode   Node to be changed.
+ * @param swLabel Node caption.
+ * @param lParam  Value associated with the node.
+ * @param iImage  Index of the node icon.
+ */
+void TreeModel::SetContents(size_t nNode, const wstring &swLabel, long lParam,
+							int iImage) {
+	Unindex(nNode);
+	arrNodes[nNode].swLabel = swLabel;
+	arrNodes[nNode].lParam = lParam;
+	arrNodes[nNode].iImage = iImage;
+	Index(nNode);
+}
+
+/**
+ * Gets the number of nodes in the tree.
+ *
+ * @return Number of nodes.
+ */
+size_t TreeModel::GetCount() const {
+	return arrNodes.size();
+}
+
+/**
+ * Gets the number of nodes that were removed by patches but still take up
+ * their place.
+ *
+ * @return Number of removed nodes.
+ */
+size_t TreeModel::GetRemovedCount() const {
+	return nRemoved;
+}
+
+/**
+ * Gets a node of the tree.
+ *
+ * @param  nNode Index of the node.
+ * @return       Tree node.
+ */
+const TreeNode& TreeModel::GetNode(size_t nNode) const {
+	return arrNodes[nNode];
+}
+
+/**
+ * Gets the children of a node.
+ *
+ * @param  nParent Parent node or TREE_NODE_NONE for the root of the tree.
+ * @return         Indexes of the children in order.
+ */
+const vector<size_t>& TreeModel::GetChildren(size_t nParent) const {
+	if (nParent == TREE_NODE_NONE)
+		return arrRoots;
+
+	return arrNodes[nParent].arrChildren;
+}
+
+/**
+ * Finds a child of a node by its key.
+ *
+ * @param  nParent Parent node or TREE_NODE_NONE for the root of the tree.
+ * @param  swKey   Key of the child.
+ * @return         Child node or TREE_NODE_NONE if there isn't one.
+ */
+size_t TreeModel::FindChild(size_t nParent, const wstring &swKey) const {
+	const vector<size_t> &arrChildren = GetChildren(nParent);
+
+	for (size_t i = 0; i < arrChildren.size(); i++) {
+		if (arrNodes[arrChildren[i]].swKey == swKey)
+			return arrChildren[i];
+	}
+
+	return TREE_NODE_NONE;
+}
+
+/**
+ * Finds the node at the root of the tree that a node is under.
+ *
+ * @param  nNode Node to start from.
+ * @return       Root node, which may be the node itself.
+ */
+size_t TreeModel::FindRoot(size_t nNode) const {
+	while (arrNodes[nNode].nParent != TREE_NODE_NONE)
+		nNode = arrNodes[nNode].nParent;
+
+	return nNode;
+}
+
+/**
+ * Finds every node that holds a value and wasn't removed.
+ *
+ * @param lParam   Value associated with the nodes.
+ * @param arrFound Where to put the nodes that were found.
+ */
+void TreeModel::FindNodes(long lParam, vector<size_t> *arrFound) {
+	multimap<long, size_t>::iterator it;
+
+	// Build the index the first time we need it.
+	if (!bIndexed) {
+		bIndexed = true;
+		for (size_t i = 0; i < arrNodes.size(); i++)
+			Index(i);
+	}
+
+	for (it = mapParams.lower_bound(lParam);
+			(it != mapParams.end()) && (it->first == lParam); it++) {
+		arrFound->push_back(it->second);
+	}
+}
+
+/**
+ * Accounts for the memory used by the tree, including the object itself.
+ *
+ * @param report Report to add the memory to.
+ */
+void TreeModel::AccountMemory(MemoryReport *report) const {
+	report->Add(MEMORY_TREE, sizeof(TreeModel) +
+		(arrNodes.capacity() * sizeof(TreeNode)) +
+		(arrRoots.capacity() * sizeof(size_t)));
+
+	for (size_t i = 0; i < arrNodes.size(); i++) {
+		report->AddString(MEMORY_TREE, arrNodes[i].swKey);
+		report->AddString(MEMORY_TREE, arrNodes[i].swLabel);
+		report->Add(MEMORY_TREE, arrNodes[i].arrChildren.capacity() *
+			sizeof(size_t));
+	}
+	report->AddMapNodes(MEMORY_TREE, mapParams.size(),
+		sizeof(long) + sizeof(size_t));
+}
+
+/**
+ * Adds a node to the index of values if it's being kept.
+ *
+ * @param nNode Node to be indexed.
+ */
+void TreeModel::Index(size_t nNode) {
+	if (bIndexed && !arrNodes[nNode].bRemoved)
+		mapParams.insert(make_pair(arrNodes[nNode].lParam, nNode));
+}
+
+/**
+ * Removes a node from the index of values.
+ *
+ * @param nNode Node to be removed from the index.
+ */
+void TreeModel::Unindex(size_t nNode) {
+	multimap<long, size_t>::iterator it;
+	long lParam = arrNodes[nNode].lParam;
+
+	for (it = mapParams.lower_bound(lParam);
+			(it != mapParams.end()) && (it->first == lParam); it++) {
+		if (it->second == nNode) {
+			mapParams.erase(it);
+			return;
+		}
+	}
+}
+
+/**
+ * Marks a node and everything under it as removed.
+ *
+ * @param nNode Node that is no longer part of the tree.
+ */
+void TreeModel::MarkRemoved(size_t nNode) {
+	const vector<size_t> &arrChildren = arrNodes[nNode].arrChildren;
+
+	Unindex(nNode);
+	arrNodes[nNode].bRemoved = true;
+	nRemoved++;
+	for (size_t i = 0; i < arrChildren.size(); i++)
+		MarkRemoved(arrChildren[i]);
+}
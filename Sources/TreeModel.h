@@ -0,0 +1,80 @@
+/**
+ * TreeModel.h
+ * Describes the contents of a tree so that two versions of it can be compared.
+ * @remark This class doesn't depend on any platform specific API.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _TREE_MODEL_H
+#define _TREE_MODEL_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "MemoryReport.h"
+
+using namespace std;
+
+// Index used for the root of the tree and for nodes that don't exist.
+#define TREE_NODE_NONE ((size_t)-1)
+
+// A single node of the tree.
+typedef struct {
+	wstring swKey;
+	wstring swLabel;
+	long lParam;
+	int iImage;
+	bool bExpand;
+	bool bRemoved;
+	size_t nParent;
+	vector<size_t> arrChildren;
+} TreeNode;
+
+class TreeModel {
+protected:
+	vector<TreeNode> arrNodes;
+	vector<size_t> arrRoots;
+	multimap<long, size_t> mapParams;
+	size_t nRemoved;
+	bool bIndexed;
+
+	// Helpers.
+	void Index(size_t nNode);
+	void Unindex(size_t nNode);
+	void MarkRemoved(size_t nNode);
+
+public:
+	// Constructors and destructors.
+	TreeModel();
+
+	// Building.
+	size_t AddNode(size_t nParent, const wstring &swKey,
+				   const wstring &swLabel, long lParam, int iImage,
+				   bool bExpand);
+	void Reserve(size_t nCount);
+	void Clear();
+	void Swap(TreeModel &model);
+
+	// Patching.
+	size_t CreateNode(size_t nParent, const wstring &swKey,
+					  const wstring &swLabel, long lParam, int iImage,
+					  bool bExpand);
+	void ReplaceChildren(size_t nParent, const vector<size_t> &arrChildren);
+	void SetContents(size_t nNode, const wstring &swLabel, long lParam,
+					 int iImage);
+
+	// Getters.
+	size_t GetCount() const;
+	size_t GetRemovedCount() const;
+	const TreeNode& GetNode(size_t nNode) const;
+	const vector<size_t>& GetChildren(size_t nParent) const;
+	size_t FindChild(size_t nParent, const wstring &swKey) const;
+	size_t FindRoot(size_t nNode) const;
+	void FindNodes(long lParam, vector<size_t> *arrFound);
+
+	// Memory.
+	void AccountMemory(MemoryReport *report) const;
+};
+
+#endif  // _TREE_MODEL_H
@@ -86,6 +86,71 @@ BOOL TreeView::GetItem(TVITEM *tvItem) {
 	return TreeView_GetItem(hWnd, tvItem);
 }
 
+/**
+ * Sets the attributes of a TreeView item.
+ *
+ * @param  tvItem TVITEM structure with the information to set.
+ * @return        TRUE if the operation was successful.
+ */
+BOOL TreeView::SetItem(TVITEM *tvItem) {
+	return TreeView_SetItem(hWnd, tvItem);
+}
+
+/**
+ * Changes the caption of a TreeView item.
+ *
+ * @param  hItem  Item to be changed.
+ * @param  szText New item caption.
+ * @return        TRUE if the operation was successful.
+ */
+BOOL TreeView::SetItemText(HTREEITEM hItem, LPCTSTR szText) {
+	TVITEM tvItem;
+
+	tvItem.hItem = hItem;
+	tvItem.mask = TVIF_TEXT;
+	tvItem.pszText = (LPTSTR)szText;
+	tvItem.cchTextMax = wcslen(szText);
+
+	return TreeView_SetItem(hWnd, &tvItem);
+}
+
+/**
+ * Gets the first child of an item.
+ *
+ * @param  hItem Parent item or NULL to get the first root item.
+ * @return       First child item or NULL if there isn't one.
+ */
+HTREEITEM TreeView::GetChild(HTREEITEM hItem) {
+	if (hItem == NULL)
+		return TreeView_GetRoot(hWnd);
+
+	return TreeView_GetChild(hWnd, hItem);
+}
+
+/**
+ * Gets the item right before or after another one under the same parent.
+ *
+ * @param  hItem Item to get the sibling of.
+ * @param  bNext Get the next item instead of the previous one?
+ * @return       Sibling item or NULL if there isn't one.
+ */
+HTREEITEM TreeView::GetSibling(HTREEITEM hItem, bool bNext) {
+	if (bNext)
+		return TreeView_GetNextSibling(hWnd, hItem);
+
+	return TreeView_GetPrevSibling(hWnd, hItem);
+}
+
+/**
+ * Selects an item in the TreeView.
+ *
+ * @param  hItem Item to be selected or NULL to remove the selection.
+ * @return       TRUE if the operation was successful.
+ */
+BOOL TreeView::SelectItem(HTREEITEM hItem) {
+	return TreeView_SelectItem(hWnd, hItem);
+}
+
 /**
  * Expands a node in the TreeView.
  *
@@ -96,6 +161,28 @@ BOOL TreeView::ExpandNode(HTREEITEM hNode) {
 	return TreeView_Expand(hWnd, hNode, TVE_EXPAND);
 }
 
+/**
+ * Deletes an item and all of its children from the TreeView.
+ *
+ * @param  hItem Item to be deleted.
+ * @return       TRUE if the operation was successful.
+ */
+BOOL TreeView::DeleteItem(HTREEITEM hItem) {
+	return TreeView_DeleteItem(hWnd, hItem);
+}
+
+/**
+ * Removes every child of an item, leaving the item itself alone.
+ *
+ * @param hItem Item to have its children removed.
+ */
+void TreeView::DeleteChildren(HTREEITEM hItem) {
+	HTREEITEM hChild;
+
+	while ((hChild = TreeView_GetChild(hWnd, hItem)) != NULL)
+		TreeView_DeleteItem(hWnd, hChild);
+}
+
 /**
  * Clears the entire TreeView contents.
  *
@@ -105,6 +192,141 @@ BOOL TreeView::Clear() {
 	return TreeView_DeleteAllItems(hWnd);
 }
 
+/**
+ * Applies the operations of a tree comparison to the control. Redrawing is
+ * disabled while the changes are made to avoid flickering. Nodes whose parent
+ * hasn't been materialized are left out.
+ *
+ * @param model        New version of the tree.
+ * @param diff         Comparison between the current and the new tree.
+ * @param materializer Materialization state of the new tree.
+ * @param arrItems     Items of the nodes of the current tree. Replaced by the
+ *                     items of the nodes of the new one, NULL for the ones
+ *                     that aren't in the control.
+ */
+void TreeView::Apply(const TreeModel &model, const TreeDiff &diff,
+					 const TreeMaterializer &materializer,
+					 vector<HTREEITEM> *arrItems) {
+	const vector<TreeOperation> &arrOps = diff.GetOperations();
+	vector<HTREEITEM> arrNewItems(model.GetCount(), (HTREEITEM)NULL);
+	TVITEM tvItem;
+	size_t i;
+
+	if (!arrOps.empty())
+		SendMessage(hWnd, WM_SETREDRAW, FALSE, 0);
+
+	// Get rid of the old items first.
+	for (i = 0; i < arrOps.size(); i++) {
+		if (((arrOps[i].nType == TREE_OP_DELETE) ||
+				(arrOps[i].nType == TREE_OP_MOVE)) &&
+				((*arrItems)[arrOps[i].nOldNode] != NULL))
+			TreeView_DeleteItem(hWnd, (*arrItems)[arrOps[i].nOldNode]);
+	}
+
+	// Carry over the items that are kept.
+	for (i = 0; i < model.GetCount(); i++) {
+		size_t nOldNode = diff.GetKeptNode(i);
+		if (nOldNode != TREE_NODE_NONE)
+			arrNewItems[i] = (*arrItems)[nOldNode];
+	}
+
+	// Insert and update everything else in order.
+	for (i = 0; i < arrOps.size(); i++) {
+		const TreeOperation &op = arrOps[i];
+		if (op.nType == TREE_OP_DELETE)
+			continue;
+		const TreeNode &node = model.GetNode(op.nNode);
+
+		if (op.nType == TREE_OP_RENAME) {
+			if (arrNewItems[op.nNode] == NULL)
+				continue;
+
+			tvItem.hItem = arrNewItems[op.nNode];
+			tvItem.mask = TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE |
+				TVIF_PARAM | TVIF_CHILDREN;
+			tvItem.pszText = (LPTSTR)node.swLabel.c_str();
+			tvItem.cchTextMax = node.swLabel.length();
+			tvItem.iImage = node.iImage;
+			tvItem.iSelectedImage = node.iImage;
+			tvItem.lParam = node.lParam;
+			tvItem.cChildren = node.arrChildren.empty() ? 0 : 1;
+			TreeView_SetItem(hWnd, &tvItem);
+		} else if (materializer.IsVisible(model, op.nNode)) {
+			HTREEITEM hParent = NULL;
+			HTREEITEM hAfter = TVI_FIRST;
+
+			if (op.nParent != TREE_NODE_NONE)
+				hParent = arrNewItems[op.nParent];
+			if (op.nAfter != TREE_NODE_NONE)
+				hAfter = arrNewItems[op.nAfter];
+
+			arrNewItems[op.nNode] = InsertNode(node, hParent, hAfter);
+		}
+	}
+
+	// Expand the new nodes now that they have children.
+	for (i = 0; i < arrOps.size(); i++) {
+		if (((arrOps[i].nType == TREE_OP_INSERT) ||
+				(arrOps[i].nType == TREE_OP_MOVE)) &&
+				model.GetNode(arrOps[i].nNode).bExpand &&
+				materializer.IsMaterialized(arrOps[i].nNode) &&
+				(arrNewItems[arrOps[i].nNode] != NULL))
+			ExpandNode(arrNewItems[arrOps[i].nNode]);
+	}
+
+	if (!arrOps.empty()) {
+		SendMessage(hWnd, WM_SETREDRAW, TRUE, 0);
+		InvalidateRect(hWnd, NULL, TRUE);
+	}
+	arrItems->swap(arrNewItems);
+}
+
+/**
+ * Inserts the children of a folder that was just materialized.
+ *
+ * @param model    Tree that the nodes belong to.
+ * @param arrNodes Nodes to be inserted, in order.
+ * @param arrItems Items of the nodes of the tree.
+ */
+void TreeView::Materialize(const TreeModel &model,
+						   const vector<size_t> &arrNodes,
+						   vector<HTREEITEM> *arrItems) {
+	for (size_t i = 0; i < arrNodes.size(); i++) {
+		const TreeNode &node = model.GetNode(arrNodes[i]);
+
+		(*arrItems)[arrNodes[i]] = InsertNode(node,
+			(*arrItems)[node.nParent], TVI_LAST);
+	}
+}
+
+/**
+ * Inserts an item for a tree node. The expand button is shown whenever the
+ * node has children, even if they haven't been inserted yet.
+ *
+ * @param  node    Node to be inserted.
+ * @param  hParent Parent item or NULL for the root of the tree.
+ * @param  hAfter  Insert after this item.
+ * @return         Inserted item.
+ */
+HTREEITEM TreeView::InsertNode(const TreeNode &node, HTREEITEM hParent,
+							   HTREEITEM hAfter) {
+	TV_INSERTSTRUCT tvInsert;
+
+	tvInsert.item.mask = TVIF_TEXT | TVIF_IMAGE | TVIF_SELECTEDIMAGE |
+		TVIF_PARAM | TVIF_CHILDREN;
+	tvInsert.item.pszText = (LPTSTR)node.swLabel.c_str();
+	tvInsert.item.cchTextMax = node.swLabel.length();
+	tvInsert.item.iImage = node.iImage;
+	tvInsert.item.iSelectedImage = node.iImage;
+	tvInsert.item.lParam = node.lParam;
+	tvInsert.item.cChildren = node.arrChildren.empty() ? 0 : 1;
+	tvInsert.hInsertAfter = hAfter;
+	tvInsert.hParent = hParent;
+
+	return (HTREEITEM)SendMessage(hWnd, TVM_INSERTITEM, 0,
+		(LPARAM)(LPTV_INSERTSTRUCT)&tvInsert);
+}
+
 /**
  * Associates an ImageList with the control.
  *
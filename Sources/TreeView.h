@@ -10,12 +10,22 @@
 
 #include <windows.h>
 #include <commctrl.h>
+#include <vector>
 #include "StdAfx.h"
+#include "TreeModel.h"
+#include "TreeDiff.h"
+#include "TreeMaterializer.h"
+
+using namespace std;
 
 class TreeView {
 private:
 	HWND hWnd;
 
+	// Tree nodes.
+	HTREEITEM InsertNode(const TreeNode &node, HTREEITEM hParent,
+						 HTREEITEM hAfter);
+
 public:
 	// Contructors and destructor.
 	TreeView();
@@ -27,8 +37,20 @@ public:
 					  HTREEITEM hInsAfter, int iImage,
 					  LPARAM lParam);
 	BOOL GetItem(TVITEM *tvItem);
+	BOOL SetItem(TVITEM *tvItem);
+	BOOL SetItemText(HTREEITEM hItem, LPCTSTR szText);
+	HTREEITEM GetChild(HTREEITEM hItem);
+	HTREEITEM GetSibling(HTREEITEM hItem, bool bNext);
+	BOOL SelectItem(HTREEITEM hItem);
 	BOOL ExpandNode(HTREEITEM hNode);
+	BOOL DeleteItem(HTREEITEM hItem);
+	void DeleteChildren(HTREEITEM hItem);
 	BOOL Clear();
+	void Apply(const TreeModel &model, const TreeDiff &diff,
+			   const TreeMaterializer &materializer,
+			   vector<HTREEITEM> *arrItems);
+	void Materialize(const TreeModel &model, const vector<size_t> &arrNodes,
+					 vector<HTREEITEM> *arrItems);
 
 	// Misc.
 	void SetImageList(HIMAGELIST hIml);
@@ -8,19 +8,70 @@
 
 #include <algorithm>
 #include "UIManager.h"
-#include "Category.h"
 #include "ImageUtils.h"
 #include "PropertyEditor.h"
 #include "CreationDialog.h"
+#include "DuplicateFinder.h"
+#include "BomImporter.h"
+#include "Benchmark.h"
+#include "Tracer.h"
+#include "IoAccounting.h"
+#include "AllocProfiler.h"
 #include "resource.h"
 #include "commdlg.h"
 
+// Size of the component image in the detail view.
+#ifdef SHELL_AYGSHELL
+	#define COMPONENT_IMAGE_WIDTH  82
+	#define COMPONENT_IMAGE_HEIGHT 85
+#else
+	#define COMPONENT_IMAGE_WIDTH  86
+	#define COMPONENT_IMAGE_HEIGHT 83
+#endif
+
+// Number of components on each side of the selection to prefetch images for.
+#define PREFETCH_NEIGHBOURS 2
+
+// Number of components shown in the reorder queue folder.
+#define REORDER_QUEUE_LENGTH 50
+
+// Minimum similarity for components to be reported as possible duplicates.
+#define DUPLICATE_SIMILARITY 0.8
+
+// Period (in seconds) and number of components shown as the top consumers.
+#define TOP_CONSUMERS_PERIOD (90 * 24 * 60 * 60)
+#define TOP_CONSUMERS_COUNT  10
+
+// Number of components from which folders are only populated when expanded.
+#define LAZY_TREE_THRESHOLD 1000
+
+// Where the benchmark workspace and its results are written to.
+#define BENCHMARK_WORKSPACE L"\\Temp\\PartCat Benchmark"
+#define BENCHMARK_RESULTS   L"\\Temp\\PartCat Benchmark.json"
+
+// Parts in the in-memory workspaces that the indexes are timed against. Bigger
+// ones don't fit in the memory of a handheld.
+#define BENCHMARK_INDEX_PARTS 5000
+
+// Where the traces are saved to.
+#define TRACE_FILE L"\\Temp\\PartCat Trace.json"
+
+// Text shown while the detail view is being loaded.
+#define DETAIL_PLACEHOLDER L"Loading..."
+
 /**
  * Initializes an empty component manager.
  */
 UIManager::UIManager() {
 	SetDirty(false);
-	iSelComponent = -1;
+	hSelComponent = COMPONENT_HANDLE_NONE;
+	hbmpComponent = NULL;
+	imageLoader = NULL;
+	detailLoader = NULL;
+	hSelItem = NULL;
+	bUpdatingTree = false;
+	bNotesLoaded = true;
+	bPropertiesLoaded = true;
 }
 
 /**
@@ -34,10 +85,13 @@ UIManager::UIManager() {
  * @param hIml         ImageList handle.
  * @param hwndDetail   Detail dialog view handle.
  * @param lpDetailProc Detail view dialog procedure.
+ * @param imageLoader  Background loader of the component images.
+ * @param detailLoader Background loader of the detail view contents.
  */
 UIManager::UIManager(HINSTANCE *hInst, HWND *hwndMain, Settings *settings,
 					 Workspace *workspace, TreeView *treeView, HIMAGELIST *hIml,
-					 HWND *hwndDetail, DLGPROC lpDetailProc) {
+					 HWND *hwndDetail, DLGPROC lpDetailProc,
+					 ImageLoader *imageLoader, DetailLoader *detailLoader) {
 	this->settings = settings;
 	this->workspace = workspace;
 	this->treeView = treeView;
@@ -46,6 +100,13 @@ UIManager::UIManager(HINSTANCE *hInst, HWND *hwndMain, Settings *settings,
 	this->hwndMain = hwndMain;
 	this->hwndDetail = hwndDetail;
 	this->lpDetailProc = lpDetailProc;
+	this->imageLoader = imageLoader;
+	this->detailLoader = detailLoader;
+	this->hbmpComponent = NULL;
+	this->hSelItem = NULL;
+	this->bUpdatingTree = false;
+	this->bNotesLoaded = true;
+	this->bPropertiesLoaded = true;
 
 	ClearDetailView(true);
 }
@@ -92,12 +153,23 @@ LRESULT UIManager::CreateComponent() {
 
 	CreationDialog dialog(*hInst, hwndMain, L"Component");
 	if (dialog.Created()) {
+		ComponentHandle hComponent;
+
 		if (!Component::Create(workspace->GetDirectory(), dialog.GetName())) {
 			MessageBox(*hwndMain, L"An error occured while creating the component.",
 				L"Component Creation Error", MB_OK | MB_ICONERROR);
+			return 1;
 		}
 
-		RefreshWorkspace();
+		// Load just the new component and add it to the tree.
+		Directory dirComponent(workspace->GetDirectory().Concatenate(
+			COMPONENTS_ROOT).Concatenate(dialog.GetName()));
+		if (!workspace->AddComponent(dirComponent, &hComponent)) {
+			MessageBox(*hwndMain, L"An error occured while loading the new component.",
+				L"Component Creation Error", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+		UpdateTreeView(vector<ComponentHandle>(1, hComponent));
 	}
 
 	return 0;
@@ -132,6 +204,37 @@ LRESULT UIManager::CreateWorkspace() {
 	return 0;
 }
 
+/**
+ * Creates a smart folder for the user.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::CreateSmartFolder() {
+	CreationDialog dlgName(*hInst, hwndMain, L"Smart Folder Name");
+	if (!dlgName.Created())
+		return 1;
+
+	// Folders are identified by their names.
+	if (workspace->GetSmartFolders()->HasFolder(dlgName.GetName())) {
+		MessageBox(*hwndMain, L"A smart folder with this name already exists.",
+			L"Smart Folder Creation Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	CreationDialog dlgQuery(*hInst, hwndMain, L"Query (e.g. Quantity < 10)");
+	if (!dlgQuery.Created())
+		return 1;
+
+	if (!workspace->AddSmartFolder(dlgName.GetName(), dlgQuery.GetName())) {
+		MessageBox(*hwndMain, L"The query isn't valid or the workspace couldn't "
+			L"be saved.", L"Smart Folder Creation Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+	UpdateTreeView();
+
+	return 0;
+}
+
 /**
  * Opens a workspace for the user.
  *
@@ -139,6 +242,7 @@ LRESULT UIManager::CreateWorkspace() {
  * @return          0 if the operation was successful.
  */
 LRESULT UIManager::OpenWorkspace(bool bRefresh) {
+	IoScope scope(bRefresh ? IO_OP_REFRESH : IO_OP_OPEN);
 	OPENFILENAME ofn = {0};
     WCHAR szPath[MAX_PATH] = L"";
 
@@ -147,11 +251,11 @@ LRESULT UIManager::OpenWorkspace(bool bRefresh) {
 
 	// Clear the screen.
 	ClearDetailView(true);
-	treeView->Clear();
 
 	// Check if we are not refreshing.
 	if (!bRefresh) {
 		// Close the workspace first.
+		ClearTreeView();
 		workspace->Close();
 
 		// Populate the structure.
@@ -196,11 +300,12 @@ LRESULT UIManager::OpenWorkspace(bool bRefresh) {
  * @return 0 if the operation was successful.
  */
 LRESULT UIManager::RefreshWorkspace() {
+	IoScope scope(IO_OP_REFRESH);
+
 	if (CheckForUnsavedChanges())
 		return 1;
 
 	ClearDetailView(true);
-	treeView->Clear();
 	if (!workspace->Refresh()) {
 		MessageBox(*hwndMain, L"An error occured while refreshing the workspace.",
 			L"Workspace Refresh Error", MB_OK | MB_ICONERROR);
@@ -222,23 +327,320 @@ LRESULT UIManager::CloseWorkspace() {
 
 	// Clear the UI.
 	ClearDetailView(true);
-	treeView->Clear();
+	ClearTreeView();
 	SetApplicationSubTitle(NULL);
 
 	// Close the workspace and clear the last workspace settings.
+	imageLoader->Cancel();
 	workspace->Close();
 	settings->SetLastOpenedWorkspace(L"");
 
 	return 0;
 }
 
+/**
+ * Exports the list of components that are below their reorder level.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ExportReorderList() {
+	OPENFILENAME ofn = {0};
+	WCHAR szPath[MAX_PATH] = L"";
+
+	// Populate the structure.
+	ofn.lStructSize = sizeof(ofn);
+	ofn.lpstrTitle = L"Export Reorder List";
+	ofn.hwndOwner = *hwndMain;
+	ofn.lpstrFilter = L"CSV Files (*.csv)\0*.csv\0All Files (*.*)\0*.*\0";
+	ofn.lpstrFile = szPath;
+	ofn.nMaxFile = MAX_PATH;
+	ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT;
+	ofn.lpstrDefExt = L"csv";
+
+	// Open the save file dialog.
+	if (!GetSaveFileName(&ofn))
+		return 1;
+
+	// Export the list.
+	ReorderQueue *reorderQueue = workspace->GetReorderQueue();
+	if (!ReorderQueue::Export(szPath, reorderQueue->GetBelowReorderLevel())) {
+		MessageBox(*hwndMain, L"An error occured while exporting the reorder list.",
+			L"Export Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Looks for duplicate components and lists them in the TreeView, replacing
+ * the ones that were found before.
+ * @remark Nothing in the workspace is changed by this operation.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::FindDuplicates() {
+	WCHAR szMessage[MAX_PATH];
+	WCHAR szNumber[33];
+	size_t nExact = 0;
+	size_t nSimilar = 0;
+
+	// Look for the duplicates.
+	ShowLoading();
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	DuplicateFinder finder(arrComponents, DUPLICATE_SIMILARITY);
+	vector<DuplicateGroup> arrGroups = finder.Find();
+	HideLoading();
+
+	// Replace whatever duplicates were being shown before.
+	arrDuplicates.clear();
+	for (size_t i = 0; i < arrGroups.size(); i++) {
+		DuplicateFolder folder;
+
+		folder.bExact = arrGroups[i].bExact;
+		for (size_t j = 0; j < arrGroups[i].arrIndexes.size(); j++) {
+			folder.arrHandles.push_back(workspace->GetComponentHandle(
+				arrGroups[i].arrIndexes[j]));
+		}
+
+		if (folder.bExact) {
+			nExact++;
+		} else {
+			nSimilar++;
+		}
+		arrDuplicates.push_back(folder);
+	}
+	UpdateTreeView();
+
+	// Report that we didn't find anything.
+	if (arrGroups.size() == 0) {
+		MessageBox(*hwndMain, L"No duplicate components were found.",
+			L"Find Duplicates", MB_OK);
+		return 0;
+	}
+
+	// Show a summary.
+	wcscpy(szMessage, L"Exact duplicate groups: ");
+	_ltow(nExact, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	wcscat(szMessage, L"\r\nSimilar component groups: ");
+	_ltow(nSimilar, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	MessageBox(*hwndMain, szMessage, L"Find Duplicates", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Imports a BOM CSV file, matches its lines against the workspace components
+ * and writes a report next to it. If there's enough stock for the whole BOM
+ * the user can take the parts out of stock in a single batch.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ImportBom() {
+	OPENFILENAME ofn = {0};
+	WCHAR szPath[MAX_PATH] = L"";
+	WCHAR szMessage[MAX_PATH];
+	WCHAR szNumber[33];
+
+	// Populate the structure.
+	ofn.lStructSize = sizeof(ofn);
+	ofn.lpstrTitle = L"Import BOM";
+	ofn.hwndOwner = *hwndMain;
+	ofn.lpstrFilter = L"CSV Files (*.csv)\0*.csv\0All Files (*.*)\0*.*\0";
+	ofn.lpstrFile = szPath;
+	ofn.nMaxFile = MAX_PATH;
+	ofn.Flags = OFN_EXPLORER | OFN_FILEMUSTEXIST;
+
+	// Open the file dialog.
+	if (!GetOpenFileName(&ofn))
+		return 1;
+
+	// Import the BOM.
+	wstring swReportPath = szPath;
+	swReportPath += L".report.csv";
+	ShowLoading();
+	BomImporter importer(workspace->GetEditableComponents());
+	bool bSuccess = importer.Import(szPath, swReportPath.c_str());
+	HideLoading();
+
+	if (!bSuccess) {
+		MessageBox(*hwndMain, L"An error occured while importing the BOM.",
+			L"Import Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	// Show a summary.
+	BomSummary summary = importer.GetSummary();
+	wcscpy(szMessage, L"Lines: ");
+	_ltow(summary.nLines, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	wcscat(szMessage, L"\r\nMatched: ");
+	_ltow(summary.nMatched, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	wcscat(szMessage, L"\r\nUnmatched: ");
+	_ltow(summary.nUnmatched, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	wcscat(szMessage, L"\r\nNot enough stock: ");
+	_ltow(summary.nInsufficient, szNumber, 10);
+	wcscat(szMessage, szNumber);
+
+	// Just show the summary if the BOM can't be built from stock.
+	if ((summary.nMatched == 0) || (summary.nInsufficient > 0)) {
+		MessageBox(*hwndMain, szMessage, L"Import BOM", MB_OK);
+		return 0;
+	}
+
+	// Check if the user wants to take the parts out of stock.
+	wcscat(szMessage, L"\r\n\r\nTake the parts out of stock?");
+	if (MessageBox(*hwndMain, szMessage, L"Import BOM",
+			MB_YESNO | MB_ICONQUESTION) != IDYES)
+		return 0;
+	if (CheckForUnsavedChanges())
+		return 1;
+
+	// Consume everything as a single batch.
+	vector<QuantityDelta> arrDeltas;
+	map<size_t, size_t> mapRequired = importer.GetRequired();
+	for (map<size_t, size_t>::iterator it = mapRequired.begin();
+			it != mapRequired.end(); it++) {
+		QuantityDelta delta;
+
+		delta.hComponent = workspace->GetComponentHandle(it->first);
+		delta.lDelta = -(long)it->second;
+		arrDeltas.push_back(delta);
+	}
+	bSuccess = workspace->ApplyQuantityDeltas(arrDeltas);
+
+	// Show the new quantities.
+	vector<ComponentHandle> arrChanged;
+	for (size_t i = 0; i < arrDeltas.size(); i++)
+		arrChanged.push_back(arrDeltas[i].hComponent);
+	UpdateTreeView(arrChanged);
+	if (IsComponentOpened())
+		PopulateDetailView(hSelComponent);
+
+	if (!bSuccess) {
+		MessageBox(*hwndMain, L"An error occured while taking the parts out of "
+			L"stock.", L"Import Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Shows the components that were consumed the most recently.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ShowTopConsumers() {
+	WCHAR szNumber[33];
+	wstring swMessage;
+
+	// Get the consumption of the last few days.
+	DWORD dwNow = QuantityHistory::Now();
+	DWORD dwFrom = (dwNow > TOP_CONSUMERS_PERIOD) ? dwNow - TOP_CONSUMERS_PERIOD : 0;
+	vector<HistoryConsumer> arrConsumers = workspace->GetQuantityHistory()->
+		GetTopConsumers(dwFrom, dwNow, TOP_CONSUMERS_COUNT);
+
+	// Check if there's anything to show.
+	if (arrConsumers.size() == 0) {
+		MessageBox(*hwndMain, L"No components were consumed recently.",
+			L"Top Consumers", MB_OK);
+		return 0;
+	}
+
+	// Build the list.
+	for (size_t i = 0; i < arrConsumers.size(); i++) {
+		_ltow(arrConsumers[i].nConsumed, szNumber, 10);
+		swMessage += arrConsumers[i].swName;
+		swMessage += L": ";
+		swMessage += szNumber;
+		swMessage += L"\r\n";
+	}
+
+	MessageBox(*hwndMain, swMessage.c_str(), L"Top Consumers", MB_OK);
+	return 0;
+}
+
+/**
+ * Removes stale thumbnails and builds the missing ones for every image in the
+ * workspace.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::RebuildThumbnails() {
+	WCHAR szMessage[MAX_PATH];
+	WCHAR szNumber[33];
+	size_t nRemoved;
+	size_t nGenerated;
+
+	// Do the work.
+	ShowLoading();
+	workspace->RescanImages();
+	imageLoader->RebuildThumbnails(COMPONENT_IMAGE_WIDTH,
+		COMPONENT_IMAGE_HEIGHT, &nRemoved, &nGenerated);
+	HideLoading();
+
+	// Show a summary.
+	wcscpy(szMessage, L"Thumbnails built: ");
+	_ltow(nGenerated, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	wcscat(szMessage, L"\r\nStale thumbnails removed: ");
+	_ltow(nRemoved, szNumber, 10);
+	wcscat(szMessage, szNumber);
+	MessageBox(*hwndMain, szMessage, L"Rebuild Thumbnails", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Replaces identical copies of datasheets and images with references to a
+ * single copy in the asset store.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::DeduplicateAssets() {
+	WCHAR szMessage[512];
+	AssetReport report;
+
+	if (CheckForUnsavedChanges())
+		return 1;
+
+	// Do the work.
+	ShowLoading();
+	bool bSuccess = workspace->GetAssets()->Deduplicate(&report);
+	HideLoading();
+	if (!bSuccess) {
+		MessageBox(*hwndMain, L"Couldn't create the asset store.",
+			L"Deduplication Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	// Show a summary.
+	swprintf(szMessage, L"Files scanned: %u\r\nDuplicates replaced: %u\r\n"
+		L"Space freed: %lu KB\r\nUnused blobs removed: %u\r\n\r\n"
+		L"%u blobs are shared by %u files, saving %lu KB in total.",
+		report.nScanned, report.nDeduplicated, report.dwBytesReclaimed / 1024,
+		report.nOrphans, report.nBlobs, report.nReferences,
+		report.dwBytesSaved / 1024);
+	MessageBox(*hwndMain, szMessage, L"Deduplicate Assets", MB_OK);
+
+	// Images keep their names when they move into the store, so only the ones
+	// that were removed as orphans have to be resolved again.
+	workspace->RescanImages();
+	return 0;
+}
+
 /**
  * Checks if there's a component opened in the detail view.
  *
  * @return TRUE if there is a component opened.
  */
 bool UIManager::IsComponentOpened() {
-	return iSelComponent >= 0;
+	return hSelComponent != COMPONENT_HANDLE_NONE;
 }
 
 /**
@@ -253,13 +655,13 @@ void UIManager::SyncDetailViewWithComponent(Component *component, bool bSaveNote
 	// Sync quantity.
 	GetEditText(GetDlgItem(*hwndDetail, IDC_EDQUANTITY), &szBuffer);
 	component->SetQuantity(szBuffer);
-	LocalFree(szBuffer);
+	AllocProfiler::Free(szBuffer);
 
-	// Sync notes.
-	if (bSaveNotes) {
+	// Sync notes. Placeholders must never end up in the notes file.
+	if (bSaveNotes && bNotesLoaded) {
 		GetEditText(GetDlgItem(*hwndDetail, IDC_EDNOTES), &szBuffer);
 		component->SaveNotes(szBuffer);
-		LocalFree(szBuffer);
+		AllocProfiler::Free(szBuffer);
 	}
 }
 
@@ -270,8 +672,10 @@ void UIManager::SyncDetailViewWithComponent(Component *component, bool bSaveNote
  * @return         0 if the operation was successful.
  */
 LRESULT UIManager::SaveComponent(bool bSaveAs) {
+	IoScope scope(IO_OP_SAVE);
+
 	// Get component.
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	if (component == NULL) {
 		MessageBox(*hwndMain, L"Couldn't retrieve the currently selected component.",
 			L"Component Retrieval Error", MB_OK | MB_ICONERROR);
@@ -282,51 +686,88 @@ LRESULT UIManager::SaveComponent(bool bSaveAs) {
 	SyncDetailViewWithComponent(component, !bSaveAs);
 	if (!bSaveAs) {
 		if (!component->Save()) {
+			if (component->HasConflict()) {
+				MessageBox(*hwndMain, L"Someone else has changed the properties "
+					L"of this component while you were editing it. Refresh the "
+					L"workspace and try again.", L"Component Save Conflict",
+					MB_OK | MB_ICONERROR);
+				return 1;
+			}
+
 			MessageBox(*hwndMain, L"An error occured while trying to save the component.",
 				L"Component Save Error", MB_OK | MB_ICONERROR);
 			return 1;
 		}
+
+		workspace->NotifyComponentChanged(component);
 	}
 
 	// Check if we should Save As or if a rename is required.
+	ComponentHandle hOriginal = COMPONENT_HANDLE_NONE;
 	LPTSTR szName;
 	GetEditText(GetDlgItem(*hwndDetail, IDC_EDNAME), &szName);
 	if (bSaveAs) {
+		Component componentOriginal(*component);
+		Directory dirOriginal = component->GetDirectory();
+
 		// Check if the names are different.
 		if (wcscmp(szName, component->GetName()) == 0) {
 			MessageBox(*hwndMain, L"The name of the new component should be "
 				L"different than the current one. Change the component name "
 				L"before trying to \"Save As\".", L"Trying to Save As with Same Name",
 				MB_OK | MB_ICONERROR);
-			LocalFree(szName);
+			AllocProfiler::Free(szName);
 
 			return 1;
 		}
 
+		// Notes that weren't loaded yet have to be copied from the original.
+		LPTSTR szNotes = NULL;
+		if (!bNotesLoaded)
+			szNotes = component->GetNotes();
+
 		// Actually save the component as a new one.
 		component->SetName(szName);
 		if (!component->Save(component->GetDirectory().Parent(), true)) {
 			MessageBox(*hwndMain, L"An error occured while trying to save the component.",
 				L"Component Save Error", MB_OK | MB_ICONERROR);
-			LocalFree(szName);
+			AllocProfiler::Free(szName);
+			if (szNotes != NULL)
+				AllocProfiler::Free(szNotes);
 
 			return 1;
 		}
+		if (szNotes != NULL) {
+			component->SaveNotes(szNotes);
+			AllocProfiler::Free(szNotes);
+		}
 		SyncDetailViewWithComponent(component, true);
+
+		// Our copy became the new component, so load the original back.
+		workspace->NotifyComponentSavedAs(component, &componentOriginal);
+		workspace->AddComponent(dirOriginal, &hOriginal);
 	} else if (wcscmp(szName, component->GetName()) != 0) {
+		Directory dirOld = component->GetDirectory();
+
+		// Listeners only hear about it once the folder was actually moved.
 		if (!component->Rename(szName)) {
 			MessageBox(*hwndMain, L"An error occured while renaming the component.",
 				L"Component Rename Error", MB_OK | MB_ICONERROR);
-			LocalFree(szName);
+			AllocProfiler::Free(szName);
 
 			return 1;
 		}
+		workspace->NotifyComponentRenamed(component, dirOld);
 	}
-	LocalFree(szName);
+	AllocProfiler::Free(szName);
 
-	// Refresh the workspace.
+	// Update just the nodes that changed.
+	vector<ComponentHandle> arrChanged(1, hSelComponent);
+	if (bSaveAs)
+		arrChanged.push_back(hOriginal);
 	SetDirty(false);
-	RefreshWorkspace();
+	ClearDetailView(true);
+	UpdateTreeView(arrChanged);
 
 	return 0;
 }
@@ -344,7 +785,7 @@ LRESULT UIManager::DeleteComponent() {
 		return 1;
 
 	// Get component.
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	if (component == NULL) {
 		MessageBox(*hwndMain, L"Couldn't retrieve the currently selected component.",
 			L"Component Retrieval Error", MB_OK | MB_ICONERROR);
@@ -352,6 +793,7 @@ LRESULT UIManager::DeleteComponent() {
 	}
 
 	// Clear the space.
+	ComponentHandle hComponent = hSelComponent;
 	ClearDetailView(true);
 
 	// Actually delete the component.
@@ -360,31 +802,38 @@ LRESULT UIManager::DeleteComponent() {
 			L"Component Deletion Error", MB_OK | MB_ICONERROR);
 		return 1;
 	}
+	workspace->RemoveComponent(hComponent);
 
-	// Refresh workspace and return.
-	RefreshWorkspace();
+	// Remove it from the tree and return.
+	UpdateTreeView(vector<ComponentHandle>(1, hComponent));
 	return 0;
 }
 
 /**
- * Populates the detail view with data from a selected component.
+ * Populates the detail view with data from a selected component. Everything
+ * that has to be read from disk is shown as a placeholder until the detail
+ * loader has it ready.
  *
- * @param nIndex Selected component index.
+ * @param hComponent Selected component handle.
  */
-void UIManager::PopulateDetailView(size_t nIndex) {
+void UIManager::PopulateDetailView(ComponentHandle hComponent) {
+	TraceSpan span(L"UIManager::PopulateDetailView");
+	IoScope scope(IO_OP_SELECT);
+	DWORD dwRequested = GetTickCount();
+
 	// Clear the view for a new component.
 	ClearDetailView(false);
 
 	// Get the component and check if it's valid.
-	Component *component = workspace->GetComponent(nIndex);
+	Component *component = workspace->GetComponentByHandle(hComponent);
 	if (component == NULL) {
 		MessageBox(NULL, L"Looks like you've selected an invalid component",
 			L"Invalid Component Selected", MB_OK | MB_ICONERROR);
 		return;
 	}
 
-	// Set the selected component index.
-	iSelComponent = nIndex;
+	// Set the selected component.
+	hSelComponent = hComponent;
 
 	// Set the name field.
 	SetDlgItemText(*hwndDetail, IDC_EDNAME, component->GetName());
@@ -395,22 +844,352 @@ void UIManager::PopulateDetailView(size_t nIndex) {
 	// Set the quantity field.
 	LPTSTR szQuantity = component->GetQuantityString();
 	SetDlgItemText(*hwndDetail, IDC_EDQUANTITY, szQuantity);
-	LocalFree(szQuantity);
+	AllocProfiler::Free(szQuantity);
 
-	// Set the notes field.
-	LPTSTR szNotes = component->GetNotes();
-	if (szNotes) {
-		SetDlgItemText(*hwndDetail, IDC_EDNOTES, szNotes);
-		LocalFree(szNotes);
-	}
+	// Show placeholders for the notes and properties.
+	SetDlgItemText(*hwndDetail, IDC_EDNOTES, DETAIL_PLACEHOLDER);
+	SendDlgItemMessage(*hwndDetail, IDC_EDNOTES, EM_SETREADONLY, TRUE, 0);
+	SendDlgItemMessage(*hwndDetail, IDC_LSPROPS, LB_ADDSTRING, 0,
+		(LPARAM)DETAIL_PLACEHOLDER);
+	EnableWindow(GetDlgItem(*hwndDetail, IDC_LSPROPS), FALSE);
+	bNotesLoaded = false;
+	bPropertiesLoaded = false;
 
-	// Populate the properties list.
-	PopulatePropertiesList(component);
+	// Load them in the background.
+	detailLoader->Start(*hwndMain);
+	detailLoader->Request(hComponent, component, dwRequested);
 
 	// Make sure we are not dirty.
 	SetDirty(false);
 }
 
+/**
+ * Handles a detail view model that was prepared in the background. The
+ * placeholders are swapped for the real contents if the model still belongs
+ * to the selected component.
+ *
+ * @param  model Model that was prepared. It's freed by this function.
+ * @return       0 if everything worked.
+ */
+LRESULT UIManager::DetailReady(DetailModel *model) {
+	// Check if the user is still looking at this component.
+	if ((model->hComponent != hSelComponent) ||
+			!detailLoader->IsCurrent(model->ulGeneration)) {
+		DetailLoader::FreeModel(model);
+		return 0;
+	}
+
+	// Swap everything in at once.
+	bool bWasDirty = IsDirty();
+	SendMessage(*hwndDetail, WM_SETREDRAW, FALSE, 0);
+
+	// Set the notes field and remember them to only save them if changed.
+	if (!bNotesLoaded) {
+		Component *component = workspace->GetComponentByHandle(hSelComponent);
+		if (component != NULL)
+			component->RememberNotes(model->swNotes.c_str());
+
+		SetDlgItemText(*hwndDetail, IDC_EDNOTES, model->swNotes.c_str());
+		SendDlgItemMessage(*hwndDetail, IDC_EDNOTES, EM_SETREADONLY, FALSE, 0);
+		bNotesLoaded = true;
+	}
+
+	// Populate the properties list.
+	if (!bPropertiesLoaded) {
+		SendDlgItemMessage(*hwndDetail, IDC_LSPROPS, LB_RESETCONTENT, 0, 0);
+		for (size_t i = 0; i < model->arrProperties.size(); i++) {
+			int pos = (int)SendDlgItemMessage(*hwndDetail, IDC_LSPROPS,
+				LB_ADDSTRING, 0, (LPARAM)model->arrProperties[i].c_str());
+			SendDlgItemMessage(*hwndDetail, IDC_LSPROPS, LB_SETITEMDATA,
+				(WPARAM)pos, (LPARAM)i);
+		}
+
+		EnableWindow(GetDlgItem(*hwndDetail, IDC_LSPROPS), TRUE);
+		bPropertiesLoaded = true;
+	}
+
+	SendMessage(*hwndDetail, WM_SETREDRAW, TRUE, 0);
+	InvalidateRect(*hwndDetail, NULL, TRUE);
+
+	// Filling the controls isn't an edit by the user.
+	SetDirty(bWasDirty);
+	detailLoader->RecordLatency(model->dwRequested);
+
+	DetailLoader::FreeModel(model);
+	return 0;
+}
+
+/**
+ * Shows how long it took for the detail view to be ready after selecting a
+ * component.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ShowSelectionLatency() {
+	WCHAR szMessage[MAX_PATH];
+	DetailLatency latency = detailLoader->GetLatency();
+
+	// Check if there's anything to show.
+	if (latency.dwCount == 0) {
+		MessageBox(*hwndMain, L"No components were selected yet.",
+			L"Selection Latency", MB_OK);
+		return 0;
+	}
+
+	swprintf(szMessage, L"Selections: %lu\r\nAverage: %lu ms\r\n"
+		L"Slowest: %lu ms\r\nLast: %lu ms", latency.dwCount,
+		latency.dwTotal / latency.dwCount, latency.dwMax, latency.dwLast);
+	MessageBox(*hwndMain, szMessage, L"Selection Latency", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Generates a synthetic workspace, times the core operations against it and
+ * saves the results as JSON. The opened workspace isn't touched.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::RunBenchmark() {
+	Benchmark benchmark(WorkspaceGenerator::GetDefaultSettings(),
+		BENCHMARK_RUNS);
+	Directory dirBenchmark(BENCHMARK_WORKSPACE);
+	Workspace wsBenchmark;
+	TreeModel model;
+	WCHAR szMessage[512];
+
+	// Ask the user politely.
+	if (MessageBox(*hwndMain, L"A synthetic workspace will be generated in "
+			BENCHMARK_WORKSPACE L" to time the application. This may take "
+			L"several minutes. Continue?", L"Run Benchmark",
+			MB_YESNO | MB_ICONQUESTION) != IDYES)
+		return 1;
+	bool bProfile = MessageBox(*hwndMain, L"Profile the memory allocations as "
+		L"well? This makes the timings less accurate.", L"Run Benchmark",
+		MB_YESNO | MB_ICONQUESTION) == IDYES;
+
+	// Start from a fresh workspace.
+	ShowLoading();
+	if (dirBenchmark.Exists())
+		dirBenchmark.DeleteRecursively();
+	if (!benchmark.Generate(BENCHMARK_WORKSPACE)) {
+		HideLoading();
+		MessageBox(*hwndMain, L"An error occured while generating the benchmark "
+			L"workspace.", L"Benchmark Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	// Time everything, counting only what the benchmark does.
+	IoAccounting::Reset();
+	if (bProfile)
+		AllocProfiler::Enable();
+	if (!benchmark.RunWorkspace(BENCHMARK_WORKSPACE, &wsBenchmark)) {
+		AllocProfiler::Disable();
+		HideLoading();
+		MessageBox(*hwndMain, L"An error occured while opening the benchmark "
+			L"workspace.", L"Benchmark Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+	for (size_t i = 0; i < benchmark.GetRuns(); i++) {
+		model.Clear();
+
+		benchmark.Start(L"tree_model_build");
+		BuildTreeModel(&wsBenchmark, vector<DuplicateFolder>(), &model);
+		benchmark.Stop();
+	}
+
+	// Check where the memory went while everything is loaded.
+	MemoryReport memory;
+	wsBenchmark.AccountMemory(&memory);
+	model.AccountMemory(&memory);
+	bool bWithinMemory = benchmark.AddMemoryReport(&memory);
+
+	benchmark.RunSearch(&wsBenchmark, BENCHMARK_QUERY);
+	benchmark.RunComponents(&wsBenchmark, BENCHMARK_SAVES);
+	benchmark.RunSelection(&wsBenchmark, BENCHMARK_SAVES);
+	benchmark.RunSaveChecks(&wsBenchmark);
+	benchmark.RunSaveAsChecks(&wsBenchmark);
+
+	// Time what the UI goes through to show a saved component.
+	vector<Component> *arrComponents = wsBenchmark.GetEditableComponents();
+	for (size_t j = 0; (j < arrComponents->size()) && (j < BENCHMARK_SAVES);
+			j++) {
+		Component *component = &(*arrComponents)[j];
+		TreeModel modelNew;
+		TreeDiff diff;
+
+		component->SetQuantity(component->GetQuantity() + 1);
+		IoScope scope(IO_OP_SAVE);
+		benchmark.Start(L"ui_save");
+		if (component->Save()) {
+			wsBenchmark.NotifyComponentChanged(component);
+			if (!PatchTreeModel(&wsBenchmark, vector<DuplicateFolder>(),
+					vector<ComponentHandle>(1, wsBenchmark.GetComponentHandle(j)),
+					&model, &diff)) {
+				BuildTreeModel(&wsBenchmark, vector<DuplicateFolder>(),
+					&modelNew);
+				diff.Compare(model, modelNew);
+				model.Swap(modelNew);
+			}
+		}
+		benchmark.Stop();
+	}
+	bool bConsistent = benchmark.RunConcurrentWriters(BENCHMARK_WORKSPACE,
+		&wsBenchmark);
+	bConsistent = benchmark.RunConcurrentProcesses(BENCHMARK_WORKSPACE,
+		&wsBenchmark) && bConsistent;
+	benchmark.RunBomImport(&wsBenchmark, BENCHMARK_BOM_IMPORT_LINES);
+	benchmark.RunBomApply(&wsBenchmark, BENCHMARK_BOM_APPLY_LINES);
+	benchmark.RunHistory(BENCHMARK_WORKSPACE, BENCHMARK_HISTORY_EVENTS);
+	wsBenchmark.Close();
+	bool bWithinBudget = benchmark.AddIoReport();
+
+	// Time the indexes against a workspace that only lives in memory.
+	benchmark.RunFacets(BENCHMARK_INDEX_PARTS, BENCHMARK_INDEX_EDITS);
+	benchmark.RunSmartFolders(BENCHMARK_INDEX_PARTS, BENCHMARK_SMART_FOLDERS,
+		BENCHMARK_INDEX_EDITS);
+	benchmark.RunDuplicates(BENCHMARK_INDEX_PARTS, DUPLICATE_SIMILARITY);
+
+	// Check the policies of the subsystems that don't need a workspace.
+	benchmark.RunCacheChecks();
+	benchmark.RunImageChecks();
+	benchmark.RunPrefetchChecks();
+	benchmark.RunTreeChecks();
+	benchmark.RunReclaimChecks();
+	benchmark.RunTraceChecks();
+	bool bChecksPassed = benchmark.AddChecks();
+
+	// Anything the profiler still knows about after closing was leaked.
+	size_t nLeaks = 0;
+	if (bProfile) {
+		nLeaks = AllocProfiler::GetLeakCount();
+		benchmark.AddSection(L"allocations", AllocProfiler::ToJSON());
+		AllocProfiler::Disable();
+		AllocProfiler::Reset();
+	}
+
+	// Save the results.
+	bool bSaved = benchmark.Save(BENCHMARK_RESULTS);
+	HideLoading();
+	if (!bSaved)
+		return 1;
+
+	swprintf(szMessage, L"The benchmark results were saved to %s%s%s%s%s%s",
+		BENCHMARK_RESULTS, (bWithinBudget) ? L"" :
+		L"\r\nSome operations went over their I/O budget.", (bWithinMemory) ?
+		L"" : L"\r\nComponents went over their memory budget.",
+		(nLeaks == 0) ? L"" : L"\r\nSome allocations were leaked.",
+		(bConsistent) ? L"" : L"\r\nConcurrent writers lost some changes.",
+		(bChecksPassed) ? L"" : L"\r\nSome checks failed.");
+	MessageBox(*hwndMain, szMessage, L"Benchmark Finished", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Starts recording a new trace or stops the one being recorded.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ToggleTracing() {
+	if (Tracer::IsEnabled()) {
+		Tracer::Disable();
+		MessageBox(*hwndMain, L"Tracing stopped. Use \"Save Trace\" to save "
+			L"what was recorded.", L"Tracing", MB_OK);
+
+		return 0;
+	}
+
+	if (!Tracer::Enable()) {
+		MessageBox(*hwndMain, L"Couldn't allocate the trace buffer.",
+			L"Tracing Error", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+	MessageBox(*hwndMain, L"Tracing started.", L"Tracing", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Saves the spans recorded so far in the Chrome trace event format.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::SaveTrace() {
+	WCHAR szMessage[MAX_PATH];
+
+	// Check if there's anything to save.
+	if (Tracer::GetEventCount() == 0) {
+		MessageBox(*hwndMain, L"Nothing was traced yet.", L"Save Trace", MB_OK);
+		return 0;
+	}
+
+	if (!Tracer::Save(TRACE_FILE))
+		return 1;
+
+	swprintf(szMessage, L"The trace was saved to %s", TRACE_FILE);
+	MessageBox(*hwndMain, szMessage, L"Save Trace", MB_OK);
+
+	return 0;
+}
+
+/**
+ * Shows the file system operations done on behalf of each user action and
+ * lets the user reset them.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ShowIoStatistics() {
+	WCHAR szLine[MAX_PATH];
+	wstring swMessage;
+
+	// Build a line for each action.
+	for (int i = 0; i < IO_OP_COUNT; i++) {
+		IoCounters counters = IoAccounting::GetCounters(i);
+
+		swprintf(szLine, L"%s: %ld calls, %ld opens, %ld reads (%ld bytes), "
+			L"%ld writes, %ld listings, %ld probes, %ld deletes\r\n",
+			IoAccounting::GetOperationName(i), counters.lCalls,
+			counters.lOpens, counters.lReads, counters.lBytesRead,
+			counters.lWrites, counters.lEnumerations, counters.lProbes,
+			counters.lDeletes);
+		swMessage += szLine;
+	}
+	swMessage += L"\r\nReset the counters?";
+
+	if (MessageBox(*hwndMain, swMessage.c_str(), L"I/O Statistics",
+			MB_YESNO) == IDYES)
+		IoAccounting::Reset();
+
+	return 0;
+}
+
+/**
+ * Shows how much memory each subsystem is using.
+ *
+ * @return 0 if the operation was successful.
+ */
+LRESULT UIManager::ShowMemoryUsage() {
+	WCHAR szLine[MAX_PATH];
+	MemoryReport report;
+	wstring swMessage;
+
+	AccountMemory(&report);
+
+	// Build a line for each subsystem.
+	for (int i = 0; i < MEMORY_SUBSYSTEMS; i++) {
+		swprintf(szLine, L"%s: %lu KB\r\n", MemoryReport::GetSubsystemName(i),
+			(DWORD)(report.GetBytes(i) / 1024));
+		swMessage += szLine;
+	}
+	swprintf(szLine, L"\r\nTotal: %lu KB\r\nPer component: %lu bytes",
+		(DWORD)(report.GetTotal() / 1024), (DWORD)report.GetPerComponent());
+	swMessage += szLine;
+
+	MessageBox(*hwndMain, swMessage.c_str(), L"Memory Usage", MB_OK);
+	return 0;
+}
+
 /**
  * Populates the properties list with data from a component.
  *
@@ -429,8 +1208,12 @@ void UIManager::PopulatePropertiesList(Component *component) {
 		SendDlgItemMessage(*hwndDetail, IDC_LSPROPS, LB_SETITEMDATA,
 			(WPARAM)pos, (LPARAM)i);
 
-		LocalFree(szCaption);
+		AllocProfiler::Free(szCaption);
 	}
+
+	// Whatever the loader was preparing is now stale.
+	EnableWindow(GetDlgItem(*hwndDetail, IDC_LSPROPS), TRUE);
+	bPropertiesLoaded = true;
 }
 
 /**
@@ -448,8 +1231,16 @@ void UIManager::ClearDetailView(bool bClose) {
 	SendDlgItemMessage(*hwndDetail, IDC_LSPROPS, LB_RESETCONTENT, 0, 0);
 	ClearImage();
 
+	// Forget about the contents that were still being loaded.
+	if (detailLoader != NULL)
+		detailLoader->Cancel();
+	SendDlgItemMessage(*hwndDetail, IDC_EDNOTES, EM_SETREADONLY, FALSE, 0);
+	EnableWindow(GetDlgItem(*hwndDetail, IDC_LSPROPS), TRUE);
+	bNotesLoaded = true;
+	bPropertiesLoaded = true;
+
 	// Reset flags.
-	iSelComponent = -1;
+	hSelComponent = COMPONENT_HANDLE_NONE;
 	SetDirty(false);
 
 #ifdef SHELL_AYGSHELL
@@ -459,55 +1250,209 @@ void UIManager::ClearDetailView(bool bClose) {
 }
 
 /**
- * Sets the component image label in the detail view.
+ * Sets the component image label in the detail view. Images that aren't
+ * loaded yet are loaded in the background, along with the images of the
+ * neighbouring components.
  *
  * @param component Component to get the image for.
  */
 void UIManager::SetComponentImage(Component *component) {
-	int cx, cy;
+	TraceSpan span(L"UIManager::SetComponentImage");
 
 	// Clear the current image.
 	ClearImage();
 
-	// Grab the path to the component image.
-	LPTSTR szImagePath = component->GetImage();
-	if (szImagePath == NULL)
-		return;
+	// Grab the path to the component image and show it if we already have it.
+	LPCTSTR szImagePath = workspace->GetImages()->GetImage(component);
+	if (szImagePath != NULL) {
+		HBITMAP hBitmap = bitmaps.Get(szImagePath, COMPONENT_IMAGE_WIDTH,
+			COMPONENT_IMAGE_HEIGHT);
+
+		if (hBitmap != NULL) {
+			ShowImage(szImagePath, hBitmap);
+			szImagePath = NULL;
+		} else {
+			swPendingImage = szImagePath;
+		}
+	}
 
-	// Load the new image.
-	HBITMAP hBmp = ImageUtils::LoadBitmap(szImagePath);
-	LocalFree(szImagePath);
-	if (hBmp == NULL) {
-		MessageBox(*hwndMain, L"An error occured while loading the component image.",
-			L"Image Loading Error", MB_OK | MB_ICONERROR);
+	// Load everything else in the background.
+	vector<wstring> arrNeighbours = GetNeighbourImages();
+	if ((szImagePath == NULL) && arrNeighbours.empty())
 		return;
+	imageLoader->Start(*hwndMain, COMPONENT_IMAGE_WIDTH, COMPONENT_IMAGE_HEIGHT);
+	imageLoader->Request(szImagePath, arrNeighbours);
+}
+
+/**
+ * Handles an image that was loaded in the background. The image is cached and
+ * displayed if it's the one the user is still waiting for.
+ *
+ * @param  image Image that was loaded. It's freed by this function.
+ * @return       0 if everything worked.
+ */
+LRESULT UIManager::ImageLoaded(LoadedImage *image) {
+	LPCTSTR szPath = image->swPath.c_str();
+	HBITMAP hBitmap = image->hBitmap;
+	bool bShow;
+
+	// Check if the user is still waiting for it.
+	bShow = image->bSelected && (image->swPath == swPendingImage) &&
+		imageLoader->IsCurrent(image->ulGeneration);
+
+	// Hand the bitmap over to the cache.
+	image->hBitmap = NULL;
+	if (hBitmap != NULL) {
+		hBitmap = bitmaps.Put(szPath, COMPONENT_IMAGE_WIDTH,
+			COMPONENT_IMAGE_HEIGHT, hBitmap);
 	}
 
-	// Set the optimal size for the component image.
-#ifdef SHELL_AYGSHELL
-	cx = 82;
-	cy = 85;
-#else
-	cx = 86;
-	cy = 83;
-#endif
+	if (bShow) {
+		swPendingImage.erase();
+
+		if (hBitmap == NULL) {
+			MessageBox(*hwndMain, L"An error occured while loading the component image.",
+				L"Image Loading Error", MB_OK | MB_ICONERROR);
+		} else {
+			ShowImage(szPath, hBitmap);
+		}
+	} else if (hBitmap != NULL) {
+		// Prefetched images just stay in the cache.
+		bitmaps.Release(szPath, COMPONENT_IMAGE_WIDTH, COMPONENT_IMAGE_HEIGHT);
+	}
+
+	ImageLoader::FreeResult(image);
+	return 0;
+}
+
+/**
+ * Displays a component image that's pinned in the bitmap cache.
+ *
+ * @param szPath  Path to the image file.
+ * @param hBitmap Bitmap of the image.
+ */
+void UIManager::ShowImage(LPCTSTR szPath, HBITMAP hBitmap) {
+	swComponentImage = szPath;
+	hbmpComponent = hBitmap;
 
-	// Resize it and display it.
-	hbmpComponent = ImageUtils::ResizeBitmap(hBmp, cx, cy);
 	SendDlgItemMessage(*hwndDetail, IDC_PICOMP, STM_SETIMAGE, IMAGE_BITMAP,
 		(LPARAM)hbmpComponent);
 	ShowWindow(GetDlgItem(*hwndDetail, IDC_LBNOIMAGE), SW_HIDE);
 	ShowWindow(GetDlgItem(*hwndDetail, IDC_PICOMP), SW_SHOW);
 }
 
+/**
+ * Gets the images of the components around the selected one in the TreeView
+ * that aren't loaded yet, closest ones first.
+ *
+ * @return Paths to the images.
+ */
+vector<wstring> UIManager::GetNeighbourImages() {
+	vector<wstring> arrPaths;
+	HTREEITEM hNext = hSelItem;
+	HTREEITEM hPrev = hSelItem;
+
+	if (hSelItem == NULL)
+		return arrPaths;
+
+	for (int i = 0; i < PREFETCH_NEIGHBOURS; i++) {
+		if (hNext != NULL) {
+			hNext = treeView->GetSibling(hNext, true);
+			AddNeighbourImage(hNext, &arrPaths);
+		}
+
+		if (hPrev != NULL) {
+			hPrev = treeView->GetSibling(hPrev, false);
+			AddNeighbourImage(hPrev, &arrPaths);
+		}
+	}
+
+	return arrPaths;
+}
+
+/**
+ * Adds the image of a TreeView item to a list of images to be prefetched if
+ * it isn't loaded yet.
+ *
+ * @param hItem    TreeView item.
+ * @param arrPaths List of images to be prefetched.
+ */
+void UIManager::AddNeighbourImage(HTREEITEM hItem, vector<wstring> *arrPaths) {
+	TVITEM tvItem;
+
+	if (hItem == NULL)
+		return;
+
+	// Check if the item is a component.
+	tvItem.hItem = hItem;
+	tvItem.mask = TVIF_PARAM;
+	if (!treeView->GetItem(&tvItem) || (tvItem.lParam == -1))
+		return;
+	Component *component = workspace->GetComponentByHandle(
+		(ComponentHandle)tvItem.lParam);
+	if (component == NULL)
+		return;
+
+	// Check if we need to load its image.
+	LPCTSTR szPath = workspace->GetImages()->GetImage(component);
+	if ((szPath != NULL) && !bitmaps.Contains(szPath, COMPONENT_IMAGE_WIDTH,
+			COMPONENT_IMAGE_HEIGHT))
+		arrPaths->push_back(wstring(szPath));
+}
+
 /**
  * Clears the component image from the view.
  */
 void UIManager::ClearImage() {
 	SendDlgItemMessage(*hwndDetail, IDC_PICOMP, STM_SETIMAGE, IMAGE_BITMAP, (LPARAM)NULL);
 	ShowWindow(GetDlgItem(*hwndDetail, IDC_PICOMP), SW_HIDE);
-	DeleteObject(hbmpComponent);
 	ShowWindow(GetDlgItem(*hwndDetail, IDC_LBNOIMAGE), SW_SHOW);
+
+	// Let the cache know that we are done with the bitmap.
+	if (!swComponentImage.empty()) {
+		bitmaps.Release(swComponentImage.c_str(), COMPONENT_IMAGE_WIDTH,
+			COMPONENT_IMAGE_HEIGHT);
+		swComponentImage.erase();
+	}
+	swPendingImage.erase();
+	hbmpComponent = NULL;
+}
+
+/**
+ * Shrinks or restores the image cache budget according to the memory load.
+ */
+void UIManager::CheckMemoryLoad() {
+	bitmaps.CheckMemoryLoad();
+}
+
+/**
+ * Frees the memory used by the images that aren't being displayed.
+ */
+void UIManager::ReleaseMemory() {
+	bitmaps.ReleaseMemory();
+	ReclaimTreeView();
+}
+
+/**
+ * Accounts for the memory used by the tree, the images and the opened
+ * workspace.
+ *
+ * @param report Report to add the memory to.
+ */
+void UIManager::AccountMemory(MemoryReport *report) {
+	// Tree.
+	treeModel.AccountMemory(report);
+	treeMaterializer.AccountMemory(report);
+	report->Add(MEMORY_TREE, arrTreeItems.capacity() * sizeof(HTREEITEM));
+
+	// Images.
+	imageLoader->AccountMemory(report);
+	bitmaps.AccountMemory(report);
+	report->AddString(MEMORY_IMAGES, swComponentImage);
+	report->AddString(MEMORY_IMAGES, swPendingImage);
+
+	if (workspace->IsOpened())
+		workspace->AccountMemory(report);
 }
 
 /**
@@ -520,7 +1465,7 @@ LRESULT UIManager::CreateProperty() {
 
 	// Create property editor.
 	Property prop;
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	PropertyEditor editor(*hInst, hwndMain, &prop);
 
 	// Check if any changes were made to the property.
@@ -551,7 +1496,7 @@ LRESULT UIManager::EditSelectedProperty() {
 	size_t iProp = (size_t)SendMessage(hwndList, LB_GETITEMDATA, iSelected, 0);
 
 	// Get property and create property editor.
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	Property *prop = component->GetProperty(iProp);
 	PropertyEditor editor(*hInst, hwndMain, prop);
 
@@ -585,7 +1530,7 @@ LRESULT UIManager::DeleteSelectedProperty() {
 	size_t iProp = (size_t)SendMessage(hwndList, LB_GETITEMDATA, iSelected, 0);
 
 	// Get component and remove the selected property.
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	component->RemoveProperty(iProp);
 	SetDirty(true);
 
@@ -605,15 +1550,20 @@ LRESULT UIManager::ShowDatasheet() {
 	SHELLEXECUTEINFO lpExecInfo = {0};
 
 	// Get component.
-	Component *component = workspace->GetComponent(iSelComponent);
+	Component *component = workspace->GetComponentByHandle(hSelComponent);
 	if (component == NULL) {
 		MessageBox(*hwndMain, L"Couldn't retrieve the currently selected component.",
 			L"Component Retrieval Error", MB_OK | MB_ICONERROR);
 		return 1;
 	}
 
-	// Get datasheet path and setup its opening.
+	// Get datasheet path, which may be in the asset store, and setup its opening.
 	Path pathDatasheet = component->GetDirectory().Concatenate(DATASHEET_FILE);
+	if (!workspace->GetAssets()->Resolve(pathDatasheet, &pathDatasheet)) {
+		MessageBox(*hwndMain, L"This component doesn't have a datasheet.",
+			L"Datasheet Not Found", MB_OK | MB_ICONERROR);
+		return 1;
+	}
 	lpExecInfo.cbSize = sizeof(SHELLEXECUTEINFO);
 	lpExecInfo.lpFile = pathDatasheet.ToString();
 	lpExecInfo.fMask = SEE_MASK_NOCLOSEPROCESS;
@@ -681,7 +1631,11 @@ LRESULT UIManager::TreeViewSelectionChanged(HWND hWnd, UINT wMsg,
 											WPARAM wParam, LPARAM lParam) {
 	TVITEM tvItem;
 	NMTREEVIEW* pnmTreeView = (LPNMTREEVIEW)lParam;
-	size_t nIndex;
+	ComponentHandle hComponent;
+
+	// Nodes being moved around by an update aren't selections by the user.
+	if (bUpdatingTree)
+		return 0;
 
 	if (CheckForUnsavedChanges())
 		return 1;
@@ -704,131 +1658,663 @@ LRESULT UIManager::TreeViewSelectionChanged(HWND hWnd, UINT wMsg,
 		ShowWindow(*hwndDetail, SW_SHOW);
 #endif
 	
-	// Get component index from parameter and show it in the detail view.
-	nIndex = (size_t)tvItem.lParam;
-	PopulateDetailView(nIndex);
+	// Get component handle from parameter and show it in the detail view.
+	hComponent = (ComponentHandle)tvItem.lParam;
+	hSelItem = tvItem.hItem;
+	PopulateDetailView(hComponent);
 
 	return 0;
 }
 
 /**
- * Populates the TreeView with components.
+ * Process the TVN_ITEMEXPANDING message for the component TreeView, inserting
+ * the children of a folder that is expanded for the first time.
+ *
+ * @param  hWnd   Window handler.
+ * @param  wMsg   Message type.
+ * @param  wParam Message parameter.
+ * @param  lParam Message parameter.
+ * @return        FALSE to allow the node to be expanded.
+ */
+LRESULT UIManager::TreeViewItemExpanding(HWND hWnd, UINT wMsg, WPARAM wParam,
+										 LPARAM lParam) {
+	NMTREEVIEW* pnmTreeView = (LPNMTREEVIEW)lParam;
+	vector<size_t> arrNodes;
+
+	// Only folders that are opened by the user in the lazy mode matter.
+	if (bUpdatingTree || !treeMaterializer.IsLazy() ||
+			(pnmTreeView->action != TVE_EXPAND))
+		return FALSE;
+	size_t nNode = FindTreeNode(pnmTreeView->itemNew.hItem);
+	if (nNode == TREE_NODE_NONE)
+		return FALSE;
+
+	// Insert its children if they aren't there yet.
+	if (treeMaterializer.Materialize(treeModel, nNode, &arrNodes))
+		treeView->Materialize(treeModel, arrNodes, &arrTreeItems);
+
+	return FALSE;
+}
+
+/**
+ * Process the TVN_ITEMEXPANDED message for the component TreeView, keeping
+ * track of which folders can have their children reclaimed.
+ *
+ * @param  hWnd   Window handler.
+ * @param  wMsg   Message type.
+ * @param  wParam Message parameter.
+ * @param  lParam Message parameter.
+ * @return        0 if everything worked.
+ */
+LRESULT UIManager::TreeViewItemExpanded(HWND hWnd, UINT wMsg, WPARAM wParam,
+										LPARAM lParam) {
+	NMTREEVIEW* pnmTreeView = (LPNMTREEVIEW)lParam;
+
+	// Only folders that are opened by the user in the lazy mode matter.
+	if (bUpdatingTree || !treeMaterializer.IsLazy())
+		return 0;
+
+	size_t nNode = FindTreeNode(pnmTreeView->itemNew.hItem);
+	if (nNode != TREE_NODE_NONE) {
+		treeMaterializer.SetExpanded(nNode,
+			pnmTreeView->action == TVE_EXPAND);
+	}
+
+	return 0;
+}
+
+/**
+ * Populates the TreeView with components. Only the nodes that changed since
+ * it was last populated are touched.
  */
 void UIManager::PopulateTreeView() {
-	size_t i, j;
-	bool bHasUncategorized = false;
+	TraceSpan span(L"UIManager::PopulateTreeView");
+
+	// Duplicates from before may not even exist anymore.
+	arrDuplicates.clear();
 
-	// Clear the TreeView and get components.
+	// Update the tree.
+	imageLoader->SetWorkspace(workspace->GetDirectory());
+	UpdateTreeView();
+}
+
+/**
+ * Brings the TreeView up to date with the workspace by comparing it with what
+ * it should look like and only applying the differences.
+ */
+void UIManager::UpdateTreeView() {
+	TreeModel modelNew;
+	TreeDiff diff;
+
+	// Huge workspaces only get their folders populated when they're opened.
+	if (treeModel.GetCount() == 0) {
+		treeMaterializer.SetLazy(workspace->GetEditableComponents()->size() >=
+			LAZY_TREE_THRESHOLD);
+	}
+
+	// Compare the tree with what it should be.
+	BuildTreeModel(workspace, arrDuplicates, &modelNew);
+	diff.Compare(treeModel, modelNew);
+	ApplyTreeDiff(modelNew, diff);
+
+	treeModel.Swap(modelNew);
+}
+
+/**
+ * Brings the TreeView up to date after some components changed by only
+ * rebuilding the folders they were and are now in. Falls back to comparing
+ * the whole tree when folders have to come or go.
+ *
+ * @param arrChanged Components that were added, changed or removed.
+ */
+void UIManager::UpdateTreeView(const vector<ComponentHandle> &arrChanged) {
+	TreeDiff diff;
+
+	if (!PatchTreeModel(workspace, arrDuplicates, arrChanged, &treeModel,
+			&diff)) {
+		UpdateTreeView();
+		return;
+	}
+
+	ApplyTreeDiff(treeModel, diff);
+}
+
+/**
+ * Applies the differences between what the TreeView is showing and a tree.
+ *
+ * @param model Tree that the TreeView should show.
+ * @param diff  Operations that take the TreeView there.
+ */
+void UIManager::ApplyTreeDiff(const TreeModel &model, const TreeDiff &diff) {
+	treeMaterializer.Update(model, diff);
+
+	// Nodes being moved around aren't selections by the user.
+	bUpdatingTree = true;
+	treeView->SelectItem(NULL);
+	hSelItem = NULL;
+	treeView->Apply(model, diff, treeMaterializer, &arrTreeItems);
+	bUpdatingTree = false;
+}
+
+/**
+ * Removes everything from the TreeView.
+ */
+void UIManager::ClearTreeView() {
+	bUpdatingTree = true;
 	treeView->Clear();
-	vector<Component> arrComponents = workspace->GetComponents();
+	bUpdatingTree = false;
+
+	treeModel.Clear();
+	treeMaterializer.Clear();
+	arrTreeItems.clear();
+	arrDuplicates.clear();
+	hSelItem = NULL;
+}
 
-	// Populate the categories.
-	vector<Category> arrCategories;
-	for (i = 0; i < arrComponents.size(); i++) {
-		LPCTSTR szCategory = arrComponents[i].GetCategory();
-		bool bUnique = true;
+/**
+ * Drops the children of the folders that were collapsed by the user, leaving
+ * them to be populated again the next time they are expanded.
+ */
+void UIManager::ReclaimTreeView() {
+	vector<size_t> arrNodes;
+
+	treeMaterializer.Reclaim(treeModel, &arrNodes);
+	bUpdatingTree = true;
+	for (size_t i = 0; i < arrNodes.size(); i++) {
+		treeView->DeleteChildren(arrTreeItems[arrNodes[i]]);
+		ForgetTreeItems(arrNodes[i]);
+	}
+	bUpdatingTree = false;
+}
+
+/**
+ * Forgets the items of everything under a node after they were removed from
+ * the TreeView.
+ *
+ * @param nNode Node that had its children removed.
+ */
+void UIManager::ForgetTreeItems(size_t nNode) {
+	const vector<size_t> &arrChildren = treeModel.GetChildren(nNode);
+
+	for (size_t i = 0; i < arrChildren.size(); i++) {
+		if (arrTreeItems[arrChildren[i]] == hSelItem)
+			hSelItem = NULL;
+
+		arrTreeItems[arrChildren[i]] = NULL;
+		ForgetTreeItems(arrChildren[i]);
+	}
+}
+
+/**
+ * Finds the node of the tree that an item belongs to.
+ *
+ * @param  hItem TreeView item.
+ * @return       Node of the item or TREE_NODE_NONE if it isn't part of the
+ *               tree.
+ */
+size_t UIManager::FindTreeNode(HTREEITEM hItem) {
+	for (size_t i = 0; i < arrTreeItems.size(); i++) {
+		if (arrTreeItems[i] == hItem)
+			return i;
+	}
+
+	return TREE_NODE_NONE;
+}
+
+/**
+ * Builds what the TreeView should look like with the components of a
+ * workspace. Folders and components are always listed in alphabetical order.
+ *
+ * @param workspace     Workspace to be shown.
+ * @param arrDuplicates Groups of duplicates to be listed.
+ * @param model         Tree to be populated.
+ */
+void UIManager::BuildTreeModel(Workspace *workspace,
+							   const vector<DuplicateFolder> &arrDuplicates,
+							   TreeModel *model) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+	SmartFolders *smartFolders = workspace->GetSmartFolders();
+	map<wstring, vector<Component*> > mapCategories;
+	map<wstring, vector<Component*> >::iterator it;
+	vector<Component*> arrOrder;
+	vector<Component*> arrUncategorized;
+	vector<wstring> arrCategories;
+	size_t i;
+
+	// Sort the components by name.
+	arrOrder.reserve(arrComponents->size());
+	for (i = 0; i < arrComponents->size(); i++)
+		arrOrder.push_back(&(*arrComponents)[i]);
+	sort(arrOrder.begin(), arrOrder.end(), CompareNames);
+	model->Reserve(arrComponents->size() * 2);
+
+	// Split them into their categories while keeping them in order.
+	for (i = 0; i < arrOrder.size(); i++) {
+		LPCTSTR szCategory = arrOrder[i]->GetCategory();
 
-		// Check if it's an uncategorized component.
 		if (szCategory == NULL) {
-			bHasUncategorized = true;
-			continue;
-		}
-		
-		// Check if this category is new.
-		for (j = 0; j < arrCategories.size(); j++) {
-			if (arrCategories[j].Equals(szCategory)) {
-				bUnique = false;
-				break;
-			}
+			arrUncategorized.push_back(arrOrder[i]);
+		} else {
+			mapCategories[szCategory].push_back(arrOrder[i]);
 		}
+	}
+
+	// Add the category folders in alphabetical order.
+	for (it = mapCategories.begin(); it != mapCategories.end(); it++)
+		arrCategories.push_back(it->first);
+	sort(arrCategories.begin(), arrCategories.end(), CompareFolders);
+	for (i = 0; i < arrCategories.size(); i++) {
+		AddCategoryNodes(workspace, arrCategories[i].c_str(),
+			mapCategories[arrCategories[i]], model);
+	}
+
+	// Add the uncategorized folder.
+	if (arrUncategorized.size() > 0)
+		AddCategoryNodes(workspace, NULL, arrUncategorized, model);
+
+	// Add the smart folders, components closest to running out and duplicates.
+	for (i = 0; i < smartFolders->GetFoldersCount(); i++)
+		AddSmartFolderNodes(workspace, i, model);
+	AddReorderNodes(workspace, model);
+	AddDuplicateNodes(workspace, arrDuplicates, model);
+}
+
+/**
+ * Brings a tree up to date after some components changed by only rebuilding
+ * the folders they were and are now in.
+ *
+ * @param  workspace     Workspace being shown.
+ * @param  arrDuplicates Groups of duplicates being listed.
+ * @param  arrChanged    Components that were added, changed or removed.
+ * @param  model         Tree to be patched in place.
+ * @param  diff          Operations that were applied to the tree.
+ * @return               TRUE if the tree was patched. FALSE if folders have
+ *                       to be added or removed and the whole tree must be
+ *                       rebuilt instead.
+ *
+ * @remark The tree is left untouched when FALSE is returned.
+ */
+bool UIManager::PatchTreeModel(Workspace *workspace,
+							   const vector<DuplicateFolder> &arrDuplicates,
+							   const vector<ComponentHandle> &arrChanged,
+							   TreeModel *model, TreeDiff *diff) {
+	SmartFolders *smartFolders = workspace->GetSmartFolders();
+	map<ComponentHandle, bool> mapChanged;
+	map<wstring, bool> mapAffected;
+	map<wstring, bool>::iterator it;
+	TreeModel modelWanted;
+	size_t i, j;
+
+	// Dropped nodes pile up until the tree is rebuilt from scratch.
+	if ((model->GetCount() == 0) ||
+			(model->GetRemovedCount() > (model->GetCount() / 2))) {
+		return false;
+	}
+
+	// Find the folders that held the changed components.
+	for (i = 0; i < arrChanged.size(); i++) {
+		vector<size_t> arrNodes;
+
+		// Folders share the value of an invalid handle.
+		if (arrChanged[i] == COMPONENT_HANDLE_NONE)
+			continue;
+
+		mapChanged[arrChanged[i]] = true;
+		model->FindNodes((long)arrChanged[i], &arrNodes);
+		for (j = 0; j < arrNodes.size(); j++)
+			mapAffected[model->GetNode(model->FindRoot(arrNodes[j])).swKey] = true;
+	}
 
-		// Looks like we have a new category.
-		if (bUnique) {
-			Category cat(szCategory);
-			cat.PopulateSubCategories(arrComponents);
+	// Find the folders that should hold them now.
+	for (i = 0; i < arrChanged.size(); i++) {
+		Component *component = workspace->GetComponentByHandle(arrChanged[i]);
+		if (component == NULL)
+			continue;
 
-			arrCategories.push_back(cat);
+		LPCTSTR szCategory = component->GetCategory();
+		mapAffected[(szCategory == NULL) ? wstring(L"u") :
+			L"c:" + wstring(szCategory)] = true;
+		for (j = 0; j < smartFolders->GetFoldersCount(); j++) {
+			if (smartFolders->Contains(j, component))
+				mapAffected[L"s:" + wstring(smartFolders->GetFolderName(j))] = true;
 		}
 	}
 
-	// Add the category nodes and populate them with components.
-	for (i = 0; i < arrCategories.size(); i++) {
-		// Add category to the TreeView.
-		HTREEITEM nodeCategory = treeView->AddItem(NULL, arrCategories[i].GetName(),
-			NULL, ILI_FOLDER, (LPARAM)-1);
-
-		// Go through sub-categories and populate its components.
-		vector<wstring> arrSubCategories = arrCategories[i].GetSubCategories();
-		for (j = 0; j < arrSubCategories.size(); j++) {
-			HTREEITEM nodeSubCategory = treeView->AddItem(nodeCategory,
-				arrSubCategories[j].c_str(), NULL, ILI_FOLDER, (LPARAM)-1);
-
-			// Go through components searching for the ones that belong here.
-			for (size_t k = 0; k < arrComponents.size(); k++) {
-				LPCTSTR szCategory = arrComponents[k].GetCategory();
-				if (szCategory == NULL)
-					continue;
+	// Any change in quantity may shuffle the reorder queue.
+	mapAffected[L"r"] = true;
 
-				// This component belongs inside this category.
-				if (arrCategories[i].Equals(szCategory)) {
-					LPCTSTR szSubCategory = arrComponents[k].GetSubCategory();
-					
-					// This component doesn't have a sub-category.
-					if (szSubCategory == NULL)
-						continue;
-
-					// Check if this component fits into this sub-category.
-					if (arrSubCategories[j].compare(wstring(szSubCategory)) == 0)
-						treeView->AddItem(nodeSubCategory, arrComponents[k].ToString(),
-							NULL, ILI_CHIP, (LPARAM)k);
-				}
-			}
+	// Build what the affected folders should look like.
+	for (it = mapAffected.begin(); it != mapAffected.end(); it++) {
+		const wstring &swKey = it->first;
+		size_t nRoot = model->FindChild(TREE_NODE_NONE, swKey);
 
-			// Expand the sub-category node.
-			treeView->ExpandNode(nodeSubCategory);
+		if (swKey == L"r") {
+			// The queue folder only exists while there's something in it.
+			size_t nCount = modelWanted.GetCount();
+			AddReorderNodes(workspace, &modelWanted);
+			if ((nRoot == TREE_NODE_NONE) != (modelWanted.GetCount() == nCount))
+				return false;
+
+			continue;
+		} else if (nRoot == TREE_NODE_NONE) {
+			return false;
 		}
 
-		// Search for components without a sub-category.
-		if (arrCategories[i].HasComponentsWithNoSubCategory()) {
-			for (j = 0; j < arrComponents.size(); j++) {
-				LPCTSTR szCategory = arrComponents[j].GetCategory();
-				if (szCategory == NULL)
+		if (swKey == L"d") {
+			AddDuplicateNodes(workspace, arrDuplicates, &modelWanted);
+		} else if (swKey.substr(0, 2) == L"s:") {
+			for (j = 0; j < smartFolders->GetFoldersCount(); j++) {
+				if (swKey.compare(2, wstring::npos,
+						smartFolders->GetFolderName(j)) == 0) {
+					AddSmartFolderNodes(workspace, j, &modelWanted);
+				}
+			}
+		} else {
+			vector<ComponentHandle> arrHandles;
+			vector<Component*> arrMembers;
+			bool bUncategorized = (swKey == L"u");
+
+			// Keep the members that didn't change.
+			CollectHandles(*model, nRoot, &arrHandles);
+			for (j = 0; j < arrHandles.size(); j++) {
+				if (mapChanged.find(arrHandles[j]) != mapChanged.end())
 					continue;
 
-				// This component belongs inside this category.
-				if (arrCategories[i].Equals(szCategory)) {
-					LPCTSTR szSubCategory = arrComponents[j].GetSubCategory();
+				Component *component = workspace->GetComponentByHandle(
+					arrHandles[j]);
+				if (component != NULL)
+					arrMembers.push_back(component);
+			}
+
+			// Bring in the changed ones that belong here now.
+			for (j = 0; j < arrChanged.size(); j++) {
+				Component *component = workspace->GetComponentByHandle(
+					arrChanged[j]);
+				if (component == NULL)
+					continue;
 
-					if (szSubCategory == NULL)
-						treeView->AddItem(nodeCategory, arrComponents[j].ToString(),
-							NULL, ILI_CHIP, (LPARAM)j);
+				LPCTSTR szCategory = component->GetCategory();
+				if (bUncategorized ? (szCategory == NULL) :
+						((szCategory != NULL) &&
+						(swKey.compare(2, wstring::npos, szCategory) == 0))) {
+					arrMembers.push_back(component);
 				}
 			}
+
+			// Empty folders have to go away.
+			if (arrMembers.size() == 0)
+				return false;
+
+			sort(arrMembers.begin(), arrMembers.end(), CompareNames);
+			AddCategoryNodes(workspace, bUncategorized ? NULL :
+				swKey.c_str() + 2, arrMembers, &modelWanted);
 		}
+	}
+
+	diff->Patch(model, modelWanted);
+	return true;
+}
+
+/**
+ * Checks if a component comes before another in alphabetical order.
+ *
+ * @param  componentA First component.
+ * @param  componentB Second component.
+ * @return            TRUE if the first component comes first.
+ */
+bool UIManager::CompareNames(Component *componentA, Component *componentB) {
+	return _wcsicmp(componentA->GetName(), componentB->GetName()) < 0;
+}
 
-		// Expand the category node.
-		treeView->ExpandNode(nodeCategory);
+/**
+ * Checks if a folder comes before another in alphabetical order.
+ *
+ * @param  swA First folder name.
+ * @param  swB Second folder name.
+ * @return     TRUE if the first folder comes first.
+ */
+bool UIManager::CompareFolders(const wstring &swA, const wstring &swB) {
+	int iOrder = _wcsicmp(swA.c_str(), swB.c_str());
+
+	// Folders that only differ in case still need a stable order.
+	if (iOrder == 0)
+		return swA < swB;
+
+	return iOrder < 0;
+}
+
+/**
+ * Adds a component to a tree.
+ *
+ * @param workspace Workspace that the component belongs to.
+ * @param nParent   Folder node to add the component to.
+ * @param component Component to be added.
+ * @param model     Tree to be populated.
+ */
+void UIManager::AddComponentNode(Workspace *workspace, size_t nParent,
+								 Component *component, TreeModel *model) {
+	vector<Component> *arrComponents = workspace->GetEditableComponents();
+
+	model->AddNode(nParent, component->GetDirectory().ToString(),
+		component->ToString(), (long)workspace->GetComponentHandle(
+		(size_t)(component - &arrComponents->front())), ILI_CHIP, false);
+}
+
+/**
+ * Adds a category folder to a tree with its sub-category folders and
+ * components.
+ *
+ * @param workspace  Workspace that the components belong to.
+ * @param szCategory Category of the folder or NULL for the uncategorized one.
+ * @param arrMembers Components of the category in alphabetical order.
+ * @param model      Tree to be populated.
+ */
+void UIManager::AddCategoryNodes(Workspace *workspace, LPCTSTR szCategory,
+								 const vector<Component*> &arrMembers,
+								 TreeModel *model) {
+	FacetIndex *facets = workspace->GetFacets();
+	map<wstring, size_t> mapSubFolders;
+	vector<wstring> arrSubCategories;
+	size_t i, nFolder;
+
+	// Uncategorized components don't have sub-categories.
+	if (szCategory == NULL) {
+		nFolder = model->AddNode(TREE_NODE_NONE, L"u",
+			BuildFacetLabel(L"Uncategorized", facets->GetCategory(NULL)), -1,
+			ILI_FOLDER, true);
+
+		for (i = 0; i < arrMembers.size(); i++)
+			AddComponentNode(workspace, nFolder, arrMembers[i], model);
+
+		return;
+	}
+
+	// Add the category folder.
+	nFolder = model->AddNode(TREE_NODE_NONE, L"c:" + wstring(szCategory),
+		BuildFacetLabel(szCategory, facets->GetCategory(szCategory)), -1,
+		ILI_FOLDER, true);
+
+	// Add the sub-category folders in alphabetical order.
+	for (i = 0; i < arrMembers.size(); i++) {
+		LPCTSTR szSubCategory = arrMembers[i]->GetSubCategory();
+		if (szSubCategory != NULL)
+			mapSubFolders[szSubCategory] = TREE_NODE_NONE;
+	}
+	for (map<wstring, size_t>::iterator it = mapSubFolders.begin();
+			it != mapSubFolders.end(); it++) {
+		arrSubCategories.push_back(it->first);
+	}
+	sort(arrSubCategories.begin(), arrSubCategories.end(), CompareFolders);
+	for (i = 0; i < arrSubCategories.size(); i++) {
+		LPCTSTR szSubCategory = arrSubCategories[i].c_str();
+
+		mapSubFolders[arrSubCategories[i]] = model->AddNode(nFolder,
+			L"c:" + arrSubCategories[i], BuildFacetLabel(szSubCategory,
+			facets->GetSubCategory(szCategory, szSubCategory)), -1,
+			ILI_FOLDER, true);
+	}
+
+	// Populate the folders with their components.
+	for (i = 0; i < arrMembers.size(); i++) {
+		LPCTSTR szSubCategory = arrMembers[i]->GetSubCategory();
+
+		AddComponentNode(workspace, (szSubCategory == NULL) ? nFolder :
+			mapSubFolders[szSubCategory], arrMembers[i], model);
 	}
+}
 
-	// Add the uncategorized folder and its components.
-	if (bHasUncategorized) {
-		arrCategories.push_back(Category(L"Uncategorized"));
-		HTREEITEM nodeCategory = treeView->AddItem(NULL, L"Uncategorized",
-			NULL, ILI_FOLDER, (LPARAM)-1);
+/**
+ * Adds a smart folder to a tree with its members.
+ *
+ * @param workspace Workspace that the folder belongs to.
+ * @param nFolder   Index of the smart folder.
+ * @param model     Tree to be populated.
+ */
+void UIManager::AddSmartFolderNodes(Workspace *workspace, size_t nFolder,
+									TreeModel *model) {
+	SmartFolders *smartFolders = workspace->GetSmartFolders();
+	const map<wstring, size_t> &mapMembers = smartFolders->GetMembers(nFolder);
+	vector<Component*> arrMembers;
+	size_t i;
+
+	// Resolve the members from their paths.
+	arrMembers.reserve(mapMembers.size());
+	for (map<wstring, size_t>::const_iterator it = mapMembers.begin();
+			it != mapMembers.end(); it++) {
+		Component *component = workspace->GetComponentByHandle(
+			workspace->FindComponent(it->first.c_str()));
+		if (component != NULL)
+			arrMembers.push_back(component);
+	}
+	sort(arrMembers.begin(), arrMembers.end(), CompareNames);
+
+	// Add the folder and its members.
+	size_t nNode = model->AddNode(TREE_NODE_NONE,
+		L"s:" + wstring(smartFolders->GetFolderName(nFolder)),
+		BuildFacetLabel(smartFolders->GetFolderName(nFolder),
+		smartFolders->GetFolderTotals(nFolder)), -1, ILI_FOLDER, false);
+	for (i = 0; i < arrMembers.size(); i++)
+		AddComponentNode(workspace, nNode, arrMembers[i], model);
+}
 
-		// Go through components searching for uncategorized ones.
-		for (j = 0; j < arrComponents.size(); j++) {
-			LPCTSTR szCategory = arrComponents[j].GetCategory();
-			if (szCategory == NULL)
-				treeView->AddItem(nodeCategory, arrComponents[j].ToString(),
-					NULL, ILI_CHIP, (LPARAM)j);
+/**
+ * Adds the folder of the components that are closest to running out to a
+ * tree. Nothing is added if none of them is running low.
+ *
+ * @param workspace Workspace that the components belong to.
+ * @param model     Tree to be populated.
+ */
+void UIManager::AddReorderNodes(Workspace *workspace, TreeModel *model) {
+	vector<ReorderEntry> arrReorder = workspace->GetReorderQueue()->
+		GetClosestToRunningOut(REORDER_QUEUE_LENGTH);
+	if (arrReorder.size() == 0)
+		return;
+
+	size_t nFolder = model->AddNode(TREE_NODE_NONE, L"r", L"Reorder Queue", -1,
+		ILI_FOLDER, false);
+	for (size_t i = 0; i < arrReorder.size(); i++) {
+		ComponentHandle hComponent = workspace->FindComponent(
+			arrReorder[i].swPath.c_str());
+		if (hComponent != COMPONENT_HANDLE_NONE) {
+			model->AddNode(nFolder, arrReorder[i].swPath, arrReorder[i].swName,
+				(long)hComponent, ILI_CHIP, false);
 		}
+	}
+}
+
+/**
+ * Adds the groups of duplicates that were found to a tree.
+ *
+ * @param workspace     Workspace that the components belong to.
+ * @param arrDuplicates Groups of duplicates to be listed.
+ * @param model         Tree to be populated.
+ */
+void UIManager::AddDuplicateNodes(Workspace *workspace,
+								  const vector<DuplicateFolder> &arrDuplicates,
+								  TreeModel *model) {
+	WCHAR szNumber[33];
+	size_t nExact = 0;
+	size_t nSimilar = 0;
+	size_t i, j;
 
-		// Expand the node.
-		treeView->ExpandNode(nodeCategory);
+	if (arrDuplicates.size() == 0)
+		return;
+
+	size_t nFolder = model->AddNode(TREE_NODE_NONE, L"d", L"Duplicates", -1,
+		ILI_FOLDER, true);
+	for (i = 0; i < arrDuplicates.size(); i++) {
+		wstring swLabel;
+
+		// Build the group label.
+		if (arrDuplicates[i].bExact) {
+			swLabel = L"Exact Match ";
+			_ltow(++nExact, szNumber, 10);
+		} else {
+			swLabel = L"Similar ";
+			_ltow(++nSimilar, szNumber, 10);
+		}
+		swLabel += szNumber;
+
+		// Add the group and the components that still exist.
+		size_t nGroup = model->AddNode(nFolder, L"d:" + swLabel, swLabel, -1,
+			ILI_FOLDER, true);
+		for (j = 0; j < arrDuplicates[i].arrHandles.size(); j++) {
+			Component *component = workspace->GetComponentByHandle(
+				arrDuplicates[i].arrHandles[j]);
+			if (component != NULL) {
+				model->AddNode(nGroup, component->GetDirectory().ToString(),
+					component->ToString(), (long)arrDuplicates[i].
+					arrHandles[j], ILI_CHIP, false);
+			}
+		}
 	}
 }
 
+/**
+ * Gets the handles of every component under a node of a tree.
+ *
+ * @param model      Tree to look into.
+ * @param nNode      Node to start from.
+ * @param arrHandles Where the handles will be appended to.
+ */
+void UIManager::CollectHandles(const TreeModel &model, size_t nNode,
+							   vector<ComponentHandle> *arrHandles) {
+	const vector<size_t> &arrChildren = model.GetChildren(nNode);
+
+	for (size_t i = 0; i < arrChildren.size(); i++) {
+		const TreeNode &node = model.GetNode(arrChildren[i]);
+
+		if (node.iImage == ILI_CHIP) {
+			arrHandles->push_back((ComponentHandle)node.lParam);
+		} else {
+			CollectHandles(model, arrChildren[i], arrHandles);
+		}
+	}
+}
+
+/**
+ * Builds the label of a folder node in the TreeView with its part and stock
+ * counts.
+ *
+ * @param  szName Folder name.
+ * @param  count  Part and stock counts for the folder.
+ * @return        Label in the "Name (parts / stock)" format.
+ */
+wstring UIManager::BuildFacetLabel(LPCTSTR szName, FacetCount count) {
+	WCHAR szNumber[33];
+	wstring swLabel(szName);
+
+	swLabel += L" (";
+	_ltow(count.nParts, szNumber, 10);
+	swLabel += szNumber;
+	swLabel += L" / ";
+	_ltow(count.nStock, szNumber, 10);
+	swLabel += szNumber;
+	swLabel += L")";
+
+	return swLabel;
+}
+
 /**
  * Shows the classic loading/waiting hourglass.
  */
@@ -856,7 +2342,8 @@ bool UIManager::GetEditText(HWND hwndControl, LPTSTR *szBuffer) {
 
 	// Get the string length and allocate it.
 	nLength = GetWindowTextLength(hwndControl) + 1;
-	*szBuffer = (LPTSTR)LocalAlloc(LMEM_FIXED, nLength * sizeof(WCHAR));
+	*szBuffer = (LPTSTR)AllocProfiler::Alloc(LMEM_FIXED,
+		nLength * sizeof(WCHAR), L"UIManager::GetEditText");
 
 	// Get the string from the control and return.
 	return GetWindowText(hwndControl, *szBuffer, nLength) != 0;
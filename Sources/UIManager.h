@@ -10,15 +10,26 @@
 #define _UI_MANAGER_H
 
 #include <windows.h>
+#include <map>
 #include "Settings.h"
 #include "TreeView.h"
 #include "Directory.h"
 #include "Workspace.h"
+#include "BitmapCache.h"
+#include "ImageLoader.h"
+#include "DetailLoader.h"
+#include "MemoryReport.h"
 
 // Define the Image List image indexes.
 #define ILI_FOLDER 0
 #define ILI_CHIP   1
 
+// A group of duplicate components shown in the TreeView.
+typedef struct {
+	bool bExact;
+	vector<ComponentHandle> arrHandles;
+} DuplicateFolder;
+
 class UIManager {
 protected:
 	HINSTANCE *hInst;
@@ -26,19 +37,67 @@ protected:
 	HWND *hwndDetail;
 	HIMAGELIST *hIml;
 	HBITMAP hbmpComponent;
+	wstring swComponentImage;
+	wstring swPendingImage;
+	BitmapCache bitmaps;
+	ImageLoader *imageLoader;
+	HTREEITEM hSelItem;
+	TreeModel treeModel;
+	TreeMaterializer treeMaterializer;
+	vector<HTREEITEM> arrTreeItems;
+	vector<DuplicateFolder> arrDuplicates;
+	bool bUpdatingTree;
+	DetailLoader *detailLoader;
 	DLGPROC lpDetailProc;
 	Settings *settings;
 	Workspace *workspace;
 	TreeView *treeView;
-	long iSelComponent;
+	ComponentHandle hSelComponent;
 	bool bDirty;
+	bool bNotesLoaded;
+	bool bPropertiesLoaded;
+
+	// TreeView.
+	static wstring BuildFacetLabel(LPCTSTR szName, FacetCount count);
+	static void BuildTreeModel(Workspace *workspace,
+							   const vector<DuplicateFolder> &arrDuplicates,
+							   TreeModel *model);
+	static bool PatchTreeModel(Workspace *workspace,
+							   const vector<DuplicateFolder> &arrDuplicates,
+							   const vector<ComponentHandle> &arrChanged,
+							   TreeModel *model, TreeDiff *diff);
+	static bool CompareNames(Component *componentA, Component *componentB);
+	static bool CompareFolders(const wstring &swA, const wstring &swB);
+	static void AddComponentNode(Workspace *workspace, size_t nParent,
+								 Component *component, TreeModel *model);
+	static void AddCategoryNodes(Workspace *workspace, LPCTSTR szCategory,
+								 const vector<Component*> &arrMembers,
+								 TreeModel *model);
+	static void AddSmartFolderNodes(Workspace *workspace, size_t nFolder,
+									TreeModel *model);
+	static void AddReorderNodes(Workspace *workspace, TreeModel *model);
+	static void AddDuplicateNodes(Workspace *workspace,
+								  const vector<DuplicateFolder> &arrDuplicates,
+								  TreeModel *model);
+	static void CollectHandles(const TreeModel &model, size_t nNode,
+							   vector<ComponentHandle> *arrHandles);
+	void ApplyTreeDiff(const TreeModel &model, const TreeDiff &diff);
+	void ReclaimTreeView();
+	void ForgetTreeItems(size_t nNode);
+	size_t FindTreeNode(HTREEITEM hItem);
+
+	// Image.
+	void ShowImage(LPCTSTR szPath, HBITMAP hBitmap);
+	vector<wstring> GetNeighbourImages();
+	void AddNeighbourImage(HTREEITEM hItem, vector<wstring> *arrPaths);
 
 public:
 	// Constructors and destructors.
 	UIManager();
 	UIManager(HINSTANCE *hInst, HWND *hwndMain, Settings *settings,
 			  Workspace *workspace, TreeView *treeView, HIMAGELIST *hIml,
-			  HWND *hwndDetail, DLGPROC lpDetailProc);
+			  HWND *hwndDetail, DLGPROC lpDetailProc, ImageLoader *imageLoader,
+			  DetailLoader *detailLoader);
 
 	// Loading dialog.
 	static void ShowLoading();
@@ -66,16 +125,34 @@ public:
 
 	// Detail view.
 	void ClearDetailView(bool bClose);
-	void PopulateDetailView(size_t nIndex);
+	void PopulateDetailView(ComponentHandle hComponent);
+	LRESULT DetailReady(DetailModel *model);
+	LRESULT ShowSelectionLatency();
+	LRESULT RunBenchmark();
+	LRESULT ToggleTracing();
+	LRESULT SaveTrace();
+	LRESULT ShowIoStatistics();
+	LRESULT ShowMemoryUsage();
 
 	// TreeView.
 	void PopulateTreeView();
 	LRESULT TreeViewSelectionChanged(HWND hWnd, UINT wMsg, WPARAM wParam,
 									 LPARAM lParam);
+	LRESULT TreeViewItemExpanding(HWND hWnd, UINT wMsg, WPARAM wParam,
+								  LPARAM lParam);
+	LRESULT TreeViewItemExpanded(HWND hWnd, UINT wMsg, WPARAM wParam,
+								 LPARAM lParam);
+	void UpdateTreeView();
+	void UpdateTreeView(const vector<ComponentHandle> &arrChanged);
+	void ClearTreeView();
 
 	// Image.
 	void ClearImage();
+	void CheckMemoryLoad();
+	void ReleaseMemory();
+	void AccountMemory(MemoryReport *report);
 	void SetComponentImage(Component *component);
+	LRESULT ImageLoaded(LoadedImage *image);
 
 	// Properties.
 	void PopulatePropertiesList(Component *component);
@@ -85,9 +162,16 @@ public:
 
 	// Workspace operations.
 	LRESULT CreateWorkspace();
+	LRESULT CreateSmartFolder();
 	LRESULT OpenWorkspace(bool bRefresh);
 	LRESULT RefreshWorkspace();
 	LRESULT CloseWorkspace();
+	LRESULT ExportReorderList();
+	LRESULT FindDuplicates();
+	LRESULT ImportBom();
+	LRESULT ShowTopConsumers();
+	LRESULT RebuildThumbnails();
+	LRESULT DeduplicateAssets();
 };
 
 #endif  // _UI_MANAGER_H
\ No newline at end of file
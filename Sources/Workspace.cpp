@@ -6,13 +6,23 @@
  * @author Nathan Campos <nathan@innoveworkshop.com>
  */
 
+#include <map>
 #include "Workspace.h"
 #include "FileUtils.h"
+#include "Tracer.h"
+#include "AllocProfiler.h"
+#include "FileLock.h"
+
+// Quantity journal.
+#define JOURNAL_LOCK_EXTENSION L".lock"
+#define JOURNAL_LOCK_TIMEOUT   10000
+#define JOURNAL_BATCH_END      L"."
 
 /**
  * Initializes an empty PartCat workspace.
  */
 Workspace::Workspace() {
+	dwLastBatch = QUANTITY_BATCH_NONE;
 	bOpened = false;
 }
 
@@ -22,6 +32,7 @@ Workspace::Workspace() {
  * @param pathWorkspace A PartCat workspace file.
  */
 Workspace::Workspace(Path pathWorkspace) {
+	dwLastBatch = QUANTITY_BATCH_NONE;
 	Open(pathWorkspace);
 }
 
@@ -31,6 +42,7 @@ Workspace::Workspace(Path pathWorkspace) {
  * @param dirWorkspace A PartCat workspace directory.
  */
 Workspace::Workspace(Directory dirWorkspace) {
+	dwLastBatch = QUANTITY_BATCH_NONE;
 	Open(dirWorkspace.Concatenate(WORKSPACE_FILE));
 }
 
@@ -79,7 +91,7 @@ bool Workspace::Save() {
 		swProperties += szBuffer;
 		swProperties += L"\r\n";
 
-		LocalFree(szBuffer);
+		AllocProfiler::Free(szBuffer);
 	}
 
 	return FileUtils::SaveContents(dirWorkspace.Concatenate(WORKSPACE_FILE).ToString(),
@@ -90,6 +102,7 @@ bool Workspace::Save() {
  * Populates the properties from the workspace file.
  */
 void Workspace::PopulateProperties() {
+	TraceSpan span(L"Workspace::PopulateProperties");
 	HANDLE hFile;
 	wstring swLine;
 
@@ -97,9 +110,8 @@ void Workspace::PopulateProperties() {
 	arrProperties.clear();
 
 	// Open the MANIFEST file for reading.
-	hFile = CreateFile(dirWorkspace.Concatenate(WORKSPACE_FILE).ToString(),
-		GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
-		NULL);
+	hFile = FileUtils::Open(dirWorkspace.Concatenate(WORKSPACE_FILE).ToString(),
+		GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING);
 
 	// Go through the file line by line.
 	while (FileUtils::ReadLine(hFile, &swLine)) {
@@ -108,6 +120,9 @@ void Workspace::PopulateProperties() {
 
 	// Close the file handle.
 	CloseHandle(hFile);
+
+	// Load the smart folder definitions.
+	smartFolders.LoadQueries(arrProperties);
 }
 
 /**
@@ -202,6 +217,207 @@ vector<Component> Workspace::GetComponents() {
 	return arrComponents;
 }
 
+/**
+ * Gets an editable version of the components array.
+ *
+ * @return Pointer to the array of components.
+ */
+vector<Component>* Workspace::GetEditableComponents() {
+	return &arrComponents;
+}
+
+/**
+ * Loads a single component from disk and adds it to the workspace without
+ * having to reload every other one.
+ *
+ * @param  dirComponent Path to the component folder.
+ * @param  hComponent   Handle of the new component.
+ * @return              TRUE if the component was added.
+ */
+bool Workspace::AddComponent(Directory dirComponent,
+							 ComponentHandle *hComponent) {
+	if (!dirComponent.Exists())
+		return false;
+
+	arrComponents.push_back(Component(dirComponent));
+	arrHandles.push_back(AllocateHandle(arrComponents.size() - 1));
+	*hComponent = arrHandles.back();
+	IndexPath(&arrComponents.back());
+	NotifyComponentAdded(&arrComponents.back());
+
+	return true;
+}
+
+/**
+ * Removes a single component from the workspace.
+ * @remark The last component takes the place of the removed one, so indexes
+ *         aren't stable across removals. Handles are.
+ *
+ * @param  hComponent Handle of the component.
+ * @return            TRUE if the component was removed.
+ */
+bool Workspace::RemoveComponent(ComponentHandle hComponent) {
+	long lIndex = GetComponentIndex(hComponent);
+	if (lIndex < 0)
+		return false;
+
+	// Move the last component into its place.
+	size_t nIndex = (size_t)lIndex;
+	size_t nLast = arrComponents.size() - 1;
+	NotifyComponentRemoved(&arrComponents[nIndex]);
+	mapPaths.erase(wstring(arrComponents[nIndex].GetDirectory().ToString()));
+	if (nIndex != nLast) {
+		arrComponents[nIndex] = arrComponents[nLast];
+		arrHandles[nIndex] = arrHandles[nLast];
+		arrSlots[arrHandles[nIndex] & COMPONENT_SLOT_MASK].nIndex = nIndex;
+	}
+	arrComponents.pop_back();
+	arrHandles.pop_back();
+
+	// Free its slot.
+	size_t nSlot = hComponent & COMPONENT_SLOT_MASK;
+	arrSlots[nSlot].bUsed = false;
+	arrFreeSlots.push_back(nSlot);
+
+	return true;
+}
+
+/**
+ * Gets the handle of a component.
+ *
+ * @param  nIndex Index of the component in the array.
+ * @return        Component handle or COMPONENT_HANDLE_NONE if the index is
+ *                invalid.
+ */
+ComponentHandle Workspace::GetComponentHandle(size_t nIndex) {
+	if (nIndex >= arrHandles.size())
+		return COMPONENT_HANDLE_NONE;
+
+	return arrHandles[nIndex];
+}
+
+/**
+ * Gets a component using its handle.
+ *
+ * @param  hComponent Component handle.
+ * @return            Component or NULL if the handle is no longer valid.
+ */
+Component* Workspace::GetComponentByHandle(ComponentHandle hComponent) {
+	long lIndex = GetComponentIndex(hComponent);
+	if (lIndex < 0)
+		return NULL;
+
+	return &arrComponents[lIndex];
+}
+
+/**
+ * Gets the current index of a component in the array using its handle.
+ *
+ * @param  hComponent Component handle.
+ * @return            Component index or -1 if the handle is no longer valid.
+ */
+long Workspace::GetComponentIndex(ComponentHandle hComponent) {
+	size_t nSlot = hComponent & COMPONENT_SLOT_MASK;
+
+	if ((hComponent == COMPONENT_HANDLE_NONE) || (nSlot >= arrSlots.size()))
+		return -1;
+
+	ComponentSlot *slot = &arrSlots[nSlot];
+	if (!slot->bUsed ||
+			(slot->dwGeneration != (hComponent >> COMPONENT_SLOT_BITS)))
+		return -1;
+
+	return (long)slot->nIndex;
+}
+
+/**
+ * Finds a component by the path of its folder.
+ *
+ * @param  szPath Path to the component folder.
+ * @return        Component handle or COMPONENT_HANDLE_NONE if there's no
+ *                component in that folder.
+ */
+ComponentHandle Workspace::FindComponent(LPCTSTR szPath) {
+	map<wstring, ComponentHandle>::iterator it;
+
+	it = mapPaths.find(wstring(szPath));
+	if (it == mapPaths.end())
+		return COMPONENT_HANDLE_NONE;
+
+	// Make sure the component didn't move somewhere else in the meantime.
+	Component *component = GetComponentByHandle(it->second);
+	if ((component == NULL) ||
+			(wcscmp(component->GetDirectory().ToString(), szPath) != 0))
+		return COMPONENT_HANDLE_NONE;
+
+	return it->second;
+}
+
+/**
+ * Remembers the folder of a component, so that it can be found by its path.
+ *
+ * @param component Component from the array. Anything else is ignored.
+ */
+void Workspace::IndexPath(Component *component) {
+	if (arrComponents.empty())
+		return;
+
+	size_t nIndex = component - &arrComponents.front();
+	if (nIndex < arrHandles.size())
+		mapPaths[wstring(component->GetDirectory().ToString())] = arrHandles[nIndex];
+}
+
+/**
+ * Gives a component a new handle, reusing a free slot if possible.
+ *
+ * @param  nIndex Index of the component in the array.
+ * @return        New component handle.
+ */
+ComponentHandle Workspace::AllocateHandle(size_t nIndex) {
+	size_t nSlot;
+
+	// Get a slot.
+	if (arrFreeSlots.empty()) {
+		ComponentSlot slot;
+		slot.dwGeneration = 0;
+
+		nSlot = arrSlots.size();
+		if (nSlot > COMPONENT_SLOT_MASK)
+			return COMPONENT_HANDLE_NONE;
+		arrSlots.push_back(slot);
+	} else {
+		nSlot = arrFreeSlots.back();
+		arrFreeSlots.pop_back();
+	}
+
+	// A new generation makes the old handles of the slot invalid.
+	ComponentSlot *slot = &arrSlots[nSlot];
+	if (slot->dwGeneration >= COMPONENT_GENERATION_MAX) {
+		slot->dwGeneration = 1;
+	} else {
+		slot->dwGeneration++;
+	}
+	slot->nIndex = nIndex;
+	slot->bUsed = true;
+
+	return (ComponentHandle)((slot->dwGeneration << COMPONENT_SLOT_BITS) | nSlot);
+}
+
+/**
+ * Releases the handles of every component. The slots keep their generations
+ * so handles from before are never mistaken for new ones.
+ */
+void Workspace::ReleaseHandles() {
+	arrHandles.clear();
+	arrFreeSlots.clear();
+	arrFreeSlots.reserve(arrSlots.size());
+
+	for (size_t i = arrSlots.size(); i > 0; i--) {
+		arrSlots[i - 1].bUsed = false;
+		arrFreeSlots.push_back(i - 1);
+	}
+}
+
 /**
  * Populates the components array.
  */
@@ -211,14 +427,508 @@ void Workspace::PopulateComponents() {
 
 	// Clear the components array.
 	arrComponents.clear();
+	mapPaths.clear();
+	ReleaseHandles();
+	NotifyComponentsCleared();
 
 	// Populate components array.
+	arrComponents.reserve(subDirs.size());
+	arrHandles.reserve(subDirs.size());
 	for (size_t i = 0; i < subDirs.size(); i++) {
 		Directory dir = subDirs[i];
 		arrComponents.push_back(Component(dir));
+		arrHandles.push_back(AllocateHandle(i));
+		IndexPath(&arrComponents.back());
+		NotifyComponentAdded(&arrComponents.back());
+	}
+}
+
+/**
+ * Notifies everyone that a component was added to the workspace.
+ *
+ * @param component Component that was added.
+ */
+void Workspace::NotifyComponentAdded(Component *component) {
+	facets.ComponentAdded(component);
+	smartFolders.ComponentAdded(component);
+	reorderQueue.ComponentAdded(component);
+	history.ComponentAdded(component);
+	images.ComponentAdded(component);
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentAdded(component);
+}
+
+/**
+ * Notifies everyone that a component has been changed and saved.
+ *
+ * @param component Component that was changed.
+ */
+void Workspace::NotifyComponentChanged(Component *component) {
+	facets.ComponentChanged(component);
+	smartFolders.ComponentChanged(component);
+	reorderQueue.ComponentChanged(component);
+	history.ComponentChanged(component);
+	images.ComponentChanged(component);
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentChanged(component);
+}
+
+/**
+ * Notifies everyone that a batch of components has been changed and saved.
+ *
+ * @param arrComponents Components that were changed.
+ */
+void Workspace::NotifyComponentsChanged(vector<Component*> arrComponents) {
+	facets.ComponentsChanged(arrComponents);
+	smartFolders.ComponentsChanged(arrComponents);
+	reorderQueue.ComponentsChanged(arrComponents);
+	history.ComponentsChanged(arrComponents);
+	images.ComponentsChanged(arrComponents);
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentsChanged(arrComponents);
+}
+
+/**
+ * Notifies everyone that a component is about to be removed from the
+ * workspace.
+ *
+ * @param component Component that will be removed.
+ */
+void Workspace::NotifyComponentRemoved(Component *component) {
+	facets.ComponentRemoved(component);
+	smartFolders.ComponentRemoved(component);
+	reorderQueue.ComponentRemoved(component);
+	history.ComponentRemoved(component);
+	images.ComponentRemoved(component);
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentRemoved(component);
+}
+
+/**
+ * Notifies everyone that a component was renamed, which moved its folder.
+ *
+ * @param component Component that was renamed.
+ * @param dirOld    Folder of the component before it was renamed.
+ */
+void Workspace::NotifyComponentRenamed(Component *component, Directory dirOld) {
+	mapPaths.erase(wstring(dirOld.ToString()));
+	IndexPath(component);
+
+	facets.ComponentRenamed(component, dirOld);
+	smartFolders.ComponentRenamed(component, dirOld);
+	reorderQueue.ComponentRenamed(component, dirOld);
+	history.ComponentRenamed(component, dirOld);
+	images.ComponentRenamed(component, dirOld);
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentRenamed(component, dirOld);
+}
+
+/**
+ * Notifies everyone that a component was saved as a new one, which moved it
+ * to another folder while the original stays behind in the old one.
+ * @remark As far as everyone is concerned the original was removed and a new
+ *         component was added. The original has to be added back afterwards.
+ *
+ * @param component         Component that was saved as a new one.
+ * @param componentOriginal Copy of the component from before it was saved.
+ */
+void Workspace::NotifyComponentSavedAs(Component *component,
+									   Component *componentOriginal) {
+	mapPaths.erase(wstring(componentOriginal->GetDirectory().ToString()));
+	NotifyComponentRemoved(componentOriginal);
+
+	IndexPath(component);
+	NotifyComponentAdded(component);
+}
+
+/**
+ * Notifies everyone that all the components have been dropped.
+ */
+void Workspace::NotifyComponentsCleared() {
+	facets.ComponentsCleared();
+	smartFolders.ComponentsCleared();
+	reorderQueue.ComponentsCleared();
+	history.ComponentsCleared();
+	images.ComponentsCleared();
+
+	for (size_t i = 0; i < arrListeners.size(); i++)
+		arrListeners[i]->ComponentsCleared();
+}
+
+/**
+ * Notifies the image map that an image was added to the workspace.
+ *
+ * @param szName Name of the image without its extension.
+ */
+void Workspace::NotifyImageAdded(LPCTSTR szName) {
+	images.ImageAdded(szName);
+}
+
+/**
+ * Notifies the image map that an image was removed from the workspace.
+ *
+ * @param szName Name of the image without its extension.
+ */
+void Workspace::NotifyImageRemoved(LPCTSTR szName) {
+	images.ImageRemoved(szName);
+}
+
+/**
+ * Lists the images folder again and sends the image events for whatever was
+ * added or removed outside of the application, so that only the components
+ * that use those images have to be resolved again.
+ */
+void Workspace::RescanImages() {
+	vector<wstring> arrAdded;
+	vector<wstring> arrRemoved;
+	size_t i;
+
+	images.Rescan(&arrAdded, &arrRemoved);
+	for (i = 0; i < arrRemoved.size(); i++)
+		NotifyImageRemoved(arrRemoved[i].c_str());
+	for (i = 0; i < arrAdded.size(); i++)
+		NotifyImageAdded(arrAdded[i].c_str());
+}
+
+/**
+ * Registers a listener to be notified of changes to the components.
+ *
+ * @param listener Listener to be registered.
+ */
+void Workspace::AddListener(WorkspaceListener *listener) {
+	arrListeners.push_back(listener);
+}
+
+/**
+ * Unregisters a listener.
+ *
+ * @param listener Listener to be removed.
+ */
+void Workspace::RemoveListener(WorkspaceListener *listener) {
+	for (size_t i = 0; i < arrListeners.size(); i++) {
+		if (arrListeners[i] == listener) {
+			arrListeners.erase(arrListeners.begin() + i);
+			return;
+		}
 	}
 }
 
+/**
+ * Gets the queue of components ordered by how close they are to running out.
+ *
+ * @return Reorder queue of the workspace.
+ */
+ReorderQueue* Workspace::GetReorderQueue() {
+	return &reorderQueue;
+}
+
+/**
+ * Gets the history of quantity changes of the workspace.
+ *
+ * @return Quantity history of the workspace.
+ */
+QuantityHistory* Workspace::GetQuantityHistory() {
+	return &history;
+}
+
+/**
+ * Gets the map used to resolve the images of the components.
+ *
+ * @return Image map of the workspace.
+ */
+ImageMap* Workspace::GetImages() {
+	return &images;
+}
+
+/**
+ * Gets the store that holds the deduplicated datasheets and images.
+ *
+ * @return Asset store of the workspace.
+ */
+AssetStore* Workspace::GetAssets() {
+	return &assets;
+}
+
+/**
+ * Adds a smart folder to the workspace and saves it to the workspace file.
+ *
+ * @param  szName       Name of the smart folder.
+ * @param  szExpression Query expression that defines the folder contents.
+ * @return              TRUE if the query was valid, its name wasn't taken and the
+ *                      workspace was saved.
+ */
+bool Workspace::AddSmartFolder(LPCTSTR szName, LPCTSTR szExpression) {
+	Property prop;
+	wstring swDefinition(szName);
+
+	// Build the definition and check if it's valid.
+	swDefinition += L"; ";
+	swDefinition += szExpression;
+	SmartQuery query(swDefinition.c_str());
+	if (!query.IsValid() || smartFolders.HasFolder(query.GetName()))
+		return false;
+
+	// Populate the folder and store its definition.
+	smartFolders.AddQuery(query, &arrComponents);
+	prop.SetName(PROPERTY_SMART_FOLDER);
+	prop.SetValue(swDefinition.c_str());
+	AddProperty(prop);
+
+	return Save();
+}
+
+/**
+ * Gets the smart folders of the workspace.
+ *
+ * @return Smart folders of the workspace.
+ */
+SmartFolders* Workspace::GetSmartFolders() {
+	return &smartFolders;
+}
+
+/**
+ * Gets the part and stock counts of the workspace.
+ *
+ * @return Facet index of the workspace.
+ */
+FacetIndex* Workspace::GetFacets() {
+	return &facets;
+}
+
+/**
+ * Applies a batch of quantity changes as a single operation. The changes are
+ * appended to a journal before anything is touched, so that whatever couldn't
+ * be saved is finished the next time the workspace is opened.
+ * @remark Batches still pending in the journal are finished first, so that
+ *         every component gets its batches in order. Nothing new is applied
+ *         while one of them can't be finished.
+ * @remark Components that couldn't be saved keep their old quantity in memory
+ *         until the journal is replayed.
+ *
+ * @param  arrDeltas Quantity changes. A component may appear more than once.
+ * @return           TRUE if every change was saved.
+ */
+bool Workspace::ApplyQuantityDeltas(vector<QuantityDelta> arrDeltas) {
+	Path pathJournal = dirWorkspace.Concatenate(QUANTITY_JOURNAL_FILE);
+	map<ComponentHandle, long> mapTotals;
+	map<ComponentHandle, long>::iterator it;
+	vector<Component*> arrChanged;
+	vector<wstring> arrReplayed;
+	bool bSuccess = true;
+	size_t i;
+
+	// Add up the changes for each component.
+	for (i = 0; i < arrDeltas.size(); i++) {
+		if (GetComponentByHandle(arrDeltas[i].hComponent) == NULL)
+			return false;
+
+		mapTotals[arrDeltas[i].hComponent] += arrDeltas[i].lDelta;
+	}
+
+	// Keep other instances out of the journal until we are done with it.
+	FileLock lock(Path((wstring(pathJournal.ToString()) +
+		JOURNAL_LOCK_EXTENSION).c_str()));
+	if (!lock.Acquire(JOURNAL_LOCK_TIMEOUT))
+		return false;
+
+	// Finish what was left behind before applying anything on top of it.
+	bSuccess = ReplayQuantityJournal(&arrReplayed);
+	for (i = 0; i < arrReplayed.size(); i++) {
+		Component *component = GetComponentByHandle(
+			FindComponent(arrReplayed[i].c_str()));
+		if (component == NULL)
+			continue;
+
+		*component = Component(component->GetDirectory());
+		arrChanged.push_back(component);
+	}
+	if (!bSuccess) {
+		NotifyComponentsChanged(arrChanged);
+		return false;
+	}
+
+	// Make sure the whole batch is valid before touching anything.
+	for (it = mapTotals.begin(); it != mapTotals.end(); it++) {
+		Component *component = GetComponentByHandle(it->first);
+		if (((long)component->GetQuantity() + it->second) < 0) {
+			NotifyComponentsChanged(arrChanged);
+			return false;
+		}
+	}
+
+	// Persist the changes with a single write to the end of the journal.
+	DWORD dwBatch = NextQuantityBatch();
+	if (!WriteQuantityJournal(dwBatch, mapTotals)) {
+		NotifyComponentsChanged(arrChanged);
+		return false;
+	}
+
+	// Save each component, merging with changes made by other writers.
+	for (it = mapTotals.begin(); it != mapTotals.end(); it++) {
+		Component *component = GetComponentByHandle(it->first);
+		size_t nPrevious = component->GetQuantity();
+
+		component->SetQuantity((size_t)((long)nPrevious + it->second));
+		if (component->SaveQuantity(dwBatch)) {
+			arrChanged.push_back(component);
+		} else {
+			component->SetQuantity(nPrevious);
+			bSuccess = false;
+		}
+	}
+
+	// The journal is only needed if something is still missing.
+	if (bSuccess)
+		FileUtils::Delete(pathJournal.ToString());
+
+	NotifyComponentsChanged(arrChanged);
+	return bSuccess;
+}
+
+/**
+ * Gets a new identifier for a batch of quantity changes.
+ *
+ * @return Batch identifier that is always larger than the previous one.
+ */
+DWORD Workspace::NextQuantityBatch() {
+	DWORD dwBatch = QuantityHistory::Now();
+
+	if (dwBatch <= dwLastBatch)
+		dwBatch = dwLastBatch + 1;
+	dwLastBatch = dwBatch;
+
+	return dwBatch;
+}
+
+/**
+ * Appends a batch of quantity changes to the quantity journal. The first line
+ * identifies the batch, every other line has a component path and its
+ * quantity change, and a last line marks the batch as complete.
+ *
+ * @param  dwBatch   Batch identifier.
+ * @param  mapTotals Quantity change of each component.
+ * @return           TRUE if the operation was successful.
+ */
+bool Workspace::WriteQuantityJournal(DWORD dwBatch,
+									 const map<ComponentHandle, long> &mapTotals) {
+	map<ComponentHandle, long>::const_iterator it;
+	WCHAR szNumber[33];
+	wstring swJournal;
+
+	_ultow(dwBatch, szNumber, 10);
+	swJournal = szNumber;
+	swJournal += L"\r\n";
+
+	for (it = mapTotals.begin(); it != mapTotals.end(); it++) {
+		_ltow(it->second, szNumber, 10);
+
+		swJournal += GetComponentByHandle(it->first)->GetDirectory().ToString();
+		swJournal += L'\t';
+		swJournal += szNumber;
+		swJournal += L"\r\n";
+	}
+	swJournal += JOURNAL_BATCH_END;
+	swJournal += L"\r\n";
+
+	return FileUtils::AppendContents(
+		dirWorkspace.Concatenate(QUANTITY_JOURNAL_FILE).ToString(),
+		swJournal.c_str());
+}
+
+/**
+ * Finishes the batches of quantity changes that were interrupted, applying
+ * the changes that didn't make it to disk on top of the quantities there and
+ * recording them in the history. The journal is removed afterwards.
+ * @remark Batches that aren't complete in the journal were interrupted before
+ *         any component was touched, so they are skipped.
+ * @remark We stop at the first batch that can't be finished, since the ones
+ *         after it may change the same components.
+ *
+ * @param  arrApplied Optional list where the paths of the components that
+ *                    were changed now are placed.
+ * @return            TRUE if the operation was successful or there was no
+ *                    journal.
+ */
+bool Workspace::ReplayQuantityJournal(vector<wstring> *arrApplied) {
+	TraceSpan span(L"Workspace::ReplayQuantityJournal");
+	Path pathJournal = dirWorkspace.Concatenate(QUANTITY_JOURNAL_FILE);
+	vector<HistoryPending> arrDeltas;
+	vector<wstring> arrLines;
+	HANDLE hFile;
+	wstring swLine;
+	DWORD dwBatch = QUANTITY_BATCH_NONE;
+	bool bSuccess = true;
+	size_t i;
+
+	// Check if we have anything to replay.
+	if (!pathJournal.Exists())
+		return true;
+
+	// Open the journal for reading.
+	hFile = FileUtils::Open(pathJournal.ToString(), GENERIC_READ,
+		FILE_SHARE_READ, OPEN_EXISTING);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	while (bSuccess && FileUtils::ReadLine(hFile, &swLine)) {
+		// Remember the changes until we know the batch is complete.
+		if (swLine != JOURNAL_BATCH_END) {
+			if (swLine.find(L'\t') != wstring::npos) {
+				if (dwBatch != QUANTITY_BATCH_NONE)
+					arrLines.push_back(swLine);
+			} else {
+				dwBatch = (DWORD)_wtol(swLine.c_str());
+				if (dwBatch > dwLastBatch)
+					dwLastBatch = dwBatch;
+				arrLines.clear();
+			}
+
+			continue;
+		}
+
+		// Apply each change of the batch that is still missing.
+		for (i = 0; (dwBatch != QUANTITY_BATCH_NONE) &&
+				(i < arrLines.size()); i++) {
+			wstring::size_type pos = arrLines[i].find_last_of(L'\t');
+			Directory dirComponent(arrLines[i].substr(0, pos).c_str());
+			long lDelta = _wtol(arrLines[i].substr(pos + 1).c_str());
+			bool bApplied;
+
+			if (!Component::ReplayQuantityDelta(dirComponent, lDelta, dwBatch,
+					&bApplied)) {
+				bSuccess = false;
+			} else if (bApplied) {
+				HistoryPending pending;
+				pending.swName = dirComponent.FileName();
+				pending.lDelta = lDelta;
+				pending.dwTime = QuantityHistory::Now();
+				arrDeltas.push_back(pending);
+
+				if (arrApplied != NULL)
+					arrApplied->push_back(arrLines[i].substr(0, pos));
+			}
+		}
+
+		dwBatch = QUANTITY_BATCH_NONE;
+		arrLines.clear();
+	}
+	CloseHandle(hFile);
+
+	// Record what we've applied with a single write to the history.
+	history.RecordDeltas(arrDeltas);
+
+	// Only get rid of the journal if everything was written.
+	if (!bSuccess)
+		return false;
+
+	return FileUtils::Delete(pathJournal.ToString());
+}
+
 /**
  * Opens a workspace.
  *
@@ -226,9 +936,24 @@ void Workspace::PopulateComponents() {
  * @return               TRUE if the operation was successful.
  */
 bool Workspace::Open(Path pathWorkspace) {
+	TraceSpan span(L"Workspace::Open");
+
 	this->dirWorkspace = Directory(pathWorkspace.Parent());
-	PopulateComponents();
+	history.Open(dirWorkspace.Concatenate(QUANTITY_HISTORY_FILE));
+
+	// Finish the batches of quantity changes that were interrupted.
+	Path pathJournal = dirWorkspace.Concatenate(QUANTITY_JOURNAL_FILE);
+	if (pathJournal.Exists()) {
+		FileLock lock(Path((wstring(pathJournal.ToString()) +
+			JOURNAL_LOCK_EXTENSION).c_str()));
+		if (lock.Acquire(JOURNAL_LOCK_TIMEOUT))
+			ReplayQuantityJournal(NULL);
+	}
+
 	PopulateProperties();
+	assets.Open(dirWorkspace);
+	images.Open(dirWorkspace);
+	PopulateComponents();
 
 	bOpened = true;
 	return bOpened;
@@ -250,6 +975,8 @@ bool Workspace::Open(Directory dirWorkspace) {
  * @return TRUE if the operation was successful.
  */
 bool Workspace::Refresh() {
+	TraceSpan span(L"Workspace::Refresh");
+
 	Close();
 	return Open(dirWorkspace);
 }
@@ -260,6 +987,11 @@ bool Workspace::Refresh() {
 void Workspace::Close() {
 	bOpened	= false;
 	arrComponents.clear();
+	mapPaths.clear();
+	ReleaseHandles();
+	NotifyComponentsCleared();
+	history.Close();
+	images.Close();
 }
 
 /**
@@ -278,4 +1010,42 @@ Directory Workspace::GetDirectory() {
  */
 bool Workspace::IsOpened() {
 	return bOpened;
+}
+
+/**
+ * Accounts for the memory used by the workspace and everything it keeps
+ * about its components. The fixed fields of the workspace itself are left
+ * out since they don't grow.
+ *
+ * @param report Report to add the memory to.
+ */
+void Workspace::AccountMemory(MemoryReport *report) {
+	report->Add(MEMORY_PATHS, sizeof(dirWorkspace));
+	report->Add(MEMORY_PROPERTIES, arrProperties.capacity() * sizeof(Property));
+
+	// Components, including the slots that were reserved but not used yet.
+	report->AddComponents(arrComponents.size());
+	report->Add(MEMORY_COMPONENTS, (arrComponents.capacity() -
+		arrComponents.size()) * sizeof(Component));
+	for (size_t i = 0; i < arrComponents.size(); i++)
+		arrComponents[i].AccountMemory(report);
+
+	// Handles.
+	report->Add(MEMORY_INDEXES, (arrHandles.capacity() *
+		sizeof(ComponentHandle)) + (arrSlots.capacity() *
+		sizeof(ComponentSlot)) + (arrFreeSlots.capacity() * sizeof(size_t)));
+
+	// Paths.
+	map<wstring, ComponentHandle>::iterator it;
+	report->AddMapNodes(MEMORY_INDEXES, mapPaths.size(),
+		sizeof(wstring) + sizeof(ComponentHandle));
+	for (it = mapPaths.begin(); it != mapPaths.end(); it++)
+		report->AddString(MEMORY_INDEXES, it->first);
+
+	// Everything that is built from the components.
+	facets.AccountMemory(report);
+	smartFolders.AccountMemory(report);
+	reorderQueue.AccountMemory(report);
+	history.AccountMemory(report);
+	images.AccountMemory(report);
 }
\ No newline at end of file
@@ -10,23 +10,81 @@
 #define _WORKSPACE_H
 
 #include <windows.h>
+#include <map>
 #include "Constants.h"
 #include "Directory.h"
 #include "Component.h"
+#include "FacetIndex.h"
+#include "SmartFolders.h"
+#include "ReorderQueue.h"
+#include "QuantityHistory.h"
+#include "ImageMap.h"
+#include "AssetStore.h"
+#include "WorkspaceListener.h"
+#include "MemoryReport.h"
 
 using namespace std;
 
+// Stable reference to a component made of its slot and a generation.
+typedef DWORD ComponentHandle;
+#define COMPONENT_HANDLE_NONE ((ComponentHandle)-1)
+
+// Bits of a handle used for the slot. The rest are used for the generation.
+#define COMPONENT_SLOT_BITS      20
+#define COMPONENT_SLOT_MASK      ((1UL << COMPONENT_SLOT_BITS) - 1)
+#define COMPONENT_GENERATION_MAX ((1UL << (32 - COMPONENT_SLOT_BITS)) - 2)
+
+// Where the component of a handle currently is.
+typedef struct {
+	size_t nIndex;
+	DWORD dwGeneration;
+	bool bUsed;
+} ComponentSlot;
+
+// A change in the quantity of a single component.
+typedef struct {
+	ComponentHandle hComponent;
+	long lDelta;
+} QuantityDelta;
+
 class Workspace {
 protected:
 	Directory dirWorkspace;
 	vector<Property> arrProperties;
 	vector<Component> arrComponents;
+	vector<ComponentHandle> arrHandles;
+	vector<ComponentSlot> arrSlots;
+	vector<size_t> arrFreeSlots;
+	map<wstring, ComponentHandle> mapPaths;
+	vector<WorkspaceListener*> arrListeners;
+	FacetIndex facets;
+	SmartFolders smartFolders;
+	ReorderQueue reorderQueue;
+	QuantityHistory history;
+	ImageMap images;
+	AssetStore assets;
+	DWORD dwLastBatch;
 	bool bOpened;
 
 	// Population.
 	void PopulateProperties();
 	void PopulateComponents();
 
+	// Handles.
+	ComponentHandle AllocateHandle(size_t nIndex);
+	void ReleaseHandles();
+	void IndexPath(Component *component);
+
+	// Quantity journal.
+	DWORD NextQuantityBatch();
+	bool WriteQuantityJournal(DWORD dwBatch,
+							  const map<ComponentHandle, long> &mapTotals);
+	bool ReplayQuantityJournal(vector<wstring> *arrApplied);
+
+	// Change notifications.
+	void NotifyComponentAdded(Component *component);
+	void NotifyComponentsCleared();
+
 public:
 	// Constructors and destructors.
 	Workspace();
@@ -45,6 +103,42 @@ public:
 	// Components.
 	Component* GetComponent(size_t nIndex);
 	vector<Component> GetComponents();
+	vector<Component>* GetEditableComponents();
+	bool AddComponent(Directory dirComponent, ComponentHandle *hComponent);
+	bool RemoveComponent(ComponentHandle hComponent);
+
+	// Handles.
+	ComponentHandle GetComponentHandle(size_t nIndex);
+	Component* GetComponentByHandle(ComponentHandle hComponent);
+	long GetComponentIndex(ComponentHandle hComponent);
+	ComponentHandle FindComponent(LPCTSTR szPath);
+
+	// Bulk operations.
+	bool ApplyQuantityDeltas(vector<QuantityDelta> arrDeltas);
+
+	// Change notifications.
+	void NotifyComponentChanged(Component *component);
+	void NotifyComponentsChanged(vector<Component*> arrComponents);
+	void NotifyComponentRemoved(Component *component);
+	void NotifyComponentRenamed(Component *component, Directory dirOld);
+	void NotifyComponentSavedAs(Component *component,
+								Component *componentOriginal);
+	void NotifyImageAdded(LPCTSTR szName);
+	void NotifyImageRemoved(LPCTSTR szName);
+	void RescanImages();
+
+	// Listeners and indexes.
+	void AddListener(WorkspaceListener *listener);
+	void RemoveListener(WorkspaceListener *listener);
+	FacetIndex* GetFacets();
+	ReorderQueue* GetReorderQueue();
+	QuantityHistory* GetQuantityHistory();
+	ImageMap* GetImages();
+	AssetStore* GetAssets();
+
+	// Smart folders.
+	bool AddSmartFolder(LPCTSTR szName, LPCTSTR szExpression);
+	SmartFolders* GetSmartFolders();
 
 	// Operations.
 	static bool Create(LPCTSTR szPath);
@@ -56,6 +150,9 @@ public:
 	// Status.
 	Directory GetDirectory();
 	bool IsOpened();
+
+	// Memory.
+	void AccountMemory(MemoryReport *report);
 };
 
 #endif  // _WORKSPACE_H
\ No newline at end of file
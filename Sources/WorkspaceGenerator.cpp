@@ -0,0 +1,319 @@
+/**
+ * WorkspaceGenerator.cpp
+ * Generates synthetic workspaces to measure how the application performs.
+ *
+ * Everything is written through the same classes the application uses, so
+ * the generated workspace looks exactly like one created by hand. The random
+ * numbers come from a seeded generator of our own, which makes the same
+ * settings always produce the same workspace on every device.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#include "WorkspaceGenerator.h"
+#include "Workspace.h"
+#include "Constants.h"
+#include "FileUtils.h"
+
+// Packages and value units picked for the generated components.
+static LPCTSTR aszPackages[] = { L"0402", L"0603", L"0805", L"1206", L"SOT-23",
+	L"SOIC-8", L"TSSOP-14", L"DIP-8", L"TO-92", L"TO-220" };
+static LPCTSTR aszUnits[] = { L"R", L"k", L"M", L"pF", L"nF", L"uF", L"V" };
+#define PACKAGES_COUNT (sizeof(aszPackages) / sizeof(LPCTSTR))
+#define UNITS_COUNT    (sizeof(aszUnits) / sizeof(LPCTSTR))
+
+// A tiny 2x2 24-bit bitmap used for every generated image.
+static const BYTE abPlaceholderImage[] = {
+	'B', 'M', 70, 0, 0, 0, 0, 0, 0, 0, 54, 0, 0, 0,
+	40, 0, 0, 0, 2, 0, 0, 0, 2, 0, 0, 0, 1, 0, 24, 0, 0, 0, 0, 0,
+	16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0, 0,
+	0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0, 0 };
+
+/**
+ * Initializes the generator with the default settings.
+ */
+WorkspaceGenerator::WorkspaceGenerator() {
+	settings = GetDefaultSettings();
+	dwRandom = settings.dwSeed;
+}
+
+/**
+ * Initializes the generator with custom settings.
+ *
+ * @param settings Shape of the workspace to be generated.
+ */
+WorkspaceGenerator::WorkspaceGenerator(GeneratorSettings settings) {
+	this->settings = settings;
+	dwRandom = settings.dwSeed;
+}
+
+/**
+ * Generates a workspace.
+ *
+ * @param  szPath Path of the workspace directory. Must not exist yet.
+ * @return        TRUE if the operation was successful.
+ */
+bool WorkspaceGenerator::Generate(LPCTSTR szPath) {
+	Directory dirWorkspace(szPath);
+
+	// Always generate the same workspace for the same settings.
+	dwRandom = settings.dwSeed;
+
+	// Create the skeleton and the images.
+	if (!Workspace::Create(szPath))
+		return false;
+	if (!GenerateImages(dirWorkspace))
+		return false;
+
+	// Create the components.
+	for (size_t i = 0; i < settings.nComponents; i++) {
+		if (!GenerateComponent(dirWorkspace, i))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Builds synthetic components in memory without touching the disk, so that
+ * the indexes can be measured against workspaces far larger than what would
+ * be practical to generate.
+ *
+ * @param dirComponents Folder where the components would live.
+ * @param nComponents   Number of components to be built.
+ * @param arrComponents Vector where the components will be appended to.
+ */
+void WorkspaceGenerator::Generate(Directory dirComponents, size_t nComponents,
+								  vector<Component> *arrComponents) {
+	dwRandom = settings.dwSeed;
+
+	arrComponents->reserve(arrComponents->size() + nComponents);
+	for (size_t i = 0; i < nComponents; i++) {
+		arrComponents->push_back(Component(dirComponents,
+			BuildName(L"Part ", i).c_str()));
+		BuildComponent(&arrComponents->back());
+	}
+}
+
+/**
+ * Generates a single component.
+ *
+ * @param  dirWorkspace Workspace directory.
+ * @param  nIndex       Index of the component.
+ * @return              TRUE if the operation was successful.
+ */
+bool WorkspaceGenerator::GenerateComponent(Directory dirWorkspace,
+										   size_t nIndex) {
+	Component component;
+
+	// Name, quantity and properties.
+	component.SetName(BuildName(L"Part ", nIndex).c_str());
+	BuildComponent(&component);
+
+	// Write it to disk.
+	if (!component.Save(dirWorkspace.Concatenate(COMPONENTS_ROOT), true))
+		return false;
+	if (!component.SaveNotes(BuildNotes(RandomBetween(settings.nMinNotesLength,
+			settings.nMaxNotesLength)).c_str()))
+		return false;
+
+	// Reference one of the images.
+	if ((settings.nImages > 0) &&
+			(RandomBetween(1, 100) <= settings.nImagePercent)) {
+		wstring swImage = BuildName(L"image", RandomBetween(0,
+			settings.nImages - 1));
+
+		if (!FileUtils::SaveContents(component.GetDirectory().Concatenate(
+				IMAGE_FILE).ToString(), swImage.c_str()))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Fills in the quantity and properties of a synthetic component.
+ *
+ * @param component Component that already has its name set.
+ */
+void WorkspaceGenerator::BuildComponent(Component *component) {
+	WCHAR szValue[33];
+
+	component->SetQuantity(RandomBetween(0, 500));
+
+	// Category and sub-category.
+	if ((settings.nCategories > 0) &&
+			(RandomBetween(1, 100) > settings.nUncategorizedPercent)) {
+		size_t nCategory = RandomBetween(0, settings.nCategories - 1);
+		AddProperty(component, PROPERTY_CATEGORY,
+			BuildName(L"Category ", nCategory).c_str());
+
+		if (settings.nSubCategories > 0) {
+			AddProperty(component, PROPERTY_SUBCATEGORY, BuildName(L"Group ",
+				RandomBetween(0, settings.nSubCategories - 1)).c_str());
+		}
+	}
+
+	// Value, package and reorder level.
+	wstring swValue(_ltow(RandomBetween(1, 999), szValue, 10));
+	swValue += aszUnits[RandomBetween(0, UNITS_COUNT - 1)];
+	AddProperty(component, PROPERTY_VALUE, swValue.c_str());
+	AddProperty(component, PROPERTY_PACKAGE,
+		aszPackages[RandomBetween(0, PACKAGES_COUNT - 1)]);
+	AddProperty(component, PROPERTY_REORDER,
+		_ltow(RandomBetween(0, 50), szValue, 10));
+
+	// Filler properties.
+	size_t nProperties = RandomBetween(settings.nMinProperties,
+		settings.nMaxProperties);
+	for (size_t i = 0; i < nProperties; i++) {
+		AddProperty(component, BuildName(L"Parameter ", i).c_str(),
+			_ltow(Random() % 100000, szValue, 10));
+	}
+}
+
+/**
+ * Generates the images that the components can reference.
+ *
+ * @param  dirWorkspace Workspace directory.
+ * @return              TRUE if the operation was successful.
+ */
+bool WorkspaceGenerator::GenerateImages(Directory dirWorkspace) {
+	Directory dirImages = dirWorkspace.Concatenate(ASSETS_ROOT).Concatenate(
+		IMAGES_DIR);
+
+	for (size_t i = 0; i < settings.nImages; i++) {
+		Path pathImage = dirImages.Concatenate(BuildName(L"image", i).c_str());
+		DWORD dwWritten;
+		pathImage.AppendString(IMAGE_EXTENSION);
+
+		// Write the placeholder bitmap.
+		HANDLE hFile = CreateFile(pathImage.ToString(), GENERIC_WRITE, 0, NULL,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			return false;
+		BOOL bWritten = WriteFile(hFile, abPlaceholderImage,
+			sizeof(abPlaceholderImage), &dwWritten, NULL);
+		CloseHandle(hFile);
+
+		if (!bWritten)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Builds the notes of a component.
+ *
+ * @param  nLength Number of characters in the notes.
+ * @return         Lines of filler text.
+ */
+wstring WorkspaceGenerator::BuildNotes(size_t nLength) {
+	LPCTSTR szFiller = L"Lorem ipsum dolor sit amet, consectetur adipiscing "
+		L"elit, sed do eiusmod tempor incididunt ut labore.";
+	size_t nFiller = wcslen(szFiller);
+	wstring swNotes;
+
+	swNotes.reserve(nLength + 2);
+	while (swNotes.length() + nFiller + 2 <= nLength) {
+		swNotes += szFiller;
+		swNotes += L"\r\n";
+	}
+	if (nLength - swNotes.length() > nFiller) {
+		swNotes.append(szFiller);
+	} else {
+		swNotes.append(szFiller, nLength - swNotes.length());
+	}
+	swNotes += L"\r\n";
+
+	return swNotes;
+}
+
+/**
+ * Adds a property to a component.
+ *
+ * @param component Component to have the property added.
+ * @param szName    Property name.
+ * @param szValue   Property value.
+ */
+void WorkspaceGenerator::AddProperty(Component *component, LPCTSTR szName,
+									 LPCTSTR szValue) {
+	Property prop;
+
+	prop.SetName(szName);
+	prop.SetValue(szValue);
+	component->AddProperty(prop);
+}
+
+/**
+ * Builds a name made of a prefix followed by a number.
+ *
+ * @param  szPrefix Text before the number.
+ * @param  nIndex   Number to be appended.
+ * @return          Built name.
+ */
+wstring WorkspaceGenerator::BuildName(LPCTSTR szPrefix, size_t nIndex) {
+	WCHAR szNumber[33];
+	wstring swName(szPrefix);
+
+	swName += _ltow((long)nIndex, szNumber, 10);
+	return swName;
+}
+
+/**
+ * Gets the next number of our linear congruential generator.
+ *
+ * @return Pseudo-random 31-bit number.
+ */
+DWORD WorkspaceGenerator::Random() {
+	dwRandom = (dwRandom * 1103515245UL) + 12345UL;
+	return (dwRandom >> 1) & 0x7FFFFFFF;
+}
+
+/**
+ * Gets a pseudo-random number inside a range.
+ *
+ * @param  nMin Smallest number that can be returned.
+ * @param  nMax Largest number that can be returned.
+ * @return      Number between nMin and nMax, inclusive.
+ */
+size_t WorkspaceGenerator::RandomBetween(size_t nMin, size_t nMax) {
+	if (nMax <= nMin)
+		return nMin;
+
+	return nMin + (Random() % (nMax - nMin + 1));
+}
+
+/**
+ * Gets the settings used to generate the workspace.
+ *
+ * @return Shape of the generated workspace.
+ */
+GeneratorSettings WorkspaceGenerator::GetSettings() {
+	return settings;
+}
+
+/**
+ * Gets the settings of a workspace that looks like a typical parts bin.
+ *
+ * @return Default generator settings.
+ */
+GeneratorSettings WorkspaceGenerator::GetDefaultSettings() {
+	GeneratorSettings settings;
+
+	settings.nComponents = 1000;
+	settings.nCategories = 12;
+	settings.nSubCategories = 6;
+	settings.nUncategorizedPercent = 5;
+	settings.nMinProperties = 2;
+	settings.nMaxProperties = 8;
+	settings.nMinNotesLength = 0;
+	settings.nMaxNotesLength = 1024;
+	settings.nImages = 40;
+	settings.nImagePercent = 60;
+	settings.dwSeed = 0x5EED;
+
+	return settings;
+}
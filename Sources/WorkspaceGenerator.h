@@ -0,0 +1,67 @@
+/**
+ * WorkspaceGenerator.h
+ * Generates synthetic workspaces to measure how the application performs.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _WORKSPACE_GENERATOR_H
+#define _WORKSPACE_GENERATOR_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include "Directory.h"
+#include "Component.h"
+
+using namespace std;
+
+// Shape of the generated workspace.
+typedef struct {
+	size_t nComponents;
+	size_t nCategories;
+	size_t nSubCategories;
+	size_t nUncategorizedPercent;
+	size_t nMinProperties;
+	size_t nMaxProperties;
+	size_t nMinNotesLength;
+	size_t nMaxNotesLength;
+	size_t nImages;
+	size_t nImagePercent;
+	DWORD dwSeed;
+} GeneratorSettings;
+
+class WorkspaceGenerator {
+protected:
+	GeneratorSettings settings;
+	DWORD dwRandom;
+
+	// Generation.
+	bool GenerateComponent(Directory dirWorkspace, size_t nIndex);
+	void BuildComponent(Component *component);
+	bool GenerateImages(Directory dirWorkspace);
+	wstring BuildNotes(size_t nLength);
+	static void AddProperty(Component *component, LPCTSTR szName,
+							LPCTSTR szValue);
+	static wstring BuildName(LPCTSTR szPrefix, size_t nIndex);
+
+	// Random numbers.
+	DWORD Random();
+	size_t RandomBetween(size_t nMin, size_t nMax);
+
+public:
+	// Constructors and destructors.
+	WorkspaceGenerator();
+	WorkspaceGenerator(GeneratorSettings settings);
+
+	// Generation.
+	bool Generate(LPCTSTR szPath);
+	void Generate(Directory dirComponents, size_t nComponents,
+				  vector<Component> *arrComponents);
+
+	// Settings.
+	GeneratorSettings GetSettings();
+	static GeneratorSettings GetDefaultSettings();
+};
+
+#endif  // _WORKSPACE_GENERATOR_H
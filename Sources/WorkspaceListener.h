@@ -0,0 +1,43 @@
+/**
+ * WorkspaceListener.h
+ * Interface for objects that want to be notified of changes to the components
+ * in a workspace.
+ *
+ * @author Nathan Campos <nathan@innoveworkshop.com>
+ */
+
+#ifndef _WORKSPACE_LISTENER_H
+#define _WORKSPACE_LISTENER_H
+
+#include <windows.h>
+#include <vector>
+#include "Component.h"
+
+using namespace std;
+
+class WorkspaceListener {
+public:
+	virtual ~WorkspaceListener() {};
+
+	// Component events.
+	virtual void ComponentAdded(Component *component) = 0;
+	virtual void ComponentChanged(Component *component) = 0;
+	virtual void ComponentRemoved(Component *component) = 0;
+	virtual void ComponentRenamed(Component *component, Directory dirOld) = 0;
+
+	/**
+	 * A batch of components was changed at once. By default this is the same
+	 * as getting a change event for each of them.
+	 *
+	 * @param arrComponents Components that were changed.
+	 */
+	virtual void ComponentsChanged(vector<Component*> arrComponents) {
+		for (size_t i = 0; i < arrComponents.size(); i++)
+			ComponentChanged(arrComponents[i]);
+	};
+
+	// Workspace events.
+	virtual void ComponentsCleared() = 0;
+};
+
+#endif  // _WORKSPACE_LISTENER_H
@@ -52,13 +52,26 @@
 #define IDS_CAP_COMPONENT               40028
 #define IDM_COMP_DELETE                 40030
 #define IDM_COMP_DATASHEET              40032
+#define IDM_FILE_EXPORTREORDER          40033
+#define IDM_FILE_FINDDUPLICATES         40034
+#define IDM_FILE_IMPORTBOM              40035
+#define IDM_FILE_TOPCONSUMERS           40036
+#define IDM_FILE_REBUILDTHUMBS          40037
+#define IDM_FILE_DEDUPASSETS            40038
+#define IDM_HELP_LATENCY                40039
+#define IDM_HELP_BENCHMARK              40040
+#define IDM_HELP_TRACE                  40041
+#define IDM_HELP_SAVETRACE              40042
+#define IDM_HELP_IOSTATS                40043
+#define IDM_HELP_MEMORY                 40044
+#define IDM_FILE_NEW_SMARTFOLDER        40045
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        116
-#define _APS_NEXT_COMMAND_VALUE         40033
+#define _APS_NEXT_COMMAND_VALUE         40046
 #define _APS_NEXT_CONTROL_VALUE         1018
 #define _APS_NEXT_SYMED_VALUE           101
 #endif